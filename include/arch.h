@@ -29,6 +29,29 @@ void arch_disable_interrupts(void); // Disable hardware interrupts
 void arch_halt(void);              // Halt the CPU
 void arch_idle(void);              // Idle the CPU (halt with interrupts enabled)
 
+// Local interrupt state save/restore for short critical sections
+#if defined(ARCH_X86_64)
+static inline uintptr_t arch_irq_save(void) {
+    uintptr_t flags;
+    asm volatile("pushfq; popq %0; cli" : "=r"(flags) :: "memory");
+    return flags;
+}
+#elif defined(ARCH_I386)
+static inline uintptr_t arch_irq_save(void) {
+    uintptr_t flags;
+    asm volatile("pushfl; popl %0; cli" : "=r"(flags) :: "memory");
+    return flags;
+}
+#endif
+
+#if defined(ARCH_X86_64) || defined(ARCH_I386)
+static inline void arch_irq_restore(uintptr_t flags) {
+    if (flags & 0x200) {  // IF was set on entry
+        asm volatile("sti" ::: "memory");
+    }
+}
+#endif
+
 // Architecture-independent interrupt management
 void arch_interrupts_init(void);   // Initialize interrupt system (IDT, PIC, etc.)
 void arch_register_interrupt_handler(uint8_t n, void (*handler)(void* regs));
@@ -39,6 +62,7 @@ void arch_disable_irq(uint8_t irq); // Disable specific IRQ line
 void arch_timer_init(uint32_t frequency_hz); // Initialize system timer
 uint32_t arch_timer_get_ticks(void);         // Get current timer tick count
 uint32_t arch_timer_get_frequency(void);     // Get timer frequency in Hz
+uint64_t arch_read_tsc(void);                // Read CPU timestamp counter (cycles)
 
 // Architecture-independent context structure (opaque to generic code)
 typedef struct arch_context arch_context_t;
@@ -57,6 +81,10 @@ void arch_io_outw(uint16_t port, uint16_t value);
 void arch_io_outl(uint16_t port, uint32_t value);
 #endif
 
+// Multiprocessor support
+uint32_t arch_cpu_index(void);     // Logical index of the executing CPU (0 = BSP)
+void arch_smp_cpu_init(uint32_t cpu, uintptr_t irq_stack_top);  // Per-CPU GDT/TSS/IDT on an AP
+
 // Architecture name and information
 const char* arch_get_name(void);
 const char* arch_get_description(void);
@@ -82,6 +82,10 @@ typedef struct tss_entry_struct tss_entry_t;
 // Public function declarations
 void init_gdt();
 void set_kernel_stack(uint32_t stack);
+
+// Per-CPU descriptor tables for application processors
+void gdt_init_cpu(uint32_t cpu, uint32_t kernel_stack);
+uint32_t gdt_cpu_index(void);
 extern void gdt_load(uint32_t gdt_ptr_addr); // Assembly function
 extern void tss_load(uint16_t tss_segment);   // Assembly function
 
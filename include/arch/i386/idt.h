@@ -42,6 +42,9 @@ typedef struct idt_ptr_struct idt_ptr_t;
 // Initializes the IDT.
 void init_idt(void);
 
+// Loads the already-built IDT on an application processor.
+void idt_reload(void);
+
 // Declarations for ISR stubs (assembly functions).
 // CPU Exceptions (0-31)
 extern void isr0(void); extern void isr1(void); extern void isr2(void); extern void isr3(void);
@@ -59,6 +62,9 @@ extern void isr36(void); extern void isr37(void); extern void isr38(void); exter
 extern void isr40(void); extern void isr41(void); extern void isr42(void); extern void isr43(void);
 extern void isr44(void); extern void isr45(void); extern void isr46(void); extern void isr47(void);
 
+// Local APIC vectors (IPIs and spurious)
+extern void isr240(void); extern void isr241(void); extern void isr242(void); extern void isr255(void);
+
 // Assembly function to load the IDT register (lidt).
 // This is typically in a file like gdt_asm.s or interrupts_asm.s.
 extern void idt_load(uint32_t idt_ptr_addr);
@@ -49,6 +49,7 @@
 #define PAGE_DIRTY          0x040   // Page has been written to (set by CPU)
 #define PAGE_SIZE_FLAG      0x080   // 4MB page (only in page directory)
 #define PAGE_GLOBAL         0x100   // Global page (not flushed on CR3 load)
+#define PAGE_COW            0x200   // Copy-on-write (software-available bit)
 
 // Extract address from page table entry
 #define PAGE_GET_ADDR(entry) ((entry) & 0xFFFFF000)
@@ -87,6 +88,8 @@ void map_page(page_directory_t *dir, uint32_t virtual_addr, uint32_t physical_ad
 void unmap_page(page_directory_t *dir, uint32_t virtual_addr);
 uint32_t get_physical_address(page_directory_t *dir, uint32_t virtual_addr);
 int is_page_present(page_directory_t *dir, uint32_t virtual_addr);
+uint32_t get_page_flags(page_directory_t *dir, uint32_t virtual_addr);
+int set_page_flags(page_directory_t *dir, uint32_t virtual_addr, uint32_t flags);
 
 // TLB management
 void flush_tlb_single(uint32_t virtual_addr);
@@ -37,6 +37,7 @@ typedef struct {
 } __attribute__((packed)) idt_ptr_t;
 
 void init_idt(void);
+void idt_reload(void);
 
 /* CPU exceptions 0-31 */
 extern void isr0(void);  extern void isr1(void);  extern void isr2(void);  extern void isr3(void);
@@ -54,6 +55,9 @@ extern void isr36(void); extern void isr37(void); extern void isr38(void); exter
 extern void isr40(void); extern void isr41(void); extern void isr42(void); extern void isr43(void);
 extern void isr44(void); extern void isr45(void); extern void isr46(void); extern void isr47(void);
 
+/* Local APIC vectors (IPIs and spurious) */
+extern void isr240(void); extern void isr241(void); extern void isr242(void); extern void isr255(void);
+
 /* Syscall vector */
 extern void isr128(void);
 
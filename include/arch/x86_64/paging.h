@@ -39,6 +39,7 @@
 #define PAGE_DIRTY          0x040
 #define PAGE_SIZE_FLAG      0x080
 #define PAGE_GLOBAL         0x100
+#define PAGE_COW            0x200   // Copy-on-write (software-available bit)
 #define PAGE_NOEXEC         (1ULL << 63)
 
 typedef struct {
@@ -59,6 +60,8 @@ void map_page(page_directory_t* dir, uintptr_t virtual_addr, uintptr_t physical_
 void unmap_page(page_directory_t* dir, uintptr_t virtual_addr);
 uintptr_t get_physical_address(page_directory_t* dir, uintptr_t virtual_addr);
 int is_page_present(page_directory_t* dir, uintptr_t virtual_addr);
+uint32_t get_page_flags(page_directory_t* dir, uintptr_t virtual_addr);
+int set_page_flags(page_directory_t* dir, uintptr_t virtual_addr, uint32_t flags);
 
 void flush_tlb_single(uintptr_t virtual_addr);
 void flush_tlb_full(void);
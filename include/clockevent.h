@@ -0,0 +1,60 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * include/clockevent.h
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+/*
+ * DEVELOPER_NOTE_BLOCK
+ * Module Overview:
+ * - This file is part of the aOS production kernel/userspace codebase.
+ * - Review public symbols in this unit to understand contracts with adjacent modules.
+ * - Keep behavior-focused comments near non-obvious invariants, state transitions, and safety checks.
+ * - Avoid changing ABI/data-layout assumptions without updating dependent modules.
+ */
+
+#ifndef CLOCKEVENT_H
+#define CLOCKEVENT_H
+
+#include <stdint.h>
+
+// Timer device driving the scheduler, best first
+typedef enum {
+    CLOCKEVENT_MODE_PIT = 0,        // Periodic PIT IRQ0 on the BSP (boot default)
+    CLOCKEVENT_MODE_LAPIC_PERIODIC, // Periodic LAPIC timer per CPU (no usable TSC)
+    CLOCKEVENT_MODE_LAPIC_ONESHOT,  // One-shot LAPIC countdown per CPU, tickless
+    CLOCKEVENT_MODE_TSC_DEADLINE    // One-shot TSC deadline per CPU, tickless
+} clockevent_mode_t;
+
+// Longest an idle CPU sleeps without an event (the BSP also polls the NIC)
+#define CLOCKEVENT_IDLE_MAX_TICKS       100
+#define CLOCKEVENT_BSP_IDLE_MAX_TICKS   10
+
+/*
+ * Calibrate the TSC and LAPIC timer against PIT channel 2 and move the BSP
+ * from the PIT tick to the best available mode. Call once after
+ * arch_timer_init() and before smp_init().
+ */
+void clockevent_init(void);
+
+// Start the calibrated LAPIC timer on an application processor
+void clockevent_init_ap(void);
+
+/*
+ * Re-arm this CPU's one-shot timer for its next scheduler event (time-slice
+ * expiry, sleeper wake-up, module timer). No-op in periodic modes.
+ */
+void clockevent_reprogram(void);
+
+clockevent_mode_t clockevent_get_mode(void);
+const char* clockevent_mode_name(void);
+int clockevent_is_oneshot(void);
+
+uint32_t clockevent_tsc_khz(void);      // 0 when the TSC is not used
+uint32_t clockevent_lapic_khz(void);    // LAPIC timer input after the divider
+uint32_t clockevent_events(void);       // Timer interrupts taken on this CPU
+
+#endif // CLOCKEVENT_H
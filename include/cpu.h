@@ -74,5 +74,6 @@ void cpu_log_summary(void);
 const cpu_info_t* cpu_get_info(void);
 uint32_t cpu_get_detected_count(void);
 uint32_t cpu_get_online_count(void);
+void cpu_set_online_count(uint32_t online);
 
 #endif // CPU_H
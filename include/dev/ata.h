@@ -35,6 +35,10 @@
 #define ATA_PRIMARY_COMMAND      0x1F7
 #define ATA_PRIMARY_ALT_STATUS   0x3F6
 #define ATA_PRIMARY_CTRL         0x3F6
+#define ATA_PRIMARY_IRQ          14
+
+// Device control register bits
+#define ATA_CTRL_NIEN            0x02  // Mask INTRQ
 
 // ATA Status Register Bits
 #define ATA_SR_BSY  0x80  // Busy
@@ -51,6 +55,10 @@
 #define ATA_CMD_READ_PIO_EXT    0x24
 #define ATA_CMD_WRITE_PIO       0x30
 #define ATA_CMD_WRITE_PIO_EXT   0x34
+#define ATA_CMD_READ_DMA        0xC8
+#define ATA_CMD_READ_DMA_EXT    0x25
+#define ATA_CMD_WRITE_DMA       0xCA
+#define ATA_CMD_WRITE_DMA_EXT   0x35
 #define ATA_CMD_CACHE_FLUSH     0xE7
 #define ATA_CMD_CACHE_FLUSH_EXT 0xEA
 #define ATA_CMD_IDENTIFY        0xEC
@@ -62,27 +70,73 @@
 // Block size
 #define ATA_SECTOR_SIZE 512
 
+// Addressing limits
+#define ATA_LBA28_MAX_SECTOR        0x0FFFFFFFu  // Last sector a 28-bit command can reach
+#define ATA_LBA28_MAX_COUNT         256          // Sector count register 0 means 256
+#define ATA_LBA48_MAX_COUNT         65536        // 16-bit sector count, 0 means 65536
+#define ATA_MAX_SECTORS_PER_REQUEST ATA_LBA48_MAX_COUNT  // LBA28-only drives: ATA_LBA28_MAX_COUNT
+
+// PCI IDE bus-master registers (primary channel, offsets from BAR4)
+#define ATA_BM_COMMAND           0x00
+#define ATA_BM_STATUS            0x02
+#define ATA_BM_PRDT              0x04
+
+#define ATA_BM_CMD_START         0x01
+#define ATA_BM_CMD_READ          0x08  // Bus master writes to memory (disk read)
+
+#define ATA_BM_SR_ACTIVE         0x01
+#define ATA_BM_SR_ERR            0x02
+#define ATA_BM_SR_IRQ            0x04
+
+#define ATA_PRD_EOT              0x8000
+#define ATA_DMA_MAX_SECTORS      256    // Bounce buffer size; longer requests are chunked
+#define ATA_DMA_TIMEOUT_MS       5000
+
+typedef struct ata_stats {
+    uint32_t dma_capable;        // Bus-master IDE controller found
+    uint32_t dma_enabled;        // DMA used for transfers (else PIO)
+    uint32_t lba48;              // Drive supports 48-bit addressing
+    uint32_t dma_reads;
+    uint32_t dma_writes;
+    uint32_t pio_reads;
+    uint32_t pio_writes;
+    uint32_t dma_errors;         // DMA failures retried with PIO
+    uint32_t irqs;
+    uint32_t commands;           // Read/write commands issued to the drive
+    uint32_t lba48_commands;     // ... of which used the EXT (48-bit) form
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+    uint64_t sleep_ns;           // Time callers spent blocked instead of polling
+} ata_stats_t;
+
 // Initialize ATA driver
 void ata_init(void);
 
 // Read sectors from disk
-// lba: Logical Block Address (28-bit LBA)
-// count: Number of sectors to read (1-255)
+// lba: Logical Block Address (48-bit commands are used past the 28-bit limit)
+// count: Number of sectors to read (queued in pieces of one command's sector count)
 // buffer: Buffer to store read data (must be at least count * 512 bytes)
 // Returns: 0 on success, -1 on error
-int ata_read_sectors(uint32_t lba, uint8_t count, uint8_t* buffer);
+int ata_read_sectors(uint32_t lba, uint32_t count, uint8_t* buffer);
 
 // Write sectors to disk
-// lba: Logical Block Address (28-bit LBA)
-// count: Number of sectors to write (1-255)
+// lba: Logical Block Address (48-bit commands are used past the 28-bit limit)
+// count: Number of sectors to write (queued in pieces of one command's sector count)
 // buffer: Buffer containing data to write (must be at least count * 512 bytes)
 // Returns: 0 on success, -1 on error
-int ata_write_sectors(uint32_t lba, uint8_t count, const uint8_t* buffer);
+int ata_write_sectors(uint32_t lba, uint32_t count, const uint8_t* buffer);
 
 // Check if ATA drive is available
 int ata_drive_available(void);
 
-// Get total sector count of the disk
+// Get total sector count of the disk (clamped to 32 bits, i.e. 2 TiB)
 uint32_t ata_get_sector_count(void);
 
+// Block-layer device number of the drive, or -1 if there is none
+int ata_get_blk_device(void);
+
+// Switch between bus-master DMA and PIO (DMA only if the controller supports it)
+int ata_set_dma_enabled(int enabled);
+void ata_get_stats(ata_stats_t* stats);
+
 #endif // ATA_H
@@ -0,0 +1,177 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * include/dev/blkdev.h
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+/*
+ * DEVELOPER_NOTE_BLOCK
+ * Module Overview:
+ * - This file is part of the aOS production kernel/userspace codebase.
+ * - Review public symbols in this unit to understand contracts with adjacent modules.
+ * - Keep behavior-focused comments near non-obvious invariants, state transitions, and safety checks.
+ * - Avoid changing ABI/data-layout assumptions without updating dependent modules.
+ */
+
+#ifndef BLKDEV_H
+#define BLKDEV_H
+
+#include <stdint.h>
+#include <process.h>
+
+/*
+ * Block I/O request queue.
+ *
+ * Clients submit bios (one LBA range, one buffer). Each device keeps its
+ * pending bios sorted by LBA and dispatches them with a deadline elevator:
+ * C-LOOK order from the last dispatched position, except that a bio past
+ * its deadline goes first. At dispatch, adjacent bios of the same direction
+ * are merged into one request of up to max_sectors. While a device is
+ * plugged, bios only collect in the queue; unplugging (or waiting on a bio)
+ * sends them out, so bursts become large sequential commands.
+ *
+ * Drivers implement submit(). Drivers that sleep may complete the request
+ * before returning; asynchronous drivers return at once and call
+ * blk_end_request() from their interrupt handler.
+ */
+
+#define BLK_SECTOR_SIZE         512
+#define BLK_MAX_DEVICES         4
+#define BLK_MAX_QUEUE_DEPTH     32
+#define BLK_NAME_LEN            16
+
+#define BLK_READ_EXPIRE_MS      500
+#define BLK_WRITE_EXPIRE_MS     5000
+#define BLK_POLL_INTERVAL_MS    10      // Sleeping waiters also call ops->poll this often
+
+#define BLK_DEPTH_BUCKETS       8       // 1, 2, 3-4, 5-8, ... 65+
+#define BLK_LAT_BUCKETS         16      // <64us, <128us, ... <1s, >=1s
+#define BLK_LAT_BASE_US         64
+
+// blk_driver_ops_t.flags
+#define BLK_DRIVER_ATOMIC_SUBMIT 0x01   // submit() never sleeps; may be called from IRQ context
+
+// blk_bio_t.flags
+#define BLK_BIO_WRITE           0x01
+
+struct blk_device;
+
+typedef struct blk_bio {
+    uint32_t dev;
+    uint32_t lba;
+    uint32_t count;             // Sectors
+    uint8_t* buffer;
+    uint32_t flags;
+    volatile uint32_t done;
+    int status;                 // 0 or -1 once done
+    uint32_t seq;               // Submission order, for overlap ordering
+    uint32_t deadline_ms;
+    uint64_t submit_ns;
+    struct blk_bio* next;       // Pending list (sorted by LBA)
+    struct blk_bio* rq_next;    // Bios merged into the same request
+} blk_bio_t;
+
+typedef struct blk_request {
+    uint32_t lba;
+    uint32_t count;
+    uint32_t flags;             // BLK_BIO_WRITE
+    uint32_t nr_bios;
+    blk_bio_t* bios;
+    void* driver_data;          // Free for the driver while the request is in flight
+    uint8_t in_use;
+} blk_request_t;
+
+typedef struct blk_driver_ops {
+    int (*submit)(struct blk_device* dev, blk_request_t* req);
+    void (*poll)(struct blk_device* dev);   // Optional: reap completions with IRQs off
+    uint32_t flags;
+} blk_driver_ops_t;
+
+typedef struct blk_stats {
+    uint32_t bios;
+    uint32_t requests;
+    uint32_t merged;            // Bios that rode along in another bio's request
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+    uint32_t errors;
+    uint32_t expired;           // Requests dispatched out of order for their deadline
+    uint32_t max_depth;
+    uint32_t depth_hist[BLK_DEPTH_BUCKETS];     // Queue depth seen by each new bio
+    uint32_t latency_hist[BLK_LAT_BUCKETS];     // Bio submit-to-completion time
+} blk_stats_t;
+
+typedef struct blk_device {
+    char name[BLK_NAME_LEN];
+    uint32_t id;
+    uint32_t total_sectors;
+    uint32_t max_sectors;       // Largest request the driver accepts
+    uint32_t queue_depth;       // Requests the driver can have in flight
+    const blk_driver_ops_t* ops;
+    void* driver_data;
+
+    blk_bio_t* pending;
+    uint32_t nr_pending;
+    uint32_t in_flight;
+    uint32_t plugged;
+    uint32_t waiters;           // Tasks in blk_wait_bio(); dispatch ignores the plug
+    uint32_t head_lba;          // Elevator position: end of the last dispatch
+    uint32_t next_seq;
+    blk_request_t requests[BLK_MAX_QUEUE_DEPTH];
+    wait_queue_t wait;
+    blk_stats_t stats;
+} blk_device_t;
+
+// Walks the sectors of a request across its bios
+typedef struct blk_rq_iter {
+    blk_bio_t* bio;
+    uint32_t sector;            // Within bio
+} blk_rq_iter_t;
+
+/*
+ * Register a disk. Returns the device number used by blk_* and the buffer
+ * cache, or -1 when the table is full.
+ */
+int blk_register_device(const char* name, const blk_driver_ops_t* ops, void* driver_data,
+                        uint32_t total_sectors, uint32_t max_sectors, uint32_t queue_depth);
+blk_device_t* blk_get_device(uint32_t dev);
+int blk_find_device(const char* name);
+uint32_t blk_device_count(void);
+
+/*
+ * Parse a filesystem mount source such as "lba=2048", "vda",
+ * "dev=vda lba=2048" or "/dev/vda:lba=2048" (tokens split on space, comma
+ * or ':' before "lba"). Missing parts default to device 0 and LBA 0.
+ * Returns -1 when a named device is not registered.
+ */
+int blk_parse_source(const char* source, uint32_t* dev, uint32_t* lba);
+
+// Asynchronous interface: submit, optionally more, then wait for each bio
+void blk_bio_init(blk_bio_t* bio, uint32_t lba, uint32_t count, void* buffer, int write);
+int blk_submit_bio(uint32_t dev, blk_bio_t* bio);
+int blk_wait_bio(blk_bio_t* bio);
+
+// Synchronous helpers; ranges longer than max_sectors are split
+int blk_read(uint32_t dev, uint32_t lba, uint32_t count, void* buffer);
+int blk_write(uint32_t dev, uint32_t lba, uint32_t count, const void* buffer);
+
+// Hold back dispatch while a burst is queued; nests
+void blk_plug(uint32_t dev);
+void blk_unplug(uint32_t dev);
+
+// Driver side: complete a request handed to submit() (IRQ-safe)
+void blk_end_request(blk_device_t* dev, blk_request_t* req, int status);
+
+// Driver side: sector-by-sector access to request data starting at `sector`
+void blk_rq_iter_init(blk_rq_iter_t* it, blk_request_t* req, uint32_t sector);
+uint8_t* blk_rq_iter_next(blk_rq_iter_t* it);
+void blk_rq_copy_out(blk_request_t* req, uint32_t sector, void* dst, uint32_t count);
+void blk_rq_copy_in(blk_request_t* req, uint32_t sector, const void* src, uint32_t count);
+
+int blk_get_stats(uint32_t dev, blk_stats_t* stats);
+
+#endif // BLKDEV_H
@@ -72,6 +72,12 @@
 #define E1000_TCTL_EN       (1 << 1)   // Transmit Enable
 #define E1000_TCTL_PSP      (1 << 3)   // Pad Short Packets
 
+// Interrupt Cause/Mask Bits
+#define E1000_ICR_RXDMT0    (1 << 4)   // RX Descriptor Minimum Threshold
+#define E1000_ICR_RXO       (1 << 6)   // Receiver Overrun
+#define E1000_ICR_RXT0      (1 << 7)   // Receiver Timer Interrupt
+#define E1000_IMS_RX        (E1000_ICR_RXT0 | E1000_ICR_RXO | E1000_ICR_RXDMT0)
+
 // Descriptor Status Bits
 #define E1000_TXD_STAT_DD   (1 << 0)   // Descriptor Done
 #define E1000_TXD_CMD_EOP   (1 << 0)   // End of Packet
@@ -109,7 +115,6 @@ typedef struct {
 // E1000 Functions
 int e1000_init(void);
 int e1000_transmit(const uint8_t* data, uint32_t len);
-void e1000_handle_interrupt(void);
 net_interface_t* e1000_get_interface(void);
 
 #endif // E1000_H
@@ -74,6 +74,18 @@ uint16_t pci_read_config_word(uint8_t bus, uint8_t device, uint8_t function, uin
 uint8_t pci_read_config_byte(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset);
 void pci_write_config_word(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset, uint16_t value);
 pci_device_t* pci_find_device(uint16_t vendor_id, uint16_t device_id);
+pci_device_t* pci_find_class(uint8_t class_code, uint8_t subclass);
 int pci_scan_bus(void);
 
+// Legacy INTx lines and handlers sharing one line
+#define PCI_IRQ_LINES           16
+#define PCI_IRQ_MAX_SHARED      4
+
+/*
+ * Attach `handler` to the device's INTx line and unmask it. The line may be
+ * shared, so the handler must check (and acknowledge) its own device's
+ * status first. Returns the line, or -1 when the device has no usable one.
+ */
+int pci_irq_attach(pci_device_t* dev, void (*handler)(void* ctx), void* ctx);
+
 #endif // PCI_H
@@ -220,7 +220,6 @@ typedef enum {
 // PCnet Driver Functions
 int pcnet_init(void);
 int pcnet_transmit(const uint8_t* data, uint32_t len);
-void pcnet_handle_interrupt(void);
 net_interface_t* pcnet_get_interface(void);
 pcnet_type_t pcnet_get_type(void);
 const char* pcnet_get_type_string(void);
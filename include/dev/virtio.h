@@ -0,0 +1,155 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * include/dev/virtio.h
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+/*
+ * DEVELOPER_NOTE_BLOCK
+ * Module Overview:
+ * - This file is part of the aOS production kernel/userspace codebase.
+ * - Review public symbols in this unit to understand contracts with adjacent modules.
+ * - Keep behavior-focused comments near non-obvious invariants, state transitions, and safety checks.
+ * - Avoid changing ABI/data-layout assumptions without updating dependent modules.
+ */
+
+#ifndef VIRTIO_H
+#define VIRTIO_H
+
+#include <stdint.h>
+#include <dev/pci.h>
+
+/*
+ * Legacy VirtIO PCI transport shared by virtio-net and virtio-blk.
+ *
+ * Devices expose the legacy register layout in I/O BAR0. Each virtqueue
+ * lives in one physically contiguous, page-aligned block owned by the
+ * driver: descriptor table, then the available ring, then (page-aligned)
+ * the used ring.
+ */
+
+#define VIRTIO_PCI_VENDOR_ID             0x1AF4
+
+// Legacy VirtIO PCI register offsets (I/O BAR)
+#define VIRTIO_PCI_REG_DEVICE_FEATURES   0x00
+#define VIRTIO_PCI_REG_GUEST_FEATURES    0x04
+#define VIRTIO_PCI_REG_QUEUE_ADDRESS     0x08
+#define VIRTIO_PCI_REG_QUEUE_SIZE        0x0C
+#define VIRTIO_PCI_REG_QUEUE_SELECT      0x0E
+#define VIRTIO_PCI_REG_QUEUE_NOTIFY      0x10
+#define VIRTIO_PCI_REG_DEVICE_STATUS     0x12
+#define VIRTIO_PCI_REG_ISR_STATUS        0x13
+#define VIRTIO_PCI_REG_DEVICE_CONFIG     0x14    // Without MSI-X
+
+// VirtIO status bits (legacy subset)
+#define VIRTIO_STATUS_ACKNOWLEDGE        0x01
+#define VIRTIO_STATUS_DRIVER             0x02
+#define VIRTIO_STATUS_DRIVER_OK          0x04
+#define VIRTIO_STATUS_FAILED             0x80
+
+// ISR status bits
+#define VIRTIO_ISR_QUEUE                 0x01
+#define VIRTIO_ISR_CONFIG                0x02
+
+// Queue constraints and sizing
+#define VIRTIO_QUEUE_ALIGN               4096
+#define VIRTIO_QUEUE_MAX_ENTRIES         1024
+#define VIRTIO_QUEUE_MAX_MEM             32768
+
+// Virtqueue descriptor flags
+#define VIRTQ_DESC_F_NEXT                1
+#define VIRTQ_DESC_F_WRITE               2
+
+// Available ring flags
+#define VIRTQ_AVAIL_F_NO_INTERRUPT       1
+
+typedef struct {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed)) virtq_desc_t;
+
+typedef struct {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];
+} __attribute__((packed)) virtq_avail_t;
+
+typedef struct {
+    uint32_t id;
+    uint32_t len;
+} __attribute__((packed)) virtq_used_elem_t;
+
+typedef struct {
+    uint16_t flags;
+    uint16_t idx;
+    virtq_used_elem_t ring[];
+} __attribute__((packed)) virtq_used_t;
+
+typedef struct {
+    uint16_t index;             // Queue number on the device
+    uint16_t size;
+    uint8_t* mem;
+    virtq_desc_t* desc;
+    virtq_avail_t* avail;
+    virtq_used_t* used;
+    uint16_t avail_idx_shadow;
+    uint16_t last_used_idx;
+} virtq_t;
+
+typedef struct {
+    pci_device_t* pci;
+    uint16_t io_base;
+    uint32_t features;          // Negotiated feature bits
+} virtio_device_t;
+
+static inline uintptr_t virtio_dma_addr(const void* ptr) {
+    /* Kernel and early-heap allocations are identity-mapped in current boot flow. */
+    return (uintptr_t)ptr;
+}
+
+// Find a device by its legacy (transitional) or modern PCI device ID
+pci_device_t* virtio_pci_find(uint16_t legacy_id, uint16_t modern_id);
+
+/*
+ * Enable I/O decoding and bus mastering, reset the device and announce the
+ * driver (ACKNOWLEDGE | DRIVER). Fails when BAR0 is not an I/O BAR.
+ */
+int virtio_open(virtio_device_t* vdev, pci_device_t* pci);
+
+// Accept the subset of `wanted` the device offers; returns the result
+uint32_t virtio_negotiate(virtio_device_t* vdev, uint32_t wanted);
+
+// Size queue `index` from the device and place it in queue_mem
+int virtq_setup(virtio_device_t* vdev, uint16_t index, virtq_t* q,
+                uint8_t* queue_mem, uint32_t queue_mem_size);
+
+// Queue a descriptor chain head; the device sees it after virtq_kick()
+void virtq_push_avail(virtq_t* q, uint16_t head);
+void virtq_kick(virtio_device_t* vdev, virtq_t* q);
+
+// Take the next used element; returns 0 when the used ring is empty
+int virtq_pop_used(virtq_t* q, uint32_t* id, uint32_t* len);
+
+/*
+ * Ask the device not to interrupt for used buffers on `q`. Only a hint:
+ * an interrupt may still arrive. Re-enabling returns non-zero when used
+ * entries are already waiting, which would otherwise raise no interrupt.
+ */
+void virtq_disable_interrupts(virtq_t* q);
+int virtq_enable_interrupts(virtq_t* q);
+
+void virtio_driver_ok(virtio_device_t* vdev);
+void virtio_fail(virtio_device_t* vdev);
+
+// Reading the ISR acknowledges (and deasserts) the legacy INTx line
+uint8_t virtio_read_isr(virtio_device_t* vdev);
+
+uint8_t virtio_config_read8(virtio_device_t* vdev, uint32_t offset);
+uint32_t virtio_config_read32(virtio_device_t* vdev, uint32_t offset);
+
+#endif // VIRTIO_H
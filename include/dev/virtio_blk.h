@@ -0,0 +1,58 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * include/dev/virtio_blk.h
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+/*
+ * DEVELOPER_NOTE_BLOCK
+ * Module Overview:
+ * - This file is part of the aOS production kernel/userspace codebase.
+ * - Review public symbols in this unit to understand contracts with adjacent modules.
+ * - Keep behavior-focused comments near non-obvious invariants, state transitions, and safety checks.
+ * - Avoid changing ABI/data-layout assumptions without updating dependent modules.
+ */
+
+
+#ifndef VIRTIO_BLK_H
+#define VIRTIO_BLK_H
+
+#include <stdint.h>
+#include <dev/virtio.h>
+
+// VirtIO PCI IDs
+#define VIRTIO_PCI_DEVICE_ID_BLK_LEGACY  0x1001
+#define VIRTIO_PCI_DEVICE_ID_BLK_MODERN  0x1042
+
+// Requests the driver keeps in flight, and the largest one (64 KB)
+#define VIRTIO_BLK_QUEUE_DEPTH           8
+#define VIRTIO_BLK_MAX_SECTORS           128
+
+typedef struct virtio_blk_stats {
+    uint32_t available;
+    uint32_t read_only;
+    uint32_t irq;               // IRQ line, 0 when completions are polled
+    uint32_t capacity;          // Sectors
+    uint32_t requests;
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+    uint32_t errors;
+    uint32_t interrupts;
+    uint32_t polled;            // Completions reaped without an interrupt
+    uint32_t max_in_flight;
+} virtio_blk_stats_t;
+
+// Probe the PCI bus and register the disk with the block layer as "vda"
+int virtio_blk_init(void);
+
+int virtio_blk_available(void);
+
+// Block-layer device number, or -1 when no disk was found
+int virtio_blk_get_blk_device(void);
+
+void virtio_blk_get_stats(virtio_blk_stats_t* stats);
+
+#endif // VIRTIO_BLK_H
@@ -22,16 +22,15 @@
 
 #include <stdint.h>
 #include <net/net.h>
+#include <dev/virtio.h>
 
 // VirtIO PCI IDs
-#define VIRTIO_PCI_VENDOR_ID             0x1AF4
 #define VIRTIO_PCI_DEVICE_ID_NET_LEGACY  0x1000
 #define VIRTIO_PCI_DEVICE_ID_NET_MODERN  0x1041
 
 // Driver entry points
 int virtio_net_init(void);
 int virtio_net_transmit(const uint8_t* data, uint32_t len);
-void virtio_net_handle_interrupt(void);
 net_interface_t* virtio_net_get_interface(void);
 
 #endif // VIRTIO_NET_H
\ No newline at end of file
@@ -0,0 +1,95 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * include/fs/bcache.h
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+/*
+ * DEVELOPER_NOTE_BLOCK
+ * Module Overview:
+ * - This file is part of the aOS production kernel/userspace codebase.
+ * - Review public symbols in this unit to understand contracts with adjacent modules.
+ * - Keep behavior-focused comments near non-obvious invariants, state transitions, and safety checks.
+ * - Avoid changing ABI/data-layout assumptions without updating dependent modules.
+ */
+
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include <stdint.h>
+
+/*
+ * Block buffer cache shared by the disk filesystems.
+ *
+ * Buffers are keyed by (device, LBA), hashed for lookup and recycled with
+ * the CLOCK algorithm. Writes only dirty the buffer; the bflushd kernel
+ * thread writes buffers back once they have been dirty for
+ * BCACHE_DIRTY_EXPIRE_MS (sooner above the high-water mark), and
+ * bcache_sync() forces everything out.
+ */
+
+#define BCACHE_BLOCK_SIZE           512
+#define BCACHE_NUM_BUFFERS          256     // 128 KB of cached blocks
+#define BCACHE_HASH_BITS            7
+#define BCACHE_HASH_SIZE            (1u << BCACHE_HASH_BITS)
+#define BCACHE_MAX_IO_BLOCKS        2048    // Longest uncached run per device request (1 MB)
+#define BCACHE_STREAM_MIN_BLOCKS    64      // Runs this long bypass the cache (32 KB)
+
+#define BCACHE_WRITEBACK_INTERVAL_MS 500
+#define BCACHE_DIRTY_EXPIRE_MS      3000
+#define BCACHE_DIRTY_HIGH_WATER     (BCACHE_NUM_BUFFERS / 2)
+
+// Device numbers are block-layer devices (dev/blkdev.h)
+#define BCACHE_DEV_ATA0             0       // Primary ATA master, registered first
+#define BCACHE_DEV_ALL              0xFFFFFFFFu
+
+typedef struct bcache_stats {
+    uint32_t buffers;
+    uint32_t valid;
+    uint32_t dirty;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t writebacks;
+    uint32_t evictions;
+    uint32_t read_errors;
+    uint32_t write_errors;
+    uint32_t direct_reads;      // Streaming requests that bypassed the cache
+    uint32_t direct_writes;
+    uint32_t direct_blocks;
+} bcache_stats_t;
+
+// Initialize the cache (block devices may register before or after)
+void bcache_init(void);
+
+// Start the bflushd writeback thread (needs the process manager)
+int bcache_start_writeback(void);
+
+// Copy one block through the cache. Returns 0 on success, -1 on I/O error.
+int bcache_read(uint32_t dev, uint32_t lba, void* buffer);
+int bcache_write(uint32_t dev, uint32_t lba, const void* buffer);
+
+/*
+ * Multi-block transfers. Each run of uncached blocks is one device request.
+ * Runs of BCACHE_STREAM_MIN_BLOCKS or more stream past the cache: reads are
+ * not cached, and writes go to the device synchronously and leave any cached
+ * copies clean. Shorter runs are cached like single blocks.
+ */
+int bcache_read_blocks(uint32_t dev, uint32_t lba, uint32_t count, void* buffer);
+int bcache_write_blocks(uint32_t dev, uint32_t lba, uint32_t count, const void* buffer);
+
+// Write back dirty buffers of one device (or BCACHE_DEV_ALL); returns -1 if any write failed
+int bcache_flush(uint32_t dev);
+int bcache_sync(void);
+
+/*
+ * Drop cached blocks in [lba, lba + count), discarding dirty data. Call
+ * before writing the range behind the cache's back (mkfs, installer).
+ */
+void bcache_invalidate(uint32_t dev, uint32_t lba, uint32_t count);
+
+void bcache_get_stats(bcache_stats_t* stats);
+
+#endif // BCACHE_H
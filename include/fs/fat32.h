@@ -55,7 +55,14 @@
 
 // Sector/cluster sizes
 #define FAT32_SECTOR_SIZE 512
+#define FAT32_ENTRIES_PER_SECTOR (FAT32_SECTOR_SIZE / 4)
 #define FAT32_MAX_CLUSTER_SIZE 32768
+#define FAT32_MAX_RUN_SECTORS 256       // Longest contiguous cluster run per disk request
+#define FAT32_EXTENT_CACHE_SIZE 16      // Cached chain extents per open vnode
+
+// BPB ext_flags
+#define FAT32_EXT_ACTIVE_MASK 0x0F      // Active FAT when mirroring is off
+#define FAT32_EXT_NO_MIRROR   0x80      // Only the active FAT is updated
 
 // FAT32 Boot Sector (BIOS Parameter Block)
 typedef struct fat32_boot_sector {
@@ -136,14 +143,31 @@ typedef struct fat32_data {
     fat32_boot_sector_t boot_sector;
     fat32_fsinfo_t fsinfo;
     uint32_t* fat;                   // File Allocation Table (in-memory cache)
+    uint32_t dev;                    // Block device (dev/blkdev.h)
     uint32_t start_lba;              // Starting LBA on disk
     uint32_t fat_start_sector;       // FAT start sector
     uint32_t data_start_sector;      // Data region start sector
     uint32_t bytes_per_cluster;      // Bytes per cluster
     uint32_t total_clusters;         // Total number of clusters
     uint8_t  fat_cache_dirty;        // FAT cache dirty flag
+    uint32_t* free_map;              // One bit per cluster, set while it is free
+    uint32_t* fat_dirty_map;         // One bit per FAT sector changed since sync
+    uint32_t chain_gen;              // Bumped when a link is freed or redirected
 } fat32_data_t;
 
+/*
+ * Run of physically contiguous clusters in a file's chain. Each vnode keeps
+ * a window of up to FAT32_EXTENT_CACHE_SIZE of them, built lazily from the
+ * FAT as the file is read. Appending only adds to the end of a chain, so the
+ * cache stays valid; freeing or relinking clusters bumps chain_gen, which
+ * drops every vnode's cached extents.
+ */
+typedef struct fat32_extent {
+    uint32_t file_cluster;           // First cluster index within the file
+    uint32_t disk_cluster;           // Its cluster number on disk
+    uint32_t count;
+} fat32_extent_t;
+
 // In-memory file/directory data
 typedef struct fat32_file_data {
     uint32_t first_cluster;          // First cluster of file/directory
@@ -153,6 +177,9 @@ typedef struct fat32_file_data {
     uint8_t  attributes;             // File attributes
     uint32_t parent_cluster;         // Parent directory cluster (for updating entry)
     char name[256];                  // Filename (for updating entry)
+    fat32_extent_t extents[FAT32_EXTENT_CACHE_SIZE];
+    uint32_t extent_count;
+    uint32_t extent_gen;             // chain_gen the extents were built against
 } fat32_file_data_t;
 
 // Initialize FAT32 filesystem driver
@@ -26,17 +26,33 @@
 // SimpleFS: A modern, complete block-based filesystem for aOS
 // Inspired by ext2 with modern enhancements
 // Block size: 512 bytes (matches ATA sector size)
-// Max file size: ~258MB (12 direct + 1-level indirect + 2-level indirect)
+// Regular files map their data as extents (v3); directories and files not
+// yet rewritten since a v2 volume was upgraded keep the 12 direct +
+// 1-level indirect + 2-level indirect block map
 // Max files: Limited by inode count
 // Note: This filesystem may seem absurd, but it is what i deemed best.
 
 #define SIMPLEFS_MAGIC 0x53465332  // "SFS2" - SimpleFS v2 Signature
-#define SIMPLEFS_VERSION 2
+#define SIMPLEFS_VERSION 3          // v3: extent-mapped regular files
+#define SIMPLEFS_VERSION_BLOCKMAP 2 // Upgraded to v3 online at mount
 #define SIMPLEFS_BLOCK_SIZE 512
 #define SIMPLEFS_MAX_FILENAME 255
 #define SIMPLEFS_DIRECT_BLOCKS 12  // Increased from 8
 #define SIMPLEFS_MAX_INODES 8192   // Increased from 4096
 #define SIMPLEFS_MAX_BLOCKS 524288 // 256MB filesystem (increased from 64MB)
+#define SIMPLEFS_INODE_EXTENTS 7   // Extents stored in the inode itself
+#define SIMPLEFS_EXTENTS_PER_BLOCK 63
+#define SIMPLEFS_DELALLOC_SLOTS 4  // Files with buffered, not yet placed appends
+#define SIMPLEFS_DELALLOC_BLOCKS 64 // Largest buffered run per file (32KB)
+
+// Inode flags
+#define SIMPLEFS_FL_EXTENTS 0x00080000  // Data mapped by extents, not block pointers
+#define SIMPLEFS_FL_INDEX   0x00001000  // Directory hashed by an index tree rooted at block_ptrs[0]
+
+// Directories stay a plain list of blocks up to this size, then get an index
+#define SIMPLEFS_DIR_LINEAR_BLOCKS 4
+#define SIMPLEFS_DX_MAGIC          0x58444653  // "SFDX"
+#define SIMPLEFS_DX_ENTRIES        63
 
 // Inode mode flags (Unix-style permissions)
 #define SIMPLEFS_S_IFMT   0xF000  // Format mask
@@ -70,6 +86,22 @@
 #define SIMPLEFS_JOURNAL_DIRTY 1
 #define SIMPLEFS_JOURNAL_RECOVERING 2
 
+// Metadata journal (write-ahead log in the journal_block area)
+#define SIMPLEFS_JOURNAL_MAGIC        0x4A534653  // "SFSJ": journal header
+#define SIMPLEFS_JOURNAL_DESC_MAGIC   0x44534653  // "SFSD": transaction descriptor
+#define SIMPLEFS_JOURNAL_COMMIT_MAGIC 0x43534653  // "SFSC": commit record
+#define SIMPLEFS_JOURNAL_MAX_BLOCKS   61          // Logged blocks per transaction (64-block journal)
+#define SIMPLEFS_JOURNAL_MIN_SIZE     4           // Header, descriptor, one block, commit
+#define SIMPLEFS_JOURNAL_COMMIT_MS    1000        // Group-commit interval of the journal thread
+#define SIMPLEFS_JOURNAL_CREDITS_DIROP 24         // create/mkdir/unlink: maps, inodes, directory index
+#define SIMPLEFS_JOURNAL_CREDITS_WRITE 16         // One SIMPLEFS_DELALLOC_BLOCKS chunk plus a victim flush
+#define SIMPLEFS_JOURNAL_CREDITS_FLUSH 8          // Placing one delalloc slot
+#define SIMPLEFS_MAX_MOUNTS           4           // Mounts the journal thread serves
+
+// Access-time policy (VFS_MOUNT_RELATIME / VFS_MOUNT_LAZYTIME)
+#define SIMPLEFS_RELATIME_SECS        86400       // relatime refreshes an atime this stale
+#define SIMPLEFS_LAZYTIME_EXPIRE_MS   3600000     // Oldest an in-memory-only timestamp may get
+
 // Filesystem superblock (first block)
 typedef struct simplefs_superblock {
     uint32_t magic;              // Magic number (SIMPLEFS_MAGIC)
@@ -95,6 +127,20 @@ typedef struct simplefs_superblock {
     uint8_t reserved[396];       // Pad to 512 bytes
 } __attribute__((packed)) simplefs_superblock_t;
 
+// Extent: `length` physically contiguous blocks starting at `start`. A file's
+// extents are stored in file order and cover its blocks without holes.
+typedef struct simplefs_extent {
+    uint32_t start;              // First data block
+    uint32_t length;             // Blocks in the run (0 = unused slot)
+} __attribute__((packed)) simplefs_extent_t;
+
+// Overflow extents once the inode's own slots are full, chained by `next`
+typedef struct simplefs_extent_block {
+    uint32_t next;               // Next extent block (0 = last)
+    uint32_t count;              // Extents used in this block
+    simplefs_extent_t extents[SIMPLEFS_EXTENTS_PER_BLOCK];
+} __attribute__((packed)) simplefs_extent_block_t;
+
 // Inode structure (128 bytes to fit 4 per block)
 typedef struct simplefs_inode {
     uint16_t mode;               // File type and permissions
@@ -108,10 +154,18 @@ typedef struct simplefs_inode {
     uint16_t links_count;        // Hard links count
     uint32_t blocks;             // Number of blocks used
     uint32_t flags;              // File flags
-    uint32_t block_ptrs[SIMPLEFS_DIRECT_BLOCKS]; // Direct block pointers
-    uint32_t indirect_ptr;       // 1-level indirect block pointer
-    uint32_t double_indirect_ptr; // 2-level indirect block pointer
-    uint32_t triple_indirect_ptr; // 3-level indirect (reserved for future)
+    union {
+        struct {
+            uint32_t block_ptrs[SIMPLEFS_DIRECT_BLOCKS]; // Direct block pointers
+            uint32_t indirect_ptr;       // 1-level indirect block pointer
+            uint32_t double_indirect_ptr; // 2-level indirect block pointer
+            uint32_t triple_indirect_ptr; // 3-level indirect (reserved for future)
+        } __attribute__((packed));
+        struct {                         // With SIMPLEFS_FL_EXTENTS
+            simplefs_extent_t extents[SIMPLEFS_INODE_EXTENTS];
+            uint32_t extent_block;       // First overflow extent block
+        } __attribute__((packed));
+    };
     uint32_t generation;         // File version (for NFS)
     uint32_t file_acl;           // Extended attributes block
     uint32_t size_high;          // File size (upper 32 bits) - for >4GB files
@@ -132,13 +186,59 @@ typedef struct simplefs_dirent {
     char name[SIMPLEFS_MAX_FILENAME + 1]; // Null-terminated name
 } __attribute__((packed)) simplefs_dirent_t;
 
-// Journal transaction entry
-typedef struct simplefs_journal_entry {
-    uint32_t seq_num;            // Sequence number
-    uint32_t block_num;          // Block being modified
-    uint32_t checksum;           // Data checksum
-    uint8_t data[SIMPLEFS_BLOCK_SIZE - 12]; // Block data
-} __attribute__((packed)) simplefs_journal_entry_t;
+/*
+ * Directory index node. Entries are sorted by name hash; entry i covers
+ * hashes from entries[i].hash up to the next entry's, and entries[0].hash
+ * is the lower bound of the whole node. In the root, `levels` is 0 when
+ * entries point at leaf blocks and 1 when they point at interior nodes.
+ */
+typedef struct simplefs_dx_entry {
+    uint32_t hash;
+    uint32_t block;
+} __attribute__((packed)) simplefs_dx_entry_t;
+
+typedef struct simplefs_dx_node {
+    uint32_t magic;              // SIMPLEFS_DX_MAGIC
+    uint16_t count;              // Entries in use
+    uint8_t levels;              // Root only: interior levels below it
+    uint8_t reserved;
+    simplefs_dx_entry_t entries[SIMPLEFS_DX_ENTRIES];
+} __attribute__((packed)) simplefs_dx_node_t;
+
+/*
+ * Journal layout: block 0 of the area is the header, naming the sequence
+ * number replay expects next. A transaction is written from block 1 as a
+ * descriptor listing the home block numbers, their images, then a commit
+ * record. It is checkpointed (images written home) right after it commits,
+ * so the log holds at most one transaction awaiting replay.
+ */
+typedef struct simplefs_journal_header {
+    uint32_t magic;              // SIMPLEFS_JOURNAL_MAGIC
+    uint32_t seq;                // Sequence of the next transaction to replay
+    uint8_t reserved[SIMPLEFS_BLOCK_SIZE - 8];
+} __attribute__((packed)) simplefs_journal_header_t;
+
+typedef struct simplefs_journal_desc {
+    uint32_t magic;              // SIMPLEFS_JOURNAL_DESC_MAGIC
+    uint32_t seq;                // Transaction sequence number
+    uint32_t count;              // Logged blocks that follow
+    uint32_t checksum;           // Over the logged images
+    uint32_t blocks[(SIMPLEFS_BLOCK_SIZE - 16) / sizeof(uint32_t)]; // Home block numbers
+} __attribute__((packed)) simplefs_journal_desc_t;
+
+typedef struct simplefs_journal_commit {
+    uint32_t magic;              // SIMPLEFS_JOURNAL_COMMIT_MAGIC
+    uint32_t seq;                // Must match the descriptor
+    uint32_t checksum;           // Must match the descriptor
+    uint8_t reserved[SIMPLEFS_BLOCK_SIZE - 12];
+} __attribute__((packed)) simplefs_journal_commit_t;
+
+// In-memory transaction: the latest image of every metadata block it touched
+typedef struct simplefs_txn {
+    uint32_t count;
+    uint32_t blocks[SIMPLEFS_JOURNAL_MAX_BLOCKS];
+    uint8_t* images;             // count * SIMPLEFS_BLOCK_SIZE bytes
+} simplefs_txn_t;
 
 // Extended attribute entry
 typedef struct simplefs_xattr {
@@ -148,16 +248,44 @@ typedef struct simplefs_xattr {
     char value[64];              // Attribute value
 } __attribute__((packed)) simplefs_xattr_t;
 
+// Appended file blocks held in memory until they are placed as one run
+typedef struct simplefs_delalloc {
+    uint32_t inode_num;          // Owning inode (0 = slot free)
+    uint32_t file_block;         // First file block buffered; always the mapped end
+    uint32_t count;              // Blocks buffered
+    uint32_t since_ms;           // ktime when the oldest buffered block arrived
+    uint8_t* data;               // SIMPLEFS_DELALLOC_BLOCKS blocks
+} simplefs_delalloc_t;
+
 // In-memory filesystem data
 typedef struct simplefs_data {
     simplefs_superblock_t superblock;
     uint8_t* block_bitmap;       // Block allocation bitmap
     uint8_t* inode_bitmap;       // Inode allocation bitmap
     simplefs_inode_t* inode_table; // Inode table
+    uint32_t dev;                // Block device (dev/blkdev.h)
     uint32_t start_lba;          // Starting LBA on disk
-    uint32_t journal_seq;        // Current journal sequence number
+    uint32_t journal_seq;        // Sequence of the next transaction to commit
     uint8_t journal_enabled;     // Journal enabled flag
+    uint8_t txn_running;         // Index of the transaction taking updates
+    volatile uint8_t txn_committing; // txn[!txn_running] is being written out
+    uint32_t txn_limit;          // Blocks per transaction this journal can hold
+    uint32_t journal_handles;    // Operations in progress; group commit waits for 0
+    uint32_t txn_reserved;       // Credits held by open handles in the running transaction
+    uint32_t txn_overruns;       // Handles past their credits, waiting for a commit
+    volatile uint8_t txn_locked; // Running transaction full; new handles wait for its commit
+    simplefs_txn_t txn[2];
+    uint32_t journal_commits;    // Transactions committed
+    uint32_t journal_logged;     // Blocks written to the log
+    uint32_t journal_coalesced;  // Metadata writes absorbed by an earlier image
     uint32_t dirty_count;        // Number of dirty blocks
+    uint32_t reserved_blocks;    // Free blocks promised to buffered appends
+    uint32_t delalloc_next;      // Round-robin victim when every slot is busy
+    simplefs_delalloc_t delalloc[SIMPLEFS_DELALLOC_SLOTS];
+    uint32_t mount_flags;        // VFS_MOUNT_* given to vfs_mount()
+    uint32_t lazy_count;         // Inodes with timestamp-only changes not yet written
+    uint32_t lazy_since_ms;      // ktime when the oldest of them was dirtied
+    uint32_t lazy_map[SIMPLEFS_MAX_INODES / 32];
 } simplefs_data_t;
 
 // File type macros
@@ -189,9 +317,22 @@ int simplefs_chown(const char* path, uint16_t uid, uint16_t gid);
 int simplefs_setxattr(const char* path, const char* name, const void* value, uint32_t size);
 int simplefs_getxattr(const char* path, const char* name, void* value, uint32_t size);
 
-// Journaling operations
-int simplefs_journal_start(simplefs_data_t* fs_data);
+/*
+ * Journaling operations. Metadata writes join the running transaction;
+ * start/stop bracket one filesystem operation so group commit never splits
+ * it. start reserves `credits` blocks of the running transaction for the
+ * operation, waiting for the transaction to be committed if they do not
+ * fit. Commit logs the running transaction, waits for it to reach the disk
+ * and checkpoints it; recover replays a committed transaction at mount.
+ */
+int simplefs_journal_start(simplefs_data_t* fs_data, uint32_t credits);
+void simplefs_journal_stop(simplefs_data_t* fs_data);
 int simplefs_journal_commit(simplefs_data_t* fs_data);
 int simplefs_journal_recover(simplefs_data_t* fs_data);
 
+// Start the thread that group-commits every SIMPLEFS_JOURNAL_COMMIT_MS,
+// places appends buffered for longer than that and writes lazytime inodes
+// after SIMPLEFS_LAZYTIME_EXPIRE_MS
+int simplefs_start_journal_thread(void);
+
 #endif // SIMPLEFS_H
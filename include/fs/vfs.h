@@ -42,6 +42,11 @@
 #define O_APPEND  0x0400
 #define O_DIRECTORY 0x10000
 
+// Mount flags (vfs_mount); atime handling is up to each filesystem
+#define VFS_MOUNT_NOATIME   0x0001  // Never update access times
+#define VFS_MOUNT_RELATIME  0x0002  // Update atime only if <= mtime/ctime or a day stale
+#define VFS_MOUNT_LAZYTIME  0x0004  // Keep timestamp-only inode updates in memory until sync
+
 // Seek modes
 #define SEEK_SET 0
 #define SEEK_CUR 1
@@ -120,6 +125,7 @@ typedef struct filesystem_ops {
     int (*mount)(struct filesystem* fs, const char* source, uint32_t flags);
     int (*unmount)(struct filesystem* fs);
     vnode_t* (*get_root)(struct filesystem* fs);
+    int (*sync)(struct filesystem* fs);     // Optional: flush in-memory metadata
 } filesystem_ops_t;
 
 // Filesystem structure
@@ -158,6 +164,12 @@ int vfs_unregister_filesystem(const char* name);
 int vfs_mount(const char* source, const char* target, const char* fstype, uint32_t flags);
 int vfs_unmount(const char* target);
 
+// Parse comma-separated "noatime,relatime,lazytime,strictatime" into mount flags
+int vfs_parse_mount_options(const char* options, uint32_t* flags);
+
+// Flush filesystem metadata and dirty cached blocks to disk
+int vfs_sync(void);
+
 // Path resolution
 vnode_t* vfs_resolve_path(const char* path);
 char* vfs_normalize_path(const char* path);
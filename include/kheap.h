@@ -0,0 +1,58 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * include/kheap.h
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+/*
+ * DEVELOPER_NOTE_BLOCK
+ * Module Overview:
+ * - This file is part of the aOS production kernel/userspace codebase.
+ * - Review public symbols in this unit to understand contracts with adjacent modules.
+ * - Keep behavior-focused comments near non-obvious invariants, state transitions, and safety checks.
+ * - Avoid changing ABI/data-layout assumptions without updating dependent modules.
+ */
+
+#ifndef KHEAP_H
+#define KHEAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// General-purpose kernel heap region (identity-mapped, reserved in the PMM)
+#define KHEAP_START         ((uintptr_t)0x500000)   // 5MB
+#define KHEAP_END           ((uintptr_t)0x700000)   // 7MB
+#define KHEAP_ALIGN         16
+#define KHEAP_BIN_COUNT     18
+
+// Heap statistics snapshot
+typedef struct {
+    uint32_t total_bytes;       // Size of the managed region
+    uint32_t used_bytes;        // Bytes in allocated blocks (incl. headers)
+    uint32_t free_bytes;        // Bytes in free blocks (incl. headers)
+    uint32_t largest_free;      // Largest single free block
+    uint32_t used_blocks;
+    uint32_t free_blocks;
+    uint32_t alloc_count;
+    uint32_t free_count;
+    uint32_t failed_allocs;
+} kheap_stats_t;
+
+// Allocation (returns KHEAP_ALIGN-aligned memory, not zeroed)
+void *kheap_alloc(size_t size);
+
+// Release a block; returns payload size freed, or 0 if ptr is not a live block
+size_t kheap_free(void *ptr);
+
+// Ownership and validation
+int kheap_owns(const void *ptr);
+int kheap_is_live_block(const void *ptr);   // 1 live, -1 freed, 0 not a block
+int kheap_validate(void);
+
+// Statistics
+void kheap_get_stats(kheap_stats_t *stats);
+
+#endif // KHEAP_H
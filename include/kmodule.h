@@ -124,6 +124,9 @@ void kmodule_list_v2(void);
 // Drive module-managed timer callbacks (called from scheduler tick)
 void kmodule_v2_timer_tick(void);
 
+// Ticks until the next module timer fires (0xFFFFFFFF when none is running)
+uint32_t kmodule_v2_timer_next_event(void);
+
 // Get module context by name
 kmod_ctx_t* kmodule_get_context(const char* name);
 
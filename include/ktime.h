@@ -0,0 +1,64 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * include/ktime.h
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+/*
+ * DEVELOPER_NOTE_BLOCK
+ * Module Overview:
+ * - This file is part of the aOS production kernel/userspace codebase.
+ * - Review public symbols in this unit to understand contracts with adjacent modules.
+ * - Keep behavior-focused comments near non-obvious invariants, state transitions, and safety checks.
+ * - Avoid changing ABI/data-layout assumptions without updating dependent modules.
+ */
+
+#ifndef KTIME_H
+#define KTIME_H
+
+#include <stdint.h>
+
+#define NSEC_PER_USEC   1000u
+#define NSEC_PER_MSEC   1000000u
+#define NSEC_PER_SEC    1000000000u
+
+/*
+ * Monotonic kernel clock, counted from boot.
+ *
+ * Backed by the TSC once clockevent_init() has calibrated it, otherwise by
+ * the scheduler tick. "Ticks" are the scheduler's jiffies (the rate passed to
+ * arch_timer_init()) and share their origin with system_ticks.
+ */
+uint64_t ktime_get_ns(void);
+uint32_t ktime_get_ms(void);
+uint32_t ktime_get_ticks(void);
+
+// Length of one scheduler tick
+uint32_t ktime_tick_ns(void);
+
+// Tick in which `ns` falls (rounded down)
+uint32_t ktime_ns_to_ticks(uint64_t ns);
+
+/*
+ * 64-by-32-bit division. i386 kernels are linked without libgcc, so plain
+ * uint64_t division would leave __udivdi3 unresolved.
+ */
+static inline uint64_t div_u64_u32(uint64_t dividend, uint32_t divisor) {
+#if defined(ARCH_I386)
+    uint32_t hi = (uint32_t)(dividend >> 32);
+    uint32_t lo = (uint32_t)dividend;
+    uint32_t q_hi = hi / divisor;
+    uint32_t rem = hi % divisor;
+    uint32_t q_lo;
+    // rem < divisor, so the 64/32 divl cannot overflow
+    asm("divl %3" : "=a"(q_lo), "=d"(rem) : "a"(lo), "rm"(divisor), "d"(rem));
+    return ((uint64_t)q_hi << 32) | q_lo;
+#else
+    return dividend / divisor;
+#endif
+}
+
+#endif // KTIME_H
@@ -0,0 +1,84 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * include/lapic.h
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+/*
+ * DEVELOPER_NOTE_BLOCK
+ * Module Overview:
+ * - This file is part of the aOS production kernel/userspace codebase.
+ * - Review public symbols in this unit to understand contracts with adjacent modules.
+ * - Keep behavior-focused comments near non-obvious invariants, state transitions, and safety checks.
+ * - Avoid changing ABI/data-layout assumptions without updating dependent modules.
+ */
+
+#ifndef LAPIC_H
+#define LAPIC_H
+
+#include <stdint.h>
+
+// Local APIC register offsets (xAPIC MMIO mode)
+#define LAPIC_REG_ID            0x020
+#define LAPIC_REG_VERSION       0x030
+#define LAPIC_REG_TPR           0x080
+#define LAPIC_REG_EOI           0x0B0
+#define LAPIC_REG_SVR           0x0F0
+#define LAPIC_REG_ESR           0x280
+#define LAPIC_REG_ICR_LOW       0x300
+#define LAPIC_REG_ICR_HIGH      0x310
+#define LAPIC_REG_LVT_TIMER     0x320
+#define LAPIC_REG_LVT_LINT0     0x350
+#define LAPIC_REG_LVT_LINT1     0x360
+#define LAPIC_REG_LVT_ERROR     0x370
+#define LAPIC_REG_TIMER_INIT    0x380
+#define LAPIC_REG_TIMER_CURRENT 0x390
+#define LAPIC_REG_TIMER_DIVIDE  0x3E0
+
+// ICR fields
+#define LAPIC_ICR_FIXED         0x00000000
+#define LAPIC_ICR_INIT          0x00000500
+#define LAPIC_ICR_STARTUP       0x00000600
+#define LAPIC_ICR_PENDING       0x00001000  // Delivery status
+#define LAPIC_ICR_ASSERT        0x00004000
+#define LAPIC_ICR_LEVEL         0x00008000
+#define LAPIC_ICR_ALL_BUT_SELF  0x000C0000
+
+#define LAPIC_SVR_ENABLE        0x00000100
+#define LAPIC_LVT_MASKED        0x00010000
+
+// LVT timer modes and divide configuration
+#define LAPIC_TIMER_ONESHOT     0x00000000
+#define LAPIC_TIMER_PERIODIC    0x00020000
+#define LAPIC_TIMER_TSC_DEADLINE 0x00040000
+#define LAPIC_TIMER_DIVIDE_16   0x3
+
+#define MSR_IA32_TSC_DEADLINE   0x6E0
+
+#define LAPIC_TIMER_VECTOR      0xF2    // Per-CPU clock event (see clockevent.h)
+#define LAPIC_SPURIOUS_VECTOR   0xFF
+
+// Map the LAPIC MMIO window and software-enable the executing CPU's LAPIC.
+// Returns 0 on success, negative when no LAPIC is available.
+int lapic_init(uint32_t mmio_base);
+
+// Enable the LAPIC of an application processor (MMIO already mapped by BSP)
+void lapic_init_ap(void);
+
+int lapic_available(void);
+uint32_t lapic_read(uint32_t reg);
+void lapic_write(uint32_t reg, uint32_t value);
+
+uint32_t lapic_id(void);
+void lapic_eoi(void);
+
+// Inter-processor interrupts
+int lapic_send_ipi(uint32_t apic_id, uint8_t vector);
+int lapic_broadcast_ipi(uint8_t vector);  // All CPUs except the sender
+int lapic_send_init(uint32_t apic_id);
+int lapic_send_startup(uint32_t apic_id, uint8_t page_vector);
+
+#endif // LAPIC_H
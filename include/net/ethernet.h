@@ -41,6 +41,10 @@ typedef struct {
 int eth_receive(net_interface_t* iface, net_packet_t* packet);
 int eth_transmit(net_interface_t* iface, const mac_addr_t* dest_mac, 
                  uint16_t ethertype, const uint8_t* payload, uint32_t payload_len);
+// Frame `packet` in place (needs ETH_HEADER_LEN of headroom); the caller
+// keeps its reference
+int eth_transmit_packet(net_interface_t* iface, const mac_addr_t* dest_mac,
+                        uint16_t ethertype, net_packet_t* packet);
 
 // MAC address utilities
 void mac_to_string(const mac_addr_t* mac, char* str);
@@ -57,6 +57,10 @@ void ipv4_init(void);
 int ipv4_receive(net_interface_t* iface, net_packet_t* packet);
 int ipv4_send(net_interface_t* iface, uint32_t dest_ip, uint8_t protocol,
               const uint8_t* payload, uint32_t payload_len);
+// Prepend the IPv4 header to `packet` in place and route it. Consumes the
+// caller's reference, including on failure.
+int ipv4_send_packet(net_interface_t* iface, uint32_t dest_ip, uint8_t protocol,
+                     net_packet_t* packet);
 
 // IPv4 utilities
 uint16_t ipv4_checksum(const void* data, uint32_t len);
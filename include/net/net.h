@@ -60,13 +60,41 @@ typedef struct {
     uint8_t addr[MAC_ADDR_LEN];
 } mac_addr_t;
 
-// Network packet structure
-typedef struct {
-    uint8_t* data;
-    uint32_t len;
-    uint32_t capacity;
+/*
+ * Packet buffers. Transmit buffers are allocated with NET_PACKET_HEADROOM
+ * free bytes in front of the data, so each layer on the way down prepends
+ * its header in place with net_packet_push() instead of copying the payload
+ * into a bigger buffer; receive paths strip headers with net_packet_pull().
+ * Buffers come from a static pool of DMA-safe slots (the heap only backs
+ * oversized or overflow requests) and are reference-counted, so a driver
+ * can keep one alive until the NIC has finished reading it.
+ *
+ * data/len/capacity come first and keep their meaning for loadable modules.
+ */
+#define NET_PACKET_HEADROOM     64      // Ethernet + IPv4 + driver headers
+#define NET_PACKET_BUF_SIZE     2048    // Pool slot: headroom plus a full frame
+#define NET_PACKET_POOL_SIZE    64
+
+#define NET_PACKET_F_POOL       0x0001  // Data lives in a pool slot (DMA-safe)
+#define NET_PACKET_F_BORROWED   0x0002  // Wraps memory owned by someone else
+
+typedef struct net_packet {
+    uint8_t* data;              // First byte of the current layer
+    uint32_t len;               // Bytes from data onward
+    uint32_t capacity;          // Bytes from data to the end of the buffer
+    uint8_t* head;              // Start of the buffer; data - head is headroom
+    uint16_t refcount;
+    uint16_t flags;
+    struct net_packet* next;    // Pool free list and driver queues
 } net_packet_t;
 
+typedef struct {
+    uint32_t pool_size;
+    uint32_t pool_free;
+    uint32_t allocs;
+    uint32_t heap_allocs;       // Requests the pool could not serve
+} net_packet_stats_t;
+
 // Network interface structure
 typedef struct net_interface {
     char name[16];
@@ -95,11 +123,72 @@ int net_interface_up(net_interface_t* iface);
 int net_interface_down(net_interface_t* iface);
 int net_interface_set_ip(net_interface_t* iface, uint32_t ip, uint32_t netmask);
 
-// Packet operations
+// Packet operations: alloc returns an empty buffer with `size` bytes of
+// tailroom after the headroom; free drops one reference
 net_packet_t* net_packet_alloc(uint32_t size);
 void net_packet_free(net_packet_t* packet);
+net_packet_t* net_packet_get(net_packet_t* packet);
+void net_packet_get_stats(net_packet_stats_t* stats);
+
+// Describe memory owned elsewhere (an RX ring slot) without copying it
+static inline void net_packet_wrap(net_packet_t* packet, uint8_t* data,
+                                   uint32_t len, uint32_t capacity) {
+    packet->data = data;
+    packet->len = len;
+    packet->capacity = capacity;
+    packet->head = data;
+    packet->refcount = 0;
+    packet->flags = NET_PACKET_F_BORROWED;
+    packet->next = NULL;
+}
+
+static inline uint32_t net_packet_headroom(const net_packet_t* packet) {
+    return packet->head ? (uint32_t)(packet->data - packet->head) : 0;
+}
+
+static inline uint32_t net_packet_tailroom(const net_packet_t* packet) {
+    return packet->capacity - packet->len;
+}
 
-// Packet transmission
+// Move the (empty) data start forward, keeping `n` more bytes of headroom
+static inline void net_packet_reserve(net_packet_t* packet, uint32_t n) {
+    packet->data += n;
+    packet->capacity -= n;
+}
+
+// Prepend `n` bytes; returns the new start, or NULL without enough headroom
+static inline uint8_t* net_packet_push(net_packet_t* packet, uint32_t n) {
+    if (net_packet_headroom(packet) < n) {
+        return NULL;
+    }
+    packet->data -= n;
+    packet->len += n;
+    packet->capacity += n;
+    return packet->data;
+}
+
+// Strip `n` leading bytes; returns the new start, or NULL if too short
+static inline uint8_t* net_packet_pull(net_packet_t* packet, uint32_t n) {
+    if (packet->len < n) {
+        return NULL;
+    }
+    packet->data += n;
+    packet->len -= n;
+    packet->capacity -= n;
+    return packet->data;
+}
+
+// Append `n` bytes; returns where they go, or NULL without enough tailroom
+static inline uint8_t* net_packet_put(net_packet_t* packet, uint32_t n) {
+    if (net_packet_tailroom(packet) < n) {
+        return NULL;
+    }
+    uint8_t* tail = packet->data + packet->len;
+    packet->len += n;
+    return tail;
+}
+
+// Packet transmission; the caller keeps its reference to `packet`
 int net_transmit_packet(net_interface_t* iface, net_packet_t* packet);
 int net_receive_packet(net_interface_t* iface, net_packet_t* packet);
 
@@ -114,6 +203,52 @@ static inline void mac_copy(mac_addr_t* dest, const mac_addr_t* src) {
     }
 }
 
+/*
+ * Receive path: NIC interrupts run a top half that only acknowledges the
+ * device, masks its receive interrupt and calls net_napi_schedule(). The
+ * "netrx" kernel thread (the bottom half) then drains each scheduled ring
+ * through its poll hook, at most NET_NAPI_BUDGET packets per round. A ring
+ * that empties within the budget is re-armed for interrupts; one that does
+ * not stays scheduled, so under load the driver runs polled with its
+ * interrupt off and the thread yields between rounds.
+ */
+#define NET_NAPI_BUDGET         16
+
+typedef struct net_napi {
+    struct net_napi* next;
+    const char* name;
+    // Process up to `budget` received packets; returns how many were handled
+    int (*poll)(struct net_napi* napi, int budget);
+    // Unmask the receive interrupt; non-zero if packets arrived meanwhile
+    int (*irq_enable)(struct net_napi* napi);
+    volatile uint32_t scheduled;
+    uint32_t irq;               // IRQ line, 0 when the ring is only polled
+    uint32_t interrupts;
+    uint32_t polls;
+    uint32_t packets;
+    uint32_t budget_exhausted;  // Rounds that left the ring in poll mode
+} net_napi_t;
+
+// Register a driver's receive ring with the bottom half
+void net_napi_add(net_napi_t* napi);
+
+// Queue `napi` for the bottom half; safe from interrupt handlers
+void net_napi_schedule(net_napi_t* napi);
+
+// Start the bottom-half thread; before it runs, net_poll() drives RX inline
+int net_start_rx_thread(void);
+
+// Timer hook: schedule every ring, covering lost or unwired interrupts
+void net_rx_kick(void);
+
+/*
+ * Wait up to `timeout_ms` for `*cond` to become non-zero. Tasks that can
+ * block sleep until the bottom half has processed a batch; others halt
+ * until the next interrupt and poll the rings inline. Returns 0 once the
+ * condition holds, -1 otherwise.
+ */
+int net_wait(volatile uint32_t* cond, uint32_t timeout_ms);
+
 // Network polling (processes pending packets, ARP, etc.)
 void net_poll(void);
 
@@ -61,25 +61,130 @@ typedef enum {
     TCP_TIME_WAIT
 } tcp_state_t;
 
-// TCP socket structure
+// Sequence-space comparisons, correct across 32-bit wraparound
+#define TCP_SEQ_LT(a, b)    ((int32_t)((uint32_t)(a) - (uint32_t)(b)) < 0)
+#define TCP_SEQ_LEQ(a, b)   ((int32_t)((uint32_t)(a) - (uint32_t)(b)) <= 0)
+#define TCP_SEQ_GT(a, b)    ((int32_t)((uint32_t)(a) - (uint32_t)(b)) > 0)
+#define TCP_SEQ_GEQ(a, b)   ((int32_t)((uint32_t)(a) - (uint32_t)(b)) >= 0)
+
+struct tcp_cong_ops;
+
+#define TCP_CONG_PRIV_WORDS 8
+#define TCP_CONG_NAME_MAX 16
+#define TCP_OOO_MAX_RANGES 8            // Disjoint out-of-order runs we keep
+#define TCP_SACK_MAX_RANGES 8           // Peer-SACKed runs the sender tracks
+
+// Half-open sequence range [start, end)
 typedef struct {
+    uint32_t start;
+    uint32_t end;
+} tcp_seq_range_t;
+
+// TCP socket structure
+typedef struct tcp_socket {
     uint16_t local_port;
     uint32_t local_ip;
     uint16_t remote_port;
     uint32_t remote_ip;
     tcp_state_t state;
-    uint32_t seq_num;
-    uint32_t ack_num;
-    uint16_t window_size;
+    uint32_t seq_num;           // SND.NXT: next sequence number to send
+    uint32_t ack_num;           // RCV.NXT: next sequence number expected
+    uint32_t rcv_wnd;           // Receive window last advertised, bytes
     uint8_t bound;
     uint8_t error;
+    volatile uint32_t event;    // Set when a segment for this socket is processed
     // Receive buffer
     uint8_t* rx_buffer;
     uint32_t rx_head;
     uint32_t rx_tail;
     uint32_t rx_size;
+    // Send buffer: tx_len bytes starting at SND.UNA, sent or not
+    uint8_t* tx_buffer;
+    uint32_t tx_head;           // Ring offset of the byte at SND.UNA
+    uint32_t tx_len;
+    uint32_t tx_size;
+    uint32_t snd_una;           // Oldest unacknowledged sequence number
+    uint32_t snd_max;           // Highest sequence number sent so far, + 1
+    uint32_t snd_wnd;           // Peer's advertised window
+    uint32_t snd_wl1;           // Segment seq/ack of the last window update
+    uint32_t snd_wl2;
+    uint16_t mss;               // Largest payload per segment
+    uint8_t fin_pending;        // Send FIN once the buffer drains
+    uint8_t fin_sent;
+    uint8_t orphan;             // Closed by its owner, finishing in the background
+    uint8_t dup_acks;
+    uint8_t retransmits;        // Consecutive timeouts without progress
+    uint8_t rto_armed;
+    // RFC 6298 RTT estimator; srtt and rttvar are kept scaled by 8 and 4
+    uint32_t srtt;
+    uint32_t rttvar;
+    uint32_t rto_ms;
+    uint32_t rto_deadline;
+    uint32_t rtt_seq;           // Timed segment, acked once SND.UNA passes it
+    uint32_t rtt_start;
+    uint8_t rtt_active;
+    uint32_t linger_deadline;   // Release time in FIN_WAIT_2/TIME_WAIT
+    // Congestion control (RFC 5681), with NewReno loss recovery (RFC 6582)
+    const struct tcp_cong_ops* cong;
+    uint32_t cwnd;              // Bytes the network may hold in flight
+    uint32_t ssthresh;
+    uint32_t cwnd_cnt;          // Bytes acked toward the next additive increase
+    uint32_t recover;           // SND.MAX when the last recovery began
+    uint8_t in_recovery;
+    uint32_t cong_priv[TCP_CONG_PRIV_WORDS];  // Algorithm-private state
+    uint32_t retrans_segs;      // Segments sent again, for any reason
+    uint32_t fast_retransmits;
+    uint32_t timeouts;
+    // Options agreed on the handshake: MSS, window scale (RFC 7323),
+    // SACK (RFC 2018) and timestamps (RFC 7323)
+    uint16_t peer_mss;          // 0 until the peer's SYN is seen
+    uint8_t wscale_ok;
+    uint8_t snd_wscale;         // Shift for windows the peer advertises
+    uint8_t rcv_wscale;         // Shift for windows we advertise
+    uint8_t sack_ok;
+    uint8_t ts_ok;
+    uint32_t ts_recent;         // Peer TSval to echo
+    // Out-of-order data, already stored in the receive ring past RCV.NXT
+    tcp_seq_range_t ooo[TCP_OOO_MAX_RANGES];
+    uint8_t ooo_count;
+    uint32_t ooo_last;          // Start of the latest out-of-order segment
+    // SACK scoreboard: data above SND.UNA the peer reports holding
+    tcp_seq_range_t sacked[TCP_SACK_MAX_RANGES];
+    uint8_t sacked_count;
+    uint32_t high_rxt;          // End of the latest recovery retransmission
+    // Receive-buffer autotuning
+    uint32_t rcv_copied;        // Bytes the owner read this round trip
+    uint32_t rcv_round_start;
 } tcp_socket_t;
 
+// Per-connection snapshot for netstat-style listings
+typedef struct {
+    uint32_t local_ip;
+    uint16_t local_port;
+    uint32_t remote_ip;
+    uint16_t remote_port;
+    tcp_state_t state;
+    char cong[TCP_CONG_NAME_MAX];
+    uint32_t mss;
+    uint32_t cwnd;              // Bytes
+    uint32_t ssthresh;          // Bytes, 0xFFFFFFFF before the first loss
+    uint32_t snd_wnd;
+    uint32_t in_flight;
+    uint32_t srtt_ms;           // 0 until the first RTT sample
+    uint32_t rttvar_ms;
+    uint32_t rto_ms;
+    uint32_t retrans_segs;
+    uint32_t fast_retransmits;
+    uint32_t timeouts;
+    uint32_t rcv_buf;           // Receive buffer size, bytes
+    uint8_t wscale_ok;
+    uint8_t snd_wscale;
+    uint8_t rcv_wscale;
+    uint8_t sack_ok;
+    uint8_t ts_ok;
+    uint8_t ooo_ranges;
+} tcp_conn_info_t;
+
 // TCP initialization
 void tcp_init(void);
 
@@ -94,14 +199,29 @@ int tcp_socket_bind(tcp_socket_t* sock, uint32_t ip, uint16_t port);
 int tcp_socket_listen(tcp_socket_t* sock, int backlog);
 tcp_socket_t* tcp_socket_accept(tcp_socket_t* sock);
 int tcp_socket_connect(tcp_socket_t* sock, uint32_t ip, uint16_t port);
+// Queue data behind the send window, blocking while the buffer is full; returns len
 int tcp_socket_send(tcp_socket_t* sock, const uint8_t* data, uint32_t len);
 int tcp_socket_recv(tcp_socket_t* sock, uint8_t* buffer, uint32_t len);
+// Queued data and the FIN still go out after close; the socket is freed once done
 void tcp_socket_close(tcp_socket_t* sock);
 
 // Blocking operations
 int tcp_socket_connect_blocking(tcp_socket_t* sock, uint32_t ip, uint16_t port, uint32_t timeout_ms);
 int tcp_socket_recv_blocking(tcp_socket_t* sock, uint8_t* buffer, uint32_t len, uint32_t timeout_ms);
 
+// Pick the congestion-control algorithm for one connection by name
+int tcp_socket_set_congestion(tcp_socket_t* sock, const char* name);
+
+// Ceiling for receive-buffer autotuning (the procfs tcp_rmem_max knob)
+uint32_t tcp_get_rmem_max(void);
+int tcp_set_rmem_max(uint32_t bytes);
+
+// Fill up to max entries for sockets in use; returns the count
+int tcp_get_connections(tcp_conn_info_t* out, int max);
+
+// Retransmission and lingering-close timer, run from the network bottom half
+void tcp_timer(void);
+
 // TCP utilities
 const char* tcp_state_to_string(tcp_state_t state);
 
@@ -0,0 +1,73 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * include/net/tcp_cong.h
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+/*
+ * DEVELOPER_NOTE_BLOCK
+ * Module Overview:
+ * - This file is part of the aOS production kernel/userspace codebase.
+ * - Review public symbols in this unit to understand contracts with adjacent modules.
+ * - Keep behavior-focused comments near non-obvious invariants, state transitions, and safety checks.
+ * - Avoid changing ABI/data-layout assumptions without updating dependent modules.
+ */
+
+#ifndef TCP_CONG_H
+#define TCP_CONG_H
+
+#include <stdint.h>
+#include <net/tcp.h>
+
+/*
+ * Pluggable TCP congestion control.
+ *
+ * The TCP core owns loss detection and recovery: it calls ssthresh() when it
+ * detects a loss, sets cwnd to the result plus the NewReno inflation (or to
+ * one segment after a timeout), and leaves recovery on the ACK that covers
+ * everything sent before the loss. Outside recovery, each ACK of new data
+ * goes to cong_avoid(), which grows cwnd in slow start and congestion
+ * avoidance. Algorithms keep their own state in sock->cong_priv.
+ */
+
+#define TCP_CONG_MAX_ALGORITHMS 4
+#define TCP_CONG_CWND_MAX 0x3FFFFFFFu
+
+typedef enum {
+    TCP_CA_EVENT_FAST_RECOVERY = 0,     // Three duplicate ACKs, ssthresh just set
+    TCP_CA_EVENT_RECOVERY_EXIT,         // Everything sent before the loss is acked
+    TCP_CA_EVENT_TIMEOUT                // Retransmission timeout, cwnd is one segment
+} tcp_ca_event_t;
+
+typedef struct tcp_cong_ops {
+    const char* name;
+    void (*init)(tcp_socket_t* sock);                           // Optional
+    uint32_t (*ssthresh)(tcp_socket_t* sock);                   // Threshold after a loss
+    void (*cong_avoid)(tcp_socket_t* sock, uint32_t acked);     // acked: new bytes
+    void (*event)(tcp_socket_t* sock, tcp_ca_event_t event);    // Optional
+} tcp_cong_ops_t;
+
+extern const tcp_cong_ops_t tcp_newreno_ops;
+extern const tcp_cong_ops_t tcp_cubic_ops;
+
+// Register the built-in algorithms; NewReno is the default
+void tcp_cong_init(void);
+int tcp_cong_register(const tcp_cong_ops_t* ops);
+const tcp_cong_ops_t* tcp_cong_find(const char* name);
+
+// Algorithm given to new connections (the procfs tcp_congestion_control knob)
+const tcp_cong_ops_t* tcp_cong_default(void);
+int tcp_cong_set_default(const char* name);
+
+// Space-separated names of the registered algorithms
+int tcp_cong_list(char* buf, uint32_t size);
+
+// Helpers for algorithms
+uint32_t tcp_cong_flight_size(const tcp_socket_t* sock);
+void tcp_cong_slow_start(tcp_socket_t* sock, uint32_t acked);
+void tcp_cong_avoid_ai(tcp_socket_t* sock, uint32_t bytes_per_mss, uint32_t acked);
+
+#endif // TCP_CONG_H
@@ -48,6 +48,7 @@ typedef struct {
     uint32_t filesystem_type;        // Filesystem identifier
     char mount_point[32];            // Where it's mounted
     int mounted;                     // Mount status
+    uint32_t dev;                    // Block device holding it (dev/blkdev.h)
 } partition_t;
 
 // Partition table manager
@@ -59,7 +60,7 @@ typedef struct {
 // Initialize partition manager
 void init_partitions(void);
 
-// Partition operations
+// Partition operations; partition_create() places the partition on block device 0
 int partition_create(const char* name, uint8_t type, uint32_t start_sector, uint32_t size_sectors);
 int partition_delete(int partition_id);
 void partition_clear(void);
@@ -67,16 +68,20 @@ int partition_list(void);
 partition_t* partition_get(int partition_id);
 int partition_find_first_by_type(uint8_t type);
 int partition_find_first_by_type_and_fs(uint8_t type, uint32_t filesystem_type);
-int partition_mount(int partition_id, const char* mount_point, const char* fs_type);
+// flags are VFS_MOUNT_* (fs/vfs.h)
+int partition_mount(int partition_id, const char* mount_point, const char* fs_type, uint32_t flags);
 int partition_unmount(int partition_id);
 
+// Mount source string ("dev=<name> lba=<start>") for the filesystem drivers
+int partition_mount_source(const partition_t* part, char* buf, uint32_t size);
+
 // Scan disk for partitions
 int partition_scan_disk(void);
 
-// Write partition table to disk
+// Write each disk's partitions to its table sector
 int partition_save_table(void);
 
-// Read partition table from disk
+// Read partition tables from every block device
 int partition_load_table(void);
 
 #endif // PARTITION_H
@@ -58,6 +58,10 @@ void* alloc_page_from_zone(pmm_zone_t zone);
 void* alloc_pages_contiguous(size_t num_pages);
 void free_page(void* page);
 
+// Frame sharing (copy-on-write). free_page() releases one owner at a time.
+int pmm_page_ref(void* page);
+uint32_t pmm_page_refcount(void* page);
+
 // Validation and safety
 int pmm_is_valid_frame(uint32_t frame_addr);
 int pmm_is_frame_used(uint32_t frame_addr);
@@ -69,6 +69,11 @@ typedef enum {
 // Process ID type
 typedef int pid_t;
 
+// Tasks blocked until an event (typically an IRQ) wakes them
+typedef struct wait_queue {
+    struct process* head;
+} wait_queue_t;
+
 // CPU context saved during context switch
 typedef struct {
 #if defined(ARCH_X86_64)
@@ -129,7 +134,17 @@ typedef struct process {
     uint32_t files_open;            // Number of open files
     uint32_t children_count;        // Number of child processes
     
-    struct process* next;           // Next in queue
+    struct process* next;           // Next in ready queue
+    struct process* prev;           // Previous in ready queue
+    uint8_t on_runqueue;            // 1 while linked into a ready queue
+    uint8_t on_timer_wheel;         // 1 while linked into the sleep wheel
+    uint8_t timer_level;            // Sleep wheel level
+    uint8_t timer_slot;             // Sleep wheel slot within the level
+    uint8_t cpu;                    // CPU whose ready queue owns this task
+    struct process* timer_next;     // Next in sleep wheel bucket
+    struct process* timer_prev;     // Previous in sleep wheel bucket
+    wait_queue_t* wait_queue;       // Wait queue this task is blocked on
+    struct process* wait_next;      // Next waiter on the same queue
     struct process* parent;         // Parent process
     struct process* children;       // First child
     struct process* sibling;        // Next sibling
@@ -165,9 +180,24 @@ const char* process_task_type_name(task_type_t type);
 // Scheduler
 void schedule(void);
 void scheduler_tick(void);
+void scheduler_tick_local(uint32_t elapsed);  // Per-CPU time slice accounting
+void scheduler_advance(uint32_t now);         // Global tick work up to tick `now`
+uint32_t scheduler_next_event(uint32_t now);  // Ticks until this CPU's next deadline
+void process_run_cpu_idle(void) __attribute__((noreturn));  // AP scheduler loop
 void process_set_preempt_disabled(int disabled);
 int process_is_preempt_disabled(void);
 
+// Wait queues
+void wait_queue_init(wait_queue_t* wq);
+/*
+ * Block the current task on `wq` until `*condition` is non-zero. Returns 0
+ * once it is, -1 after `timeout_ms` (0 = no timeout). Only call when
+ * process_can_block() is true; otherwise poll the device instead.
+ */
+int wait_queue_wait(wait_queue_t* wq, volatile uint32_t* condition, uint32_t timeout_ms);
+void wait_queue_wake_all(wait_queue_t* wq);  // Safe from interrupt handlers
+int process_can_block(void);
+
 // Memory management
 void* process_sbrk(int increment);
 
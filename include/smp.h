@@ -0,0 +1,108 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * include/smp.h
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+/*
+ * DEVELOPER_NOTE_BLOCK
+ * Module Overview:
+ * - This file is part of the aOS production kernel/userspace codebase.
+ * - Review public symbols in this unit to understand contracts with adjacent modules.
+ * - Keep behavior-focused comments near non-obvious invariants, state transitions, and safety checks.
+ * - Avoid changing ABI/data-layout assumptions without updating dependent modules.
+ */
+
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdint.h>
+
+#define SMP_MAX_CPUS            16
+
+// Physical page the AP real-mode trampoline is copied to (SIPI vector 0x07)
+#define SMP_TRAMPOLINE_BASE     0x7000
+#define SMP_AP_STACK_SIZE       16384
+
+// Inter-processor interrupt vectors (delivered through the LAPIC, not the PIC)
+#define SMP_TICK_VECTOR         0xF0    // Scheduler tick forwarded from the BSP
+#define SMP_TLB_VECTOR          0xF1    // TLB shootdown request
+
+// smp_irq_enter() results
+#define SMP_IRQ_NESTED          0       // CPU already held the kernel lock
+#define SMP_IRQ_LOCKED          1       // Kernel lock taken on entry, drop on exit
+#define SMP_IRQ_SKIP            -1      // Lock busy for a droppable tick: skip handler
+
+struct process;
+struct address_space;
+
+// Per-CPU state
+typedef struct cpu_local {
+    uint32_t index;                     // Logical CPU number (0 = BSP)
+    uint32_t apic_id;
+    volatile uint32_t online;
+    struct process* current;            // Task running on this CPU
+    struct process* idle;               // Fallback task when nothing is runnable
+    struct address_space* address_space;  // Address space loaded in CR3
+    uint32_t preempt_disable_depth;
+    volatile uint32_t tlb_flush_pending;
+    uint32_t ticks;                     // Scheduler ticks observed by this CPU
+    uint32_t clock_last_tick;           // Tick of the last clock event handled here
+    uint32_t clock_events;              // Clock event interrupts taken
+    uintptr_t stack_top;                // Boot/idle stack of an AP
+    uintptr_t irq_stack_top;            // Ring 0 stack for user -> kernel entries on an AP
+} cpu_local_t;
+
+/*
+ * Boot parameters patched into the trampoline page for each AP. Layout is
+ * shared with ap_trampoline.s of both architectures.
+ */
+typedef struct {
+    uint64_t cr0;
+    uint64_t cr3;
+    uint64_t cr4;
+    uint64_t efer;
+    uint64_t stack_top;
+    uint64_t entry;
+    uint64_t cpu_index;
+} __attribute__((packed)) smp_ap_boot_params_t;
+
+// Bring up every enabled application processor listed in the MADT
+void smp_init(void);
+
+cpu_local_t* smp_this_cpu(void);
+cpu_local_t* smp_cpu(uint32_t index);
+uint32_t smp_cpu_index(void);
+uint32_t smp_cpu_count(void);    // CPUs with a cpu_local slot (online or not)
+uint32_t smp_online_count(void);
+int smp_is_active(void);
+
+/*
+ * Big kernel lock: only one CPU executes kernel code at a time. It is taken
+ * on every ring 3 -> ring 0 transition and dropped when returning to user
+ * mode or halting, so user-mode work on different CPUs runs in parallel.
+ */
+void smp_kernel_lock(void);
+void smp_kernel_unlock(void);
+int smp_kernel_lock_held(void);
+
+int smp_irq_enter(uint32_t vector);
+// `to_user` is set when the interrupt frame returns to ring 3
+void smp_irq_exit(int state, int to_user);
+
+// Halt until the next interrupt with the kernel lock dropped
+void smp_wait_for_interrupt(void);
+
+// Forward the scheduler tick to the other online CPUs
+void smp_send_tick(void);
+
+// Make `cpu` re-run its scheduler (e.g. new work for an idle CPU)
+void smp_send_reschedule(uint32_t cpu);
+
+// Flush TLBs of other CPUs that may cache translations of `as`
+void smp_tlb_shootdown(struct address_space* as);
+
+#endif // SMP_H
@@ -26,7 +26,7 @@
 // Userspace memory allocator (aOS-style)
 // Uses pool-based allocation for efficiency
 
-#define UMEM_POOL_SIZE 8192  // 8KB per pool
+#define UMEM_POOL_SIZE 65536  // 64KB per pool (kernel backs pages on first touch)
 
 // Memory block header
 typedef struct mem_block {
@@ -23,6 +23,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <arch/paging.h>
+#include <smp.h>
 
 // Virtual Memory Manager - handles higher-level memory operations
 
@@ -37,6 +38,11 @@
 #define VMM_WRITE       PAGE_WRITE
 #define VMM_USER        PAGE_USER
 #define VMM_NOCACHE     PAGE_NOCACHE
+#define VMM_DEMAND      0x00010000  // Reserve only: frames are mapped on first touch
+
+// User stack reservation (backed on demand, ends at KERNEL_VIRTUAL_BASE)
+#define VMM_USER_STACK_RESERVE  ((uintptr_t)0x100000)
+#define VMM_USER_STACK_BASE     (VMM_USER_STACK_TOP + 1 - VMM_USER_STACK_RESERVE)
 
 // Memory guards for corruption detection
 #define GUARD_MAGIC_START   0xDEADBEEF
@@ -54,37 +60,91 @@
 #define SLAB_SIZE_2048  2048
 #define NUM_SLAB_CACHES 9
 
+// Slab debugging: header checksums, end guards and free poisoning.
+// Off by default so release kernels take the short path; `make SLAB_DEBUG=1`.
+#ifndef SLAB_DEBUG
+#define SLAB_DEBUG 0
+#endif
+
+// Magazine layer in front of the kernel slab caches
+#define SLAB_MAX_CPUS           8
+#define SLAB_MAGAZINE_ROUNDS    16      // Objects cached per magazine
+#define SLAB_DEPOT_MAGAZINES    4       // Spare magazines parked in each depot
+#define SLAB_COLOR_ALIGN        64      // Offset step between slab colors (cache line)
+
 // Slab object header (prepended to each allocation)
 typedef struct slab_obj {
     uint32_t magic_start;       // Guard against underflow
     uint32_t size;              // Size of allocation
     struct slab_obj *next;      // Next free object
-    uint32_t checksum;          // Integrity check
+    uint32_t checksum;          // Integrity check (SLAB_DEBUG only)
 } slab_obj_t;
 
+// Fixed-capacity stack of free objects owned by one CPU
+typedef struct slab_magazine {
+    uint32_t rounds;
+    void *objs[SLAB_MAGAZINE_ROUNDS];
+} slab_magazine_t;
+
+// Per-CPU magazine pair (Bonwick-style loaded/previous)
+typedef struct slab_cpu_cache {
+    slab_magazine_t *loaded;
+    slab_magazine_t *previous;
+} slab_cpu_cache_t;
+
+// Depot of spare full/empty magazines shared by all CPUs of one cache
+typedef struct slab_depot {
+    slab_cpu_cache_t cpu[SLAB_MAX_CPUS];
+    slab_magazine_t *full[SLAB_DEPOT_MAGAZINES];
+    slab_magazine_t *empty[SLAB_DEPOT_MAGAZINES];
+    uint32_t full_count;
+    uint32_t empty_count;
+    uint32_t refills;           // Bulk refills from the slab free list
+    uint32_t flushes;           // Bulk returns to the slab free list
+    slab_magazine_t pool[SLAB_DEPOT_MAGAZINES + 2 * SLAB_MAX_CPUS];
+} slab_depot_t;
+
 // Slab cache for fixed-size allocations
 typedef struct slab_cache {
     uint32_t obj_size;          // Size of objects in this cache
     slab_obj_t *free_list;      // List of free objects
     uint32_t total_objects;     // Total objects allocated
-    uint32_t free_objects;      // Free objects available
+    uint32_t free_objects;      // Objects not handed out (free list + magazines)
+    uint32_t cached_objects;    // Subset of free_objects held in magazines
     uint32_t total_slabs;       // Number of slabs (pages)
+    uint32_t color_next;        // Offset of the first object in the next slab
     void *slab_pages;           // Linked list of slab pages
+    slab_depot_t *depot;        // Magazine layer (NULL = free list only)
 } slab_cache_t;
 
+// VMA magic and red-black tree colors
+#define VMA_MAGIC       0xDEADBEEF
+#define VMA_RB_RED      0
+#define VMA_RB_BLACK    1
+
 // Virtual memory area structure (for tracking allocations)
+// VMAs never overlap; each address space keeps them both in an
+// address-ordered list and in a red-black tree keyed by start_addr.
 typedef struct vma {
     uintptr_t start_addr;
     uintptr_t end_addr;
     uint32_t flags;
     uint32_t magic;             // Magic number for validation
-    struct vma *next;
+    struct vma *next;           // Next VMA by address
+    struct vma *prev;           // Previous VMA by address
+    struct vma *rb_parent;
+    struct vma *rb_left;
+    struct vma *rb_right;
+    uint32_t rb_color;
+    uintptr_t subtree_gap;      // Largest unmapped gap before any VMA in this subtree
 } vma_t;
 
 // Address space structure (per-process)
-typedef struct {
+typedef struct address_space {
     page_directory_t *page_dir;
-    vma_t *vma_list;
+    vma_t *vma_list;            // Lowest VMA (head of the address-ordered list)
+    vma_t *vma_root;            // Root of the VMA tree
+    uint32_t vma_count;
     uintptr_t heap_start;
     uintptr_t heap_end;
     uintptr_t stack_top;
@@ -98,12 +158,26 @@ void init_vmm(void);
 address_space_t *create_address_space(void);
 void destroy_address_space(address_space_t *as);
 void switch_address_space(address_space_t *as);
+address_space_t *vmm_fork_address_space(address_space_t *parent);
+
+// Resolve a page fault in the current address space (copy-on-write break
+// or demand fill). Returns 1 if the faulting access can be retried.
+int vmm_handle_page_fault(uintptr_t fault_addr, int present, int write);
 
 // Memory allocation functions
 void *vmm_alloc_pages(address_space_t *as, uintptr_t virtual_addr, size_t num_pages, uint32_t flags);
 void *vmm_alloc_at(address_space_t *as, uintptr_t virtual_addr, size_t size, uint32_t flags);
 void *vmm_alloc_anywhere(address_space_t *as, size_t size, uint32_t flags);
-void vmm_free_pages(address_space_t *as, uintptr_t virtual_addr, size_t num_pages);
+int vmm_free_pages(address_space_t *as, uintptr_t virtual_addr, size_t num_pages);  // 0, or -1 with nothing freed
+
+// VMA tree (src/mm/vma.c)
+void vma_insert(address_space_t *as, vma_t *vma);
+void vma_remove(address_space_t *as, vma_t *vma);
+void vma_resize(address_space_t *as, vma_t *vma, uintptr_t start_addr, uintptr_t end_addr);
+vma_t *vma_find(address_space_t *as, uintptr_t addr);
+vma_t *vma_find_intersection(address_space_t *as, uintptr_t start_addr, uintptr_t end_addr);
+uintptr_t vma_find_gap(address_space_t *as, uintptr_t low, uintptr_t high, size_t length);
+int vma_validate(address_space_t *as);
 
 // Kernel memory allocation (using kernel address space)
 void *kmalloc_pages(size_t num_pages);
@@ -114,11 +188,13 @@ void kfree(void *ptr);
 // Memory mapping
 int vmm_map_physical(address_space_t *as, uintptr_t virtual_addr, uintptr_t physical_addr, size_t size, uint32_t flags);
 int vmm_unmap(address_space_t *as, uintptr_t virtual_addr, size_t size);
+int vmm_protect(address_space_t *as, uintptr_t virtual_addr, size_t size, uint32_t flags);
 
 // Utility functions
 int vmm_is_mapped(address_space_t *as, uintptr_t virtual_addr);
 uintptr_t vmm_virt_to_phys(address_space_t *as, uintptr_t virtual_addr);
 void vmm_print_stats(address_space_t *as);
+void vmm_get_usage(address_space_t *as, size_t *virtual_bytes, size_t *resident_bytes);
 
 // Memory validation and debugging
 int vmm_validate_pointer(void *ptr);
@@ -129,8 +205,8 @@ int vmm_validate_allocation(void *ptr);
 int vmm_scan_region_for_corruption(void *start, size_t size);
 int vmm_check_heap_consistency(void);
 
-// Current address space
-extern address_space_t *current_address_space;
+// Address space loaded on this CPU
+#define current_address_space (smp_this_cpu()->address_space)
 extern address_space_t *kernel_address_space;
 
 #endif // VMM_H
@@ -0,0 +1,92 @@
+; === AOS HEADER BEGIN ===
+; src/arch/i386/ap_trampoline.s
+; Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+; Licensed under CC BY-NC 4.0
+; aOS Version : 0.9.0
+; === AOS HEADER END ===
+
+; Application processor startup trampoline.
+;
+; smp_init() copies this blob to SMP_TRAMPOLINE_BASE and patches
+; ap_trampoline_params (smp_ap_boot_params_t) before each STARTUP IPI.
+; The AP starts in real mode at TRAMPOLINE_BASE:0, enters protected mode,
+; loads the BSP's CR4/CR3/CR0 (paging + WP) and calls
+; smp_ap_entry(cpu_index) on the stack the BSP allocated for it.
+;
+; All addresses are computed relative to ap_trampoline_start because the
+; code runs from the copy, not from where it was linked.
+
+%define TRAMPOLINE_BASE 0x7000
+%define REL(label) (TRAMPOLINE_BASE + ((label) - ap_trampoline_start))
+
+; smp_ap_boot_params_t field offsets (include/smp.h)
+%define PARAM_CR0       0
+%define PARAM_CR3       8
+%define PARAM_CR4       16
+%define PARAM_STACK     32
+%define PARAM_ENTRY     40
+%define PARAM_CPU       48
+
+section .rodata
+align 16
+
+global ap_trampoline_start
+global ap_trampoline_params
+global ap_trampoline_end
+
+BITS 16
+ap_trampoline_start:
+    cli
+    cld
+    xor ax, ax
+    mov ds, ax
+    lgdt [REL(tramp_gdt_ptr)]
+
+    mov eax, cr0
+    or eax, 1                         ; PE
+    mov cr0, eax
+    jmp dword 0x08:REL(ap_pm32)
+
+BITS 32
+ap_pm32:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+
+    mov eax, [REL(ap_trampoline_params) + PARAM_CR4]
+    mov cr4, eax
+    mov eax, [REL(ap_trampoline_params) + PARAM_CR3]
+    mov cr3, eax
+    mov eax, [REL(ap_trampoline_params) + PARAM_CR0]
+    mov cr0, eax                      ; PG|WP from the BSP; trampoline is identity-mapped
+    jmp .paged
+.paged:
+    mov esp, [REL(ap_trampoline_params) + PARAM_STACK]
+    xor ebp, ebp
+    push dword [REL(ap_trampoline_params) + PARAM_CPU]
+    mov eax, [REL(ap_trampoline_params) + PARAM_ENTRY]
+    call eax
+
+.hang:
+    cli
+    hlt
+    jmp .hang
+
+align 8
+tramp_gdt:
+    dq 0x0000000000000000
+    dq 0x00CF9A000000FFFF             ; 0x08: 32-bit flat code
+    dq 0x00CF92000000FFFF             ; 0x10: flat data
+tramp_gdt_end:
+
+tramp_gdt_ptr:
+    dw tramp_gdt_end - tramp_gdt - 1
+    dd REL(tramp_gdt)
+
+align 8
+ap_trampoline_params:
+    times 7 dq 0
+ap_trampoline_end:
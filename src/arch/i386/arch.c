@@ -14,6 +14,7 @@
 #include <arch/pit.h>
 #include <arch/isr.h>
 #include <io.h>
+#include <ktime.h>
 #include <stdint.h>
 
 /*
@@ -96,6 +97,17 @@ void arch_set_kernel_stack(uintptr_t stack) {
     set_kernel_stack((uint32_t)stack);
 }
 
+// Multiprocessor support
+uint32_t arch_cpu_index(void) {
+    return gdt_cpu_index();
+}
+
+void arch_smp_cpu_init(uint32_t cpu, uintptr_t irq_stack_top) {
+    /* Load this AP's GDT/TSS, then the shared IDT. */
+    gdt_init_cpu(cpu, (uint32_t)irq_stack_top);
+    idt_reload();
+}
+
 // Timer initialization
 // Use the existing PIT timer system (which maintains system_ticks)
 extern volatile uint32_t system_ticks;
@@ -126,13 +138,19 @@ void arch_timer_init(uint32_t frequency_hz) {
 }
 
 uint32_t arch_timer_get_ticks(void) {
-    return system_ticks;
+    return ktime_get_ticks();
 }
 
 uint32_t arch_timer_get_frequency(void) {
     return timer_frequency;
 }
 
+uint64_t arch_read_tsc(void) {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
 // I/O port access (i386 supports this natively)
 #define ARCH_HAS_IO_PORTS 1
 
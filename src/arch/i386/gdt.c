@@ -19,6 +19,7 @@
 
 #include <arch/i386/gdt.h> // Updated include path
 #include <string.h>        // For memset
+#include <smp.h>           // For SMP_MAX_CPUS
 
 #define GDT_ENTRIES 6 // Null, Kernel Code, Kernel Data, User Code, User Data, TSS
 
@@ -26,17 +27,42 @@ gdt_entry_t gdt_entries[GDT_ENTRIES];
 gdt_ptr_t   gdt_ptr;
 tss_entry_t tss_entry;
 
+/*
+ * Application processors get their own GDT copy so each can hold a busy TSS
+ * descriptor. The GDT base doubles as a cheap CPU identifier (see
+ * gdt_cpu_index); slot 0 is unused because the BSP keeps gdt_entries.
+ */
+static gdt_entry_t cpu_gdt_entries[SMP_MAX_CPUS][GDT_ENTRIES];
+static gdt_ptr_t   cpu_gdt_ptr[SMP_MAX_CPUS];
+static tss_entry_t cpu_tss[SMP_MAX_CPUS];
+
+static void gdt_fill_gate(gdt_entry_t* table, int32_t num, uint32_t base, uint32_t limit, uint8_t access, uint8_t gran) {
+    table[num].base_low    = (base & 0xFFFF);
+    table[num].base_middle = (base >> 16) & 0xFF;
+    table[num].base_high   = (base >> 24) & 0xFF;
+
+    table[num].limit_low   = (limit & 0xFFFF);
+    table[num].granularity = (limit >> 16) & 0x0F;
+
+    table[num].granularity |= gran & 0xF0;
+    table[num].access      = access;
+}
+
 // Helper function to create a GDT entry
 static void gdt_set_gate(int32_t num, uint32_t base, uint32_t limit, uint8_t access, uint8_t gran) {
-    gdt_entries[num].base_low    = (base & 0xFFFF);
-    gdt_entries[num].base_middle = (base >> 16) & 0xFF;
-    gdt_entries[num].base_high   = (base >> 24) & 0xFF;
-
-    gdt_entries[num].limit_low   = (limit & 0xFFFF);
-    gdt_entries[num].granularity = (limit >> 16) & 0x0F;
+    gdt_fill_gate(gdt_entries, num, base, limit, access, gran);
+}
 
-    gdt_entries[num].granularity |= gran & 0xF0;
-    gdt_entries[num].access      = access;
+static void tss_init(tss_entry_t* tss, uint32_t kernel_stack) {
+    memset(tss, 0, sizeof(*tss));
+    tss->ss0 = 0x10;  // Kernel data segment
+    tss->esp0 = kernel_stack;
+    tss->cs = 0x0b;    // Kernel code segment | Ring 3
+    tss->ss = 0x13;    // User data segment | Ring 3
+    tss->ds = 0x13;
+    tss->es = 0x13;
+    tss->fs = 0x13;
+    tss->gs = 0x13;
 }
 
 void init_gdt() {
@@ -62,16 +88,8 @@ void init_gdt() {
     // Granularity=0xCF (4KB blocks, 32-bit protected mode)
     gdt_set_gate(4, 0, 0xFFFFFFFF, 0xF2, 0xCF);
 
-    // Initialize TSS
-    memset(&tss_entry, 0, sizeof(tss_entry));
-    tss_entry.ss0 = 0x10;  // Kernel data segment
-    tss_entry.esp0 = 0;     // Will be set during context switch
-    tss_entry.cs = 0x0b;    // Kernel code segment | Ring 3
-    tss_entry.ss = 0x13;    // User data segment | Ring 3
-    tss_entry.ds = 0x13;
-    tss_entry.es = 0x13;
-    tss_entry.fs = 0x13;
-    tss_entry.gs = 0x13;
+    // Initialize TSS (esp0 is set during context switch)
+    tss_init(&tss_entry, 0);
 
     // TSS Segment: access=0x89 (present, ring 0, TSS, accessed)
     uint32_t tss_base = (uint32_t)&tss_entry;
@@ -85,6 +103,40 @@ void init_gdt() {
     tss_load(0x28);
 }
 
+void gdt_init_cpu(uint32_t cpu, uint32_t kernel_stack) {
+    /* Clone the BSP segments and give this AP a private TSS. */
+    if (cpu == 0 || cpu >= SMP_MAX_CPUS) return;
+
+    gdt_entry_t* table = cpu_gdt_entries[cpu];
+    memcpy(table, gdt_entries, sizeof(gdt_entries));
+
+    tss_init(&cpu_tss[cpu], kernel_stack);
+    gdt_fill_gate(table, 5, (uint32_t)&cpu_tss[cpu], sizeof(tss_entry_t), 0x89, 0x40);
+
+    cpu_gdt_ptr[cpu].limit = sizeof(gdt_entries) - 1;
+    cpu_gdt_ptr[cpu].base = (uint32_t)table;
+
+    gdt_load((uint32_t)&cpu_gdt_ptr[cpu]);
+    tss_load(TSS_SEGMENT);
+}
+
+uint32_t gdt_cpu_index(void) {
+    gdt_ptr_t current;
+    asm volatile("sgdt %0" : "=m"(current));
+
+    uint32_t first = (uint32_t)&cpu_gdt_entries[0];
+    uint32_t last = (uint32_t)&cpu_gdt_entries[SMP_MAX_CPUS];
+    if (current.base < first || current.base >= last) {
+        return 0;  // Boot GDT: the BSP
+    }
+    return (current.base - first) / sizeof(cpu_gdt_entries[0]);
+}
+
 void set_kernel_stack(uint32_t stack) {
-    tss_entry.esp0 = stack;
+    uint32_t cpu = gdt_cpu_index();
+    if (cpu == 0) {
+        tss_entry.esp0 = stack;
+    } else {
+        cpu_tss[cpu].esp0 = stack;
+    }
 }
@@ -111,7 +111,18 @@ void init_idt() {
     extern void isr128(void);
     idt_set_gate(128, (uint32_t)isr128, KERNEL_CS, 0xEE); // INT 0x80: Syscall (DPL=3)
 
+    // Local APIC vectors: scheduler tick / TLB shootdown IPIs and spurious
+    idt_set_gate(240, (uint32_t)isr240, KERNEL_CS, 0x8E);
+    idt_set_gate(241, (uint32_t)isr241, KERNEL_CS, 0x8E);
+    idt_set_gate(242, (uint32_t)isr242, KERNEL_CS, 0x8E);
+    idt_set_gate(255, (uint32_t)isr255, KERNEL_CS, 0x8E);
+
     // Load the IDT register.
     idt_load((uint32_t)&idt_ptr);
     serial_puts("IDT Initialized and Loaded (Exceptions & IRQs).\n");
 }
+
+void idt_reload(void) {
+    /* All CPUs share one IDT; APs only need IDTR pointed at it. */
+    idt_load((uint32_t)&idt_ptr);
+}
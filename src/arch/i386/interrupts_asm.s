@@ -156,6 +156,23 @@ common_irq_stub:
     add esp, 8            ; Clean up the pushed error code (dummy) and interrupt number
     iret                  ; Return from interrupt (restores EIP, CS, EFLAGS, and optionally UserESP, UserSS)
 
+; Local APIC vectors (IPIs and spurious). They use the ISR path because the
+; PIC must not see an EOI for them; handlers acknowledge the LAPIC instead.
+; push dword: vectors >= 128 do not fit a sign-extended push byte.
+%macro ISR_LAPIC 1
+global isr%1
+isr%1:
+    cli
+    push dword 0
+    push dword %1
+    jmp isr_stub_common
+%endmacro
+
+ISR_LAPIC 240   ; Scheduler tick IPI
+ISR_LAPIC 241   ; TLB shootdown IPI
+ISR_LAPIC 242   ; LAPIC timer (clock event)
+ISR_LAPIC 255   ; LAPIC spurious
+
 ; INT 0x80 - System Call Handler
 ; This needs DPL=3 in the IDT to allow ring 3 code to invoke it
 ; Uses the common ISR stub (not IRQ stub) so interrupt_handlers[] table is used
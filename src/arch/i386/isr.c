@@ -15,6 +15,7 @@
 // #include <panic.h>      // Old panic.h, new one includes debug.h, or directly include debug.h
 #include <debug.h>         // For panic_screen and other debug facilities
 #include <io.h>            // For outb()
+#include <smp.h>           // For the kernel lock taken on interrupt entry
 
 /*
  * i386 interrupt/exception dispatch layer.
@@ -49,8 +50,13 @@ void isr_handler_common(registers_t* regs) {
     // Check if there's a registered handler for this interrupt
     // This allows software interrupts (like INT 0x80 syscall) to be handled
     if (interrupt_handlers[regs->int_no] != 0) {
+        int smp_state = smp_irq_enter(regs->int_no);
+        if (smp_state == SMP_IRQ_SKIP) {
+            return;
+        }
         isr_t handler = interrupt_handlers[regs->int_no];
         handler(regs);
+        smp_irq_exit(smp_state, (regs->cs & 3) == 3);
         return;  // Return to interrupted code (important for ring 3 syscalls)
     }
 
@@ -90,8 +96,10 @@ void irq_handler_common(registers_t* regs) {
 
     // Call the registered C handler for this IRQ, if one exists.
     if (interrupt_handlers[regs->int_no] != 0) {
+        int smp_state = smp_irq_enter(regs->int_no);
         isr_t handler = interrupt_handlers[regs->int_no];
         handler(regs); // Pass the registers pointer to the specific handler.
+        smp_irq_exit(smp_state, (regs->cs & 3) == 3);
     } else {
         // Optionally handle unexpected/unregistered IRQs.
         // Spurious IRQ7 or IRQ15 might occur.
@@ -21,6 +21,8 @@
 #include <arch/isr.h>
 #include <memory.h>
 #include <pmm.h>
+#include <kheap.h>
+#include <vmm.h>
 #include <serial.h>
 #include <stdlib.h>
 #include <panic.h>
@@ -358,6 +360,51 @@ int is_page_present(page_directory_t *dir, uint32_t virtual_addr) {
     return (table->pages[table_index] & PAGE_PRESENT) ? 1 : 0;
 }
 
+uint32_t get_page_flags(page_directory_t *dir, uint32_t virtual_addr) {
+    if (!dir || !dir->tables_physical) {
+        return 0;
+    }
+    
+    uint32_t dir_index = virtual_addr >> 22;
+    uint32_t table_index = (virtual_addr >> 12) & 0x3FF;
+    
+    if (!dir->tables_physical[dir_index]) {
+        return 0;
+    }
+    
+    uint32_t page_entry = dir->tables_physical[dir_index]->pages[table_index];
+    if (!(page_entry & PAGE_PRESENT)) {
+        return 0;
+    }
+    return PAGE_GET_FLAGS(page_entry);
+}
+
+int set_page_flags(page_directory_t *dir, uint32_t virtual_addr, uint32_t flags) {
+    // Rewrite the flags of an existing mapping, keeping its frame
+    if (!dir || !dir->tables_physical) {
+        return -1;
+    }
+    
+    virtual_addr = PAGE_ALIGN_DOWN(virtual_addr);
+    uint32_t dir_index = virtual_addr >> 22;
+    uint32_t table_index = (virtual_addr >> 12) & 0x3FF;
+    
+    page_table_t *table = dir->tables_physical[dir_index];
+    if (!table || !(table->pages[table_index] & PAGE_PRESENT)) {
+        return -1;
+    }
+    
+    table->pages[table_index] = PAGE_GET_ADDR(table->pages[table_index]) | (flags & 0xFFF) | PAGE_PRESENT;
+    if (flags & PAGE_USER) {
+        dir->cpu_dir->entries[dir_index] |= PAGE_USER;
+    }
+    
+    if (dir == current_directory) {
+        flush_tlb_single(virtual_addr);
+    }
+    return 0;
+}
+
 void switch_page_directory(page_directory_t *dir) {
     current_directory = dir;
     load_page_directory(dir->physical_addr);
@@ -375,6 +422,12 @@ void page_fault_handler(registers_t *regs) {
     int reserved = regs->err_code & 0x8;      // Overwritten CPU-reserved bits?
     int fetch = regs->err_code & 0x10;        // Instruction fetch?
     
+    // Copy-on-write breaks and demand-paged first touches are resolved by
+    // the VMM; the faulting instruction is simply retried
+    if (!reserved && vmm_handle_page_fault(faulting_address, !present, write != 0)) {
+        return;
+    }
+    
     // Print error information to serial (for debugging)
     serial_puts("\n=== PAGE FAULT ===");
     serial_puts("\nFaulting address: 0x");
@@ -404,7 +457,7 @@ void page_fault_handler(registers_t *regs) {
         mid = " (null pointer dereference)";
     } else if (faulting_address >= 0xC0000000) {
         mid = " (kernel space access)";
-    } else if (faulting_address >= 0x500000 && faulting_address < 0x700000) {
+    } else if (faulting_address >= KHEAP_START && faulting_address < KHEAP_END) {
         mid = " (heap access)";
     } else {
         mid = "";
@@ -15,7 +15,7 @@ enable_paging_asm:
     
     ; Enable paging by setting PG bit (bit 31) in CR0
     mov eax, cr0
-    or eax, 0x80000000  ; Set PG bit
+    or eax, 0x80010000  ; Set PG bit, and WP so kernel writes honour COW
     mov cr0, eax
     
     pop ebp
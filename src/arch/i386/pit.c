@@ -21,12 +21,13 @@
 #include <io.h>     // For outb() and io_wait().
 #include <serial.h> // For serial_puts() for debugging.
 #include <stdlib.h> // For itoa() (if available and functional).
+#include <ktime.h>  // For ktime_get_ticks() once clock events replace IRQ0.
 
 // Forward declaration for scheduler_tick (from process manager)
 extern void scheduler_tick(void);
 
-// Forward declaration for network polling
-extern void net_poll(void);
+// Forward declaration for the network receive fallback
+extern void net_rx_kick(void);
 
 // Global tick counter, incremented by the PIT handler.
 volatile uint32_t system_ticks = 0;
@@ -78,9 +79,10 @@ void pit_handler(registers_t *regs) {
     // Call scheduler tick for process scheduling
     scheduler_tick();
     
-    // Poll network for received packets every 10 ticks (~100ms at 100Hz)
+    // Have the network bottom half poll every ring every 10 ticks (~100ms at
+    // 100Hz), catching NICs without an interrupt line or with a lost interrupt
     if (system_ticks % 10 == 0) {
-        net_poll();
+        net_rx_kick();
     }
 
     // Optional: Debugging message every N ticks (e.g., every second if PIT is 100Hz).
@@ -104,5 +106,6 @@ void pit_handler(registers_t *regs) {
 
 // Get the current system tick count
 uint32_t get_tick_count(void) {
-    return system_ticks;
+    // Live tick count once the TSC clocksource replaces IRQ0
+    return ktime_get_ticks();
 }
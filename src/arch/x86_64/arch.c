@@ -13,6 +13,9 @@
 #include <arch/x86_64/pit.h>
 #include <arch/x86_64/isr.h>
 #include <io.h>
+#include <ktime.h>
+#include <smp.h>
+#include <string.h>
 #include <stdint.h>
 
 /*
@@ -86,9 +89,105 @@ uint32_t arch_get_user_data_segment(void) {
 
 extern uint64_t tss_rsp0;
 
+/*
+ * Application processors get their own GDT copy (boot.s layout: null,
+ * kernel code/data, user code/data, 16-byte TSS descriptor) and TSS. The GDT
+ * base doubles as a cheap CPU identifier; slot 0 is unused because the BSP
+ * keeps the boot GDT.
+ */
+#define CPU_GDT_ENTRIES 7
+
+typedef struct {
+    uint32_t reserved0;
+    uint64_t rsp0;
+    uint64_t rsp1;
+    uint64_t rsp2;
+    uint64_t reserved1;
+    uint64_t ist[7];
+    uint64_t reserved2;
+    uint16_t reserved3;
+    uint16_t iomap_base;
+} __attribute__((packed)) tss64_t;
+
+typedef struct {
+    uint16_t limit;
+    uint64_t base;
+} __attribute__((packed)) gdt64_ptr_t;
+
+static uint64_t cpu_gdt[SMP_MAX_CPUS][CPU_GDT_ENTRIES] __attribute__((aligned(16)));
+static tss64_t cpu_tss[SMP_MAX_CPUS] __attribute__((aligned(16)));
+
+uint32_t arch_cpu_index(void) {
+    gdt64_ptr_t current;
+    asm volatile("sgdt %0" : "=m"(current));
+
+    uint64_t first = (uint64_t)(uintptr_t)&cpu_gdt[0];
+    uint64_t last = (uint64_t)(uintptr_t)&cpu_gdt[SMP_MAX_CPUS];
+    if (current.base < first || current.base >= last) {
+        return 0;  // Boot GDT: the BSP
+    }
+    return (uint32_t)((current.base - first) / sizeof(cpu_gdt[0]));
+}
+
+void arch_smp_cpu_init(uint32_t cpu, uintptr_t irq_stack_top) {
+    /* Load this AP's GDT/TSS, then the shared IDT. */
+    if (cpu == 0 || cpu >= SMP_MAX_CPUS) return;
+
+    uint64_t* gdt = cpu_gdt[cpu];
+    tss64_t* tss = &cpu_tss[cpu];
+
+    memset(tss, 0, sizeof(*tss));
+    tss->rsp0 = (uint64_t)irq_stack_top;
+    tss->iomap_base = sizeof(tss64_t);
+
+    uint64_t base = (uint64_t)(uintptr_t)tss;
+    uint64_t limit = sizeof(tss64_t) - 1;
+
+    gdt[0] = 0;
+    gdt[1] = 0x00AF9A000000FFFFULL;   // Kernel code
+    gdt[2] = 0x00AF92000000FFFFULL;   // Kernel data
+    gdt[3] = 0x00AFFA000000FFFFULL;   // User code
+    gdt[4] = 0x00AFF2000000FFFFULL;   // User data
+    gdt[5] = (limit & 0xFFFF) |
+             ((base & 0xFFFFFF) << 16) |
+             (0x89ULL << 40) |        // Present, available 64-bit TSS
+             (((limit >> 16) & 0xF) << 48) |
+             (((base >> 24) & 0xFF) << 56);
+    gdt[6] = base >> 32;
+
+    gdt64_ptr_t ptr;
+    ptr.limit = sizeof(cpu_gdt[0]) - 1;
+    ptr.base = (uint64_t)(uintptr_t)gdt;
+
+    asm volatile(
+        "lgdt %0\n"
+        "pushq $0x08\n"
+        "leaq 1f(%%rip), %%rax\n"
+        "pushq %%rax\n"
+        "lretq\n"
+        "1:\n"
+        "movw $0x10, %%ax\n"
+        "movw %%ax, %%ds\n"
+        "movw %%ax, %%es\n"
+        "movw %%ax, %%fs\n"
+        "movw %%ax, %%gs\n"
+        "movw %%ax, %%ss\n"
+        :
+        : "m"(ptr)
+        : "rax", "memory");
+    asm volatile("ltr %0" :: "r"((uint16_t)0x28));
+
+    idt_reload();
+}
+
 void arch_set_kernel_stack(uintptr_t stack) {
     /* Update TSS RSP0 used for privilege transitions from ring 3 to ring 0. */
-    tss_rsp0 = (uint64_t)stack;
+    uint32_t cpu = arch_cpu_index();
+    if (cpu == 0) {
+        tss_rsp0 = (uint64_t)stack;
+    } else {
+        cpu_tss[cpu].rsp0 = (uint64_t)stack;
+    }
 }
 
 extern volatile uint32_t system_ticks;
@@ -113,13 +212,19 @@ void arch_timer_init(uint32_t frequency_hz) {
 }
 
 uint32_t arch_timer_get_ticks(void) {
-    return system_ticks;
+    return ktime_get_ticks();
 }
 
 uint32_t arch_timer_get_frequency(void) {
     return timer_frequency;
 }
 
+uint64_t arch_read_tsc(void) {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
 uint8_t arch_io_inb(uint16_t port) {
     return inb(port);
 }
@@ -156,7 +156,7 @@ _start:
 
     ; Enable paging
     mov eax, cr0
-    or eax, 0x80000000                ; PG
+    or eax, 0x80010000                ; PG|WP (kernel writes honour COW)
     mov cr0, eax
 
     ; Enable SSE/SSE2 so compiler-emitted XMM instructions are valid
@@ -64,6 +64,17 @@ void init_idt(void) {
 
     idt_set_gate(128, (uint64_t)isr128, 0xEE);
 
+    // Local APIC vectors: scheduler tick / TLB shootdown IPIs and spurious
+    idt_set_gate(240, (uint64_t)isr240, 0x8E);
+    idt_set_gate(241, (uint64_t)isr241, 0x8E);
+    idt_set_gate(242, (uint64_t)isr242, 0x8E);
+    idt_set_gate(255, (uint64_t)isr255, 0x8E);
+
     idt_load((uint64_t)&idt_ptr);
     serial_puts("IDT Initialized and Loaded (x86_64).\n");
 }
+
+void idt_reload(void) {
+    /* All CPUs share one IDT; APs only need IDTR pointed at it. */
+    idt_load((uint64_t)&idt_ptr);
+}
@@ -170,6 +170,12 @@ ISR_IRQ_NOERRCODE 45
 ISR_IRQ_NOERRCODE 46
 ISR_IRQ_NOERRCODE 47
 
+; Local APIC vectors (acknowledged with a LAPIC EOI by their handlers)
+ISR_NOERRCODE 240
+ISR_NOERRCODE 241
+ISR_NOERRCODE 242
+ISR_NOERRCODE 255
+
 ; INT 0x80 syscall vector
 global isr128
 isr128:
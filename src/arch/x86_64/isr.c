@@ -13,6 +13,7 @@
 #include <serial.h>
 #include <stdlib.h>
 #include <io.h>
+#include <smp.h>
 
 /*
  * x86_64 interrupt dispatch core.
@@ -37,8 +38,13 @@ static const char* exception_messages[] = {
 void isr_handler_common(registers_t* regs) {
     /* Dispatch exception/software interrupt to handler or panic on miss. */
     if (regs->int_no < 256 && interrupt_handlers[regs->int_no] != 0) {
+        int smp_state = smp_irq_enter((uint32_t)regs->int_no);
+        if (smp_state == SMP_IRQ_SKIP) {
+            return;
+        }
         isr_t handler = interrupt_handlers[regs->int_no];
         handler(regs);
+        smp_irq_exit(smp_state, (regs->cs & 3) == 3);
         return;
     }
 
@@ -63,8 +69,10 @@ void irq_handler_common(registers_t* regs) {
     outb(PIC1_COMMAND, PIC_EOI);
 
     if (regs->int_no < 256 && interrupt_handlers[regs->int_no] != 0) {
+        int smp_state = smp_irq_enter((uint32_t)regs->int_no);
         isr_t handler = interrupt_handlers[regs->int_no];
         handler(regs);
+        smp_irq_exit(smp_state, (regs->cs & 3) == 3);
     }
 }
 
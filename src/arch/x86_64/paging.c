@@ -11,6 +11,7 @@
 #include <arch/x86_64/isr.h>
 #include <serial.h>
 #include <pmm.h>
+#include <vmm.h>
 #include <stdlib.h>
 #include <string.h>
 #include <panic.h>
@@ -80,7 +81,8 @@ static uint64_t normalize_entry_flags(uint32_t flags) {
     /* Keep only supported PTE flags and force PRESENT bit for mapped entries. */
     uint64_t entry_flags = (uint64_t)(flags & (PAGE_PRESENT | PAGE_WRITE | PAGE_USER |
                                                PAGE_WRITETHROUGH | PAGE_NOCACHE |
-                                               PAGE_ACCESSED | PAGE_DIRTY | PAGE_GLOBAL));
+                                               PAGE_ACCESSED | PAGE_DIRTY | PAGE_GLOBAL |
+                                               PAGE_COW));
     entry_flags |= PAGE_PRESENT;
     return entry_flags;
 }
@@ -487,10 +489,103 @@ int is_page_present(page_directory_t* dir, uintptr_t virtual_addr) {
     return entry_present(pt[pt_i]);
 }
 
+uint32_t get_page_flags(page_directory_t* dir, uintptr_t virtual_addr) {
+    /* Flags of the leaf entry mapping virtual_addr, 0 if not present. */
+    if (!dir || !dir->pml4) {
+        return 0;
+    }
+
+    uint64_t va = (uint64_t)virtual_addr;
+    uint64_t pml4e = dir->pml4[pml4_index(va)];
+    if (!entry_present(pml4e)) {
+        return 0;
+    }
+
+    uint64_t* pdpt = (uint64_t*)(uintptr_t)entry_addr(pml4e);
+    uint64_t pdpte = pdpt[pdpt_index(va)];
+    if (!entry_present(pdpte)) {
+        return 0;
+    }
+    if (entry_large(pdpte)) {
+        return (uint32_t)(pdpte & X86_64_FLAGS_MASK & ~((uint64_t)PAGE_SIZE_FLAG));
+    }
+
+    uint64_t* pd = (uint64_t*)(uintptr_t)entry_addr(pdpte);
+    uint64_t pde = pd[pd_index(va)];
+    if (!entry_present(pde)) {
+        return 0;
+    }
+    if (entry_large(pde)) {
+        return (uint32_t)(pde & X86_64_FLAGS_MASK & ~((uint64_t)PAGE_SIZE_FLAG));
+    }
+
+    uint64_t* pt = (uint64_t*)(uintptr_t)entry_addr(pde);
+    uint64_t pte = pt[pt_index(va)];
+    if (!entry_present(pte)) {
+        return 0;
+    }
+    return (uint32_t)(pte & X86_64_FLAGS_MASK);
+}
+
+int set_page_flags(page_directory_t* dir, uintptr_t virtual_addr, uint32_t flags) {
+    /* Rewrite the flags of an existing 4KiB mapping, keeping its frame. */
+    if (!dir || !dir->pml4) {
+        return -1;
+    }
+
+    uint64_t va = (uint64_t)PAGE_ALIGN_DOWN(virtual_addr);
+    uint64_t pml4e = dir->pml4[pml4_index(va)];
+    if (!entry_present(pml4e)) {
+        return -1;
+    }
+
+    uint64_t* pdpt = (uint64_t*)(uintptr_t)entry_addr(pml4e);
+    uint64_t pdpte = pdpt[pdpt_index(va)];
+    if (!entry_present(pdpte) || entry_large(pdpte)) {
+        return -1;
+    }
+
+    uint64_t* pd = (uint64_t*)(uintptr_t)entry_addr(pdpte);
+    uint16_t pd_i = pd_index(va);
+    if (!entry_present(pd[pd_i])) {
+        return -1;
+    }
+    if (entry_large(pd[pd_i]) && split_2mb_page(pd, pd_i) != 0) {
+        return -1;
+    }
+
+    uint64_t* pt = (uint64_t*)(uintptr_t)entry_addr(pd[pd_i]);
+    uint16_t pt_i = pt_index(va);
+    if (!entry_present(pt[pt_i])) {
+        return -1;
+    }
+
+    uint64_t entry_flags = normalize_entry_flags(flags);
+    if (entry_flags & PAGE_USER) {
+        dir->pml4[pml4_index(va)] |= PAGE_USER;
+        pdpt[pdpt_index(va)] |= PAGE_USER;
+        pd[pd_i] |= PAGE_USER;
+    }
+    pt[pt_i] = (pt[pt_i] & (X86_64_ADDR_MASK | X86_64_NX_BIT)) | entry_flags;
+
+    if (dir == current_directory) {
+        flush_tlb_single((uintptr_t)va);
+    }
+    return 0;
+}
+
 void page_fault_handler(registers_t* regs) {
     uint64_t faulting_address;
     asm volatile("mov %%cr2, %0" : "=r"(faulting_address));
 
+    // Copy-on-write breaks and demand-paged first touches are resolved by
+    // the VMM; the faulting instruction is simply retried
+    if (!(regs->err_code & 0x8) &&
+        vmm_handle_page_fault((uintptr_t)faulting_address,
+                              (regs->err_code & 0x1) != 0, (regs->err_code & 0x2) != 0)) {
+        return;
+    }
+
     serial_puts("\n=== PAGE FAULT (x86_64) ===\n");
     serial_puts("Fault address: 0x");
     char buf[17];
@@ -20,8 +20,10 @@
 #include <io.h>
 #include <serial.h>
 #include <stdlib.h>
+#include <ktime.h>
 
-extern void net_poll(void);
+extern void scheduler_tick(void);
+extern void net_rx_kick(void);
 
 volatile uint32_t system_ticks = 0;
 
@@ -55,11 +57,14 @@ void pit_handler(registers_t* regs) {
     (void)regs;
     system_ticks++;
 
+    scheduler_tick();
+
     if ((system_ticks % 10) == 0) {
-        net_poll();
+        net_rx_kick();
     }
 }
 
 uint32_t get_tick_count(void) {
-    return system_ticks;
+    // Live tick count once the TSC clocksource replaces IRQ0
+    return ktime_get_ticks();
 }
@@ -0,0 +1,564 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * src/dev/blkdev.c
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+
+#include <dev/blkdev.h>
+#include <arch.h>
+#include <process.h>
+#include <ktime.h>
+#include <serial.h>
+#include <string.h>
+#include <stdlib.h>
+
+/*
+ * Queue state is touched from task context and, for asynchronous drivers,
+ * from completion interrupts, so every queue update runs with interrupts
+ * off on this CPU; the kernel lock keeps other CPUs out. Driver submit()
+ * calls happen outside that section.
+ */
+
+static blk_device_t blk_devices[BLK_MAX_DEVICES];
+static uint32_t blk_num_devices = 0;
+
+int blk_register_device(const char* name, const blk_driver_ops_t* ops, void* driver_data,
+                        uint32_t total_sectors, uint32_t max_sectors, uint32_t queue_depth) {
+    if (!name || !ops || !ops->submit || blk_num_devices >= BLK_MAX_DEVICES) {
+        return -1;
+    }
+
+    uint32_t id = blk_num_devices;
+    blk_device_t* dev = &blk_devices[id];
+    memset(dev, 0, sizeof(*dev));
+    strncpy(dev->name, name, BLK_NAME_LEN - 1);
+    dev->id = id;
+    dev->total_sectors = total_sectors;
+    dev->max_sectors = max_sectors ? max_sectors : 1;
+    dev->queue_depth = queue_depth;
+    if (dev->queue_depth == 0) {
+        dev->queue_depth = 1;
+    }
+    if (dev->queue_depth > BLK_MAX_QUEUE_DEPTH) {
+        dev->queue_depth = BLK_MAX_QUEUE_DEPTH;
+    }
+    dev->ops = ops;
+    dev->driver_data = driver_data;
+    wait_queue_init(&dev->wait);
+    blk_num_devices++;
+
+    char buf[16];
+    serial_puts("BLK: registered ");
+    serial_puts(dev->name);
+    serial_puts(" as device ");
+    itoa(id, buf, 10);
+    serial_puts(buf);
+    serial_puts(", queue depth ");
+    itoa(dev->queue_depth, buf, 10);
+    serial_puts(buf);
+    serial_puts("\n");
+    return (int)id;
+}
+
+blk_device_t* blk_get_device(uint32_t dev) {
+    if (dev >= blk_num_devices) {
+        return NULL;
+    }
+    return &blk_devices[dev];
+}
+
+int blk_find_device(const char* name) {
+    if (!name) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < blk_num_devices; i++) {
+        if (strcmp(blk_devices[i].name, name) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+uint32_t blk_device_count(void) {
+    return blk_num_devices;
+}
+
+static uint32_t blk_parse_u32(const char* s, uint32_t len) {
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < len && s[i] >= '0' && s[i] <= '9'; i++) {
+        value = (value * 10U) + (uint32_t)(s[i] - '0');
+    }
+    return value;
+}
+
+int blk_parse_source(const char* source, uint32_t* dev, uint32_t* lba) {
+    uint32_t out_dev = 0;
+    uint32_t out_lba = 0;
+
+    const char* p = source;
+    while (p && *p) {
+        while (*p == ' ' || *p == ',') {
+            p++;
+        }
+        const char* tok = p;
+        while (*p && *p != ' ' && *p != ',') {
+            p++;
+        }
+        uint32_t len = (uint32_t)(p - tok);
+        if (len == 0) {
+            continue;
+        }
+
+        // "vda:lba=N" carries both parts in one token
+        for (uint32_t i = 0; i + 4 <= len; i++) {
+            if (strncmp(tok + i, "lba=", 4) == 0 || strncmp(tok + i, "lba:", 4) == 0) {
+                out_lba = blk_parse_u32(tok + i + 4, len - i - 4);
+                len = (i > 0 && tok[i - 1] == ':') ? i - 1 : i;
+                break;
+            }
+        }
+
+        if (len >= 4 && (strncmp(tok, "dev=", 4) == 0 || strncmp(tok, "dev:", 4) == 0)) {
+            tok += 4;
+            len -= 4;
+        }
+        if (len >= 5 && strncmp(tok, "/dev/", 5) == 0) {
+            tok += 5;
+            len -= 5;
+        }
+        if (len == 0) {
+            continue;
+        }
+
+        char name[BLK_NAME_LEN];
+        if (len >= BLK_NAME_LEN) {
+            return -1;
+        }
+        memcpy(name, tok, len);
+        name[len] = '\0';
+
+        int found = blk_find_device(name);
+        if (found < 0 && name[0] >= '0' && name[0] <= '9') {
+            uint32_t n = blk_parse_u32(name, len);
+            found = (n < blk_num_devices) ? (int)n : -1;
+        }
+        if (found < 0) {
+            return -1;
+        }
+        out_dev = (uint32_t)found;
+    }
+
+    if (dev) {
+        *dev = out_dev;
+    }
+    if (lba) {
+        *lba = out_lba;
+    }
+    return 0;
+}
+
+void blk_bio_init(blk_bio_t* bio, uint32_t lba, uint32_t count, void* buffer, int write) {
+    memset(bio, 0, sizeof(*bio));
+    bio->lba = lba;
+    bio->count = count;
+    bio->buffer = (uint8_t*)buffer;
+    bio->flags = write ? BLK_BIO_WRITE : 0;
+}
+
+static uint32_t blk_bucket(uint32_t value, uint32_t base, uint32_t buckets) {
+    /* Log2 histogram slot: [0, base), [base, 2*base), ... last slot open-ended. */
+    uint32_t i = 0;
+    uint32_t limit = base;
+    while (i < buckets - 1 && value >= limit) {
+        limit <<= 1;
+        i++;
+    }
+    return i;
+}
+
+static int blk_overlaps(const blk_bio_t* a, const blk_bio_t* b) {
+    return a->lba < b->lba + b->count && b->lba < a->lba + a->count;
+}
+
+static blk_bio_t* blk_older_overlap_locked(blk_device_t* dev, blk_bio_t* bio) {
+    /* An earlier-submitted pending bio touching the same sectors must go first. */
+    blk_bio_t* oldest = NULL;
+    for (blk_bio_t* b = dev->pending; b; b = b->next) {
+        if (b != bio && (int32_t)(b->seq - bio->seq) < 0 && blk_overlaps(b, bio) &&
+            (!oldest || (int32_t)(b->seq - oldest->seq) < 0)) {
+            oldest = b;
+        }
+    }
+    return oldest;
+}
+
+static void blk_unlink_locked(blk_device_t* dev, blk_bio_t* bio) {
+    blk_bio_t** link = &dev->pending;
+    while (*link && *link != bio) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = bio->next;
+        bio->next = NULL;
+        dev->nr_pending--;
+    }
+}
+
+static blk_request_t* blk_alloc_request_locked(blk_device_t* dev) {
+    for (uint32_t i = 0; i < dev->queue_depth; i++) {
+        if (!dev->requests[i].in_use) {
+            return &dev->requests[i];
+        }
+    }
+    return NULL;
+}
+
+static blk_request_t* blk_dispatch_locked(blk_device_t* dev) {
+    /*
+     * Pick the next bio (deadline first, else C-LOOK from head_lba), then
+     * pull in the bios that directly follow it on disk in the same direction.
+     */
+    if (!dev->pending || dev->in_flight >= dev->queue_depth) {
+        return NULL;
+    }
+    blk_request_t* req = blk_alloc_request_locked(dev);
+    if (!req) {
+        return NULL;
+    }
+
+    uint32_t now = ktime_get_ms();
+    blk_bio_t* start = NULL;
+    int expired = 0;
+    for (blk_bio_t* b = dev->pending; b; b = b->next) {
+        if ((int32_t)(now - b->deadline_ms) >= 0 &&
+            (!start || (int32_t)(b->seq - start->seq) < 0)) {
+            start = b;
+        }
+    }
+    if (start) {
+        expired = 1;
+    } else {
+        for (blk_bio_t* b = dev->pending; b; b = b->next) {
+            if (b->lba >= dev->head_lba) {
+                start = b;
+                break;
+            }
+        }
+        if (!start) {
+            start = dev->pending;  // Wrap to the lowest LBA
+        }
+    }
+
+    blk_bio_t* older;
+    while ((older = blk_older_overlap_locked(dev, start)) != NULL) {
+        start = older;
+    }
+
+    // The merge candidate is whatever follows start in LBA order
+    blk_bio_t* prev = NULL;
+    for (blk_bio_t* b = dev->pending; b && b != start; b = b->next) {
+        prev = b;
+    }
+    blk_unlink_locked(dev, start);
+
+    req->lba = start->lba;
+    req->count = start->count;
+    req->flags = start->flags & BLK_BIO_WRITE;
+    req->nr_bios = 1;
+    req->bios = start;
+    req->driver_data = NULL;
+    req->in_use = 1;
+    start->rq_next = NULL;
+
+    blk_bio_t* tail = start;
+    for (;;) {
+        blk_bio_t* cand = prev ? prev->next : dev->pending;
+        if (!cand || (cand->flags & BLK_BIO_WRITE) != req->flags ||
+            cand->lba != req->lba + req->count ||
+            req->count + cand->count > dev->max_sectors ||
+            blk_older_overlap_locked(dev, cand)) {
+            break;
+        }
+        blk_unlink_locked(dev, cand);
+        cand->rq_next = NULL;
+        tail->rq_next = cand;
+        tail = cand;
+        req->count += cand->count;
+        req->nr_bios++;
+    }
+
+    dev->head_lba = req->lba + req->count;
+    dev->in_flight++;
+    dev->stats.requests++;
+    dev->stats.merged += req->nr_bios - 1;
+    if (expired) {
+        dev->stats.expired++;
+    }
+    if (req->flags & BLK_BIO_WRITE) {
+        dev->stats.writes++;
+        dev->stats.sectors_written += req->count;
+    } else {
+        dev->stats.reads++;
+        dev->stats.sectors_read += req->count;
+    }
+    return req;
+}
+
+static void blk_run_queue(blk_device_t* dev, int force) {
+    /* Hand requests to the driver until the queue or its depth runs out. */
+    for (;;) {
+        uintptr_t irq = arch_irq_save();
+        if (dev->plugged && !dev->waiters && !force) {
+            arch_irq_restore(irq);
+            return;
+        }
+        blk_request_t* req = blk_dispatch_locked(dev);
+        arch_irq_restore(irq);
+        if (!req) {
+            return;
+        }
+
+        if (dev->ops->submit(dev, req) != 0) {
+            blk_end_request(dev, req, -1);
+        }
+    }
+}
+
+void blk_end_request(blk_device_t* dev, blk_request_t* req, int status) {
+    if (!dev || !req) {
+        return;
+    }
+
+    uint64_t now = ktime_get_ns();
+    uintptr_t irq = arch_irq_save();
+    blk_bio_t* bio = req->bios;
+    while (bio) {
+        blk_bio_t* next = bio->rq_next;
+        uint64_t us = div_u64_u32(now - bio->submit_ns, NSEC_PER_USEC);
+        uint32_t us32 = (us > 0xFFFFFFFFu) ? 0xFFFFFFFFu : (uint32_t)us;
+        dev->stats.latency_hist[blk_bucket(us32, BLK_LAT_BASE_US, BLK_LAT_BUCKETS)]++;
+        bio->status = status;
+        bio->rq_next = NULL;
+        bio->done = 1;
+        bio = next;
+    }
+    if (status != 0) {
+        dev->stats.errors++;
+    }
+    req->bios = NULL;
+    req->in_use = 0;
+    dev->in_flight--;
+    int more = dev->pending != NULL;
+    arch_irq_restore(irq);
+
+    wait_queue_wake_all(&dev->wait);
+
+    // Nobody else is looping in blk_run_queue() for an asynchronous driver
+    if (more && (dev->ops->flags & BLK_DRIVER_ATOMIC_SUBMIT)) {
+        blk_run_queue(dev, 0);
+    }
+}
+
+int blk_submit_bio(uint32_t dev_id, blk_bio_t* bio) {
+    blk_device_t* dev = blk_get_device(dev_id);
+    if (!dev || !bio || bio->count == 0 || !bio->buffer ||
+        bio->lba >= dev->total_sectors || bio->count > dev->total_sectors - bio->lba) {
+        return -1;
+    }
+
+    uintptr_t irq = arch_irq_save();
+    bio->dev = dev_id;
+    bio->done = 0;
+    bio->status = 0;
+    bio->rq_next = NULL;
+    bio->seq = dev->next_seq++;
+    bio->deadline_ms = ktime_get_ms() +
+        ((bio->flags & BLK_BIO_WRITE) ? BLK_WRITE_EXPIRE_MS : BLK_READ_EXPIRE_MS);
+    bio->submit_ns = ktime_get_ns();
+
+    // Sorted insert; equal LBAs keep submission order
+    blk_bio_t** link = &dev->pending;
+    while (*link && (*link)->lba <= bio->lba) {
+        link = &(*link)->next;
+    }
+    bio->next = *link;
+    *link = bio;
+    dev->nr_pending++;
+
+    uint32_t depth = dev->nr_pending + dev->in_flight;
+    if (depth > dev->stats.max_depth) {
+        dev->stats.max_depth = depth;
+    }
+    dev->stats.depth_hist[blk_bucket(depth - 1, 1, BLK_DEPTH_BUCKETS)]++;
+    dev->stats.bios++;
+    arch_irq_restore(irq);
+
+    blk_run_queue(dev, 0);
+    return 0;
+}
+
+int blk_wait_bio(blk_bio_t* bio) {
+    if (!bio) {
+        return -1;
+    }
+    blk_device_t* dev = blk_get_device(bio->dev);
+    if (!dev) {
+        return -1;
+    }
+
+    // Waiting on a bio flushes the plug: it cannot complete otherwise
+    uintptr_t irq = arch_irq_save();
+    dev->waiters++;
+    arch_irq_restore(irq);
+
+    while (!bio->done) {
+        blk_run_queue(dev, 1);
+        if (bio->done) {
+            break;
+        }
+        if (process_can_block()) {
+            // Drivers with a poll hook also reap on a timer, in case an interrupt is lost
+            wait_queue_wait(&dev->wait, &bio->done, dev->ops->poll ? BLK_POLL_INTERVAL_MS : 0);
+            if (!bio->done && dev->ops->poll) {
+                dev->ops->poll(dev);
+            }
+        } else if (dev->ops->poll) {
+            dev->ops->poll(dev);
+        } else {
+            process_yield();
+        }
+    }
+
+    irq = arch_irq_save();
+    dev->waiters--;
+    arch_irq_restore(irq);
+    return bio->status;
+}
+
+static int blk_transfer(uint32_t dev_id, uint32_t lba, uint32_t count, void* buffer, int write) {
+    blk_device_t* dev = blk_get_device(dev_id);
+    if (!dev || !buffer) {
+        return -1;
+    }
+
+    uint8_t* ptr = (uint8_t*)buffer;
+    while (count > 0) {
+        uint32_t chunk = count > dev->max_sectors ? dev->max_sectors : count;
+        blk_bio_t bio;
+        blk_bio_init(&bio, lba, chunk, ptr, write);
+        if (blk_submit_bio(dev_id, &bio) != 0 || blk_wait_bio(&bio) != 0) {
+            return -1;
+        }
+        lba += chunk;
+        count -= chunk;
+        ptr += chunk * BLK_SECTOR_SIZE;
+    }
+    return 0;
+}
+
+int blk_read(uint32_t dev, uint32_t lba, uint32_t count, void* buffer) {
+    return blk_transfer(dev, lba, count, buffer, 0);
+}
+
+int blk_write(uint32_t dev, uint32_t lba, uint32_t count, const void* buffer) {
+    return blk_transfer(dev, lba, count, (void*)buffer, 1);
+}
+
+void blk_plug(uint32_t dev_id) {
+    blk_device_t* dev = blk_get_device(dev_id);
+    if (!dev) {
+        return;
+    }
+    uintptr_t irq = arch_irq_save();
+    dev->plugged++;
+    arch_irq_restore(irq);
+}
+
+void blk_unplug(uint32_t dev_id) {
+    blk_device_t* dev = blk_get_device(dev_id);
+    if (!dev) {
+        return;
+    }
+    uintptr_t irq = arch_irq_save();
+    if (dev->plugged) {
+        dev->plugged--;
+    }
+    int run = dev->plugged == 0;
+    arch_irq_restore(irq);
+    if (run) {
+        blk_run_queue(dev, 0);
+    }
+}
+
+void blk_rq_iter_init(blk_rq_iter_t* it, blk_request_t* req, uint32_t sector) {
+    blk_bio_t* bio = req->bios;
+    while (bio && sector >= bio->count) {
+        sector -= bio->count;
+        bio = bio->rq_next;
+    }
+    it->bio = bio;
+    it->sector = sector;
+}
+
+uint8_t* blk_rq_iter_next(blk_rq_iter_t* it) {
+    if (!it->bio) {
+        return NULL;
+    }
+    uint8_t* ptr = it->bio->buffer + it->sector * BLK_SECTOR_SIZE;
+    if (++it->sector >= it->bio->count) {
+        it->bio = it->bio->rq_next;
+        it->sector = 0;
+    }
+    return ptr;
+}
+
+void blk_rq_copy_out(blk_request_t* req, uint32_t sector, void* dst, uint32_t count) {
+    /* Gather request data (a write) into a linear buffer. */
+    blk_rq_iter_t it;
+    uint8_t* out = (uint8_t*)dst;
+    blk_rq_iter_init(&it, req, sector);
+    while (count > 0 && it.bio) {
+        uint32_t n = it.bio->count - it.sector;
+        if (n > count) {
+            n = count;
+        }
+        memcpy(out, it.bio->buffer + it.sector * BLK_SECTOR_SIZE, n * BLK_SECTOR_SIZE);
+        out += n * BLK_SECTOR_SIZE;
+        count -= n;
+        it.bio = it.bio->rq_next;
+        it.sector = 0;
+    }
+}
+
+void blk_rq_copy_in(blk_request_t* req, uint32_t sector, const void* src, uint32_t count) {
+    /* Scatter a linear buffer (read data) into the request's bios. */
+    blk_rq_iter_t it;
+    const uint8_t* in = (const uint8_t*)src;
+    blk_rq_iter_init(&it, req, sector);
+    while (count > 0 && it.bio) {
+        uint32_t n = it.bio->count - it.sector;
+        if (n > count) {
+            n = count;
+        }
+        memcpy(it.bio->buffer + it.sector * BLK_SECTOR_SIZE, in, n * BLK_SECTOR_SIZE);
+        in += n * BLK_SECTOR_SIZE;
+        count -= n;
+        it.bio = it.bio->rq_next;
+        it.sector = 0;
+    }
+}
+
+int blk_get_stats(uint32_t dev_id, blk_stats_t* stats) {
+    blk_device_t* dev = blk_get_device(dev_id);
+    if (!dev || !stats) {
+        return -1;
+    }
+    uintptr_t irq = arch_irq_save();
+    *stats = dev->stats;
+    arch_irq_restore(irq);
+    return 0;
+}
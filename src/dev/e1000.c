@@ -29,7 +29,9 @@
  * Intel e1000 NIC driver.
  *
  * Initializes PCI/MMIO-backed NIC, sets up DMA descriptor rings, and bridges
- * packet TX/RX with aOS networking interface callbacks.
+ * packet TX/RX with aOS networking interface callbacks. The INTx handler
+ * masks the receive causes and schedules the network bottom half, which
+ * drains the ring through e1000_poll() and unmasks them once it is empty.
  */
 
 // E1000 Device State
@@ -43,6 +45,7 @@ static e1000_tx_desc_t* tx_descs = NULL;
 // Buffer Pools
 static uint8_t* rx_buffers[E1000_NUM_RX_DESC];
 static uint8_t* tx_buffers[E1000_NUM_TX_DESC];
+static net_packet_t* tx_held[E1000_NUM_TX_DESC];   // Frames the NIC reads in place
 
 // Ring Indices
 static volatile uint32_t rx_head = 0;
@@ -52,6 +55,8 @@ static volatile uint32_t tx_tail = 0;
 static uint32_t tx_packets = 0;
 static uint32_t rx_packets = 0;
 
+static net_napi_t e1000_napi;
+
 // Keep boot networking responsive: avoid long DHCP blocking during startup.
 #define E1000_BOOT_DHCP_TIMEOUT_TICKS 100
 
@@ -185,7 +190,7 @@ static void e1000_init_tx(void) {
 // Packet Transmission
 
 
-int e1000_transmit(const uint8_t* data, uint32_t len) {
+static int e1000_tx_submit(net_packet_t* packet, const uint8_t* data, uint32_t len) {
     if (!mmio_base || !data || len == 0 || len > E1000_TX_BUFFER_SIZE) {
         return -1;
     }
@@ -206,8 +211,21 @@ int e1000_transmit(const uint8_t* data, uint32_t len) {
         }
     }
     
-    // Copy data to DMA buffer
-    memcpy(tx_buffers[desc_idx], data, len);
+    // The slot's previous frame has been sent
+    if (tx_held[desc_idx]) {
+        net_packet_free(tx_held[desc_idx]);
+        tx_held[desc_idx] = NULL;
+    }
+    
+    if (packet && (packet->flags & NET_PACKET_F_POOL)) {
+        // Pool buffers are DMA-safe: point the descriptor at the frame itself
+        desc->addr = (uint64_t)(uintptr_t)data;
+        tx_held[desc_idx] = net_packet_get(packet);
+    } else {
+        // Copy data to DMA buffer
+        memcpy(tx_buffers[desc_idx], data, len);
+        desc->addr = (uint64_t)(uintptr_t)tx_buffers[desc_idx];
+    }
     
     // Setup descriptor
     desc->length = len;
@@ -231,21 +249,32 @@ int e1000_transmit(const uint8_t* data, uint32_t len) {
     
     tx_packets++;
     
+    if (!(desc->status & E1000_TXD_STAT_DD)) {
+        return -1;  // Still owned by the NIC: any held frame stays referenced
+    }
+    if (tx_held[desc_idx]) {
+        net_packet_free(tx_held[desc_idx]);
+        tx_held[desc_idx] = NULL;
+    }
+    return 0;
+}
 
-    
-    return (desc->status & E1000_TXD_STAT_DD) ? 0 : -1;
+int e1000_transmit(const uint8_t* data, uint32_t len) {
+    return e1000_tx_submit(NULL, data, len);
 }
 
 
 // Packet Reception
 
 
-static void e1000_receive(void) {
+static int e1000_receive(int budget) {
     // Read hardware head pointer
     uint32_t hw_head = e1000_read_reg(E1000_REG_RDH);
+    int done = 0;
     
-    // Process all available packets
-    while (rx_head != hw_head) {
+    // Process available packets, at most `budget` of them
+    while (rx_head != hw_head && done < budget) {
+        done++;
         e1000_rx_desc_t* desc = &rx_descs[rx_head];
         
         // Memory barrier to ensure we read fresh data
@@ -257,10 +286,9 @@ static void e1000_receive(void) {
         
         // Process valid packets
         if (length > 0 && length <= E1000_RX_BUFFER_SIZE && e1000_iface) {
+            // Handed up in place; every consumer copies out what it keeps
             net_packet_t packet;
-            packet.data = rx_buffers[rx_head];
-            packet.len = length;
-            packet.capacity = E1000_RX_BUFFER_SIZE;
+            net_packet_wrap(&packet, rx_buffers[rx_head], length, E1000_RX_BUFFER_SIZE);
             
             // Process through Ethernet layer
             eth_receive(e1000_iface, &packet);
@@ -276,16 +304,34 @@ static void e1000_receive(void) {
         rx_head = (rx_head + 1) % E1000_NUM_RX_DESC;
         e1000_write_reg(E1000_REG_RDT, old_head);
     }
+    return done;
 }
 
-void e1000_handle_interrupt(void) {
-    if (!mmio_base) return;
+static void e1000_irq_handler(void* ctx) {
+    (void)ctx;
     
-    // Clear any pending interrupts
-    e1000_read_reg(E1000_REG_ICR);
-    
-    // Process received packets
-    e1000_receive();
+    // Reading ICR acknowledges every pending cause
+    uint32_t icr = e1000_read_reg(E1000_REG_ICR);
+    if (!(icr & E1000_IMS_RX)) {
+        return;  // Another device on a shared line
+    }
+    e1000_napi.interrupts++;
+    e1000_write_reg(E1000_REG_IMC, E1000_IMS_RX);
+    net_napi_schedule(&e1000_napi);
+}
+
+static int e1000_poll(net_napi_t* napi, int budget) {
+    (void)napi;
+    return e1000_receive(budget);
+}
+
+static int e1000_irq_enable(net_napi_t* napi) {
+    // Without a handler the line must stay quiet; the ring is polled instead
+    if (napi->irq) {
+        // Causes latched while masked assert the interrupt as soon as it is unmasked
+        e1000_write_reg(E1000_REG_IMS, E1000_IMS_RX);
+    }
+    return 0;
 }
 
 
@@ -299,7 +345,7 @@ static int e1000_iface_transmit(net_interface_t* iface, net_packet_t* packet) {
         return -1;
     }
     
-    return e1000_transmit(packet->data, packet->len);
+    return e1000_tx_submit(packet, packet->data, packet->len);
 }
 
 static int e1000_iface_receive(net_interface_t* iface, net_packet_t* packet) {
@@ -399,6 +445,21 @@ int e1000_init(void) {
     
     net_interface_up(e1000_iface);
     
+    // Receive interrupts feed the network bottom half
+    memset(&e1000_napi, 0, sizeof(e1000_napi));
+    e1000_napi.name = "e1000";
+    e1000_napi.poll = e1000_poll;
+    e1000_napi.irq_enable = e1000_irq_enable;
+    net_napi_add(&e1000_napi);
+    
+    int irq_line = pci_irq_attach(dev, e1000_irq_handler, NULL);
+    if (irq_line > 0) {
+        e1000_napi.irq = (uint32_t)irq_line;
+        e1000_write_reg(E1000_REG_IMS, E1000_IMS_RX);
+    } else {
+        serial_puts("e1000: No usable IRQ line, polling for packets\n");
+    }
+    
     serial_puts("e1000: MAC ");
     char mac_str[20];
     mac_to_string(&e1000_iface->mac_addr, mac_str);
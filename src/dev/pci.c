@@ -9,6 +9,7 @@
 
 
 #include <dev/pci.h>
+#include <arch.h>
 #include <io.h>
 #include <serial.h>
 #include <stdlib.h>
@@ -26,6 +27,19 @@
 static pci_device_t pci_devices[MAX_PCI_DEVICES];
 static int pci_device_count = 0;
 
+/*
+ * Legacy INTx lines are level-triggered and routinely shared between slots,
+ * so drivers attach here instead of owning the vector: each line gets one
+ * dispatcher that runs every attached handler in turn.
+ */
+typedef struct {
+    void (*handler)(void* ctx);
+    void* ctx;
+} pci_irq_action_t;
+
+static pci_irq_action_t pci_irq_actions[PCI_IRQ_LINES][PCI_IRQ_MAX_SHARED];
+static uint8_t pci_irq_count[PCI_IRQ_LINES];
+
 uint32_t pci_read_config(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset) {
     /* Read 32-bit value from PCI configuration space. */
     uint32_t address = (uint32_t)((bus << 16) | (device << 11) | 
@@ -120,6 +134,73 @@ pci_device_t* pci_find_device(uint16_t vendor_id, uint16_t device_id) {
     return NULL;
 }
 
+pci_device_t* pci_find_class(uint8_t class_code, uint8_t subclass) {
+    for (int i = 0; i < pci_device_count; i++) {
+        if (pci_devices[i].class_code == class_code &&
+            pci_devices[i].subclass == subclass) {
+            return &pci_devices[i];
+        }
+    }
+    return NULL;
+}
+
+static void pci_irq_dispatch(uint8_t line) {
+    for (uint8_t i = 0; i < pci_irq_count[line]; i++) {
+        pci_irq_actions[line][i].handler(pci_irq_actions[line][i].ctx);
+    }
+}
+
+// The arch layer does not pass the vector, so each line needs its own entry
+#define PCI_IRQ_STUB(n) \
+    static void pci_irq_line_##n(void* regs) { (void)regs; pci_irq_dispatch(n); }
+PCI_IRQ_STUB(0)  PCI_IRQ_STUB(1)  PCI_IRQ_STUB(2)  PCI_IRQ_STUB(3)
+PCI_IRQ_STUB(4)  PCI_IRQ_STUB(5)  PCI_IRQ_STUB(6)  PCI_IRQ_STUB(7)
+PCI_IRQ_STUB(8)  PCI_IRQ_STUB(9)  PCI_IRQ_STUB(10) PCI_IRQ_STUB(11)
+PCI_IRQ_STUB(12) PCI_IRQ_STUB(13) PCI_IRQ_STUB(14) PCI_IRQ_STUB(15)
+
+static void (*const pci_irq_stubs[PCI_IRQ_LINES])(void* regs) = {
+    pci_irq_line_0,  pci_irq_line_1,  pci_irq_line_2,  pci_irq_line_3,
+    pci_irq_line_4,  pci_irq_line_5,  pci_irq_line_6,  pci_irq_line_7,
+    pci_irq_line_8,  pci_irq_line_9,  pci_irq_line_10, pci_irq_line_11,
+    pci_irq_line_12, pci_irq_line_13, pci_irq_line_14, pci_irq_line_15
+};
+
+int pci_irq_attach(pci_device_t* dev, void (*handler)(void* ctx), void* ctx) {
+    if (!dev || !handler) {
+        return -1;
+    }
+    uint8_t line = dev->interrupt_line;
+    if (line == 0 || line >= PCI_IRQ_LINES) {
+        return -1;  // 0xFF: not routed
+    }
+
+    uintptr_t irq = arch_irq_save();
+    if (pci_irq_count[line] >= PCI_IRQ_MAX_SHARED) {
+        arch_irq_restore(irq);
+        return -1;
+    }
+    pci_irq_actions[line][pci_irq_count[line]].handler = handler;
+    pci_irq_actions[line][pci_irq_count[line]].ctx = ctx;
+    pci_irq_count[line]++;
+    if (pci_irq_count[line] == 1) {
+        arch_register_interrupt_handler((uint8_t)(32 + line), pci_irq_stubs[line]);
+    }
+    arch_irq_restore(irq);
+
+    // Firmware may leave INTx disabled in the command register
+    uint16_t command = pci_read_config_word(dev->bus, dev->device, dev->function, PCI_COMMAND);
+    if (command & PCI_COMMAND_INTERRUPT) {
+        pci_write_config_word(dev->bus, dev->device, dev->function, PCI_COMMAND,
+                              (uint16_t)(command & ~PCI_COMMAND_INTERRUPT));
+    }
+
+    if (line >= 8) {
+        arch_enable_irq(2);  // Cascade to the slave PIC
+    }
+    arch_enable_irq(line);
+    return line;
+}
+
 void pci_init(void) {
     /* Bootstrap PCI subsystem and emit enumeration count. */
     serial_puts("Initializing PCI subsystem...\n");
@@ -18,6 +18,7 @@
 
 #include <dev/pcnet.h>
 #include <dev/pci.h>
+#include <arch.h>
 #include <net/net.h>
 #include <net/ethernet.h>
 #include <net/arp.h>
@@ -33,7 +34,9 @@
  * AMD PCnet NIC driver.
  *
  * Handles PCI-discovered PCnet adapters using CSR/BCR register interfaces and
- * DMA descriptor rings for packet RX/TX operations.
+ * DMA descriptor rings for packet RX/TX operations. On a receive interrupt
+ * the handler clears IENA and schedules the network bottom half, which
+ * drains the ring through pcnet_poll() and sets IENA again once it is empty.
  */
 
 // PCnet Device State
@@ -60,6 +63,14 @@ static volatile uint32_t tx_tail = 0;
 static uint32_t tx_packets = 0;
 static uint32_t rx_packets = 0;
 
+static net_napi_t pcnet_napi;
+static volatile uint16_t pcnet_irq_status = 0;  // Error bits seen by the IRQ handler
+
+// CSR0 status bits that are cleared by writing 1
+#define PCNET_CSR0_ACK  (PCNET_CSR0_IDON | PCNET_CSR0_TINT | PCNET_CSR0_RINT | \
+                         PCNET_CSR0_MERR | PCNET_CSR0_MISS | PCNET_CSR0_CERR | \
+                         PCNET_CSR0_BABL)
+
 // Keep boot networking responsive: avoid long DHCP blocking during startup.
 #define PCNET_BOOT_DHCP_TIMEOUT_TICKS 100
 // I/O Access Functions
@@ -256,9 +267,12 @@ int pcnet_transmit(const uint8_t* data, uint32_t len) {
     // Memory barrier
     __asm__ __volatile__("mfence" ::: "memory");
     
-    // Trigger transmit by setting TDMD in CSR0
+    // Trigger transmit by setting TDMD in CSR0. Writing back the status
+    // bits would acknowledge them, and RAP must not change under the IRQ handler.
+    uintptr_t irq = arch_irq_save();
     uint16_t csr0 = pcnet_read_csr16(PCNET_CSR0);
-    pcnet_write_csr16(PCNET_CSR0, csr0 | PCNET_CSR0_TDMD);
+    pcnet_write_csr16(PCNET_CSR0, (uint16_t)(PCNET_CSR0_TDMD | (csr0 & PCNET_CSR0_IENA)));
+    arch_irq_restore(irq);
     
     // Wait for transmission to complete
     timeout = 100000;
@@ -291,9 +305,11 @@ int pcnet_transmit(const uint8_t* data, uint32_t len) {
 
 // Packet Reception
 
-static void pcnet_receive(void) {
-    while (!(rx_descs[rx_head].status_bcnt & PCNET_DESC_OWN)) {
+static int pcnet_receive(int budget) {
+    int done = 0;
+    while (done < budget && !(rx_descs[rx_head].status_bcnt & PCNET_DESC_OWN)) {
         pcnet_rx_desc_t* desc = &rx_descs[rx_head];
+        done++;
         
         // Memory barrier
         __asm__ __volatile__("lfence" ::: "memory");
@@ -308,17 +324,9 @@ static void pcnet_receive(void) {
             if (length > 0 && length <= PCNET_RX_BUFFER_SIZE && pcnet_iface) {
                 rx_packets++;
                 
-                serial_puts("pcnet: Rx packet len=");
-                char len_str[16];
-                itoa(length, len_str, 10);
-                serial_puts(len_str);
-                serial_puts("\n");
-                
                 // Process packet through Ethernet layer
                 net_packet_t packet;
-                packet.data = rx_buffers[rx_head];
-                packet.len = length;
-                packet.capacity = PCNET_RX_BUFFER_SIZE;
+                net_packet_wrap(&packet, rx_buffers[rx_head], length, PCNET_RX_BUFFER_SIZE);
                 
                 eth_receive(pcnet_iface, &packet);
             }
@@ -332,55 +340,60 @@ static void pcnet_receive(void) {
         // Advance head
         rx_head = (rx_head + 1) % PCNET_NUM_RX_DESC;
     }
+    return done;
 }
 
-void pcnet_handle_interrupt(void) {
-    if (!io_base) return;
-    
-    static uint32_t poll_count = 0;
-    poll_count++;
-    
-    // Debug every 50000 polls to reduce spam
-    if (poll_count % 50000 == 0) {
-        serial_puts("pcnet: poll #");
-        char count_str[16];
-        itoa(poll_count / 1000, count_str, 10);
-        serial_puts(count_str);
-        serial_puts("k, desc[0]=0x");
-        itoa(rx_descs[0].status_bcnt, count_str, 16);
-        serial_puts(count_str);
-        serial_puts("\n");
-    }
+static void pcnet_irq_handler(void* ctx) {
+    (void)ctx;
     
-    // Read and clear interrupt status
+    // The interrupted code may be between a RAP write and its data access
+    uint16_t rap = inw(io_base + PCNET_IO_RAP);
     uint16_t csr0 = pcnet_read_csr16(PCNET_CSR0);
-    
-    // Debug: Check if anything interesting is happening
-    if (csr0 & (PCNET_CSR0_RINT | PCNET_CSR0_TINT | PCNET_CSR0_ERR)) {
-        serial_puts("pcnet: CSR0=0x");
-        char hex[8];
-        itoa(csr0, hex, 16);
-        serial_puts(hex);
-        serial_puts("\n");
+    if (csr0 & PCNET_CSR0_INTR) {
+        pcnet_napi.interrupts++;
+        pcnet_irq_status |= (uint16_t)(csr0 & (PCNET_CSR0_ERR | PCNET_CSR0_BABL | PCNET_CSR0_CERR |
+                                               PCNET_CSR0_MISS | PCNET_CSR0_MERR));
+        if (csr0 & PCNET_CSR0_RINT) {
+            // Acknowledge with IENA clear: the chip stays quiet until pcnet_irq_enable()
+            pcnet_write_csr16(PCNET_CSR0, (uint16_t)(csr0 & PCNET_CSR0_ACK));
+            net_napi_schedule(&pcnet_napi);
+        } else {
+            pcnet_write_csr16(PCNET_CSR0, (uint16_t)((csr0 & PCNET_CSR0_ACK) | PCNET_CSR0_IENA));
+        }
     }
+    outw(io_base + PCNET_IO_RAP, rap);
+}
+
+static int pcnet_poll(net_napi_t* napi, int budget) {
+    (void)napi;
     
-    // Clear interrupt flags by writing 1s to them
-    pcnet_write_csr16(PCNET_CSR0, csr0 & 
-        (PCNET_CSR0_TINT | PCNET_CSR0_RINT | PCNET_CSR0_MERR | 
-         PCNET_CSR0_MISS | PCNET_CSR0_CERR | PCNET_CSR0_BABL));
+    uintptr_t irq = arch_irq_save();
+    uint16_t status = pcnet_irq_status;
+    pcnet_irq_status = 0;
+    arch_irq_restore(irq);
     
-    // Handle receive interrupt
-    if (csr0 & PCNET_CSR0_RINT) {
-        pcnet_receive();
+    // Handle errors
+    if (status & PCNET_CSR0_ERR) {
+        if (status & PCNET_CSR0_BABL) serial_puts("pcnet: Babble error\n");
+        if (status & PCNET_CSR0_CERR) serial_puts("pcnet: Collision error\n");
+        if (status & PCNET_CSR0_MISS) serial_puts("pcnet: Missed frame\n");
+        if (status & PCNET_CSR0_MERR) serial_puts("pcnet: Memory error\n");
     }
     
-    // Handle errors
-    if (csr0 & PCNET_CSR0_ERR) {
-        if (csr0 & PCNET_CSR0_BABL) serial_puts("pcnet: Babble error\n");
-        if (csr0 & PCNET_CSR0_CERR) serial_puts("pcnet: Collision error\n");
-        if (csr0 & PCNET_CSR0_MISS) serial_puts("pcnet: Missed frame\n");
-        if (csr0 & PCNET_CSR0_MERR) serial_puts("pcnet: Memory error\n");
+    return pcnet_receive(budget);
+}
+
+static int pcnet_irq_enable(net_napi_t* napi) {
+    if (!napi->irq) {
+        return 0;  // Nobody would acknowledge the line; stay polled
     }
+    
+    uintptr_t irq = arch_irq_save();
+    pcnet_write_csr16(PCNET_CSR0, PCNET_CSR0_IENA);
+    arch_irq_restore(irq);
+    
+    // RINT may have been acknowledged by a transmit while IENA was clear
+    return !(rx_descs[rx_head].status_bcnt & PCNET_DESC_OWN);
 }
 
 // Network Interface Functions
@@ -565,6 +578,21 @@ int pcnet_init(void) {
     
     net_interface_up(pcnet_iface);
     
+    // Receive interrupts feed the network bottom half
+    memset(&pcnet_napi, 0, sizeof(pcnet_napi));
+    pcnet_napi.name = "pcnet";
+    pcnet_napi.poll = pcnet_poll;
+    pcnet_napi.irq_enable = pcnet_irq_enable;
+    net_napi_add(&pcnet_napi);
+    
+    int irq_line = pci_irq_attach(dev, pcnet_irq_handler, NULL);
+    if (irq_line > 0) {
+        pcnet_napi.irq = (uint32_t)irq_line;
+        pcnet_write_csr16(PCNET_CSR0, PCNET_CSR0_ACK | PCNET_CSR0_IENA);
+    } else {
+        serial_puts("pcnet: No usable IRQ line, polling for packets\n");
+    }
+    
     serial_puts("pcnet: MAC ");
     char mac_str[20];
     mac_to_string(&pcnet_iface->mac_addr, mac_str);
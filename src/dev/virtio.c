@@ -0,0 +1,182 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * src/dev/virtio.c
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+
+/**
+ * Legacy VirtIO PCI transport and split virtqueues
+ */
+
+#include <dev/virtio.h>
+#include <dev/pci.h>
+#include <io.h>
+#include <string.h>
+
+static inline uint32_t align_up_u32(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1U) & ~(alignment - 1U);
+}
+
+static inline uint8_t virtio_read_status(virtio_device_t* vdev) {
+    return inb(vdev->io_base + VIRTIO_PCI_REG_DEVICE_STATUS);
+}
+
+static inline void virtio_write_status(virtio_device_t* vdev, uint8_t status) {
+    outb(vdev->io_base + VIRTIO_PCI_REG_DEVICE_STATUS, status);
+}
+
+static uint32_t virtq_required_bytes(uint16_t qsize) {
+    uint32_t desc_bytes = (uint32_t)sizeof(virtq_desc_t) * qsize;
+    uint32_t avail_bytes = (uint32_t)sizeof(uint16_t) * (uint32_t)(3 + qsize);
+    uint32_t used_offset = align_up_u32(desc_bytes + avail_bytes, VIRTIO_QUEUE_ALIGN);
+    uint32_t used_bytes = (uint32_t)sizeof(uint16_t) * 3U + (uint32_t)sizeof(virtq_used_elem_t) * qsize;
+    return used_offset + used_bytes;
+}
+
+pci_device_t* virtio_pci_find(uint16_t legacy_id, uint16_t modern_id) {
+    pci_device_t* dev = pci_find_device(VIRTIO_PCI_VENDOR_ID, legacy_id);
+    if (dev) {
+        return dev;
+    }
+    return pci_find_device(VIRTIO_PCI_VENDOR_ID, modern_id);
+}
+
+int virtio_open(virtio_device_t* vdev, pci_device_t* pci) {
+    if (!vdev || !pci) {
+        return -1;
+    }
+
+    uint16_t command = pci_read_config_word(pci->bus, pci->device, pci->function, PCI_COMMAND);
+    command |= PCI_COMMAND_IO | PCI_COMMAND_MASTER;
+    pci_write_config_word(pci->bus, pci->device, pci->function, PCI_COMMAND, command);
+
+    uint32_t bar0 = pci->bar[0];
+    if ((bar0 & 0x1U) == 0) {
+        return -1;  // MMIO-only: modern interface, not supported
+    }
+
+    vdev->pci = pci;
+    vdev->io_base = (uint16_t)(bar0 & 0xFFFC);
+    vdev->features = 0;
+
+    virtio_write_status(vdev, 0);
+    virtio_write_status(vdev, VIRTIO_STATUS_ACKNOWLEDGE);
+    virtio_write_status(vdev, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+    return 0;
+}
+
+uint32_t virtio_negotiate(virtio_device_t* vdev, uint32_t wanted) {
+    uint32_t host_features = inl(vdev->io_base + VIRTIO_PCI_REG_DEVICE_FEATURES);
+    vdev->features = host_features & wanted;
+    outl(vdev->io_base + VIRTIO_PCI_REG_GUEST_FEATURES, vdev->features);
+    return vdev->features;
+}
+
+int virtq_setup(virtio_device_t* vdev, uint16_t index, virtq_t* q,
+                uint8_t* queue_mem, uint32_t queue_mem_size) {
+    if (!vdev || !q || !queue_mem) {
+        return -1;
+    }
+
+    outw(vdev->io_base + VIRTIO_PCI_REG_QUEUE_SELECT, index);
+    uint16_t qsize = inw(vdev->io_base + VIRTIO_PCI_REG_QUEUE_SIZE);
+    if (qsize == 0 || qsize > VIRTIO_QUEUE_MAX_ENTRIES) {
+        return -1;
+    }
+
+    uint32_t needed = virtq_required_bytes(qsize);
+    if (needed > queue_mem_size) {
+        return -1;
+    }
+
+    memset(queue_mem, 0, queue_mem_size);
+
+    uint32_t desc_bytes = (uint32_t)sizeof(virtq_desc_t) * qsize;
+    uint32_t avail_bytes = (uint32_t)sizeof(uint16_t) * (uint32_t)(3 + qsize);
+    uint32_t used_offset = align_up_u32(desc_bytes + avail_bytes, VIRTIO_QUEUE_ALIGN);
+
+    q->index = index;
+    q->size = qsize;
+    q->mem = queue_mem;
+    q->desc = (virtq_desc_t*)(void*)queue_mem;
+    q->avail = (virtq_avail_t*)(void*)(queue_mem + desc_bytes);
+    q->used = (virtq_used_t*)(void*)(queue_mem + used_offset);
+    q->avail_idx_shadow = 0;
+    q->last_used_idx = 0;
+
+    uintptr_t q_phys = virtio_dma_addr(queue_mem);
+    if ((q_phys & (VIRTIO_QUEUE_ALIGN - 1U)) != 0) {
+        return -1;
+    }
+    uint32_t q_pfn = (uint32_t)(q_phys >> 12);
+    outl(vdev->io_base + VIRTIO_PCI_REG_QUEUE_ADDRESS, q_pfn);
+
+    return 0;
+}
+
+void virtq_push_avail(virtq_t* q, uint16_t head) {
+    uint16_t avail_slot = (uint16_t)(q->avail_idx_shadow % q->size);
+    q->avail->ring[avail_slot] = head;
+    q->avail_idx_shadow++;
+}
+
+void virtq_kick(virtio_device_t* vdev, virtq_t* q) {
+    // Descriptors and ring entries must be visible before the index moves
+    __asm__ __volatile__("" ::: "memory");
+    q->avail->idx = q->avail_idx_shadow;
+    __asm__ __volatile__("" ::: "memory");
+    outw(vdev->io_base + VIRTIO_PCI_REG_QUEUE_NOTIFY, q->index);
+}
+
+int virtq_pop_used(virtq_t* q, uint32_t* id, uint32_t* len) {
+    if (q->last_used_idx == *(volatile uint16_t*)&q->used->idx) {
+        return 0;
+    }
+    __asm__ __volatile__("" ::: "memory");
+
+    uint16_t ring_idx = (uint16_t)(q->last_used_idx % q->size);
+    virtq_used_elem_t* elem = &q->used->ring[ring_idx];
+    if (id) {
+        *id = elem->id;
+    }
+    if (len) {
+        *len = elem->len;
+    }
+    q->last_used_idx++;
+    return 1;
+}
+
+void virtq_disable_interrupts(virtq_t* q) {
+    q->avail->flags |= VIRTQ_AVAIL_F_NO_INTERRUPT;
+}
+
+int virtq_enable_interrupts(virtq_t* q) {
+    q->avail->flags &= (uint16_t)~VIRTQ_AVAIL_F_NO_INTERRUPT;
+    // The flag store must be visible before the used index is sampled
+    __asm__ __volatile__("mfence" ::: "memory");
+    return q->last_used_idx != *(volatile uint16_t*)&q->used->idx;
+}
+
+void virtio_driver_ok(virtio_device_t* vdev) {
+    virtio_write_status(vdev, virtio_read_status(vdev) | VIRTIO_STATUS_DRIVER_OK);
+}
+
+void virtio_fail(virtio_device_t* vdev) {
+    virtio_write_status(vdev, virtio_read_status(vdev) | VIRTIO_STATUS_FAILED);
+}
+
+uint8_t virtio_read_isr(virtio_device_t* vdev) {
+    return inb(vdev->io_base + VIRTIO_PCI_REG_ISR_STATUS);
+}
+
+uint8_t virtio_config_read8(virtio_device_t* vdev, uint32_t offset) {
+    return inb((uint16_t)(vdev->io_base + VIRTIO_PCI_REG_DEVICE_CONFIG + offset));
+}
+
+uint32_t virtio_config_read32(virtio_device_t* vdev, uint32_t offset) {
+    return inl((uint16_t)(vdev->io_base + VIRTIO_PCI_REG_DEVICE_CONFIG + offset));
+}
@@ -0,0 +1,317 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * src/dev/virtio_blk.c
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+
+/**
+ * Legacy VirtIO-Blk PCI Driver
+ */
+
+#include <dev/virtio_blk.h>
+#include <dev/virtio.h>
+#include <dev/blkdev.h>
+#include <dev/pci.h>
+#include <arch.h>
+#include <serial.h>
+#include <string.h>
+#include <stdlib.h>
+
+/*
+ * VirtIO-Blk disk driver (legacy I/O BAR interface).
+ *
+ * Every block-layer request becomes one three-descriptor chain: header,
+ * data, status byte. Slot i owns descriptors 3i..3i+2 and a bounce buffer,
+ * so up to VIRTIO_BLK_QUEUE_DEPTH requests are in flight at once and the
+ * device may complete them in any order. Completions are reaped from the
+ * INTx handler, or by the block layer's poll hook while interrupts are off.
+ *
+ * VIRTIO_BLK_F_FLUSH is deliberately not negotiated: the device then keeps
+ * its cache write-through, so a completed write is stable, as with ATA.
+ */
+
+// VirtIO-Blk feature bits
+#define VIRTIO_BLK_F_RO                  5
+
+// Request types
+#define VIRTIO_BLK_T_IN                  0
+#define VIRTIO_BLK_T_OUT                 1
+
+// Status byte written by the device
+#define VIRTIO_BLK_S_OK                  0
+#define VIRTIO_BLK_S_IOERR               1
+#define VIRTIO_BLK_S_UNSUPP              2
+#define VIRTIO_BLK_STATUS_PENDING        0xFF
+
+#define VIRTIO_BLK_QUEUE_REQUEST         0
+#define VIRTIO_BLK_DESC_PER_REQUEST      3
+#define VIRTIO_BLK_SECTOR_SIZE           512
+
+typedef struct {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((packed)) virtio_blk_req_hdr_t;
+
+typedef struct {
+    virtio_blk_req_hdr_t hdr;
+    volatile uint8_t status;
+    uint8_t in_use;
+    blk_request_t* req;
+} virtio_blk_slot_t;
+
+// Device state
+static virtio_device_t vblk;
+static virtq_t vblk_q;
+static int vblk_available = 0;
+static int vblk_blk_dev = -1;
+static uint32_t vblk_depth = 0;
+static uint32_t vblk_in_flight = 0;
+static const blk_driver_ops_t vblk_ops;
+
+static uint8_t vblk_queue_mem[VIRTIO_QUEUE_MAX_MEM] __attribute__((aligned(VIRTIO_QUEUE_ALIGN)));
+static virtio_blk_slot_t vblk_slots[VIRTIO_BLK_QUEUE_DEPTH] __attribute__((aligned(16)));
+static uint8_t vblk_bounce[VIRTIO_BLK_QUEUE_DEPTH][VIRTIO_BLK_MAX_SECTORS * VIRTIO_BLK_SECTOR_SIZE]
+    __attribute__((aligned(4096)));
+
+static virtio_blk_stats_t vblk_stats;
+
+static void virtio_blk_reap(int from_irq) {
+    /* Complete every request the device has returned, in used-ring order. */
+    blk_device_t* dev = blk_get_device((uint32_t)vblk_blk_dev);
+    uint32_t id;
+
+    for (;;) {
+        uintptr_t irq = arch_irq_save();
+        if (!virtq_pop_used(&vblk_q, &id, NULL)) {
+            arch_irq_restore(irq);
+            break;
+        }
+        uint32_t slot_idx = id / VIRTIO_BLK_DESC_PER_REQUEST;
+        if (slot_idx >= vblk_depth || !vblk_slots[slot_idx].in_use) {
+            arch_irq_restore(irq);
+            continue;  // Not ours; nothing to complete
+        }
+        arch_irq_restore(irq);
+
+        virtio_blk_slot_t* slot = &vblk_slots[slot_idx];
+        blk_request_t* req = slot->req;
+        int result = (slot->status == VIRTIO_BLK_S_OK) ? 0 : -1;
+
+        if (result == 0) {
+            if (req->flags & BLK_BIO_WRITE) {
+                vblk_stats.sectors_written += req->count;
+            } else {
+                blk_rq_copy_in(req, 0, vblk_bounce[slot_idx], req->count);
+                vblk_stats.sectors_read += req->count;
+            }
+        } else {
+            vblk_stats.errors++;
+        }
+        if (!from_irq) {
+            vblk_stats.polled++;
+        }
+
+        // Free the slot first: completion may submit the next request into it
+        irq = arch_irq_save();
+        slot->req = NULL;
+        slot->in_use = 0;
+        vblk_in_flight--;
+        arch_irq_restore(irq);
+
+        blk_end_request(dev, req, result);
+    }
+}
+
+static void virtio_blk_irq_handler(void* ctx) {
+    (void)ctx;
+
+    // Reading ISR acknowledges the level-triggered INTx line
+    uint8_t isr = virtio_read_isr(&vblk);
+    if (isr == 0) {
+        return;  // Another device on a shared line
+    }
+    vblk_stats.interrupts++;
+    if (isr & VIRTIO_ISR_QUEUE) {
+        virtio_blk_reap(1);
+    }
+}
+
+static int virtio_blk_submit(blk_device_t* dev, blk_request_t* req) {
+    (void)dev;
+    int write = (req->flags & BLK_BIO_WRITE) != 0;
+    if (req->count == 0 || req->count > VIRTIO_BLK_MAX_SECTORS || (write && vblk_stats.read_only)) {
+        return -1;
+    }
+
+    uintptr_t irq = arch_irq_save();
+    uint32_t slot_idx = 0;
+    while (slot_idx < vblk_depth && vblk_slots[slot_idx].in_use) {
+        slot_idx++;
+    }
+    if (slot_idx >= vblk_depth) {
+        arch_irq_restore(irq);
+        return -1;  // The block layer never exceeds the registered depth
+    }
+    virtio_blk_slot_t* slot = &vblk_slots[slot_idx];
+    slot->in_use = 1;
+    slot->req = req;
+    arch_irq_restore(irq);
+
+    uint8_t* bounce = vblk_bounce[slot_idx];
+    if (write) {
+        blk_rq_copy_out(req, 0, bounce, req->count);
+    }
+
+    slot->hdr.type = write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    slot->hdr.reserved = 0;
+    slot->hdr.sector = req->lba;
+    slot->status = VIRTIO_BLK_STATUS_PENDING;
+
+    uint16_t head = (uint16_t)(slot_idx * VIRTIO_BLK_DESC_PER_REQUEST);
+    virtq_desc_t* desc = vblk_q.desc;
+
+    desc[head].addr = (uint64_t)virtio_dma_addr(&slot->hdr);
+    desc[head].len = sizeof(virtio_blk_req_hdr_t);
+    desc[head].flags = VIRTQ_DESC_F_NEXT;
+    desc[head].next = (uint16_t)(head + 1);
+
+    desc[head + 1].addr = (uint64_t)virtio_dma_addr(bounce);
+    desc[head + 1].len = req->count * VIRTIO_BLK_SECTOR_SIZE;
+    desc[head + 1].flags = (uint16_t)(VIRTQ_DESC_F_NEXT | (write ? 0 : VIRTQ_DESC_F_WRITE));
+    desc[head + 1].next = (uint16_t)(head + 2);
+
+    desc[head + 2].addr = (uint64_t)virtio_dma_addr((const void*)&slot->status);
+    desc[head + 2].len = 1;
+    desc[head + 2].flags = VIRTQ_DESC_F_WRITE;
+    desc[head + 2].next = 0;
+
+    irq = arch_irq_save();
+    vblk_in_flight++;
+    if (vblk_in_flight > vblk_stats.max_in_flight) {
+        vblk_stats.max_in_flight = vblk_in_flight;
+    }
+    vblk_stats.requests++;
+    virtq_push_avail(&vblk_q, head);
+    virtq_kick(&vblk, &vblk_q);
+    arch_irq_restore(irq);
+    return 0;
+}
+
+static void virtio_blk_poll(blk_device_t* dev) {
+    (void)dev;
+    virtio_blk_reap(0);
+}
+
+static const blk_driver_ops_t vblk_ops = {
+    .submit = virtio_blk_submit,
+    .poll = virtio_blk_poll,
+    .flags = BLK_DRIVER_ATOMIC_SUBMIT
+};
+
+int virtio_blk_init(void) {
+    serial_puts("virtio-blk: Initializing...\n");
+
+    if (vblk_available) {
+        serial_puts("virtio-blk: Already initialized\n");
+        return 0;
+    }
+
+    pci_device_t* dev = virtio_pci_find(VIRTIO_PCI_DEVICE_ID_BLK_LEGACY,
+                                        VIRTIO_PCI_DEVICE_ID_BLK_MODERN);
+    if (!dev) {
+        serial_puts("virtio-blk: Device not found\n");
+        return -1;
+    }
+
+    if (virtio_open(&vblk, dev) != 0) {
+        serial_puts("virtio-blk: BAR0 is MMIO-only (legacy I/O mode expected)\n");
+        return -1;
+    }
+
+    uint32_t features = virtio_negotiate(&vblk, 1U << VIRTIO_BLK_F_RO);
+    vblk_stats.read_only = (features & (1U << VIRTIO_BLK_F_RO)) ? 1 : 0;
+
+    if (virtq_setup(&vblk, VIRTIO_BLK_QUEUE_REQUEST, &vblk_q, vblk_queue_mem, sizeof(vblk_queue_mem)) != 0) {
+        serial_puts("virtio-blk: Failed to setup request queue\n");
+        virtio_fail(&vblk);
+        return -1;
+    }
+
+    vblk_depth = vblk_q.size / VIRTIO_BLK_DESC_PER_REQUEST;
+    if (vblk_depth > VIRTIO_BLK_QUEUE_DEPTH) {
+        vblk_depth = VIRTIO_BLK_QUEUE_DEPTH;
+    }
+    if (vblk_depth == 0) {
+        serial_puts("virtio-blk: Request queue too small\n");
+        virtio_fail(&vblk);
+        return -1;
+    }
+    memset(vblk_slots, 0, sizeof(vblk_slots));
+    vblk_in_flight = 0;
+
+    // Capacity is a 64-bit sector count; the block layer addresses 32 bits
+    uint32_t cap_lo = virtio_config_read32(&vblk, 0);
+    uint32_t cap_hi = virtio_config_read32(&vblk, 4);
+    uint32_t capacity = cap_hi ? 0xFFFFFFFFu : cap_lo;
+    if (capacity == 0) {
+        serial_puts("virtio-blk: Disk has no sectors\n");
+        virtio_fail(&vblk);
+        return -1;
+    }
+    vblk_stats.capacity = capacity;
+
+    // Legacy INTx from the PCI interrupt line; without one, completions are polled
+    int irq_line = pci_irq_attach(dev, virtio_blk_irq_handler, NULL);
+    if (irq_line > 0) {
+        vblk_stats.irq = (uint32_t)irq_line;
+    } else {
+        serial_puts("virtio-blk: No usable IRQ line, polling for completions\n");
+    }
+
+    virtio_driver_ok(&vblk);
+
+    vblk_blk_dev = blk_register_device("vda", &vblk_ops, NULL, capacity,
+                                       VIRTIO_BLK_MAX_SECTORS, vblk_depth);
+    if (vblk_blk_dev < 0) {
+        serial_puts("virtio-blk: Failed to register block device\n");
+        virtio_fail(&vblk);
+        return -1;
+    }
+    vblk_available = 1;
+    vblk_stats.available = 1;
+
+    char buf[16];
+    serial_puts("virtio-blk: vda, ");
+    itoa(capacity, buf, 10);
+    serial_puts(buf);
+    serial_puts(" sectors (");
+    itoa(capacity / 2048, buf, 10);
+    serial_puts(buf);
+    serial_puts(" MB), IRQ ");
+    itoa(vblk_stats.irq, buf, 10);
+    serial_puts(buf);
+    serial_puts(vblk_stats.read_only ? ", read-only\n" : "\n");
+    return 0;
+}
+
+int virtio_blk_available(void) {
+    return vblk_available;
+}
+
+int virtio_blk_get_blk_device(void) {
+    return vblk_blk_dev;
+}
+
+void virtio_blk_get_stats(virtio_blk_stats_t* stats) {
+    if (!stats) {
+        return;
+    }
+    uintptr_t irq = arch_irq_save();
+    *stats = vblk_stats;
+    arch_irq_restore(irq);
+}
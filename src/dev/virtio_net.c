@@ -27,27 +27,13 @@
 /*
  * VirtIO-Net NIC driver (legacy I/O BAR interface).
  *
- * Implements queue setup and polling-based RX/TX for QEMU virtio-net-pci
- * devices exposing the legacy register layout.
+ * Drives QEMU virtio-net-pci devices exposing the legacy register layout;
+ * transport and virtqueues are in virtio.c. The INTx handler only turns RX
+ * interrupts off and schedules the network bottom half, which drains the
+ * RX queue through virtio_net_poll(). TX completions are reaped by the
+ * sender itself, so TX interrupts stay suppressed.
  */
 
-// Legacy VirtIO PCI register offsets (I/O BAR)
-#define VIRTIO_PCI_REG_DEVICE_FEATURES   0x00
-#define VIRTIO_PCI_REG_GUEST_FEATURES    0x04
-#define VIRTIO_PCI_REG_QUEUE_ADDRESS     0x08
-#define VIRTIO_PCI_REG_QUEUE_SIZE        0x0C
-#define VIRTIO_PCI_REG_QUEUE_SELECT      0x0E
-#define VIRTIO_PCI_REG_QUEUE_NOTIFY      0x10
-#define VIRTIO_PCI_REG_DEVICE_STATUS     0x12
-#define VIRTIO_PCI_REG_ISR_STATUS        0x13
-#define VIRTIO_PCI_REG_DEVICE_CONFIG     0x14
-
-// VirtIO status bits (legacy subset)
-#define VIRTIO_STATUS_ACKNOWLEDGE        0x01
-#define VIRTIO_STATUS_DRIVER             0x02
-#define VIRTIO_STATUS_DRIVER_OK          0x04
-#define VIRTIO_STATUS_FAILED             0x80
-
 // VirtIO-Net feature bits
 #define VIRTIO_NET_F_MAC                 5
 
@@ -55,11 +41,6 @@
 #define VIRTIO_NET_QUEUE_RX              0
 #define VIRTIO_NET_QUEUE_TX              1
 
-// Queue constraints and sizing
-#define VIRTIO_QUEUE_ALIGN               4096
-#define VIRTIO_QUEUE_MAX_ENTRIES         1024
-#define VIRTIO_QUEUE_MAX_MEM             32768
-
 // Buffers
 #define VIRTIO_NET_RX_DESC_TARGET        64
 #define VIRTIO_NET_RX_BUFFER_SIZE        2048
@@ -68,34 +49,6 @@
 // Keep boot networking responsive: avoid long DHCP blocking during startup.
 #define VIRTIO_NET_BOOT_DHCP_TIMEOUT_TICKS 100
 
-// Virtqueue descriptor flags
-#define VIRTQ_DESC_F_NEXT                1
-#define VIRTQ_DESC_F_WRITE               2
-
-typedef struct {
-    uint64_t addr;
-    uint32_t len;
-    uint16_t flags;
-    uint16_t next;
-} __attribute__((packed)) virtq_desc_t;
-
-typedef struct {
-    uint16_t flags;
-    uint16_t idx;
-    uint16_t ring[];
-} __attribute__((packed)) virtq_avail_t;
-
-typedef struct {
-    uint32_t id;
-    uint32_t len;
-} __attribute__((packed)) virtq_used_elem_t;
-
-typedef struct {
-    uint16_t flags;
-    uint16_t idx;
-    virtq_used_elem_t ring[];
-} __attribute__((packed)) virtq_used_t;
-
 typedef struct {
     uint8_t flags;
     uint8_t gso_type;
@@ -105,22 +58,12 @@ typedef struct {
     uint16_t csum_offset;
 } __attribute__((packed)) virtio_net_hdr_t;
 
-typedef struct {
-    uint16_t size;
-    uint8_t* mem;
-    virtq_desc_t* desc;
-    virtq_avail_t* avail;
-    virtq_used_t* used;
-    uint16_t avail_idx_shadow;
-    uint16_t last_used_idx;
-} virtq_state_t;
-
 // Device state
-static uint16_t io_base = 0;
+static virtio_device_t vnet;
 static net_interface_t* virtio_iface = NULL;
 
-static virtq_state_t rxq;
-static virtq_state_t txq;
+static virtq_t rxq;
+static virtq_t txq;
 
 static uint8_t rx_queue_mem[VIRTIO_QUEUE_MAX_MEM] __attribute__((aligned(VIRTIO_QUEUE_ALIGN)));
 static uint8_t tx_queue_mem[VIRTIO_QUEUE_MAX_MEM] __attribute__((aligned(VIRTIO_QUEUE_ALIGN)));
@@ -131,103 +74,41 @@ static uint8_t rx_buffer_pool[VIRTIO_NET_RX_DESC_TARGET][sizeof(virtio_net_hdr_t
 
 static uint8_t tx_buffer[sizeof(virtio_net_hdr_t) + VIRTIO_NET_TX_BUFFER_SIZE] __attribute__((aligned(16)));
 static volatile int tx_inflight = 0;
+static net_packet_t* tx_held = NULL;    // Frame the device is reading in place
+
+static net_napi_t vnet_napi;
 
 // Statistics
 static uint32_t tx_packets = 0;
 static uint32_t rx_packets = 0;
 
-static inline uint32_t align_up_u32(uint32_t value, uint32_t alignment) {
-    return (value + alignment - 1U) & ~(alignment - 1U);
-}
-
-static inline uintptr_t virtio_dma_addr(const void* ptr) {
-    /* Kernel and early-heap allocations are identity-mapped in current boot flow. */
-    return (uintptr_t)ptr;
-}
-
-static inline uint8_t virtio_read_status(void) {
-    return inb(io_base + VIRTIO_PCI_REG_DEVICE_STATUS);
-}
-
-static inline void virtio_write_status(uint8_t status) {
-    outb(io_base + VIRTIO_PCI_REG_DEVICE_STATUS, status);
-}
-
-static uint32_t virtq_required_bytes(uint16_t qsize) {
-    uint32_t desc_bytes = (uint32_t)sizeof(virtq_desc_t) * qsize;
-    uint32_t avail_bytes = (uint32_t)sizeof(uint16_t) * (uint32_t)(3 + qsize);
-    uint32_t used_offset = align_up_u32(desc_bytes + avail_bytes, VIRTIO_QUEUE_ALIGN);
-    uint32_t used_bytes = (uint32_t)sizeof(uint16_t) * 3U + (uint32_t)sizeof(virtq_used_elem_t) * qsize;
-    return used_offset + used_bytes;
-}
-
-static int virtq_setup(uint16_t queue_index, virtq_state_t* q, uint8_t* queue_mem, uint32_t queue_mem_size) {
-    if (!q || !queue_mem) {
-        return -1;
-    }
-
-    outw(io_base + VIRTIO_PCI_REG_QUEUE_SELECT, queue_index);
-    uint16_t qsize = inw(io_base + VIRTIO_PCI_REG_QUEUE_SIZE);
-    if (qsize == 0 || qsize > VIRTIO_QUEUE_MAX_ENTRIES) {
-        return -1;
-    }
-
-    uint32_t needed = virtq_required_bytes(qsize);
-    if (needed > queue_mem_size) {
-        return -1;
-    }
-
-    memset(queue_mem, 0, queue_mem_size);
-
-    uint32_t desc_bytes = (uint32_t)sizeof(virtq_desc_t) * qsize;
-    uint32_t avail_bytes = (uint32_t)sizeof(uint16_t) * (uint32_t)(3 + qsize);
-    uint32_t used_offset = align_up_u32(desc_bytes + avail_bytes, VIRTIO_QUEUE_ALIGN);
-
-    q->size = qsize;
-    q->mem = queue_mem;
-    q->desc = (virtq_desc_t*)(void*)queue_mem;
-    q->avail = (virtq_avail_t*)(void*)(queue_mem + desc_bytes);
-    q->used = (virtq_used_t*)(void*)(queue_mem + used_offset);
-    q->avail_idx_shadow = 0;
-    q->last_used_idx = 0;
-
-    uintptr_t q_phys = virtio_dma_addr(queue_mem);
-    if ((q_phys & (VIRTIO_QUEUE_ALIGN - 1U)) != 0) {
-        return -1;
-    }
-    uint32_t q_pfn = (uint32_t)(q_phys >> 12);
-    outl(io_base + VIRTIO_PCI_REG_QUEUE_ADDRESS, q_pfn);
-
-    return 0;
-}
-
 static void virtio_tx_reclaim(void) {
-    while (txq.last_used_idx != txq.used->idx) {
-        uint16_t ring_idx = (uint16_t)(txq.last_used_idx % txq.size);
-        virtq_used_elem_t* elem = &txq.used->ring[ring_idx];
-        if (elem->id == 0) {
+    uint32_t id;
+    while (virtq_pop_used(&txq, &id, NULL)) {
+        if (id == 0) {
             tx_inflight = 0;
             tx_packets++;
+            if (tx_held) {
+                net_packet_free(tx_held);
+                tx_held = NULL;
+            }
         }
-        txq.last_used_idx++;
     }
 }
 
-static void virtio_rx_process(void) {
+static int virtio_rx_process(int budget) {
     uint16_t recycled = 0;
+    int done = 0;
 
-    while (rxq.last_used_idx != rxq.used->idx) {
-        uint16_t used_ring_idx = (uint16_t)(rxq.last_used_idx % rxq.size);
-        virtq_used_elem_t* elem = &rxq.used->ring[used_ring_idx];
-        uint32_t id = elem->id;
-        uint32_t total_len = elem->len;
-
+    uint32_t id;
+    uint32_t total_len;
+    while (done < budget && virtq_pop_used(&rxq, &id, &total_len)) {
+        done++;
         if (id < rxq.size && rx_buffers[id]) {
             if (total_len > sizeof(virtio_net_hdr_t) && total_len <= rx_buffer_size && virtio_iface) {
                 net_packet_t packet;
-                packet.data = rx_buffers[id] + sizeof(virtio_net_hdr_t);
-                packet.len = total_len - sizeof(virtio_net_hdr_t);
-                packet.capacity = VIRTIO_NET_RX_BUFFER_SIZE;
+                net_packet_wrap(&packet, rx_buffers[id] + sizeof(virtio_net_hdr_t),
+                                total_len - sizeof(virtio_net_hdr_t), VIRTIO_NET_RX_BUFFER_SIZE);
 
                 eth_receive(virtio_iface, &packet);
                 rx_packets++;
@@ -238,22 +119,19 @@ static void virtio_rx_process(void) {
             rxq.desc[id].flags = VIRTQ_DESC_F_WRITE;
             rxq.desc[id].next = 0;
 
-            uint16_t avail_slot = (uint16_t)(rxq.avail_idx_shadow % rxq.size);
-            rxq.avail->ring[avail_slot] = (uint16_t)id;
-            rxq.avail_idx_shadow++;
+            virtq_push_avail(&rxq, (uint16_t)id);
             recycled++;
         }
-
-        rxq.last_used_idx++;
     }
 
     if (recycled) {
-        __asm__ __volatile__("" ::: "memory");
-        rxq.avail->idx = rxq.avail_idx_shadow;
-        outw(io_base + VIRTIO_PCI_REG_QUEUE_NOTIFY, VIRTIO_NET_QUEUE_RX);
+        virtq_kick(&vnet, &rxq);
     }
+    return done;
 }
 
+static int virtio_tx_submit(net_packet_t* packet, const uint8_t* data, uint32_t len);
+
 static int virtio_iface_transmit(net_interface_t* iface, net_packet_t* packet) {
     (void)iface;
 
@@ -261,7 +139,7 @@ static int virtio_iface_transmit(net_interface_t* iface, net_packet_t* packet) {
         return -1;
     }
 
-    return virtio_net_transmit(packet->data, packet->len);
+    return virtio_tx_submit(packet, packet->data, packet->len);
 }
 
 static int virtio_iface_receive(net_interface_t* iface, net_packet_t* packet) {
@@ -270,18 +148,8 @@ static int virtio_iface_receive(net_interface_t* iface, net_packet_t* packet) {
     return 0;
 }
 
-static pci_device_t* virtio_find_device(void) {
-    pci_device_t* dev = pci_find_device(VIRTIO_PCI_VENDOR_ID, VIRTIO_PCI_DEVICE_ID_NET_LEGACY);
-    if (dev) {
-        return dev;
-    }
-
-    dev = pci_find_device(VIRTIO_PCI_VENDOR_ID, VIRTIO_PCI_DEVICE_ID_NET_MODERN);
-    return dev;
-}
-
-int virtio_net_transmit(const uint8_t* data, uint32_t len) {
-    if (!io_base || !data || len == 0 || len > VIRTIO_NET_TX_BUFFER_SIZE) {
+static int virtio_tx_submit(net_packet_t* packet, const uint8_t* data, uint32_t len) {
+    if (!vnet.io_base || !data || len == 0 || len > VIRTIO_NET_TX_BUFFER_SIZE) {
         return -1;
     }
 
@@ -299,23 +167,27 @@ int virtio_net_transmit(const uint8_t* data, uint32_t len) {
         }
     }
 
-    memset(tx_buffer, 0, sizeof(virtio_net_hdr_t));
-    memcpy(tx_buffer + sizeof(virtio_net_hdr_t), data, len);
-
-    txq.desc[0].addr = (uint64_t)virtio_dma_addr(tx_buffer);
-    txq.desc[0].len = (uint32_t)(sizeof(virtio_net_hdr_t) + len);
+    if (packet && (packet->flags & NET_PACKET_F_POOL) &&
+        net_packet_headroom(packet) >= sizeof(virtio_net_hdr_t)) {
+        // Put the virtio-net header in the headroom and send the frame in place
+        uint8_t* hdr = net_packet_push(packet, sizeof(virtio_net_hdr_t));
+        memset(hdr, 0, sizeof(virtio_net_hdr_t));
+        txq.desc[0].addr = (uint64_t)virtio_dma_addr(hdr);
+        txq.desc[0].len = packet->len;
+        net_packet_pull(packet, sizeof(virtio_net_hdr_t));
+        tx_held = net_packet_get(packet);
+    } else {
+        memset(tx_buffer, 0, sizeof(virtio_net_hdr_t));
+        memcpy(tx_buffer + sizeof(virtio_net_hdr_t), data, len);
+        txq.desc[0].addr = (uint64_t)virtio_dma_addr(tx_buffer);
+        txq.desc[0].len = (uint32_t)(sizeof(virtio_net_hdr_t) + len);
+    }
     txq.desc[0].flags = 0;
     txq.desc[0].next = 0;
 
-    uint16_t avail_slot = (uint16_t)(txq.avail_idx_shadow % txq.size);
-    txq.avail->ring[avail_slot] = 0;
-    txq.avail_idx_shadow++;
-
-    __asm__ __volatile__("" ::: "memory");
-    txq.avail->idx = txq.avail_idx_shadow;
+    virtq_push_avail(&txq, 0);
     tx_inflight = 1;
-
-    outw(io_base + VIRTIO_PCI_REG_QUEUE_NOTIFY, VIRTIO_NET_QUEUE_TX);
+    virtq_kick(&vnet, &txq);
 
     int timeout = 100000;
     while (tx_inflight && timeout-- > 0) {
@@ -331,16 +203,33 @@ int virtio_net_transmit(const uint8_t* data, uint32_t len) {
     return 0;
 }
 
-void virtio_net_handle_interrupt(void) {
-    if (!io_base) {
-        return;
+int virtio_net_transmit(const uint8_t* data, uint32_t len) {
+    return virtio_tx_submit(NULL, data, len);
+}
+
+static void virtio_net_irq_handler(void* ctx) {
+    (void)ctx;
+
+    // Reading ISR acknowledges the level-triggered INTx line
+    uint8_t isr = virtio_read_isr(&vnet);
+    if (!(isr & VIRTIO_ISR_QUEUE)) {
+        return;  // Config change, or another device on a shared line
     }
+    vnet_napi.interrupts++;
+    virtq_disable_interrupts(&rxq);
+    net_napi_schedule(&vnet_napi);
+}
 
-    // Reading ISR acknowledges pending interrupts in legacy interface.
-    (void)inb(io_base + VIRTIO_PCI_REG_ISR_STATUS);
+static int virtio_net_poll(net_napi_t* napi, int budget) {
+    (void)napi;
+    return virtio_rx_process(budget);
+}
 
-    virtio_tx_reclaim();
-    virtio_rx_process();
+static int virtio_net_irq_enable(net_napi_t* napi) {
+    if (!napi->irq) {
+        return 0;  // Nobody would acknowledge the line; stay polled
+    }
+    return virtq_enable_interrupts(&rxq);
 }
 
 int virtio_net_init(void) {
@@ -351,56 +240,41 @@ int virtio_net_init(void) {
         return 0;
     }
 
-    pci_device_t* dev = virtio_find_device();
+    pci_device_t* dev = virtio_pci_find(VIRTIO_PCI_DEVICE_ID_NET_LEGACY,
+                                        VIRTIO_PCI_DEVICE_ID_NET_MODERN);
     if (!dev) {
         serial_puts("virtio-net: Device not found\n");
         return -1;
     }
 
-    uint16_t command = pci_read_config_word(dev->bus, dev->device, dev->function, PCI_COMMAND);
-    command |= PCI_COMMAND_IO | PCI_COMMAND_MASTER;
-    pci_write_config_word(dev->bus, dev->device, dev->function, PCI_COMMAND, command);
-
-    uint32_t bar0 = dev->bar[0];
-    if ((bar0 & 0x1U) == 0) {
+    if (virtio_open(&vnet, dev) != 0) {
         serial_puts("virtio-net: BAR0 is MMIO-only (legacy I/O mode expected)\n");
         return -1;
     }
 
-    io_base = (uint16_t)(bar0 & 0xFFFC);
-
     serial_puts("virtio-net: I/O base at 0x");
     char io_hex[16];
-    itoa(io_base, io_hex, 16);
+    itoa(vnet.io_base, io_hex, 16);
     serial_puts(io_hex);
     serial_puts("\n");
 
-    virtio_write_status(0);
-    virtio_write_status(VIRTIO_STATUS_ACKNOWLEDGE);
-    virtio_write_status(VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
-
-    uint32_t host_features = inl(io_base + VIRTIO_PCI_REG_DEVICE_FEATURES);
-    uint32_t guest_features = 0;
-    if (host_features & (1U << VIRTIO_NET_F_MAC)) {
-        guest_features |= (1U << VIRTIO_NET_F_MAC);
-    }
-    outl(io_base + VIRTIO_PCI_REG_GUEST_FEATURES, guest_features);
+    uint32_t guest_features = virtio_negotiate(&vnet, 1U << VIRTIO_NET_F_MAC);
 
-    if (virtq_setup(VIRTIO_NET_QUEUE_RX, &rxq, rx_queue_mem, sizeof(rx_queue_mem)) != 0) {
+    if (virtq_setup(&vnet, VIRTIO_NET_QUEUE_RX, &rxq, rx_queue_mem, sizeof(rx_queue_mem)) != 0) {
         serial_puts("virtio-net: Failed to setup RX queue\n");
-        virtio_write_status(virtio_read_status() | VIRTIO_STATUS_FAILED);
+        virtio_fail(&vnet);
         return -1;
     }
 
-    if (virtq_setup(VIRTIO_NET_QUEUE_TX, &txq, tx_queue_mem, sizeof(tx_queue_mem)) != 0) {
+    if (virtq_setup(&vnet, VIRTIO_NET_QUEUE_TX, &txq, tx_queue_mem, sizeof(tx_queue_mem)) != 0) {
         serial_puts("virtio-net: Failed to setup TX queue\n");
-        virtio_write_status(virtio_read_status() | VIRTIO_STATUS_FAILED);
+        virtio_fail(&vnet);
         return -1;
     }
 
     if (txq.size == 0 || rxq.size == 0) {
         serial_puts("virtio-net: Invalid queue sizes\n");
-        virtio_write_status(virtio_read_status() | VIRTIO_STATUS_FAILED);
+        virtio_fail(&vnet);
         return -1;
     }
 
@@ -426,8 +300,7 @@ int virtio_net_init(void) {
     }
 
     rxq.avail_idx_shadow = rx_desc_count;
-    rxq.avail->idx = rxq.avail_idx_shadow;
-    outw(io_base + VIRTIO_PCI_REG_QUEUE_NOTIFY, VIRTIO_NET_QUEUE_RX);
+    virtq_kick(&vnet, &rxq);
 
     txq.desc[0].addr = (uint64_t)virtio_dma_addr(tx_buffer);
     txq.desc[0].len = 0;
@@ -435,8 +308,23 @@ int virtio_net_init(void) {
     txq.desc[0].next = 0;
     txq.avail_idx_shadow = 0;
     tx_inflight = 0;
+    virtq_disable_interrupts(&txq);
+
+    memset(&vnet_napi, 0, sizeof(vnet_napi));
+    vnet_napi.name = "virtio-net";
+    vnet_napi.poll = virtio_net_poll;
+    vnet_napi.irq_enable = virtio_net_irq_enable;
+    net_napi_add(&vnet_napi);
+
+    int irq_line = pci_irq_attach(dev, virtio_net_irq_handler, NULL);
+    if (irq_line > 0) {
+        vnet_napi.irq = (uint32_t)irq_line;
+    } else {
+        virtq_disable_interrupts(&rxq);
+        serial_puts("virtio-net: No usable IRQ line, polling for packets\n");
+    }
 
-    virtio_write_status(virtio_read_status() | VIRTIO_STATUS_DRIVER_OK);
+    virtio_driver_ok(&vnet);
 
     char ifname[16] = "eth2";
     if (!net_interface_get("eth0")) {
@@ -448,13 +336,13 @@ int virtio_net_init(void) {
     virtio_iface = net_interface_register(ifname);
     if (!virtio_iface) {
         serial_puts("virtio-net: Failed to register interface\n");
-        virtio_write_status(virtio_read_status() | VIRTIO_STATUS_FAILED);
+        virtio_fail(&vnet);
         return -1;
     }
 
     if (guest_features & (1U << VIRTIO_NET_F_MAC)) {
         for (int i = 0; i < MAC_ADDR_LEN; i++) {
-            virtio_iface->mac_addr.addr[i] = inb(io_base + VIRTIO_PCI_REG_DEVICE_CONFIG + i);
+            virtio_iface->mac_addr.addr[i] = virtio_config_read8(&vnet, (uint32_t)i);
         }
     } else {
         virtio_iface->mac_addr.addr[0] = 0x02;
@@ -0,0 +1,606 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * src/fs/bcache.c
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+/*
+ * DEVELOPER_NOTE_BLOCK
+ * Module Overview:
+ * - This file is part of the aOS production kernel/userspace codebase.
+ * - Review public symbols in this unit to understand contracts with adjacent modules.
+ * - Keep behavior-focused comments near non-obvious invariants, state transitions, and safety checks.
+ * - Avoid changing ABI/data-layout assumptions without updating dependent modules.
+ */
+
+
+#include <fs/bcache.h>
+#include <dev/blkdev.h>
+#include <process.h>
+#include <ktime.h>
+#include <serial.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define BCACHE_VALID        0x01    // Data matches (or supersedes) the disk
+#define BCACHE_DIRTY        0x02    // Must be written back before reuse
+#define BCACHE_BUSY         0x04    // Owned by one caller; I/O may be in flight
+#define BCACHE_REFERENCED   0x08    // CLOCK second-chance bit
+
+#define BCACHE_NO_BUF       (-1)
+
+typedef struct bcache_buf {
+    uint32_t dev;
+    uint32_t lba;
+    uint32_t flags;
+    uint32_t dirty_since;   // ktime_get_ms() when first dirtied
+    int16_t hash_next;
+} bcache_buf_t;
+
+static uint8_t bcache_data[BCACHE_NUM_BUFFERS][BCACHE_BLOCK_SIZE] __attribute__((aligned(16)));
+static bcache_buf_t bcache_bufs[BCACHE_NUM_BUFFERS];
+static int16_t bcache_hash[BCACHE_HASH_SIZE];
+static blk_bio_t bcache_bios[BCACHE_NUM_BUFFERS];    // Writeback I/O, one per buffer
+static uint32_t bcache_clock_hand = 0;
+static bcache_stats_t bcache_stats;
+static int bcache_initialized = 0;
+static pid_t bcache_flush_pid = -1;
+
+/*
+ * Cache metadata is protected by disabling preemption: the kernel lock
+ * already keeps other CPUs out, so only a task switch on this CPU can
+ * interleave. Device I/O runs unlocked on a BUSY buffer so a sleeping
+ * driver does not stall the rest of the cache.
+ */
+static void bcache_lock(void) {
+    process_set_preempt_disabled(1);
+}
+
+static void bcache_unlock(void) {
+    process_set_preempt_disabled(0);
+}
+
+static uint32_t bcache_hash_index(uint32_t dev, uint32_t lba) {
+    return ((lba ^ (dev << 24)) * 2654435761u) >> (32 - BCACHE_HASH_BITS);
+}
+
+static int bcache_lookup_locked(uint32_t dev, uint32_t lba) {
+    int idx = bcache_hash[bcache_hash_index(dev, lba)];
+    while (idx != BCACHE_NO_BUF) {
+        bcache_buf_t* buf = &bcache_bufs[idx];
+        if (buf->dev == dev && buf->lba == lba) {
+            return idx;
+        }
+        idx = buf->hash_next;
+    }
+    return BCACHE_NO_BUF;
+}
+
+static void bcache_hash_insert_locked(int idx) {
+    uint32_t slot = bcache_hash_index(bcache_bufs[idx].dev, bcache_bufs[idx].lba);
+    bcache_bufs[idx].hash_next = bcache_hash[slot];
+    bcache_hash[slot] = (int16_t)idx;
+}
+
+static void bcache_hash_remove_locked(int idx) {
+    uint32_t slot = bcache_hash_index(bcache_bufs[idx].dev, bcache_bufs[idx].lba);
+    int16_t* link = &bcache_hash[slot];
+    while (*link != BCACHE_NO_BUF) {
+        if (*link == idx) {
+            *link = bcache_bufs[idx].hash_next;
+            bcache_bufs[idx].hash_next = BCACHE_NO_BUF;
+            return;
+        }
+        link = &bcache_bufs[*link].hash_next;
+    }
+}
+
+static void bcache_clear_dirty_locked(bcache_buf_t* buf) {
+    if (buf->flags & BCACHE_DIRTY) {
+        buf->flags &= ~BCACHE_DIRTY;
+        bcache_stats.dirty--;
+    }
+}
+
+static int bcache_select_victim_locked(void) {
+    /*
+     * CLOCK: sweep at most twice so every referenced buffer gets its second
+     * chance. Clean buffers are preferred; a dirty victim is returned only
+     * when nothing clean is free and the caller must write it back first.
+     */
+    int dirty_victim = BCACHE_NO_BUF;
+
+    for (uint32_t scanned = 0; scanned < 2 * BCACHE_NUM_BUFFERS; scanned++) {
+        int idx = (int)bcache_clock_hand;
+        bcache_buf_t* buf = &bcache_bufs[idx];
+        bcache_clock_hand = (bcache_clock_hand + 1) % BCACHE_NUM_BUFFERS;
+
+        if (buf->flags & BCACHE_BUSY) {
+            continue;
+        }
+        if (buf->flags & BCACHE_REFERENCED) {
+            buf->flags &= ~BCACHE_REFERENCED;
+            continue;
+        }
+        if (buf->flags & BCACHE_DIRTY) {
+            if (dirty_victim == BCACHE_NO_BUF) {
+                dirty_victim = idx;
+            }
+            continue;
+        }
+        return idx;
+    }
+
+    return dirty_victim;
+}
+
+static int bcache_write_out(int idx) {
+    /* Write a BUSY buffer to its device; clears DIRTY on success. */
+    bcache_buf_t* buf = &bcache_bufs[idx];
+    int result = blk_write(buf->dev, buf->lba, 1, bcache_data[idx]);
+
+    bcache_lock();
+    if (result == 0) {
+        bcache_clear_dirty_locked(buf);
+        bcache_stats.writebacks++;
+    } else {
+        bcache_stats.write_errors++;
+    }
+    bcache_unlock();
+    return result;
+}
+
+static void bcache_release(int idx) {
+    bcache_lock();
+    bcache_bufs[idx].flags &= ~BCACHE_BUSY;
+    bcache_unlock();
+}
+
+static int bcache_get(uint32_t dev, uint32_t lba) {
+    /*
+     * Return the BUSY buffer for (dev, lba), recycling a victim on a miss.
+     * The buffer is not VALID after a miss; the caller fills it.
+     */
+    for (;;) {
+        bcache_lock();
+
+        int idx = bcache_lookup_locked(dev, lba);
+        if (idx != BCACHE_NO_BUF) {
+            bcache_buf_t* buf = &bcache_bufs[idx];
+            if (buf->flags & BCACHE_BUSY) {
+                bcache_unlock();
+                process_yield();
+                continue;
+            }
+            buf->flags |= BCACHE_BUSY | BCACHE_REFERENCED;
+            if (buf->flags & BCACHE_VALID) {
+                bcache_stats.hits++;
+            }
+            bcache_unlock();
+            return idx;
+        }
+
+        idx = bcache_select_victim_locked();
+        if (idx == BCACHE_NO_BUF) {
+            // Every buffer is in use by another task
+            bcache_unlock();
+            process_yield();
+            continue;
+        }
+
+        bcache_buf_t* victim = &bcache_bufs[idx];
+        if (victim->flags & BCACHE_DIRTY) {
+            victim->flags |= BCACHE_BUSY;
+            bcache_unlock();
+            bcache_write_out(idx);
+            bcache_release(idx);
+            continue;   // Lookup again: the block may have been cached meanwhile
+        }
+
+        if (victim->flags & BCACHE_VALID) {
+            bcache_hash_remove_locked(idx);
+            bcache_stats.valid--;
+            bcache_stats.evictions++;
+        }
+        victim->dev = dev;
+        victim->lba = lba;
+        victim->flags = BCACHE_BUSY | BCACHE_REFERENCED;
+        victim->dirty_since = 0;
+        bcache_hash_insert_locked(idx);
+        bcache_stats.misses++;
+        bcache_unlock();
+        return idx;
+    }
+}
+
+static void bcache_discard(int idx) {
+    /* Forget a BUSY buffer whose contents could not be read. */
+    bcache_lock();
+    bcache_hash_remove_locked(idx);
+    bcache_bufs[idx].flags = 0;
+    bcache_unlock();
+}
+
+static int bcache_device_valid(uint32_t dev) {
+    return blk_get_device(dev) != NULL;
+}
+
+int bcache_read(uint32_t dev, uint32_t lba, void* buffer) {
+    if (!buffer || !bcache_device_valid(dev)) {
+        return -1;
+    }
+
+    int idx = bcache_get(dev, lba);
+    bcache_buf_t* buf = &bcache_bufs[idx];
+
+    if (!(buf->flags & BCACHE_VALID)) {
+        if (blk_read(dev, lba, 1, bcache_data[idx]) != 0) {
+            bcache_discard(idx);
+            bcache_lock();
+            bcache_stats.read_errors++;
+            bcache_unlock();
+            return -1;
+        }
+        bcache_lock();
+        buf->flags |= BCACHE_VALID;
+        bcache_stats.valid++;
+        bcache_unlock();
+    }
+
+    memcpy(buffer, bcache_data[idx], BCACHE_BLOCK_SIZE);
+    bcache_release(idx);
+    return 0;
+}
+
+int bcache_write(uint32_t dev, uint32_t lba, const void* buffer) {
+    if (!buffer || !bcache_device_valid(dev)) {
+        return -1;
+    }
+
+    // Whole-block writes never need the old contents
+    int idx = bcache_get(dev, lba);
+    bcache_buf_t* buf = &bcache_bufs[idx];
+    memcpy(bcache_data[idx], buffer, BCACHE_BLOCK_SIZE);
+
+    bcache_lock();
+    if (!(buf->flags & BCACHE_VALID)) {
+        buf->flags |= BCACHE_VALID;
+        bcache_stats.valid++;
+    }
+    if (!(buf->flags & BCACHE_DIRTY)) {
+        buf->flags |= BCACHE_DIRTY;
+        buf->dirty_since = ktime_get_ms();
+        bcache_stats.dirty++;
+    }
+    buf->flags &= ~BCACHE_BUSY;
+    bcache_unlock();
+    return 0;
+}
+
+static int bcache_cached_locked(uint32_t dev, uint32_t lba) {
+    int idx = bcache_lookup_locked(dev, lba);
+    return idx != BCACHE_NO_BUF && (bcache_bufs[idx].flags & (BCACHE_VALID | BCACHE_BUSY));
+}
+
+static uint32_t bcache_uncached_run(uint32_t dev, uint32_t lba, uint32_t count) {
+    /* Length of the run of blocks from lba that have no cached copy. */
+    uint32_t run = 0;
+    bcache_lock();
+    while (run < count && run < BCACHE_MAX_IO_BLOCKS && !bcache_cached_locked(dev, lba + run)) {
+        run++;
+    }
+    bcache_unlock();
+    return run;
+}
+
+static void bcache_merge_block(uint32_t dev, uint32_t lba, uint8_t* data, int fill) {
+    /*
+     * Reconcile a block just read from the device with the cache: a cached
+     * copy (possibly dirtied while the device was busy) supersedes the disk
+     * data; otherwise the block is inserted when fill is set.
+     */
+    if (!fill) {
+        bcache_lock();
+        int cached = bcache_cached_locked(dev, lba);
+        bcache_unlock();
+        if (!cached) {
+            return;
+        }
+    }
+
+    int idx = bcache_get(dev, lba);
+    bcache_buf_t* buf = &bcache_bufs[idx];
+    if (buf->flags & BCACHE_VALID) {
+        memcpy(data, bcache_data[idx], BCACHE_BLOCK_SIZE);
+    } else {
+        memcpy(bcache_data[idx], data, BCACHE_BLOCK_SIZE);
+        bcache_lock();
+        buf->flags |= BCACHE_VALID;
+        bcache_stats.valid++;
+        bcache_unlock();
+    }
+    bcache_release(idx);
+}
+
+int bcache_read_blocks(uint32_t dev, uint32_t lba, uint32_t count, void* buffer) {
+    /*
+     * Blocks already in the cache are copied from it; each run of uncached
+     * blocks is read straight into the caller's buffer with one device
+     * request. Short runs are then cached; long ones are not, so streaming
+     * reads do not flush out metadata.
+     */
+    if (!buffer || !bcache_device_valid(dev)) {
+        return -1;
+    }
+
+    uint8_t* out = (uint8_t*)buffer;
+    uint32_t done = 0;
+    while (done < count) {
+        uint32_t run = bcache_uncached_run(dev, lba + done, count - done);
+        if (run == 0) {
+            if (bcache_read(dev, lba + done, out + done * BCACHE_BLOCK_SIZE) != 0) {
+                return -1;
+            }
+            done++;
+            continue;
+        }
+
+        if (blk_read(dev, lba + done, run, out + done * BCACHE_BLOCK_SIZE) != 0) {
+            bcache_lock();
+            bcache_stats.read_errors++;
+            bcache_unlock();
+            return -1;
+        }
+
+        int fill = run < BCACHE_STREAM_MIN_BLOCKS;
+        for (uint32_t i = 0; i < run; i++) {
+            bcache_merge_block(dev, lba + done + i, out + (done + i) * BCACHE_BLOCK_SIZE, fill);
+        }
+
+        if (!fill) {
+            bcache_lock();
+            bcache_stats.direct_reads++;
+            bcache_stats.direct_blocks += run;
+            bcache_unlock();
+        }
+        done += run;
+    }
+    return 0;
+}
+
+int bcache_write_blocks(uint32_t dev, uint32_t lba, uint32_t count, const void* buffer) {
+    /*
+     * Short ranges are written back through the cache like bcache_write().
+     * Long ones are written through: cached copies are refreshed and held,
+     * then the whole range goes to the device as one request.
+     */
+    if (!buffer || !bcache_device_valid(dev)) {
+        return -1;
+    }
+
+    const uint8_t* in = (const uint8_t*)buffer;
+    if (count < BCACHE_STREAM_MIN_BLOCKS) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (bcache_write(dev, lba + i, in + i * BCACHE_BLOCK_SIZE) != 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    // Take every cached copy of the range before the device write. A BUSY
+    // buffer is skipped by the flusher, so it cannot put older dirty data
+    // back behind this request; a writeback already in flight finishes
+    // first. The copies take the new data and stay BUSY until it is on disk.
+    uint16_t held[BCACHE_NUM_BUFFERS];
+    uint32_t nheld = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        bcache_lock();
+        int cached = bcache_cached_locked(dev, lba + i);
+        bcache_unlock();
+        if (!cached) {
+            continue;
+        }
+
+        int idx = bcache_get(dev, lba + i);
+        bcache_buf_t* buf = &bcache_bufs[idx];
+        memcpy(bcache_data[idx], in + i * BCACHE_BLOCK_SIZE, BCACHE_BLOCK_SIZE);
+        bcache_lock();
+        if (!(buf->flags & BCACHE_VALID)) {
+            buf->flags |= BCACHE_VALID;
+            bcache_stats.valid++;
+        }
+        bcache_clear_dirty_locked(buf);
+        bcache_unlock();
+        held[nheld++] = (uint16_t)idx;
+    }
+
+    int result = blk_write(dev, lba, count, in);
+
+    bcache_lock();
+    if (result == 0) {
+        bcache_stats.direct_writes++;
+        bcache_stats.direct_blocks += count;
+    } else {
+        bcache_stats.write_errors++;
+    }
+    for (uint32_t i = 0; i < nheld; i++) {
+        bcache_buf_t* buf = &bcache_bufs[held[i]];
+        if (result != 0) {
+            // Neither the old nor the new data is known to be on disk
+            bcache_hash_remove_locked(held[i]);
+            bcache_stats.valid--;
+            buf->flags = 0;
+            continue;
+        }
+        buf->flags &= ~BCACHE_BUSY;
+    }
+    bcache_unlock();
+    return result == 0 ? 0 : -1;
+}
+
+static int bcache_flush_older(uint32_t dev, uint32_t min_age_ms) {
+    /*
+     * Queue every eligible buffer with the block layer while it is plugged,
+     * then wait for all of them: the elevator sorts the burst and merges
+     * neighbouring blocks into multi-sector writes.
+     */
+    int result = 0;
+    uint32_t now = ktime_get_ms();
+    uint16_t batch[BCACHE_NUM_BUFFERS];
+    uint32_t batched = 0;
+    uint32_t devices = blk_device_count();
+
+    for (uint32_t d = 0; d < devices; d++) {
+        blk_plug(d);
+    }
+
+    for (int idx = 0; idx < BCACHE_NUM_BUFFERS; idx++) {
+        bcache_buf_t* buf = &bcache_bufs[idx];
+
+        bcache_lock();
+        if (!(buf->flags & BCACHE_DIRTY) || (buf->flags & BCACHE_BUSY) ||
+            (dev != BCACHE_DEV_ALL && buf->dev != dev) ||
+            (now - buf->dirty_since) < min_age_ms) {
+            bcache_unlock();
+            continue;
+        }
+        buf->flags |= BCACHE_BUSY;
+        bcache_unlock();
+
+        blk_bio_init(&bcache_bios[idx], buf->lba, 1, bcache_data[idx], 1);
+        if (blk_submit_bio(buf->dev, &bcache_bios[idx]) != 0) {
+            bcache_lock();
+            bcache_stats.write_errors++;
+            bcache_unlock();
+            bcache_release(idx);
+            result = -1;
+            continue;
+        }
+        batch[batched++] = (uint16_t)idx;
+    }
+
+    for (uint32_t d = 0; d < devices; d++) {
+        blk_unplug(d);
+    }
+
+    for (uint32_t i = 0; i < batched; i++) {
+        int idx = batch[i];
+        int status = blk_wait_bio(&bcache_bios[idx]);
+
+        bcache_lock();
+        if (status == 0) {
+            bcache_clear_dirty_locked(&bcache_bufs[idx]);
+            bcache_stats.writebacks++;
+        } else {
+            bcache_stats.write_errors++;
+            result = -1;
+        }
+        bcache_bufs[idx].flags &= ~BCACHE_BUSY;
+        bcache_unlock();
+    }
+
+    return result;
+}
+
+int bcache_flush(uint32_t dev) {
+    if (!bcache_initialized) {
+        return 0;
+    }
+    return bcache_flush_older(dev, 0);
+}
+
+int bcache_sync(void) {
+    return bcache_flush(BCACHE_DEV_ALL);
+}
+
+void bcache_invalidate(uint32_t dev, uint32_t lba, uint32_t count) {
+    if (!bcache_initialized) {
+        return;
+    }
+
+    for (int idx = 0; idx < BCACHE_NUM_BUFFERS; idx++) {
+        bcache_buf_t* buf = &bcache_bufs[idx];
+
+        bcache_lock();
+        while ((buf->flags & BCACHE_BUSY) && buf->dev == dev &&
+               buf->lba >= lba && buf->lba - lba < count) {
+            bcache_unlock();
+            process_yield();
+            bcache_lock();
+        }
+        if ((buf->flags & BCACHE_VALID) && buf->dev == dev &&
+            buf->lba >= lba && buf->lba - lba < count) {
+            bcache_hash_remove_locked(idx);
+            bcache_clear_dirty_locked(buf);
+            bcache_stats.valid--;
+            buf->flags = 0;
+        }
+        bcache_unlock();
+    }
+}
+
+void bcache_get_stats(bcache_stats_t* stats) {
+    if (!stats) {
+        return;
+    }
+    bcache_lock();
+    *stats = bcache_stats;
+    bcache_unlock();
+}
+
+static void bcache_flush_thread(void) {
+    for (;;) {
+        process_sleep(BCACHE_WRITEBACK_INTERVAL_MS);
+
+        // Above the high-water mark write everything back so misses find clean victims
+        uint32_t min_age = (bcache_stats.dirty > BCACHE_DIRTY_HIGH_WATER) ? 0 : BCACHE_DIRTY_EXPIRE_MS;
+        if (bcache_stats.dirty != 0) {
+            bcache_flush_older(BCACHE_DEV_ALL, min_age);
+        }
+    }
+}
+
+int bcache_start_writeback(void) {
+    if (!bcache_initialized) {
+        return -1;
+    }
+    if (bcache_flush_pid > 0) {
+        return bcache_flush_pid;
+    }
+
+    pid_t pid = process_create_kernel_thread("bflushd", bcache_flush_thread, PRIORITY_NORMAL);
+    if (pid < 0) {
+        serial_puts("BCACHE: failed to start writeback thread\n");
+        return -1;
+    }
+    bcache_flush_pid = pid;
+    return pid;
+}
+
+void bcache_init(void) {
+    memset(bcache_bufs, 0, sizeof(bcache_bufs));
+    memset(&bcache_stats, 0, sizeof(bcache_stats));
+    for (uint32_t i = 0; i < BCACHE_HASH_SIZE; i++) {
+        bcache_hash[i] = BCACHE_NO_BUF;
+    }
+    for (uint32_t i = 0; i < BCACHE_NUM_BUFFERS; i++) {
+        bcache_bufs[i].hash_next = BCACHE_NO_BUF;
+    }
+    bcache_stats.buffers = BCACHE_NUM_BUFFERS;
+    bcache_clock_hand = 0;
+
+    bcache_initialized = 1;
+
+    char buf[16];
+    serial_puts("BCACHE: ");
+    itoa(BCACHE_NUM_BUFFERS, buf, 10);
+    serial_puts(buf);
+    serial_puts(" buffers of ");
+    itoa(BCACHE_BLOCK_SIZE, buf, 10);
+    serial_puts(buf);
+    serial_puts(" bytes\n");
+}
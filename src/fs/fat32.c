@@ -22,6 +22,8 @@
 #include <fs/fat32.h>
 #include <fs/vfs.h>
 #include <dev/ata.h>
+#include <fs/bcache.h>
+#include <dev/blkdev.h>
 #include <string.h>
 #include <stdlib.h>
 #include <serial.h>
@@ -91,11 +93,13 @@ static vnode_ops_t fat32_vnode_ops = {
 static int fat32_mount(filesystem_t* fs, const char* source, uint32_t flags);
 static int fat32_unmount(filesystem_t* fs);
 static vnode_t* fat32_get_root(filesystem_t* fs);
+static int fat32_fs_sync(filesystem_t* fs);
 
 static filesystem_ops_t fat32_fs_ops = {
     .mount = fat32_mount,
     .unmount = fat32_unmount,
-    .get_root = fat32_get_root
+    .get_root = fat32_get_root,
+    .sync = fat32_fs_sync
 };
 
 static filesystem_t fat32_filesystem = {
@@ -115,7 +119,7 @@ static int read_sector(fat32_data_t* fs_data, uint32_t sector, void* buffer) {
         return -1;
     }
     uint32_t lba = fs_data->start_lba + sector;
-    return ata_read_sectors(lba, 1, (uint8_t*)buffer);
+    return bcache_read(fs_data->dev, lba, buffer);
 }
 
 static int write_sector(fat32_data_t* fs_data, uint32_t sector, const void* buffer) {
@@ -124,7 +128,23 @@ static int write_sector(fat32_data_t* fs_data, uint32_t sector, const void* buff
         return -1;
     }
     uint32_t lba = fs_data->start_lba + sector;
-    return ata_write_sectors(lba, 1, (const uint8_t*)buffer);
+    return bcache_write(fs_data->dev, lba, buffer);
+}
+
+static int read_sectors(fat32_data_t* fs_data, uint32_t sector, uint32_t count, void* buffer) {
+    /* Read a contiguous sector range with as few disk requests as possible. */
+    if (!fs_data || !buffer) {
+        return -1;
+    }
+    return bcache_read_blocks(fs_data->dev, fs_data->start_lba + sector, count, buffer);
+}
+
+static int write_sectors(fat32_data_t* fs_data, uint32_t sector, uint32_t count, const void* buffer) {
+    /* Write a contiguous sector range with as few disk requests as possible. */
+    if (!fs_data || !buffer) {
+        return -1;
+    }
+    return bcache_write_blocks(fs_data->dev, fs_data->start_lba + sector, count, buffer);
 }
 
 static uint32_t cluster_to_sector(fat32_data_t* fs_data, uint32_t cluster) {
@@ -136,39 +156,40 @@ static uint32_t cluster_to_sector(fat32_data_t* fs_data, uint32_t cluster) {
            (cluster - 2) * fs_data->boot_sector.sectors_per_cluster;
 }
 
-static int read_cluster(fat32_data_t* fs_data, uint32_t cluster, void* buffer) {
-    /* Read entire cluster by iterating all constituent sectors. */
-    if (!fs_data || !buffer || cluster < 2) {
+static int read_clusters(fat32_data_t* fs_data, uint32_t cluster, uint32_t count, void* buffer) {
+    /* Read physically contiguous clusters as one multi-sector request. */
+    if (!fs_data || !buffer || cluster < 2 || count == 0 ||
+        cluster - 2 + count > fs_data->total_clusters) {
         return -1;
     }
     
-    uint32_t sector = cluster_to_sector(fs_data, cluster);
-    uint8_t* buf_ptr = (uint8_t*)buffer;
-    
-    for (uint32_t i = 0; i < fs_data->boot_sector.sectors_per_cluster; i++) {
-        if (read_sector(fs_data, sector + i, buf_ptr + (i * FAT32_SECTOR_SIZE)) != 0) {
-            return -1;
-        }
-    }
-    return 0;
+    return read_sectors(fs_data, cluster_to_sector(fs_data, cluster),
+                        count * fs_data->boot_sector.sectors_per_cluster, buffer);
 }
 
-static int write_cluster(fat32_data_t* fs_data, uint32_t cluster, const void* buffer) {
-    /* Write entire cluster by iterating all constituent sectors. */
-    if (!fs_data || !buffer || cluster < 2) {
+static int write_clusters(fat32_data_t* fs_data, uint32_t cluster, uint32_t count, const void* buffer) {
+    /* Write physically contiguous clusters as one multi-sector request. */
+    if (!fs_data || !buffer || cluster < 2 || count == 0 ||
+        cluster - 2 + count > fs_data->total_clusters) {
         return -1;
     }
     
-    uint32_t sector = cluster_to_sector(fs_data, cluster);
-    const uint8_t* buf_ptr = (const uint8_t*)buffer;
-    
-    for (uint32_t i = 0; i < fs_data->boot_sector.sectors_per_cluster; i++) {
-        if (write_sector(fs_data, sector + i, buf_ptr + (i * FAT32_SECTOR_SIZE)) != 0) {
-            return -1;
-        }
-    }
-    
-    return 0;
+    return write_sectors(fs_data, cluster_to_sector(fs_data, cluster),
+                         count * fs_data->boot_sector.sectors_per_cluster, buffer);
+}
+
+static int read_cluster(fat32_data_t* fs_data, uint32_t cluster, void* buffer) {
+    return read_clusters(fs_data, cluster, 1, buffer);
+}
+
+static int write_cluster(fat32_data_t* fs_data, uint32_t cluster, const void* buffer) {
+    return write_clusters(fs_data, cluster, 1, buffer);
+}
+
+static uint32_t max_cluster_run(fat32_data_t* fs_data) {
+    /* Longest cluster run sent as one request (at least one cluster). */
+    uint32_t run = FAT32_MAX_RUN_SECTORS / fs_data->boot_sector.sectors_per_cluster;
+    return run ? run : 1;
 }
 
 static uint32_t get_next_cluster(fat32_data_t* fs_data, uint32_t cluster) {
@@ -181,76 +202,186 @@ static uint32_t get_next_cluster(fat32_data_t* fs_data, uint32_t cluster) {
     return next;
 }
 
+static void set_fat_entry(fat32_data_t* fs_data, uint32_t cluster, uint32_t value) {
+    /* Store a FAT entry, keeping the free bitmap, free count and dirty sectors in step. */
+    uint32_t old = fs_data->fat[cluster] & 0x0FFFFFFF;
+    value &= 0x0FFFFFFF;
+    if (old == value) {
+        return;
+    }
+    
+    // The top four bits are reserved and must be preserved
+    fs_data->fat[cluster] = (fs_data->fat[cluster] & 0xF0000000) | value;
+    
+    uint32_t bit = 1U << (cluster & 31);
+    if (value == FAT32_CLUSTER_FREE) {
+        fs_data->free_map[cluster >> 5] |= bit;
+        if (fs_data->fsinfo.free_clusters != 0xFFFFFFFF) {
+            fs_data->fsinfo.free_clusters++;
+        }
+    } else if (old == FAT32_CLUSTER_FREE) {
+        fs_data->free_map[cluster >> 5] &= ~bit;
+        if (fs_data->fsinfo.free_clusters != 0xFFFFFFFF) {
+            fs_data->fsinfo.free_clusters--;
+        }
+    }
+    
+    uint32_t fat_sector = cluster / FAT32_ENTRIES_PER_SECTOR;
+    fs_data->fat_dirty_map[fat_sector >> 5] |= 1U << (fat_sector & 31);
+    fs_data->fat_cache_dirty = 1;
+}
+
 static int set_next_cluster(fat32_data_t* fs_data, uint32_t cluster, uint32_t next) {
     /* Update FAT chain link and mark in-memory FAT cache dirty for sync. */
     if (!fs_data || !fs_data->fat || cluster < 2 || cluster >= fs_data->total_clusters + 2) {
         return -1;
     }
     
-    fs_data->fat[cluster] = next & 0x0FFFFFFF;
-    fs_data->fat_cache_dirty = 1;
+    // Redirecting a live link invalidates cached extents; appending to EOC does not
+    uint32_t old = fs_data->fat[cluster] & 0x0FFFFFFF;
+    if (old >= 2 && old < FAT32_CLUSTER_RESERVED && old != (next & 0x0FFFFFFF)) {
+        fs_data->chain_gen++;
+    }
+    
+    set_fat_entry(fs_data, cluster, next);
     return 0;
 }
 
-static uint32_t alloc_cluster(fat32_data_t* fs_data) {
+static int cluster_is_free(fat32_data_t* fs_data, uint32_t cluster) {
+    return cluster >= 2 && cluster < fs_data->total_clusters + 2 &&
+           (fs_data->free_map[cluster >> 5] & (1U << (cluster & 31))) != 0;
+}
+
+static uint32_t find_free_cluster(fat32_data_t* fs_data, uint32_t start, uint32_t end) {
+    /* First free cluster in [start, end), skipping fully used bitmap words; 0 if none. */
+    uint32_t cluster = start;
+    while (cluster < end) {
+        uint32_t word = fs_data->free_map[cluster >> 5] >> (cluster & 31);
+        if (word == 0) {
+            cluster = (cluster | 31) + 1;
+            continue;
+        }
+        while (!(word & 1)) {
+            word >>= 1;
+            cluster++;
+        }
+        return cluster < end ? cluster : 0;
+    }
+    return 0;
+}
+
+static uint32_t free_run_length(fat32_data_t* fs_data, uint32_t cluster, uint32_t limit) {
+    uint32_t len = 0;
+    while (len < limit && cluster_is_free(fs_data, cluster + len)) {
+        len++;
+    }
+    return len;
+}
+
+static uint32_t find_free_run(fat32_data_t* fs_data, uint32_t want, uint32_t* run) {
+    /*
+     * First-fit search for `want` contiguous free clusters, starting at the
+     * FSInfo hint and wrapping once. Falls back to the longest shorter run
+     * seen, so a fragmented volume still satisfies the request piecewise.
+     */
+    uint32_t end = fs_data->total_clusters + 2;
+    uint32_t hint = fs_data->fsinfo.next_free_cluster;
+    if (hint < 2 || hint >= end) {
+        hint = 2;
+    }
+    
+    uint32_t best = 0;
+    uint32_t best_len = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        uint32_t cluster = pass ? 2 : hint;
+        uint32_t stop = pass ? hint : end;
+        while ((cluster = find_free_cluster(fs_data, cluster, stop)) != 0) {
+            uint32_t len = free_run_length(fs_data, cluster, want);
+            if (len > best_len) {
+                best = cluster;
+                best_len = len;
+                if (len == want) {
+                    *run = len;
+                    return best;
+                }
+            }
+            cluster += len;
+        }
+    }
+    *run = best_len;
+    return best;
+}
+
+static uint32_t alloc_cluster_run(fat32_data_t* fs_data, uint32_t goal, uint32_t want, uint32_t* count) {
+    /*
+     * Allocate up to `want` contiguous clusters linked as one chain ending in
+     * EOC, trying `goal` first so a growing file stays in one extent. The
+     * caller overwrites all of them; want == 0 asks for one zeroed cluster
+     * instead. Returns the first cluster (0 when the volume is full).
+     */
     if (!fs_data || !fs_data->fat) {
         return 0;
     }
     
-    // Start from hint in FSInfo if available
-    uint32_t start_cluster = (fs_data->fsinfo.next_free_cluster >= 2) ? 
-                             fs_data->fsinfo.next_free_cluster : 2;
+    int zero = (want == 0);
+    if (zero) {
+        want = 1;
+    }
     
-    // Search for free cluster
-    for (uint32_t i = start_cluster; i < fs_data->total_clusters + 2; i++) {
-        if ((fs_data->fat[i] & 0x0FFFFFFF) == FAT32_CLUSTER_FREE) {
-            // Mark as end of chain
-            fs_data->fat[i] = FAT32_CLUSTER_EOC;
-            fs_data->fat_cache_dirty = 1;
-            
-            // Update FSInfo
-            if (fs_data->fsinfo.free_clusters != 0xFFFFFFFF) {
-                fs_data->fsinfo.free_clusters--;
-            }
-            fs_data->fsinfo.next_free_cluster = i + 1;
-            
-            // Zero out the cluster
-            uint8_t* zero_buf = (uint8_t*)kmalloc(fs_data->bytes_per_cluster);
-            if (zero_buf) {
-                memset(zero_buf, 0, fs_data->bytes_per_cluster);
-                write_cluster(fs_data, i, zero_buf);
-                kfree(zero_buf);
-            }
-            
-            return i;
-        }
+    uint32_t first = 0;
+    uint32_t run = 0;
+    if (cluster_is_free(fs_data, goal)) {
+        first = goal;
+        run = free_run_length(fs_data, goal, want);
+    } else {
+        first = find_free_run(fs_data, want, &run);
+    }
+    if (first < 2 || run == 0) {
+        return 0; // No free clusters
     }
     
-    // Wrap around if started from hint
-    if (start_cluster > 2) {
-        for (uint32_t i = 2; i < start_cluster; i++) {
-            if ((fs_data->fat[i] & 0x0FFFFFFF) == FAT32_CLUSTER_FREE) {
-                fs_data->fat[i] = FAT32_CLUSTER_EOC;
-                fs_data->fat_cache_dirty = 1;
-                
-                if (fs_data->fsinfo.free_clusters != 0xFFFFFFFF) {
-                    fs_data->fsinfo.free_clusters--;
-                }
-                fs_data->fsinfo.next_free_cluster = i + 1;
-                
-                uint8_t* zero_buf = (uint8_t*)kmalloc(fs_data->bytes_per_cluster);
-                if (zero_buf) {
-                    memset(zero_buf, 0, fs_data->bytes_per_cluster);
-                    write_cluster(fs_data, i, zero_buf);
-                    kfree(zero_buf);
-                }
-                
-                return i;
-            }
+    for (uint32_t i = 0; i < run; i++) {
+        set_fat_entry(fs_data, first + i, (i + 1 < run) ? first + i + 1 : FAT32_CLUSTER_EOC);
+    }
+    fs_data->fsinfo.next_free_cluster = first + run;
+    
+    if (zero) {
+        uint8_t* zero_buf = (uint8_t*)kmalloc(fs_data->bytes_per_cluster);
+        if (zero_buf) {
+            memset(zero_buf, 0, fs_data->bytes_per_cluster);
+            write_cluster(fs_data, first, zero_buf);
+            kfree(zero_buf);
         }
     }
     
-    return 0; // No free clusters
+    if (count) {
+        *count = run;
+    }
+    return first;
+}
+
+static uint32_t alloc_cluster(fat32_data_t* fs_data) {
+    return alloc_cluster_run(fs_data, 0, 0, NULL);
+}
+
+static uint32_t extend_cluster_chain(fat32_data_t* fs_data, uint32_t cluster, uint32_t want) {
+    /*
+     * Return the cluster after `cluster`, appending to the end of the chain
+     * if needed (0 if full). `want` is how many new clusters the caller will
+     * overwrite in full; they are allocated as one run right behind the tail
+     * when possible, and 0 appends a single zeroed cluster.
+     */
+    uint32_t next = get_next_cluster(fs_data, cluster);
+    if (next < FAT32_CLUSTER_RESERVED) {
+        return next;
+    }
+    
+    uint32_t new_cluster = alloc_cluster_run(fs_data, cluster + 1, want, NULL);
+    if (new_cluster < 2) {
+        return 0;
+    }
+    set_next_cluster(fs_data, cluster, new_cluster);
+    return new_cluster;
 }
 
 static void free_cluster_chain(fat32_data_t* fs_data, uint32_t first_cluster) {
@@ -259,18 +390,182 @@ static void free_cluster_chain(fat32_data_t* fs_data, uint32_t first_cluster) {
     }
     
     uint32_t cluster = first_cluster;
-    while (cluster >= 2 && cluster < FAT32_CLUSTER_RESERVED) {
+    while (cluster >= 2 && cluster < fs_data->total_clusters + 2) {
         uint32_t next = get_next_cluster(fs_data, cluster);
-        fs_data->fat[cluster] = FAT32_CLUSTER_FREE;
+        set_fat_entry(fs_data, cluster, FAT32_CLUSTER_FREE);
+        cluster = next;
+    }
+    
+    // Reuse freed space before moving further up the volume
+    if (first_cluster < fs_data->fsinfo.next_free_cluster) {
+        fs_data->fsinfo.next_free_cluster = first_cluster;
+    }
+    fs_data->chain_gen++;
+}
+
+static uint32_t fat32_active_fat(fat32_data_t* fs_data) {
+    /* With mirroring off, ext_flags bits 0-3 name the one FAT in use. */
+    uint32_t active = 0;
+    if (fs_data->boot_sector.ext_flags & FAT32_EXT_NO_MIRROR) {
+        active = fs_data->boot_sector.ext_flags & FAT32_EXT_ACTIVE_MASK;
+    }
+    return active < fs_data->boot_sector.num_fats ? active : 0;
+}
+
+static int fat32_build_free_map(fat32_data_t* fs_data) {
+    /*
+     * Build the free-cluster bitmap and the FAT-sector dirty map from the
+     * freshly loaded FAT. The free count is recomputed rather than trusted
+     * from FSInfo, which is only advisory.
+     */
+    uint32_t fat_sectors = fs_data->boot_sector.fat_size_32;
+    uint32_t fat_entries = fat_sectors * FAT32_ENTRIES_PER_SECTOR;
+    if (fs_data->total_clusters + 2 > fat_entries) {
+        fs_data->total_clusters = fat_entries - 2;  // The FAT cannot describe more
+    }
+    
+    uint32_t map_bytes = ((fs_data->total_clusters + 2 + 31) / 32) * sizeof(uint32_t);
+    uint32_t dirty_bytes = ((fat_sectors + 31) / 32) * sizeof(uint32_t);
+    fs_data->free_map = (uint32_t*)kmalloc(map_bytes);
+    fs_data->fat_dirty_map = (uint32_t*)kmalloc(dirty_bytes);
+    if (!fs_data->free_map || !fs_data->fat_dirty_map) {
+        if (fs_data->free_map) {
+            kfree(fs_data->free_map);
+        }
+        if (fs_data->fat_dirty_map) {
+            kfree(fs_data->fat_dirty_map);
+        }
+        fs_data->free_map = NULL;
+        fs_data->fat_dirty_map = NULL;
+        return -1;
+    }
+    memset(fs_data->free_map, 0, map_bytes);
+    memset(fs_data->fat_dirty_map, 0, dirty_bytes);
+    
+    uint32_t free_count = 0;
+    for (uint32_t cluster = 2; cluster < fs_data->total_clusters + 2; cluster++) {
+        if ((fs_data->fat[cluster] & 0x0FFFFFFF) == FAT32_CLUSTER_FREE) {
+            fs_data->free_map[cluster >> 5] |= 1U << (cluster & 31);
+            free_count++;
+        }
+    }
+    fs_data->fsinfo.free_clusters = free_count;
+    fs_data->fat_cache_dirty = 0;
+    return 0;
+}
+
+static void fat32_extent_grow(fat32_data_t* fs_data, fat32_extent_t* ext) {
+    /* Absorb the physically contiguous clusters that follow the extent's tail. */
+    for (;;) {
+        uint32_t tail = ext->disk_cluster + ext->count - 1;
+        if (get_next_cluster(fs_data, tail) != tail + 1) {
+            return;
+        }
+        ext->count++;
+    }
+}
+
+static int fat32_map_cluster(fat32_data_t* fs_data, fat32_file_data_t* file_data,
+                             uint32_t file_cluster, uint32_t* cluster, uint32_t* run) {
+    /* Disk cluster holding file cluster `file_cluster`, and how many follow it contiguously. */
+    if (file_data->first_cluster < 2 || file_data->first_cluster >= FAT32_CLUSTER_RESERVED) {
+        return -1;
+    }
+    
+    // Rebuild when stale, or when the window has slid past the wanted cluster
+    if (file_data->extent_gen != fs_data->chain_gen ||
+        (file_data->extent_count > 0 && file_cluster < file_data->extents[0].file_cluster)) {
+        file_data->extent_count = 0;
+        file_data->extent_gen = fs_data->chain_gen;
+    }
+    if (file_data->extent_count == 0) {
+        fat32_extent_t* first = &file_data->extents[0];
+        first->file_cluster = 0;
+        first->disk_cluster = file_data->first_cluster;
+        first->count = 1;
+        fat32_extent_grow(fs_data, first);
+        file_data->extent_count = 1;
+    }
+    
+    for (;;) {
+        fat32_extent_t* last = &file_data->extents[file_data->extent_count - 1];
+        if (file_cluster < last->file_cluster + last->count) {
+            break;
+        }
         
-        if (fs_data->fsinfo.free_clusters != 0xFFFFFFFF) {
-            fs_data->fsinfo.free_clusters++;
+        // The tail link is re-read each time: the chain may have grown since
+        uint32_t tail = last->disk_cluster + last->count - 1;
+        uint32_t next = get_next_cluster(fs_data, tail);
+        if (next < 2 || next >= FAT32_CLUSTER_RESERVED) {
+            return -1;  // Past the end of the chain
+        }
+        if (next == tail + 1) {
+            fat32_extent_grow(fs_data, last);
+            continue;
         }
         
-        cluster = next;
+        if (file_data->extent_count == FAT32_EXTENT_CACHE_SIZE) {
+            // Keep the newer half; sequential access only looks forward
+            uint32_t keep = FAT32_EXTENT_CACHE_SIZE / 2;
+            memmove(&file_data->extents[0], &file_data->extents[FAT32_EXTENT_CACHE_SIZE - keep],
+                    keep * sizeof(fat32_extent_t));
+            file_data->extent_count = keep;
+            last = &file_data->extents[keep - 1];
+        }
+        
+        fat32_extent_t* ext = &file_data->extents[file_data->extent_count++];
+        ext->file_cluster = last->file_cluster + last->count;
+        ext->disk_cluster = next;
+        ext->count = 1;
+        fat32_extent_grow(fs_data, ext);
+    }
+    
+    for (uint32_t i = file_data->extent_count; i-- > 0;) {
+        fat32_extent_t* ext = &file_data->extents[i];
+        if (file_cluster >= ext->file_cluster) {
+            uint32_t delta = file_cluster - ext->file_cluster;
+            *cluster = ext->disk_cluster + delta;
+            if (run) {
+                *run = ext->count - delta;
+            }
+            return 0;
+        }
     }
-    
-    fs_data->fat_cache_dirty = 1;
+    return -1;
+}
+
+static int read_cluster_part(fat32_data_t* fs_data, uint32_t cluster, uint32_t offset,
+                             uint32_t len, uint8_t* dst) {
+    /* Read part of one cluster: whole sectors straight into dst, edges via the cache. */
+    uint32_t sector = cluster_to_sector(fs_data, cluster) + offset / FAT32_SECTOR_SIZE;
+    uint32_t in_sector = offset % FAT32_SECTOR_SIZE;
+    
+    while (len > 0) {
+        uint32_t chunk;
+        if (in_sector == 0 && len >= FAT32_SECTOR_SIZE) {
+            uint32_t count = len / FAT32_SECTOR_SIZE;
+            if (read_sectors(fs_data, sector, count, dst) != 0) {
+                return -1;
+            }
+            chunk = count * FAT32_SECTOR_SIZE;
+            sector += count;
+        } else {
+            uint8_t sector_buf[FAT32_SECTOR_SIZE];
+            if (read_sector(fs_data, sector, sector_buf) != 0) {
+                return -1;
+            }
+            chunk = FAT32_SECTOR_SIZE - in_sector;
+            if (chunk > len) {
+                chunk = len;
+            }
+            memcpy(dst, sector_buf + in_sector, chunk);
+            sector++;
+        }
+        dst += chunk;
+        len -= chunk;
+        in_sector = 0;
+    }
+    return 0;
 }
 
 static void parse_short_name(const uint8_t* short_name, char* out_name) {
@@ -662,6 +957,7 @@ static vnode_t* create_vnode_from_entry(fat32_dir_entry_t* entry,
     // Setup file-specific data
     fat32_file_data_t* file_data = (fat32_file_data_t*)kmalloc(sizeof(fat32_file_data_t));
     if (file_data) {
+        memset(file_data, 0, sizeof(fat32_file_data_t));
         file_data->first_cluster = first_cluster;
         file_data->current_cluster = first_cluster;
         file_data->cluster_offset = 0;
@@ -747,46 +1043,51 @@ static int fat32_vnode_read(vnode_t* node, void* buffer, uint32_t size, uint32_t
     }
     
     uint32_t bytes_read = 0;
-    uint32_t cluster = file_data->first_cluster;
     uint32_t cluster_size = fs_data->bytes_per_cluster;
-    
-    // Skip to the cluster containing offset
-    uint32_t cluster_skip = offset / cluster_size;
-    for (uint32_t i = 0; i < cluster_skip && cluster >= 2; i++) {
-        cluster = get_next_cluster(fs_data, cluster);
-    }
-    
-    if (cluster < 2 || cluster >= FAT32_CLUSTER_RESERVED) {
-        return VFS_ERR_IO;
-    }
-    
+    uint32_t file_cluster = offset / cluster_size;
     uint32_t cluster_offset = offset % cluster_size;
-    uint8_t* cluster_buf = (uint8_t*)kmalloc(cluster_size);
-    if (!cluster_buf) {
-        return VFS_ERR_NOSPACE;
-    }
-    
-    while (bytes_read < size && cluster >= 2 && cluster < FAT32_CLUSTER_RESERVED) {
-        if (read_cluster(fs_data, cluster, cluster_buf) != 0) {
-            kfree(cluster_buf);
-            return VFS_ERR_IO;
+    uint32_t max_run = max_cluster_run(fs_data);
+    
+    while (bytes_read < size) {
+        uint32_t cluster;
+        uint32_t run;
+        if (fat32_map_cluster(fs_data, file_data, file_cluster, &cluster, &run) != 0) {
+            if (bytes_read == 0) {
+                return VFS_ERR_IO;
+            }
+            break;  // Chain shorter than the recorded size
         }
         
-        uint32_t bytes_to_copy = cluster_size - cluster_offset;
-        if (bytes_to_copy > size - bytes_read) {
-            bytes_to_copy = size - bytes_read;
+        uint32_t bytes_to_copy;
+        if (cluster_offset == 0 && size - bytes_read >= cluster_size) {
+            // Whole clusters go straight into the caller's buffer, one request per extent run
+            uint32_t want = (size - bytes_read) / cluster_size;
+            if (run > want) {
+                run = want;
+            }
+            if (run > max_run) {
+                run = max_run;
+            }
+            if (read_clusters(fs_data, cluster, run, (uint8_t*)buffer + bytes_read) != 0) {
+                return VFS_ERR_IO;
+            }
+            bytes_to_copy = run * cluster_size;
+        } else {
+            run = 1;
+            bytes_to_copy = cluster_size - cluster_offset;
+            if (bytes_to_copy > size - bytes_read) {
+                bytes_to_copy = size - bytes_read;
+            }
+            if (read_cluster_part(fs_data, cluster, cluster_offset, bytes_to_copy,
+                                  (uint8_t*)buffer + bytes_read) != 0) {
+                return VFS_ERR_IO;
+            }
         }
-        
-        memcpy((uint8_t*)buffer + bytes_read, cluster_buf + cluster_offset, bytes_to_copy);
         bytes_read += bytes_to_copy;
+        file_cluster += run;
         cluster_offset = 0;
-        
-        if (bytes_read < size) {
-            cluster = get_next_cluster(fs_data, cluster);
-        }
     }
     
-    kfree(cluster_buf);
     return (int)bytes_read;
 }
 
@@ -806,9 +1107,10 @@ static int fat32_vnode_write(vnode_t* node, const void* buffer, uint32_t size, u
     uint32_t cluster = file_data->first_cluster;
     uint32_t cluster_size = fs_data->bytes_per_cluster;
     
-    // Handle write to new file (no clusters allocated yet)
+    // Handle write to new file (no clusters allocated yet); a write from the
+    // start allocates its whole clusters as one run
     if (cluster < 2) {
-        cluster = alloc_cluster(fs_data);
+        cluster = alloc_cluster_run(fs_data, 0, (offset == 0) ? size / cluster_size : 0, NULL);
         if (cluster < 2) {
             return VFS_ERR_NOSPACE;
         }
@@ -816,21 +1118,20 @@ static int fat32_vnode_write(vnode_t* node, const void* buffer, uint32_t size, u
         file_data->current_cluster = cluster;
     }
     
-    // Skip to the cluster containing offset
+    // Find the cluster containing offset through the extent cache; past the
+    // end of the chain, extend it from its last cluster
     uint32_t cluster_skip = offset / cluster_size;
-    for (uint32_t i = 0; i < cluster_skip; i++) {
-        uint32_t next = get_next_cluster(fs_data, cluster);
-        
-        if (next >= FAT32_CLUSTER_RESERVED) {
-            // Need to allocate new cluster
-            uint32_t new_cluster = alloc_cluster(fs_data);
-            if (new_cluster < 2) {
+    if (fat32_map_cluster(fs_data, file_data, cluster_skip, &cluster, NULL) != 0) {
+        if (file_data->extent_count == 0) {
+            return VFS_ERR_IO;
+        }
+        fat32_extent_t* last = &file_data->extents[file_data->extent_count - 1];
+        cluster = last->disk_cluster + last->count - 1;
+        for (uint32_t i = last->file_cluster + last->count - 1; i < cluster_skip; i++) {
+            cluster = extend_cluster_chain(fs_data, cluster, 0);
+            if (cluster < 2) {
                 return VFS_ERR_NOSPACE;
             }
-            set_next_cluster(fs_data, cluster, new_cluster);
-            cluster = new_cluster;
-        } else {
-            cluster = next;
         }
     }
     
@@ -840,49 +1141,59 @@ static int fat32_vnode_write(vnode_t* node, const void* buffer, uint32_t size, u
         return VFS_ERR_NOSPACE;
     }
     
+    uint32_t max_run = max_cluster_run(fs_data);
     while (bytes_written < size) {
-        // Read existing cluster data (for partial writes)
-        if (cluster_offset != 0 || size - bytes_written < cluster_size) {
+        uint32_t run = 1;
+        uint32_t bytes_to_copy;
+        
+        if (cluster_offset == 0 && size - bytes_written >= cluster_size) {
+            // Whole clusters: extend the chain while it stays contiguous and write it in one request
+            uint32_t whole = (size - bytes_written) / cluster_size;
+            while (run < max_run && run < whole &&
+                   extend_cluster_chain(fs_data, cluster + run - 1, whole - run) == cluster + run) {
+                run++;
+            }
+            if (write_clusters(fs_data, cluster, run, (const uint8_t*)buffer + bytes_written) != 0) {
+                kfree(cluster_buf);
+                return VFS_ERR_IO;
+            }
+            bytes_to_copy = run * cluster_size;
+        } else {
+            // Read existing cluster data (for partial writes)
             if (read_cluster(fs_data, cluster, cluster_buf) != 0) {
                 // If read fails, zero the buffer
                 memset(cluster_buf, 0, cluster_size);
             }
-        }
-        
-        uint32_t bytes_to_copy = cluster_size - cluster_offset;
-        if (bytes_to_copy > size - bytes_written) {
-            bytes_to_copy = size - bytes_written;
-        }
-        
-        memcpy(cluster_buf + cluster_offset, (const uint8_t*)buffer + bytes_written, bytes_to_copy);
-        
-        if (write_cluster(fs_data, cluster, cluster_buf) != 0) {
-            kfree(cluster_buf);
-            return VFS_ERR_IO;
+            
+            bytes_to_copy = cluster_size - cluster_offset;
+            if (bytes_to_copy > size - bytes_written) {
+                bytes_to_copy = size - bytes_written;
+            }
+            
+            memcpy(cluster_buf + cluster_offset, (const uint8_t*)buffer + bytes_written, bytes_to_copy);
+            
+            if (write_cluster(fs_data, cluster, cluster_buf) != 0) {
+                kfree(cluster_buf);
+                return VFS_ERR_IO;
+            }
         }
         
         bytes_written += bytes_to_copy;
         cluster_offset = 0;
         
         if (bytes_written < size) {
-            uint32_t next = get_next_cluster(fs_data, cluster);
-            
-            if (next >= FAT32_CLUSTER_RESERVED) {
-                uint32_t new_cluster = alloc_cluster(fs_data);
-                if (new_cluster < 2) {
-                    kfree(cluster_buf);
-                    // Update file size even if not all bytes written
-                    if (offset + bytes_written > file_data->file_size) {
-                        file_data->file_size = offset + bytes_written;
-                        node->size = file_data->file_size;
-                    }
-                    return bytes_written;
+            uint32_t next = extend_cluster_chain(fs_data, cluster + run - 1,
+                                                 (size - bytes_written) / cluster_size);
+            if (next < 2) {
+                kfree(cluster_buf);
+                // Update file size even if not all bytes written
+                if (offset + bytes_written > file_data->file_size) {
+                    file_data->file_size = offset + bytes_written;
+                    node->size = file_data->file_size;
                 }
-                set_next_cluster(fs_data, cluster, new_cluster);
-                cluster = new_cluster;
-            } else {
-                cluster = next;
+                return bytes_written;
             }
+            cluster = next;
         }
     }
     
@@ -1192,30 +1503,6 @@ static int fat32_vnode_stat(vnode_t* node, stat_t* stat) {
 
 // Filesystem Operations
 
-static uint32_t fat32_parse_source_lba(const char* source) {
-    if (!source || !*source) {
-        return 0;
-    }
-
-    const char* lba_pos = strstr(source, "lba=");
-    if (!lba_pos) {
-        lba_pos = strstr(source, "lba:");
-    }
-    if (!lba_pos) {
-        return 0;
-    }
-
-    lba_pos += 4;
-    uint32_t lba = 0;
-    while (*lba_pos >= '0' && *lba_pos <= '9') {
-        lba = (lba * 10U) + (uint32_t)(*lba_pos - '0');
-        lba_pos++;
-    }
-
-    return lba;
-}
-
-
 static int fat32_mount(filesystem_t* fs, const char* source, uint32_t flags) {
     (void)flags;
     if (!fs) {
@@ -1224,6 +1511,14 @@ static int fat32_mount(filesystem_t* fs, const char* source, uint32_t flags) {
     
     serial_puts("FAT32: Attempting to mount filesystem...\n");
     
+    // Source names the disk and start LBA (`dev=vda lba=2048`); default is disk 0, LBA 0
+    uint32_t dev = 0;
+    uint32_t start_lba = 0;
+    if (blk_parse_source(source, &dev, &start_lba) != 0 || !blk_get_device(dev)) {
+        serial_puts("FAT32: No such block device\n");
+        return VFS_ERR_IO;
+    }
+
     // Allocate filesystem data
     fat32_data_t* fs_data = (fat32_data_t*)kmalloc(sizeof(fat32_data_t));
     if (!fs_data) {
@@ -1232,7 +1527,8 @@ static int fat32_mount(filesystem_t* fs, const char* source, uint32_t flags) {
     }
     
     memset(fs_data, 0, sizeof(fat32_data_t));
-    fs_data->start_lba = fat32_parse_source_lba(source);
+    fs_data->dev = dev;
+    fs_data->start_lba = start_lba;
     
     // Read boot sector
     if (read_sector(fs_data, 0, &fs_data->boot_sector) != 0) {
@@ -1335,7 +1631,7 @@ static int fat32_mount(filesystem_t* fs, const char* source, uint32_t flags) {
         }
     }
     
-    // Load FAT into memory (cache first FAT)
+    // Load FAT into memory (cache the active FAT)
     uint32_t fat_size_bytes = fs_data->boot_sector.fat_size_32 * fs_data->boot_sector.bytes_per_sector;
     if (fat_size_bytes == 0) {
         serial_puts("FAT32: Invalid FAT size in bytes\n");
@@ -1351,17 +1647,26 @@ static int fat32_mount(filesystem_t* fs, const char* source, uint32_t flags) {
     
     // Read FAT sectors
     serial_puts("FAT32: Loading FAT into memory...\n");
-    uint8_t* fat_ptr = (uint8_t*)fs_data->fat;
-    for (uint32_t i = 0; i < fs_data->boot_sector.fat_size_32; i++) {
-        if (read_sector(fs_data, fs_data->fat_start_sector + i, 
-                       fat_ptr + (i * fs_data->boot_sector.bytes_per_sector)) != 0) {
-            serial_puts("FAT32: Failed to read FAT sector\n");
-            kfree(fs_data->fat);
-            kfree(fs_data);
-            return VFS_ERR_IO;
-        }
+    uint32_t active_start = fs_data->fat_start_sector + fat32_active_fat(fs_data) * fs_data->boot_sector.fat_size_32;
+    if (read_sectors(fs_data, active_start, fs_data->boot_sector.fat_size_32, fs_data->fat) != 0) {
+        serial_puts("FAT32: Failed to read FAT sector\n");
+        kfree(fs_data->fat);
+        kfree(fs_data);
+        return VFS_ERR_IO;
     }
     
+    if (fat32_build_free_map(fs_data) != 0) {
+        serial_puts("FAT32: Failed to allocate free-cluster bitmap\n");
+        kfree(fs_data->fat);
+        kfree(fs_data);
+        return VFS_ERR_NOSPACE;
+    }
+    
+    serial_puts("FAT32: Free clusters: ");
+    itoa(fs_data->fsinfo.free_clusters, buf, 10);
+    serial_puts(buf);
+    serial_puts("\n");
+    
     fs->fs_data = fs_data;
     serial_puts("FAT32: Mount successful\n");
     
@@ -1375,35 +1680,19 @@ static int fat32_unmount(filesystem_t* fs) {
     
     fat32_data_t* fs_data = (fat32_data_t*)fs->fs_data;
     
-    // Write back FAT if dirty
-    if (fs_data->fat_cache_dirty && fs_data->fat) {
-        serial_puts("FAT32: Writing back FAT cache...\n");
-        uint8_t* fat_ptr = (uint8_t*)fs_data->fat;
-        for (uint32_t i = 0; i < fs_data->boot_sector.fat_size_32; i++) {
-            write_sector(fs_data, fs_data->fat_start_sector + i,
-                        fat_ptr + (i * fs_data->boot_sector.bytes_per_sector));
-        }
-        
-        // Write to backup FAT if enabled
-        if (!(fs_data->boot_sector.ext_flags & 0x80)) {
-            uint32_t backup_fat_start = fs_data->fat_start_sector + fs_data->boot_sector.fat_size_32;
-            for (uint32_t i = 0; i < fs_data->boot_sector.fat_size_32; i++) {
-                write_sector(fs_data, backup_fat_start + i,
-                            fat_ptr + (i * fs_data->boot_sector.bytes_per_sector));
-            }
-        }
-        
-        fs_data->fat_cache_dirty = 0;
-    }
-    
-    // Write back FSInfo
-    if (fs_data->boot_sector.fs_info != 0 && fs_data->boot_sector.fs_info != 0xFFFF) {
-        write_sector(fs_data, fs_data->boot_sector.fs_info, &fs_data->fsinfo);
-    }
+    // Write back changed FAT sectors and FSInfo
+    fat32_sync(fs_data);
+    bcache_flush(fs_data->dev);
     
     if (fs_data->fat) {
         kfree(fs_data->fat);
     }
+    if (fs_data->free_map) {
+        kfree(fs_data->free_map);
+    }
+    if (fs_data->fat_dirty_map) {
+        kfree(fs_data->fat_dirty_map);
+    }
     
     kfree(fs_data);
     fs->fs_data = NULL;
@@ -1418,24 +1707,55 @@ static int fat32_sync(fat32_data_t* fs_data) {
         return -1;
     }
     
-    // Write back FAT if dirty
+    // Write back only the FAT sectors that changed, one request per dirty run
+    int result = 0;
     if (fs_data->fat_cache_dirty && fs_data->fat) {
-        uint8_t* fat_ptr = (uint8_t*)fs_data->fat;
-        for (uint32_t i = 0; i < fs_data->boot_sector.fat_size_32; i++) {
-            write_sector(fs_data, fs_data->fat_start_sector + i,
-                        fat_ptr + (i * fs_data->boot_sector.bytes_per_sector));
+        uint32_t fat_sectors = fs_data->boot_sector.fat_size_32;
+        // Mirroring is on unless bit 7 of ext_flags is set; then only the active FAT is written
+        uint32_t first = 0;
+        uint32_t copies = fs_data->boot_sector.num_fats;
+        if (fs_data->boot_sector.ext_flags & FAT32_EXT_NO_MIRROR) {
+            first = fat32_active_fat(fs_data);
+            copies = 1;
         }
+        uint32_t sector = 0;
+        
+        // Sectors dirtied while the writes sleep set this again
+        fs_data->fat_cache_dirty = 0;
         
-        // Write to backup FAT if enabled
-        if (!(fs_data->boot_sector.ext_flags & 0x80)) {
-            uint32_t backup_fat_start = fs_data->fat_start_sector + fs_data->boot_sector.fat_size_32;
-            for (uint32_t i = 0; i < fs_data->boot_sector.fat_size_32; i++) {
-                write_sector(fs_data, backup_fat_start + i,
-                            fat_ptr + (i * fs_data->boot_sector.bytes_per_sector));
+        while (sector < fat_sectors) {
+            if (!(fs_data->fat_dirty_map[sector >> 5] & (1U << (sector & 31)))) {
+                sector = (fs_data->fat_dirty_map[sector >> 5] >> (sector & 31)) ? sector + 1
+                                                                                  : (sector | 31) + 1;
+                continue;
             }
+            uint32_t run = 0;
+            while (sector + run < fat_sectors &&
+                   (fs_data->fat_dirty_map[(sector + run) >> 5] & (1U << ((sector + run) & 31)))) {
+                fs_data->fat_dirty_map[(sector + run) >> 5] &= ~(1U << ((sector + run) & 31));
+                run++;
+            }
+            
+            const uint8_t* src = (const uint8_t*)fs_data->fat + sector * FAT32_SECTOR_SIZE;
+            int failed = 0;
+            for (uint32_t copy = first; copy < first + copies; copy++) {
+                if (write_sectors(fs_data, fs_data->fat_start_sector + copy * fat_sectors + sector,
+                                  run, src) != 0) {
+                    failed = 1;
+                }
+            }
+            
+            // The run counts as written only once every copy has it; otherwise
+            // the next sync retries it
+            if (failed) {
+                for (uint32_t i = 0; i < run; i++) {
+                    fs_data->fat_dirty_map[(sector + i) >> 5] |= 1U << ((sector + i) & 31);
+                }
+                fs_data->fat_cache_dirty = 1;
+                result = -1;
+            }
+            sector += run;
         }
-        
-        fs_data->fat_cache_dirty = 0;
     }
     
     // Write back FSInfo
@@ -1443,7 +1763,14 @@ static int fat32_sync(fat32_data_t* fs_data) {
         write_sector(fs_data, fs_data->boot_sector.fs_info, &fs_data->fsinfo);
     }
     
-    return 0;
+    return result;
+}
+
+static int fat32_fs_sync(filesystem_t* fs) {
+    if (!fs || !fs->fs_data) {
+        return VFS_ERR_INVALID;
+    }
+    return fat32_sync((fat32_data_t*)fs->fs_data) == 0 ? VFS_OK : VFS_ERR_IO;
 }
 
 static vnode_t* fat32_get_root(filesystem_t* fs) {
@@ -1469,6 +1796,7 @@ static vnode_t* fat32_get_root(filesystem_t* fs) {
     
     fat32_file_data_t* file_data = (fat32_file_data_t*)kmalloc(sizeof(fat32_file_data_t));
     if (file_data) {
+        memset(file_data, 0, sizeof(fat32_file_data_t));
         file_data->first_cluster = fs_data->boot_sector.root_cluster;
         file_data->current_cluster = fs_data->boot_sector.root_cluster;
         file_data->cluster_offset = 0;
@@ -1510,6 +1838,9 @@ int fat32_format(uint32_t start_lba, uint32_t num_sectors, const char* volume_la
         return -1;
     }
     
+    // The format writes the disk directly; drop stale (and dirty) cached blocks first
+    bcache_invalidate(BCACHE_DEV_ATA0, start_lba, num_sectors);
+    
     // Calculate filesystem parameters
     uint8_t sectors_per_cluster = 8;  // 4KB clusters for typical disk
     if (num_sectors > 16777216) {     // > 8GB
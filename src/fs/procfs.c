@@ -18,6 +18,9 @@
 
 
 #include <fs/procfs.h>
+#include <fs/bcache.h>
+#include <dev/blkdev.h>
+#include <net/tcp_cong.h>
 #include <string.h>
 #include <serial.h>
 #include <pmm.h>
@@ -33,6 +36,10 @@ typedef enum {
     PROC_NODE_ROOT = 0,
     PROC_NODE_MEMINFO,
     PROC_NODE_CPUINFO,
+    PROC_NODE_BCACHE,
+    PROC_NODE_DISKSTATS,
+    PROC_NODE_TCP_CONG,
+    PROC_NODE_TCP_RMEM_MAX,
     PROC_NODE_PID_DIR,
     PROC_NODE_PID_INFO
 } proc_node_type_t;
@@ -251,13 +258,140 @@ static int procfs_read_cpuinfo(void* buffer, uint32_t size, uint32_t offset) {
     return copy_out(scratch, pos, offset, buffer, size);
 }
 
+static int procfs_read_bcache(void* buffer, uint32_t size, uint32_t offset) {
+    char scratch[512];
+    uint32_t pos = 0;
+    bcache_stats_t stats;
+
+    bcache_get_stats(&stats);
+    pos = append_kv_num(scratch, sizeof(scratch), pos, "buffers", stats.buffers);
+    pos = append_kv_num(scratch, sizeof(scratch), pos, "block_size", BCACHE_BLOCK_SIZE);
+    pos = append_kv_num(scratch, sizeof(scratch), pos, "valid", stats.valid);
+    pos = append_kv_num(scratch, sizeof(scratch), pos, "dirty", stats.dirty);
+    pos = append_kv_num(scratch, sizeof(scratch), pos, "hits", stats.hits);
+    pos = append_kv_num(scratch, sizeof(scratch), pos, "misses", stats.misses);
+    pos = append_kv_num(scratch, sizeof(scratch), pos, "writebacks", stats.writebacks);
+    pos = append_kv_num(scratch, sizeof(scratch), pos, "evictions", stats.evictions);
+    pos = append_kv_num(scratch, sizeof(scratch), pos, "read_errors", stats.read_errors);
+    pos = append_kv_num(scratch, sizeof(scratch), pos, "write_errors", stats.write_errors);
+    pos = append_kv_num(scratch, sizeof(scratch), pos, "direct_reads", stats.direct_reads);
+    pos = append_kv_num(scratch, sizeof(scratch), pos, "direct_writes", stats.direct_writes);
+    pos = append_kv_num(scratch, sizeof(scratch), pos, "direct_blocks", stats.direct_blocks);
+
+    return copy_out(scratch, pos, offset, buffer, size);
+}
+
+static int procfs_read_diskstats(void* buffer, uint32_t size, uint32_t offset) {
+    /* Block-layer counters plus queue-depth and latency histograms per disk. */
+    static char scratch[2048];
+    uint32_t pos = 0;
+    scratch[0] = '\0';
+
+    for (uint32_t dev = 0; dev < blk_device_count(); dev++) {
+        blk_device_t* disk = blk_get_device(dev);
+        blk_stats_t stats;
+        if (!disk || blk_get_stats(dev, &stats) != 0) {
+            continue;
+        }
+
+        pos = str_append(scratch, sizeof(scratch), pos, disk->name);
+        pos = str_append(scratch, sizeof(scratch), pos, ":\n");
+        pos = append_kv_num(scratch, sizeof(scratch), pos, "bios", stats.bios);
+        pos = append_kv_num(scratch, sizeof(scratch), pos, "requests", stats.requests);
+        pos = append_kv_num(scratch, sizeof(scratch), pos, "merged", stats.merged);
+        pos = append_kv_num(scratch, sizeof(scratch), pos, "reads", stats.reads);
+        pos = append_kv_num(scratch, sizeof(scratch), pos, "writes", stats.writes);
+        pos = append_kv_num(scratch, sizeof(scratch), pos, "sectors_read", stats.sectors_read);
+        pos = append_kv_num(scratch, sizeof(scratch), pos, "sectors_written", stats.sectors_written);
+        pos = append_kv_num(scratch, sizeof(scratch), pos, "errors", stats.errors);
+        pos = append_kv_num(scratch, sizeof(scratch), pos, "expired", stats.expired);
+        pos = append_kv_num(scratch, sizeof(scratch), pos, "max_depth", stats.max_depth);
+
+        // Bucket i of the depth histogram holds depths up to 2^i
+        pos = str_append(scratch, sizeof(scratch), pos, "depth:");
+        for (uint32_t i = 0; i < BLK_DEPTH_BUCKETS; i++) {
+            pos = str_append(scratch, sizeof(scratch), pos, i == BLK_DEPTH_BUCKETS - 1 ? " >" : " <=");
+            pos = append_num(scratch, sizeof(scratch), pos, i == BLK_DEPTH_BUCKETS - 1 ? (1u << (i - 1)) : (1u << i), 10);
+            pos = str_append(scratch, sizeof(scratch), pos, ":");
+            pos = append_num(scratch, sizeof(scratch), pos, stats.depth_hist[i], 10);
+        }
+        pos = str_append(scratch, sizeof(scratch), pos, "\nlatency_us:");
+        for (uint32_t i = 0; i < BLK_LAT_BUCKETS; i++) {
+            pos = str_append(scratch, sizeof(scratch), pos, i == BLK_LAT_BUCKETS - 1 ? " >=" : " <");
+            pos = append_num(scratch, sizeof(scratch), pos,
+                             BLK_LAT_BASE_US << (i == BLK_LAT_BUCKETS - 1 ? i - 1 : i), 10);
+            pos = str_append(scratch, sizeof(scratch), pos, ":");
+            pos = append_num(scratch, sizeof(scratch), pos, stats.latency_hist[i], 10);
+        }
+        pos = str_append(scratch, sizeof(scratch), pos, "\n");
+    }
+
+    return copy_out(scratch, pos, offset, buffer, size);
+}
+
+static int procfs_read_tcp_cong(void* buffer, uint32_t size, uint32_t offset) {
+    char scratch[TCP_CONG_NAME_MAX + 2];
+    uint32_t pos = 0;
+
+    pos = str_append(scratch, sizeof(scratch), pos, tcp_cong_default()->name);
+    pos = str_append(scratch, sizeof(scratch), pos, "\n");
+    return copy_out(scratch, pos, offset, buffer, size);
+}
+
+static int procfs_write_tcp_cong(const void* buffer, uint32_t size) {
+    /* Select the default algorithm for new connections, sysctl style. */
+    char name[TCP_CONG_NAME_MAX];
+    uint32_t len = size < sizeof(name) - 1 ? size : sizeof(name) - 1;
+
+    memcpy(name, buffer, len);
+    name[len] = '\0';
+    while (len > 0 && (name[len - 1] == '\n' || name[len - 1] == ' ' ||
+                       name[len - 1] == '\r' || name[len - 1] == '\t')) {
+        name[--len] = '\0';
+    }
+
+    if (tcp_cong_set_default(name) != 0) {
+        return VFS_ERR_INVALID;
+    }
+    return (int)size;
+}
+
+static int procfs_read_tcp_rmem_max(void* buffer, uint32_t size, uint32_t offset) {
+    char scratch[16];
+    uint32_t pos = 0;
+
+    pos = append_num(scratch, sizeof(scratch), pos, tcp_get_rmem_max(), 10);
+    pos = str_append(scratch, sizeof(scratch), pos, "\n");
+    return copy_out(scratch, pos, offset, buffer, size);
+}
+
+static int procfs_write_tcp_rmem_max(const void* buffer, uint32_t size) {
+    /* Cap receive-buffer autotuning, in bytes. */
+    char text[16];
+    uint32_t len = size < sizeof(text) - 1 ? size : sizeof(text) - 1;
+    uint32_t value = 0;
+    uint32_t digits = 0;
+
+    memcpy(text, buffer, len);
+    text[len] = '\0';
+    for (uint32_t i = 0; i < len && text[i] >= '0' && text[i] <= '9'; i++) {
+        value = value * 10 + (uint32_t)(text[i] - '0');
+        digits++;
+    }
+
+    if (digits == 0 || digits > 9 || tcp_set_rmem_max(value) != 0) {
+        return VFS_ERR_INVALID;
+    }
+    return (int)size;
+}
+
 static int procfs_read_pidinfo(pid_t pid, void* buffer, uint32_t size, uint32_t offset) {
     process_t* proc = process_get_by_pid(pid);
     if (!proc) {
         return VFS_ERR_NOTFOUND;
     }
 
-    char scratch[256];
+    char scratch[384];
     uint32_t pos = 0;
 
     pos = append_kv_num(scratch, sizeof(scratch), pos, "tid", (uint32_t)proc->pid);
@@ -270,6 +404,13 @@ static int procfs_read_pidinfo(pid_t pid, void* buffer, uint32_t size, uint32_t
     pos = append_kv_num(scratch, sizeof(scratch), pos, "total_time", proc->total_time);
     pos = append_kv_num(scratch, sizeof(scratch), pos, "parent_tid", (uint32_t)proc->parent_pid);
     pos = append_kv_hex(scratch, sizeof(scratch), pos, "addr_space", (uint32_t)(uintptr_t)proc->address_space);
+    if (proc->address_space) {
+        size_t vm_bytes = 0;
+        size_t rss_bytes = 0;
+        vmm_get_usage(proc->address_space, &vm_bytes, &rss_bytes);
+        pos = append_kv_num(scratch, sizeof(scratch), pos, "vm_size_kb", (uint32_t)(vm_bytes / 1024));
+        pos = append_kv_num(scratch, sizeof(scratch), pos, "vm_rss_kb", (uint32_t)(rss_bytes / 1024));
+    }
     pos = append_kv_hex(scratch, sizeof(scratch), pos, "kernel_sp", proc->kernel_stack);
 
     return copy_out(scratch, pos, offset, buffer, size);
@@ -290,6 +431,14 @@ static int procfs_vnode_read(vnode_t* node, void* buffer, uint32_t size, uint32_
             return procfs_read_meminfo(buffer, size, offset);
         case PROC_NODE_CPUINFO:
             return procfs_read_cpuinfo(buffer, size, offset);
+        case PROC_NODE_BCACHE:
+            return procfs_read_bcache(buffer, size, offset);
+        case PROC_NODE_DISKSTATS:
+            return procfs_read_diskstats(buffer, size, offset);
+        case PROC_NODE_TCP_CONG:
+            return procfs_read_tcp_cong(buffer, size, offset);
+        case PROC_NODE_TCP_RMEM_MAX:
+            return procfs_read_tcp_rmem_max(buffer, size, offset);
         case PROC_NODE_PID_INFO:
             return procfs_read_pidinfo(info->pid, buffer, size, offset);
         case PROC_NODE_ROOT:
@@ -300,11 +449,21 @@ static int procfs_vnode_read(vnode_t* node, void* buffer, uint32_t size, uint32_
 }
 
 static int procfs_vnode_write(vnode_t* node, const void* buffer, uint32_t size, uint32_t offset) {
-    (void)node;
-    (void)buffer;
-    (void)size;
     (void)offset;
-    return VFS_ERR_PERM;
+
+    proc_node_t* info = node ? (proc_node_t*)node->fs_data : NULL;
+    if (!info || !buffer) {
+        return VFS_ERR_PERM;
+    }
+
+    switch (info->type) {
+        case PROC_NODE_TCP_CONG:
+            return procfs_write_tcp_cong(buffer, size);
+        case PROC_NODE_TCP_RMEM_MAX:
+            return procfs_write_tcp_rmem_max(buffer, size);
+        default:
+            return VFS_ERR_PERM;
+    }
 }
 
 typedef struct procfs_picker {
@@ -350,6 +509,18 @@ static vnode_t* procfs_vnode_finddir(vnode_t* node, const char* name) {
         if (strcmp(name, "cpuinfo") == 0) {
             return procfs_make_vnode("cpuinfo", PROC_NODE_CPUINFO, 0, node->fs);
         }
+        if (strcmp(name, "bcache") == 0) {
+            return procfs_make_vnode("bcache", PROC_NODE_BCACHE, 0, node->fs);
+        }
+        if (strcmp(name, "diskstats") == 0) {
+            return procfs_make_vnode("diskstats", PROC_NODE_DISKSTATS, 0, node->fs);
+        }
+        if (strcmp(name, "tcp_congestion_control") == 0) {
+            return procfs_make_vnode("tcp_congestion_control", PROC_NODE_TCP_CONG, 0, node->fs);
+        }
+        if (strcmp(name, "tcp_rmem_max") == 0) {
+            return procfs_make_vnode("tcp_rmem_max", PROC_NODE_TCP_RMEM_MAX, 0, node->fs);
+        }
 
         int pid = atoi(name);
         if (pid > 0 && process_get_by_pid(pid)) {
@@ -405,15 +576,39 @@ static int procfs_vnode_readdir(vnode_t* node, uint32_t index, dirent_t* dirent)
             dirent->inode = 2;
             dirent->type = VFS_FILE;
             return VFS_OK;
+        } else if (index == 2) {
+            strncpy(dirent->name, "bcache", 255);
+            dirent->name[255] = '\0';
+            dirent->inode = 3;
+            dirent->type = VFS_FILE;
+            return VFS_OK;
+        } else if (index == 3) {
+            strncpy(dirent->name, "diskstats", 255);
+            dirent->name[255] = '\0';
+            dirent->inode = 4;
+            dirent->type = VFS_FILE;
+            return VFS_OK;
+        } else if (index == 4) {
+            strncpy(dirent->name, "tcp_congestion_control", 255);
+            dirent->name[255] = '\0';
+            dirent->inode = 5;
+            dirent->type = VFS_FILE;
+            return VFS_OK;
+        } else if (index == 5) {
+            strncpy(dirent->name, "tcp_rmem_max", 255);
+            dirent->name[255] = '\0';
+            dirent->inode = 6;
+            dirent->type = VFS_FILE;
+            return VFS_OK;
         } else {
-            uint32_t pid_index = index - 2;
+            uint32_t pid_index = index - 6;
             process_t* proc = NULL;
             if (procfs_pick_nth_process(pid_index, &proc) == 0 && proc) {
                 char pid_buf[16];
                 itoa((uint32_t)proc->pid, pid_buf, 10);
                 strncpy(dirent->name, pid_buf, 255);
                 dirent->name[255] = '\0';
-                dirent->inode = 3 + pid_index;
+                dirent->inode = 7 + pid_index;
                 dirent->type = VFS_DIRECTORY;
                 return VFS_OK;
             }
@@ -18,6 +18,8 @@
 #include <fs/simplefs.h>
 #include <fs/vfs.h>
 #include <dev/ata.h>
+#include <fs/bcache.h>
+#include <dev/blkdev.h>
 
 #include <string.h>
 #include <stdlib.h>
@@ -28,6 +30,7 @@
 #include <vmm.h>
 
 #include <util.h>
+#include <ktime.h>
 
 /*
  * SimpleFS driver implementation.
@@ -35,10 +38,15 @@
  * Architectural model:
  * - Block/inode bitmap allocator over ATA-backed sectors
  * - VFS vnode adapter (`simplefs_vnode_ops`) for POSIX-like operations
- * - Direct + indirect block addressing for scalable file sizes
+ * - Extent-mapped regular files with delayed allocation of appends (v3);
+ *   direct + indirect block addressing for directories and v2 files
  * - Local ownership/permission metadata integrated with aOS fileperm model
+ * - Contiguous runs of whole file blocks move as single disk requests
  */
 
+// Longest run of contiguous file blocks sent to the disk as one request
+#define SIMPLEFS_MAX_RUN_BLOCKS 256
+
 
 // Forward declarations
 static int simplefs_vnode_open(vnode_t* node, uint32_t flags);
@@ -56,6 +64,7 @@ static int simplefs_vnode_stat(vnode_t* node, stat_t* stat);
 static int write_inode(simplefs_data_t* fs_data, uint32_t inode_num);
 static int read_block(simplefs_data_t* fs_data, uint32_t block_num, void* buffer);
 static int write_block(simplefs_data_t* fs_data, uint32_t block_num, const void* buffer);
+static int map_file_block(simplefs_data_t* fs_data, simplefs_inode_t* inode, uint32_t inode_num, uint32_t block_idx, uint32_t* block_num);
 static uint32_t alloc_block(simplefs_data_t* fs_data);
 static uint32_t alloc_inode(simplefs_data_t* fs_data);
 static void free_inode(simplefs_data_t* fs_data, uint32_t inode_num);
@@ -66,6 +75,7 @@ static uint32_t get_file_block(simplefs_data_t* fs_data, simplefs_inode_t* inode
 static int set_file_block(simplefs_data_t* fs_data, simplefs_inode_t* inode, uint32_t block_idx, uint32_t block_num, uint32_t inode_num);
 static uint32_t get_current_time(void);
 static uint32_t calculate_checksum(const uint8_t* data, uint32_t size);
+static int simplefs_journal_commit_idle(simplefs_data_t* fs_data);
 
 // VFS operations
 static vnode_ops_t simplefs_vnode_ops = {
@@ -85,11 +95,13 @@ static vnode_ops_t simplefs_vnode_ops = {
 static int simplefs_mount(filesystem_t* fs, const char* source, uint32_t flags);
 static int simplefs_unmount(filesystem_t* fs);
 static vnode_t* simplefs_get_root(filesystem_t* fs);
+static int simplefs_fs_sync(filesystem_t* fs);
 
 static filesystem_ops_t simplefs_fs_ops = {
     .mount = simplefs_mount,
     .unmount = simplefs_unmount,
-    .get_root = simplefs_get_root
+    .get_root = simplefs_get_root,
+    .sync = simplefs_fs_sync
 };
 
 static filesystem_t simplefs_filesystem = {
@@ -99,39 +111,16 @@ static filesystem_t simplefs_filesystem = {
     .mount = NULL
 };
 
-static uint32_t simplefs_parse_source_lba(const char* source) {
-    /* Parse mount source hints like `lba=12345`/`lba:12345`. */
-    if (!source || !*source) {
-        return 0;
-    }
-
-    const char* lba_pos = strstr(source, "lba=");
-    if (!lba_pos) {
-        lba_pos = strstr(source, "lba:");
-    }
-    if (!lba_pos) {
-        return 0;
-    }
-
-    lba_pos += 4;
-    uint32_t lba = 0;
-    while (*lba_pos >= '0' && *lba_pos <= '9') {
-        lba = (lba * 10U) + (uint32_t)(*lba_pos - '0');
-        lba_pos++;
-    }
-
-    return lba;
-}
-
 // Helper functions
 
-// Get current time (placeholder - returns 0 until we have a real-time clock)
+// Get current time for inode and superblock timestamps
 static uint32_t get_current_time(void) {
-    /* Placeholder monotonic stamp until RTC-backed wall-clock integration. */
-    // TODO: Implement RTC driver to get actual time
-    // For now, return a monotonic counter or 0
-    static uint32_t counter = 0;
-    return counter++;
+    /*
+     * Seconds since boot. The time base restarts every boot, so stamps do
+     * not persist meaningfully: one written late in an earlier boot can be
+     * later than now. Code comparing stamps must allow for that.
+     */
+    return ktime_get_ms() / 1000;
 }
 
 // Calculate simple checksum for data
@@ -145,6 +134,136 @@ static uint32_t calculate_checksum(const uint8_t* data, uint32_t size) {
     return checksum;
 }
 
+// Journaled mounts, visited by the group-commit thread
+static simplefs_data_t* simplefs_mounts[SIMPLEFS_MAX_MOUNTS];
+
+/*
+ * Metadata journal internals.
+ *
+ * While journaling is on, write_block() does not touch the disk: it stores
+ * the block's new image in the running transaction, replacing an earlier
+ * image of the same block, and read_block() serves those images first. The
+ * commit path (simplefs_journal_commit) owns all log and checkpoint I/O.
+ * A transaction is only closed while no handle is open, so it always holds
+ * whole operations. File data bypasses the journal; writing a block as data
+ * drops any logged image of it, and waits out a commit that already logged
+ * one, so a freed-and-reused metadata block is never overwritten by a
+ * stale image, neither at checkpoint nor at replay.
+ */
+
+static int journal_write_raw(simplefs_data_t* fs_data, uint32_t block_num, uint32_t count, const void* buffer) {
+    return bcache_write_blocks(fs_data->dev, fs_data->start_lba + block_num, count, buffer);
+}
+
+static int txn_find(simplefs_txn_t* txn, uint32_t block_num) {
+    for (uint32_t i = 0; i < txn->count; i++) {
+        if (txn->blocks[i] == block_num) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static int journal_read(simplefs_data_t* fs_data, uint32_t block_num, void* buffer) {
+    /* Copy the newest logged image of a block; 0 when the journal has none. */
+    int found = 0;
+    process_set_preempt_disabled(1);
+    simplefs_txn_t* txn = &fs_data->txn[fs_data->txn_running];
+    int idx = txn_find(txn, block_num);
+    if (idx < 0 && fs_data->txn_committing) {
+        txn = &fs_data->txn[fs_data->txn_running ^ 1];
+        idx = txn_find(txn, block_num);
+    }
+    if (idx >= 0) {
+        memcpy(buffer, txn->images + (uint32_t)idx * SIMPLEFS_BLOCK_SIZE, SIMPLEFS_BLOCK_SIZE);
+        found = 1;
+    }
+    process_set_preempt_disabled(0);
+    return found;
+}
+
+static int journal_log_block(simplefs_data_t* fs_data, uint32_t block_num, const void* buffer) {
+    /* Add a metadata block image to the running transaction, committing it first if full. */
+    int overrun = 0;
+    for (;;) {
+        process_set_preempt_disabled(1);
+        simplefs_txn_t* txn = &fs_data->txn[fs_data->txn_running];
+        int idx = txn_find(txn, block_num);
+        if (idx >= 0) {
+            memcpy(txn->images + (uint32_t)idx * SIMPLEFS_BLOCK_SIZE, buffer, SIMPLEFS_BLOCK_SIZE);
+            fs_data->journal_coalesced++;
+            process_set_preempt_disabled(0);
+            return 0;
+        }
+        if (txn->count < fs_data->txn_limit) {
+            txn->blocks[txn->count] = block_num;
+            memcpy(txn->images + txn->count * SIMPLEFS_BLOCK_SIZE, buffer, SIMPLEFS_BLOCK_SIZE);
+            txn->count++;
+            if (overrun) {
+                fs_data->txn_overruns--;
+            }
+            process_set_preempt_disabled(0);
+            return 0;
+        }
+        
+        /*
+         * Full: this caller logged more than its handle's credits. Commit
+         * once every other open handle has finished or is stuck here too,
+         * so no operation but the overrunning ones is split. Commit always
+         * empties the transaction, even on I/O errors.
+         */
+        if (!overrun) {
+            overrun = 1;
+            fs_data->txn_overruns++;
+        }
+        int others = fs_data->journal_handles > fs_data->txn_overruns;
+        process_set_preempt_disabled(0);
+        if (others) {
+            process_sleep(1);
+            continue;
+        }
+        simplefs_journal_commit(fs_data);
+    }
+}
+
+static void journal_forget(simplefs_data_t* fs_data, uint32_t block_num, uint32_t count) {
+    /* Blocks [block_num, block_num + count) are being written as file data. */
+    if (!fs_data->journal_enabled) {
+        return;
+    }
+    
+    process_set_preempt_disabled(1);
+    simplefs_txn_t* txn = &fs_data->txn[fs_data->txn_running];
+    for (uint32_t i = 0; i < txn->count; i++) {
+        if (txn->blocks[i] - block_num < count) {
+            // Move the last image into the hole
+            txn->count--;
+            txn->blocks[i] = txn->blocks[txn->count];
+            memcpy(txn->images + i * SIMPLEFS_BLOCK_SIZE, txn->images + txn->count * SIMPLEFS_BLOCK_SIZE,
+                   SIMPLEFS_BLOCK_SIZE);
+            i--;
+        }
+    }
+    
+    // Logged by the commit in flight: its descriptor names the block, so a
+    // replay would restore the old image. Reuse it only once that commit
+    // has checkpointed and the header has moved past it.
+    while (fs_data->txn_committing) {
+        txn = &fs_data->txn[fs_data->txn_running ^ 1];
+        int logged = 0;
+        for (uint32_t i = 0; i < txn->count && !logged; i++) {
+            logged = txn->blocks[i] - block_num < count;
+        }
+        if (!logged) {
+            break;
+        }
+        process_set_preempt_disabled(0);
+        process_sleep(1);
+        process_set_preempt_disabled(1);
+    }
+    process_set_preempt_disabled(0);
+}
+
 static int read_block(simplefs_data_t* fs_data, uint32_t block_num, void* buffer) {
     /* Read one filesystem block mapped to underlying ATA sector LBA. */
     if (!fs_data || !buffer) {
@@ -158,14 +277,19 @@ static int read_block(simplefs_data_t* fs_data, uint32_t block_num, void* buffer
         return -1;
     }
     
+    // Metadata updated in memory but not yet checkpointed
+    if (fs_data->journal_enabled && journal_read(fs_data, block_num, buffer)) {
+        return 0;
+    }
+    
     // Note: We can't check total_blocks on first superblock read since it's not initialized yet
     // The caller must ensure block_num is valid
     uint32_t lba = fs_data->start_lba + block_num;
-    return ata_read_sectors(lba, 1, (uint8_t*)buffer);
+    return bcache_read(fs_data->dev, lba, buffer);
 }
 
 static int write_block(simplefs_data_t* fs_data, uint32_t block_num, const void* buffer) {
-    /* Write one filesystem block mapped to underlying ATA sector LBA. */
+    /* Write one metadata block: through the journal when it is enabled. */
     if (!fs_data || !buffer) {
         // serial_puts("SimpleFS: write_block - null pointer\n");
         return -1;
@@ -177,10 +301,14 @@ static int write_block(simplefs_data_t* fs_data, uint32_t block_num, const void*
         return -1;
     }
     
+    if (fs_data->journal_enabled) {
+        return journal_log_block(fs_data, block_num, buffer);
+    }
+    
     // Note: We can't check total_blocks on first superblock write since it's not initialized yet
     // The caller must ensure block_num is valid
     uint32_t lba = fs_data->start_lba + block_num;
-    int result = ata_write_sectors(lba, 1, (const uint8_t*)buffer);
+    int result = bcache_write(fs_data->dev, lba, buffer);
     if (result != 0) {
         // serial_puts("SimpleFS: write_block failed for block ");
         // char buf[32];
@@ -194,20 +322,52 @@ static int write_block(simplefs_data_t* fs_data, uint32_t block_num, const void*
     return result;
 }
 
+static int write_data_block(simplefs_data_t* fs_data, uint32_t block_num, const void* buffer) {
+    /* Write one block of file data; data never goes through the journal. */
+    if (!fs_data || !buffer || block_num >= fs_data->superblock.total_blocks) {
+        return -1;
+    }
+    journal_forget(fs_data, block_num, 1);
+    return bcache_write(fs_data->dev, fs_data->start_lba + block_num, buffer);
+}
+
+static int read_blocks(simplefs_data_t* fs_data, uint32_t block_num, uint32_t count, void* buffer) {
+    /* Read a physically contiguous run of blocks as one device request. */
+    if (!fs_data || !buffer || block_num >= fs_data->superblock.total_blocks ||
+        count > fs_data->superblock.total_blocks - block_num) {
+        return -1;
+    }
+    return bcache_read_blocks(fs_data->dev, fs_data->start_lba + block_num, count, buffer);
+}
+
+static int write_blocks(simplefs_data_t* fs_data, uint32_t block_num, uint32_t count, const void* buffer) {
+    /* Write a physically contiguous run of blocks as one device request. */
+    if (!fs_data || !buffer || block_num >= fs_data->superblock.total_blocks ||
+        count > fs_data->superblock.total_blocks - block_num) {
+        return -1;
+    }
+    journal_forget(fs_data, block_num, count);
+    return bcache_write_blocks(fs_data->dev, fs_data->start_lba + block_num, count, buffer);
+}
+
 static uint32_t alloc_block(simplefs_data_t* fs_data) {
     if (!fs_data || !fs_data->block_bitmap) {
         // serial_puts("SimpleFS: alloc_block - null pointer\n");
         return 0;
     }
     
-    // Check if we have free blocks
-    if (fs_data->superblock.free_blocks == 0) {
+    // Check if we have free blocks not already promised to buffered appends
+    if (fs_data->superblock.free_blocks <= fs_data->reserved_blocks) {
         // serial_puts("SimpleFS: No free blocks available\n");
         return 0;
     }
     
-    // Find free block in bitmap
-    for (uint32_t i = fs_data->superblock.first_data_block; i < fs_data->superblock.total_blocks; i++) {
+    // Find free block in bitmap (one block of bits)
+    uint32_t limit = fs_data->superblock.total_blocks;
+    if (limit > SIMPLEFS_BLOCK_SIZE * 8) {
+        limit = SIMPLEFS_BLOCK_SIZE * 8;
+    }
+    for (uint32_t i = fs_data->superblock.first_data_block; i < limit; i++) {
         uint32_t byte_idx = i / 8;
         uint32_t bit_idx = i % 8;
         
@@ -225,7 +385,7 @@ static uint32_t alloc_block(simplefs_data_t* fs_data) {
             // Zero out the new block
             uint8_t zero_block[SIMPLEFS_BLOCK_SIZE];
             memset(zero_block, 0, SIMPLEFS_BLOCK_SIZE);
-            write_block(fs_data, i, zero_block);
+            write_data_block(fs_data, i, zero_block);
             
             return i;
         }
@@ -371,117 +531,1264 @@ static int set_file_block(simplefs_data_t* fs_data, simplefs_inode_t* inode, uin
             }
             write_inode(fs_data, inode_num);
         }
-        
-        uint32_t l1_idx = block_idx / ptrs_per_block;
-        uint32_t l2_idx = block_idx % ptrs_per_block;
-        
-        uint32_t l1_block[ptrs_per_block];
-        if (read_block(fs_data, inode->double_indirect_ptr, l1_block) != 0) {
-            return -1;
+        
+        uint32_t l1_idx = block_idx / ptrs_per_block;
+        uint32_t l2_idx = block_idx % ptrs_per_block;
+        
+        uint32_t l1_block[ptrs_per_block];
+        if (read_block(fs_data, inode->double_indirect_ptr, l1_block) != 0) {
+            return -1;
+        }
+        
+        // Allocate level 2 indirect block if needed
+        if (l1_block[l1_idx] == 0) {
+            l1_block[l1_idx] = alloc_block(fs_data);
+            if (l1_block[l1_idx] == 0) {
+                return -1;
+            }
+            write_block(fs_data, inode->double_indirect_ptr, l1_block);
+        }
+        
+        uint32_t l2_block[ptrs_per_block];
+        if (read_block(fs_data, l1_block[l1_idx], l2_block) != 0) {
+            return -1;
+        }
+        
+        l2_block[l2_idx] = block_num;
+        
+        return write_block(fs_data, l1_block[l1_idx], l2_block);
+    }
+    
+    // Beyond double indirect (not supported yet)
+    return -1;
+}
+
+/*
+ * Extent mapping and delayed allocation (v3 regular files).
+ *
+ * Appends to an extent-mapped file are not given disk blocks as they
+ * arrive. They collect in a per-inode delalloc buffer that always starts at
+ * the file's mapped end (inode->blocks), and are placed when the buffer is
+ * flushed: one contiguous allocation, one multi-block write, one extent
+ * update and a single bitmap/superblock/inode write for the whole run.
+ * Free space for buffered blocks is reserved up front, so a flush cannot
+ * run out of room for data the caller was told had been written.
+ */
+
+static uint32_t block_bitmap_limit(simplefs_data_t* fs_data) {
+    /* The block bitmap is a single block; it cannot describe more blocks than its bits. */
+    uint32_t limit = SIMPLEFS_BLOCK_SIZE * 8;
+    return fs_data->superblock.total_blocks < limit ? fs_data->superblock.total_blocks : limit;
+}
+
+static int block_is_free(simplefs_data_t* fs_data, uint32_t block_num) {
+    return block_num >= fs_data->superblock.first_data_block &&
+           block_num < block_bitmap_limit(fs_data) &&
+           !(fs_data->block_bitmap[block_num / 8] & (1 << (block_num % 8)));
+}
+
+static void write_alloc_maps(simplefs_data_t* fs_data) {
+    write_block(fs_data, fs_data->superblock.block_bitmap_block, fs_data->block_bitmap);
+    write_block(fs_data, 0, &fs_data->superblock);
+}
+
+static uint32_t free_run_length(simplefs_data_t* fs_data, uint32_t block_num, uint32_t limit) {
+    uint32_t len = 0;
+    while (len < limit && block_is_free(fs_data, block_num + len)) {
+        len++;
+    }
+    return len;
+}
+
+static uint32_t alloc_block_run(simplefs_data_t* fs_data, uint32_t goal, uint32_t want, uint32_t* count) {
+    /*
+     * Claim up to `want` contiguous free blocks, trying `goal` first so a
+     * file keeps growing in place, then the first run long enough, then the
+     * longest shorter run. Blocks are neither zeroed nor written back here;
+     * the caller writes the data and then calls write_alloc_maps().
+     */
+    uint32_t first = 0;
+    uint32_t run = 0;
+    
+    if (block_is_free(fs_data, goal)) {
+        first = goal;
+        run = free_run_length(fs_data, goal, want);
+    } else {
+        uint32_t limit = block_bitmap_limit(fs_data);
+        uint32_t block_num = fs_data->superblock.first_data_block;
+        while (block_num < limit && run < want) {
+            if (fs_data->block_bitmap[block_num / 8] == 0xFF) {
+                block_num = (block_num | 7) + 1;  // Whole byte in use
+                continue;
+            }
+            uint32_t len = free_run_length(fs_data, block_num, want);
+            if (len > run) {
+                first = block_num;
+                run = len;
+            }
+            block_num += len ? len : 1;
+        }
+    }
+    if (run == 0) {
+        return 0;
+    }
+    
+    for (uint32_t i = 0; i < run; i++) {
+        fs_data->block_bitmap[(first + i) / 8] |= (1 << ((first + i) % 8));
+    }
+    fs_data->superblock.free_blocks -= run;
+    *count = run;
+    return first;
+}
+
+static void free_block_range(simplefs_data_t* fs_data, uint32_t start, uint32_t length) {
+    /* Release a run of blocks in the in-memory bitmap; the caller writes the maps back. */
+    for (uint32_t block_num = start; block_num < start + length; block_num++) {
+        if (block_num < fs_data->superblock.first_data_block || block_num >= block_bitmap_limit(fs_data)) {
+            continue;
+        }
+        if (fs_data->block_bitmap[block_num / 8] & (1 << (block_num % 8))) {
+            fs_data->block_bitmap[block_num / 8] &= ~(1 << (block_num % 8));
+            fs_data->superblock.free_blocks++;
+        }
+    }
+}
+
+static uint32_t inode_extent_count(simplefs_inode_t* inode) {
+    uint32_t n = 0;
+    while (n < SIMPLEFS_INODE_EXTENTS && inode->extents[n].length != 0) {
+        n++;
+    }
+    return n;
+}
+
+static int extent_map(simplefs_data_t* fs_data, simplefs_inode_t* inode, uint32_t block_idx,
+                      uint32_t* block_num, uint32_t* run) {
+    /* Disk block holding file block `block_idx`, and how many follow it contiguously. */
+    uint32_t pos = 0;
+    uint32_t n = inode_extent_count(inode);
+    for (uint32_t i = 0; i < n; i++) {
+        simplefs_extent_t* ext = &inode->extents[i];
+        if (block_idx < pos + ext->length) {
+            *block_num = ext->start + (block_idx - pos);
+            *run = ext->length - (block_idx - pos);
+            return 0;
+        }
+        pos += ext->length;
+    }
+    
+    // Bound the walk so a corrupt chain cannot loop forever
+    uint32_t eb_num = inode->extent_block;
+    for (uint32_t hops = 0; eb_num != 0 && hops < fs_data->superblock.total_blocks; hops++) {
+        simplefs_extent_block_t eb;
+        if (read_block(fs_data, eb_num, &eb) != 0) {
+            return -1;
+        }
+        for (uint32_t i = 0; i < eb.count && i < SIMPLEFS_EXTENTS_PER_BLOCK; i++) {
+            simplefs_extent_t* ext = &eb.extents[i];
+            if (block_idx < pos + ext->length) {
+                *block_num = ext->start + (block_idx - pos);
+                *run = ext->length - (block_idx - pos);
+                return 0;
+            }
+            pos += ext->length;
+        }
+        eb_num = eb.next;
+    }
+    return -1;
+}
+
+static int extent_append(simplefs_data_t* fs_data, simplefs_inode_t* inode, uint32_t start, uint32_t length) {
+    /*
+     * Map `length` more blocks at the end of the file, merging with the last
+     * extent when the run continues it. The inode itself is not written.
+     */
+    uint32_t n = inode_extent_count(inode);
+    if (inode->extent_block == 0) {
+        if (n > 0 && inode->extents[n - 1].start + inode->extents[n - 1].length == start) {
+            inode->extents[n - 1].length += length;
+            return 0;
+        }
+        if (n < SIMPLEFS_INODE_EXTENTS) {
+            inode->extents[n].start = start;
+            inode->extents[n].length = length;
+            return 0;
+        }
+        
+        uint32_t new_block = alloc_block(fs_data);
+        if (new_block == 0) {
+            return -1;
+        }
+        simplefs_extent_block_t eb;
+        memset(&eb, 0, sizeof(eb));
+        eb.count = 1;
+        eb.extents[0].start = start;
+        eb.extents[0].length = length;
+        if (write_block(fs_data, new_block, &eb) != 0) {
+            return -1;
+        }
+        inode->extent_block = new_block;
+        return 0;
+    }
+    
+    uint32_t eb_num = inode->extent_block;
+    simplefs_extent_block_t eb;
+    for (uint32_t hops = 0; ; hops++) {
+        if (hops >= fs_data->superblock.total_blocks || read_block(fs_data, eb_num, &eb) != 0) {
+            return -1;
+        }
+        if (eb.next == 0) {
+            break;
+        }
+        eb_num = eb.next;
+    }
+    
+    if (eb.count > 0 && eb.count <= SIMPLEFS_EXTENTS_PER_BLOCK &&
+        eb.extents[eb.count - 1].start + eb.extents[eb.count - 1].length == start) {
+        eb.extents[eb.count - 1].length += length;
+        return write_block(fs_data, eb_num, &eb);
+    }
+    if (eb.count < SIMPLEFS_EXTENTS_PER_BLOCK) {
+        eb.extents[eb.count].start = start;
+        eb.extents[eb.count].length = length;
+        eb.count++;
+        return write_block(fs_data, eb_num, &eb);
+    }
+    
+    uint32_t new_block = alloc_block(fs_data);
+    if (new_block == 0) {
+        return -1;
+    }
+    simplefs_extent_block_t next_eb;
+    memset(&next_eb, 0, sizeof(next_eb));
+    next_eb.count = 1;
+    next_eb.extents[0].start = start;
+    next_eb.extents[0].length = length;
+    if (write_block(fs_data, new_block, &next_eb) != 0) {
+        return -1;
+    }
+    eb.next = new_block;
+    return write_block(fs_data, eb_num, &eb);
+}
+
+static uint32_t extent_goal(simplefs_data_t* fs_data, simplefs_inode_t* inode) {
+    /* Block just past the file's last extent: where its next run should go. */
+    if (inode->blocks == 0) {
+        return 0;
+    }
+    uint32_t block_num = 0;
+    uint32_t run = 0;
+    if (extent_map(fs_data, inode, inode->blocks - 1, &block_num, &run) != 0) {
+        return 0;
+    }
+    return block_num + 1;
+}
+
+static void extent_free_all(simplefs_data_t* fs_data, simplefs_inode_t* inode) {
+    /* Release every data and extent block of the inode; the caller writes the maps back. */
+    uint32_t n = inode_extent_count(inode);
+    for (uint32_t i = 0; i < n; i++) {
+        free_block_range(fs_data, inode->extents[i].start, inode->extents[i].length);
+    }
+    
+    uint32_t eb_num = inode->extent_block;
+    for (uint32_t hops = 0; eb_num != 0 && hops < fs_data->superblock.total_blocks; hops++) {
+        simplefs_extent_block_t eb;
+        if (read_block(fs_data, eb_num, &eb) != 0) {
+            break;
+        }
+        for (uint32_t i = 0; i < eb.count && i < SIMPLEFS_EXTENTS_PER_BLOCK; i++) {
+            free_block_range(fs_data, eb.extents[i].start, eb.extents[i].length);
+        }
+        free_block_range(fs_data, eb_num, 1);
+        eb_num = eb.next;
+    }
+    
+    memset(inode->extents, 0, sizeof(inode->extents));
+    inode->extent_block = 0;
+}
+
+static simplefs_delalloc_t* delalloc_find(simplefs_data_t* fs_data, uint32_t inode_num) {
+    for (uint32_t i = 0; i < SIMPLEFS_DELALLOC_SLOTS; i++) {
+        if (fs_data->delalloc[i].inode_num == inode_num) {
+            return &fs_data->delalloc[i];
+        }
+    }
+    return NULL;
+}
+
+static int delalloc_reserve(simplefs_data_t* fs_data, uint32_t count) {
+    if (fs_data->superblock.free_blocks < fs_data->reserved_blocks + count) {
+        return -1;
+    }
+    fs_data->reserved_blocks += count;
+    return 0;
+}
+
+static void delalloc_release(simplefs_data_t* fs_data, simplefs_delalloc_t* da) {
+    fs_data->reserved_blocks -= da->count;
+    da->count = 0;
+    da->inode_num = 0;
+}
+
+static int delalloc_flush(simplefs_data_t* fs_data, simplefs_delalloc_t* da) {
+    /* Place the buffered run on disk and map it; the slot stays with its inode. */
+    if (da->inode_num == 0 || da->count == 0) {
+        return VFS_OK;
+    }
+    
+    simplefs_inode_t* inode = &fs_data->inode_table[da->inode_num];
+    uint32_t total = da->count;
+    int result = VFS_OK;
+    uint32_t done = 0;
+    while (done < total) {
+        uint32_t got = 0;
+        uint32_t start = alloc_block_run(fs_data, extent_goal(fs_data, inode), total - done, &got);
+        if (start == 0) {
+            result = VFS_ERR_NOSPACE;
+            break;
+        }
+        if (write_blocks(fs_data, start, got, da->data + done * SIMPLEFS_BLOCK_SIZE) != 0 ||
+            extent_append(fs_data, inode, start, got) != 0) {
+            free_block_range(fs_data, start, got);
+            result = VFS_ERR_IO;
+            break;
+        }
+        inode->blocks += got;
+        done += got;
+    }
+    
+    // Placed blocks leave the buffer; on failure the rest stays buffered and reserved
+    fs_data->reserved_blocks -= done;
+    if (done != 0 && done < total) {
+        memmove(da->data, da->data + done * SIMPLEFS_BLOCK_SIZE, (total - done) * SIMPLEFS_BLOCK_SIZE);
+    }
+    da->count = total - done;
+    da->file_block = inode->blocks;
+    
+    write_alloc_maps(fs_data);
+    write_inode(fs_data, da->inode_num);
+    return result;
+}
+
+static int simplefs_flush_inode(simplefs_data_t* fs_data, uint32_t inode_num) {
+    simplefs_delalloc_t* da = delalloc_find(fs_data, inode_num);
+    if (!da) {
+        return VFS_OK;
+    }
+    int result = delalloc_flush(fs_data, da);
+    if (result == VFS_OK) {
+        da->inode_num = 0;
+    }
+    return result;
+}
+
+static void lazy_clear(simplefs_data_t* fs_data, uint32_t inode_num) {
+    /* The inode is about to be written in full; nothing stays memory-only. */
+    if (inode_num >= SIMPLEFS_MAX_INODES) {
+        return;
+    }
+    uint32_t mask = 1U << (inode_num % 32);
+    process_set_preempt_disabled(1);
+    if (fs_data->lazy_map[inode_num / 32] & mask) {
+        fs_data->lazy_map[inode_num / 32] &= ~mask;
+        fs_data->lazy_count--;
+    }
+    process_set_preempt_disabled(0);
+}
+
+static void simplefs_update_atime(simplefs_data_t* fs_data, simplefs_inode_t* inode, uint32_t inode_num) {
+    /* Apply the mount's atime policy after a read. */
+    uint32_t flags = fs_data->mount_flags;
+    if (flags & VFS_MOUNT_NOATIME) {
+        return;
+    }
+    
+    // A stamp later than now comes from an earlier boot and predates this one
+    uint32_t now = get_current_time();
+    int read_since_change = inode->atime <= now && (inode->mtime > now || inode->atime > inode->mtime);
+    if ((flags & VFS_MOUNT_RELATIME) && read_since_change && now - inode->atime < SIMPLEFS_RELATIME_SECS) {
+        return;  // Already read since the last change, and recently
+    }
+    inode->atime = now;
+    
+    if (!(flags & VFS_MOUNT_LAZYTIME) || inode_num >= SIMPLEFS_MAX_INODES) {
+        write_inode(fs_data, inode_num);
+        return;
+    }
+    uint32_t mask = 1U << (inode_num % 32);
+    process_set_preempt_disabled(1);
+    if (!(fs_data->lazy_map[inode_num / 32] & mask)) {
+        fs_data->lazy_map[inode_num / 32] |= mask;
+        if (fs_data->lazy_count++ == 0) {
+            fs_data->lazy_since_ms = ktime_get_ms();
+        }
+    }
+    process_set_preempt_disabled(0);
+}
+
+static int simplefs_flush_lazytime(simplefs_data_t* fs_data) {
+    /* Write every inode whose only changes are in-memory timestamps. */
+    int result = VFS_OK;
+    for (uint32_t w = 0; w < SIMPLEFS_MAX_INODES / 32 && fs_data->lazy_count != 0; w++) {
+        uint32_t bits;
+        while ((bits = fs_data->lazy_map[w]) != 0) {
+            // write_inode() clears the bit, even when it fails
+            if (write_inode(fs_data, w * 32 + (uint32_t)__builtin_ctz(bits)) != 0) {
+                result = VFS_ERR_IO;
+            }
+        }
+    }
+    return result;
+}
+
+static void simplefs_flush_aged(simplefs_data_t* fs_data) {
+    /* Place appends buffered for a commit interval; their inode sizes wait on them. */
+    uint32_t now = ktime_get_ms();
+    for (uint32_t i = 0; i < SIMPLEFS_DELALLOC_SLOTS; i++) {
+        simplefs_delalloc_t* da = &fs_data->delalloc[i];
+        if (da->inode_num != 0 && da->count != 0 && now - da->since_ms >= SIMPLEFS_JOURNAL_COMMIT_MS) {
+            delalloc_flush(fs_data, da);  // A failure stays buffered for the next pass
+        }
+    }
+}
+
+static int simplefs_flush_all(simplefs_data_t* fs_data) {
+    int result = VFS_OK;
+    for (uint32_t i = 0; i < SIMPLEFS_DELALLOC_SLOTS; i++) {
+        simplefs_delalloc_t* da = &fs_data->delalloc[i];
+        if (da->inode_num == 0) {
+            continue;
+        }
+        if (delalloc_flush(fs_data, da) != VFS_OK) {
+            result = VFS_ERR_IO;  // Keep the slot: a later flush retries it
+        } else {
+            da->inode_num = 0;
+        }
+    }
+    if (simplefs_flush_lazytime(fs_data) != VFS_OK) {
+        result = VFS_ERR_IO;
+    }
+    return result;
+}
+
+static int delalloc_get(simplefs_data_t* fs_data, uint32_t inode_num, simplefs_delalloc_t** slot) {
+    /* The inode's delalloc slot, claiming a free one or flushing a victim if needed. */
+    simplefs_delalloc_t* da = delalloc_find(fs_data, inode_num);
+    if (da) {
+        *slot = da;
+        return VFS_OK;
+    }
+    
+    da = delalloc_find(fs_data, 0);
+    if (!da) {
+        da = &fs_data->delalloc[fs_data->delalloc_next];
+        fs_data->delalloc_next = (fs_data->delalloc_next + 1) % SIMPLEFS_DELALLOC_SLOTS;
+        int result = delalloc_flush(fs_data, da);
+        if (result != VFS_OK) {
+            return result;  // The victim keeps its unplaced blocks
+        }
+        da->inode_num = 0;
+    }
+    
+    if (!da->data) {
+        da->data = (uint8_t*)kmalloc(SIMPLEFS_DELALLOC_BLOCKS * SIMPLEFS_BLOCK_SIZE);
+        if (!da->data) {
+            return VFS_ERR_NOSPACE;
+        }
+    }
+    da->inode_num = inode_num;
+    da->file_block = fs_data->inode_table[inode_num].blocks;
+    da->count = 0;
+    *slot = da;
+    return VFS_OK;
+}
+
+static int delalloc_write(simplefs_data_t* fs_data, uint32_t inode_num, uint32_t block_idx,
+                          uint32_t block_offset, const uint8_t* src, uint32_t len) {
+    /*
+     * Buffer bytes for unmapped file blocks starting at `block_idx`. A gap
+     * past the buffered blocks is zero-filled, so extent files have no holes.
+     * Returns the bytes taken (at most what fits in the buffer) or an error.
+     */
+    simplefs_delalloc_t* da = NULL;
+    int result = delalloc_get(fs_data, inode_num, &da);
+    if (result != VFS_OK) {
+        return result;
+    }
+    
+    // Too far ahead for this buffer: fill it with zeros and place it, repeatedly
+    while (block_idx - da->file_block >= SIMPLEFS_DELALLOC_BLOCKS) {
+        uint32_t pad = SIMPLEFS_DELALLOC_BLOCKS - da->count;
+        if (delalloc_reserve(fs_data, pad) != 0) {
+            return VFS_ERR_NOSPACE;
+        }
+        if (da->count == 0) {
+            da->since_ms = ktime_get_ms();
+        }
+        memset(da->data + da->count * SIMPLEFS_BLOCK_SIZE, 0, pad * SIMPLEFS_BLOCK_SIZE);
+        da->count = SIMPLEFS_DELALLOC_BLOCKS;
+        result = delalloc_flush(fs_data, da);
+        if (result != VFS_OK) {
+            return result;
+        }
+    }
+    
+    uint32_t rel = block_idx - da->file_block;
+    uint32_t room = (SIMPLEFS_DELALLOC_BLOCKS - rel) * SIMPLEFS_BLOCK_SIZE - block_offset;
+    if (len > room) {
+        len = room;
+    }
+    
+    // Newly covered blocks start out zeroed and need reserved space
+    uint32_t end = rel + (block_offset + len + SIMPLEFS_BLOCK_SIZE - 1) / SIMPLEFS_BLOCK_SIZE;
+    if (end > da->count) {
+        if (delalloc_reserve(fs_data, end - da->count) != 0) {
+            return VFS_ERR_NOSPACE;
+        }
+        if (da->count == 0) {
+            da->since_ms = ktime_get_ms();
+        }
+        memset(da->data + da->count * SIMPLEFS_BLOCK_SIZE, 0, (end - da->count) * SIMPLEFS_BLOCK_SIZE);
+        da->count = end;
+    }
+    memcpy(da->data + rel * SIMPLEFS_BLOCK_SIZE + block_offset, src, len);
+    
+    if (da->count == SIMPLEFS_DELALLOC_BLOCKS) {
+        result = delalloc_flush(fs_data, da);
+        if (result != VFS_OK) {
+            return result;
+        }
+    }
+    return (int)len;
+}
+
+static int simplefs_convert_inode(simplefs_data_t* fs_data, uint32_t inode_num) {
+    /*
+     * Online v2 -> v3 conversion of one regular file: rebuild its block map
+     * as extents, filling any holes with zeroed blocks, then release the
+     * indirect blocks. The inode write is the switch-over point.
+     */
+    simplefs_inode_t* inode = &fs_data->inode_table[inode_num];
+    if (!SIMPLEFS_ISREG(inode->mode) || (inode->flags & SIMPLEFS_FL_EXTENTS)) {
+        return 0;
+    }
+    
+    uint32_t nblocks = (inode->size + SIMPLEFS_BLOCK_SIZE - 1) / SIMPLEFS_BLOCK_SIZE;
+    uint32_t holes = 0;
+    for (uint32_t i = 0; i < nblocks; i++) {
+        if (get_file_block(fs_data, inode, i) == 0) {
+            holes++;
+        }
+    }
+    // Worst case: every block its own extent; never fail halfway through
+    uint32_t worst = holes + nblocks / SIMPLEFS_EXTENTS_PER_BLOCK + 1;
+    if (fs_data->superblock.free_blocks < fs_data->reserved_blocks + worst) {
+        return -1;
+    }
+    
+    simplefs_inode_t converted = *inode;
+    memset(converted.extents, 0, sizeof(converted.extents));
+    converted.extent_block = 0;
+    converted.flags |= SIMPLEFS_FL_EXTENTS;
+    converted.blocks = 0;
+    
+    for (uint32_t i = 0; i < nblocks; i++) {
+        uint32_t block_num = get_file_block(fs_data, inode, i);
+        if (block_num == 0) {
+            block_num = alloc_block(fs_data);
+        }
+        if (block_num == 0 || extent_append(fs_data, &converted, block_num, 1) != 0) {
+            return -1;
+        }
+        converted.blocks++;
+    }
+    
+    uint32_t indirect = inode->indirect_ptr;
+    uint32_t double_indirect = inode->double_indirect_ptr;
+    *inode = converted;
+    write_inode(fs_data, inode_num);
+    
+    if (indirect != 0) {
+        free_block_range(fs_data, indirect, 1);
+    }
+    if (double_indirect != 0) {
+        uint32_t l1_block[SIMPLEFS_BLOCK_SIZE / sizeof(uint32_t)];
+        if (read_block(fs_data, double_indirect, l1_block) == 0) {
+            for (uint32_t i = 0; i < SIMPLEFS_BLOCK_SIZE / sizeof(uint32_t); i++) {
+                if (l1_block[i] != 0) {
+                    free_block_range(fs_data, l1_block[i], 1);
+                }
+            }
+        }
+        free_block_range(fs_data, double_indirect, 1);
+    }
+    write_alloc_maps(fs_data);
+    return 0;
+}
+
+static uint32_t alloc_inode(simplefs_data_t* fs_data) {
+    // serial_puts("alloc_inode: searching for free inode...\n");
+    // serial_puts("alloc_inode: total_inodes=");
+    // itoa(fs_data->superblock.total_inodes, buf, 10);
+    // serial_puts(buf);
+    // serial_puts(", free_inodes=");
+    // itoa(fs_data->superblock.free_inodes, buf, 10);
+    // serial_puts(buf);
+    // serial_puts("\n");
+    
+    // Find free inode in bitmap
+    for (uint32_t i = 1; i < fs_data->superblock.total_inodes; i++) { // Start from 1, 0 is reserved
+        uint32_t byte_idx = i / 8;
+        uint32_t bit_idx = i % 8;
+        
+        if (!(fs_data->inode_bitmap[byte_idx] & (1 << bit_idx))) {
+            // Found free inode
+            // serial_puts("alloc_inode: found free inode ");
+            // itoa(i, buf, 10);
+            // serial_puts(buf);
+            // serial_puts("\n");
+            
+            // Mark as allocated
+            fs_data->inode_bitmap[byte_idx] |= (1 << bit_idx);
+            fs_data->superblock.free_inodes--;
+            
+            // Write back bitmap
+            write_block(fs_data, fs_data->superblock.inode_bitmap_block, fs_data->inode_bitmap);
+            
+            // Write back superblock
+            write_block(fs_data, 0, &fs_data->superblock);
+            
+            // Initialize inode
+            simplefs_inode_t* inode = &fs_data->inode_table[i];
+            memset(inode, 0, sizeof(simplefs_inode_t));
+            
+            return i;
+        }
+    }
+    
+    // serial_puts("alloc_inode: NO FREE INODES FOUND!\n");
+    return 0; // No free inodes
+}
+
+static void free_block_num(simplefs_data_t* fs_data, uint32_t block_num) {
+    if (block_num == 0 || block_num >= fs_data->superblock.total_blocks) {
+        return;
+    }
+    
+    uint32_t byte_idx = block_num / 8;
+    uint32_t bit_idx = block_num % 8;
+    
+    // Check if block is already free
+    if (!(fs_data->block_bitmap[byte_idx] & (1 << bit_idx))) {
+        return; // Already free
+    }
+    
+    fs_data->block_bitmap[byte_idx] &= ~(1 << bit_idx);
+    fs_data->superblock.free_blocks++;
+    
+    // Write back bitmap and superblock
+    write_block(fs_data, fs_data->superblock.block_bitmap_block, fs_data->block_bitmap);
+    write_block(fs_data, 0, &fs_data->superblock);
+}
+
+static void free_inode(simplefs_data_t* fs_data, uint32_t inode_num) {
+    if (inode_num == 0 || inode_num >= fs_data->superblock.total_inodes) {
+        return;
+    }
+    
+    uint32_t byte_idx = inode_num / 8;
+    uint32_t bit_idx = inode_num % 8;
+    
+    fs_data->inode_bitmap[byte_idx] &= ~(1 << bit_idx);
+    fs_data->superblock.free_inodes++;
+    
+    // Write back bitmap and superblock
+    write_block(fs_data, fs_data->superblock.inode_bitmap_block, fs_data->inode_bitmap);
+    write_block(fs_data, 0, &fs_data->superblock);
+}
+
+/*
+ * Directory blocks hold variable-length records chained by rec_len, the
+ * last one running to the end of the block. Blocks written before records
+ * were packed hold one fixed-size record and a zeroed tail; a rec_len of 0
+ * marks such a tail, like a fresh block, as free space to the end.
+ *
+ * Small directories are a list of these blocks in block_ptrs[]. Once one
+ * outgrows SIMPLEFS_DIR_LINEAR_BLOCKS it is converted to a hashed index
+ * (SIMPLEFS_FL_INDEX): block_ptrs[0] is the root node, with at most one
+ * level of interior nodes below it, and the leaves are ordinary directory
+ * blocks. Every name hashing into an entry's range lives in that entry's
+ * leaf, so a lookup reads at most three blocks whatever the directory size.
+ */
+
+#define DIRENT_HEADER_SIZE   8
+#define DIRENT_MAX_PER_BLOCK (SIMPLEFS_BLOCK_SIZE / 12)
+#define DX_LEAF_FILL         (SIMPLEFS_BLOCK_SIZE * 3 / 4)  // Slack left in leaves built by conversion
+
+static uint32_t dirent_size(uint32_t name_len) {
+    return (DIRENT_HEADER_SIZE + name_len + 1 + 3) & ~3U;
+}
+
+static uint32_t dx_hash(const char* name, uint32_t len) {
+    // FNV-1a
+    uint32_t hash = 2166136261U;
+    for (uint32_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+static simplefs_dirent_t* dirblock_entry(uint8_t* block, uint32_t offset) {
+    /* The record at offset, or NULL at the end of the block's records. */
+    if (offset + DIRENT_HEADER_SIZE > SIMPLEFS_BLOCK_SIZE) {
+        return NULL;
+    }
+    simplefs_dirent_t* de = (simplefs_dirent_t*)(block + offset);
+    if (de->rec_len < DIRENT_HEADER_SIZE || offset + de->rec_len > SIMPLEFS_BLOCK_SIZE) {
+        return NULL;
+    }
+    return de;
+}
+
+static int dirblock_find(uint8_t* block, const char* name, uint32_t name_len, uint32_t* offset, int32_t* prev) {
+    int32_t last = -1;
+    simplefs_dirent_t* de;
+    for (uint32_t off = 0; (de = dirblock_entry(block, off)) != NULL; off += de->rec_len) {
+        if (de->inode != 0 && de->name_len == name_len && memcmp(de->name, name, name_len) == 0) {
+            *offset = off;
+            if (prev) *prev = last;
+            return 0;
+        }
+        last = (int32_t)off;
+    }
+    return -1;
+}
+
+static int dirblock_insert(uint8_t* block, const char* name, uint32_t name_len, uint32_t inode_num, uint8_t type) {
+    /* Place a record in the first gap that fits; -1 when the block is full. */
+    uint32_t need = dirent_size(name_len);
+    uint32_t off = 0;
+
+    while (off + DIRENT_HEADER_SIZE <= SIMPLEFS_BLOCK_SIZE) {
+        simplefs_dirent_t* de = (simplefs_dirent_t*)(block + off);
+        uint32_t rec_len = de->rec_len;
+        uint32_t used = 0;
+
+        if (rec_len == 0) {
+            // Zeroed tail: free up to the end of the block
+            rec_len = SIMPLEFS_BLOCK_SIZE - off;
+        } else if (rec_len < DIRENT_HEADER_SIZE || off + rec_len > SIMPLEFS_BLOCK_SIZE) {
+            return -1;
+        } else if (de->inode != 0) {
+            used = dirent_size(de->name_len);
+        }
+
+        if (rec_len >= used + need) {
+            if (used != 0) {
+                // Split the live record's slack off into the new one
+                de->rec_len = (uint16_t)used;
+                de = (simplefs_dirent_t*)(block + off + used);
+                rec_len -= used;
+            }
+            de->inode = inode_num;
+            de->rec_len = (uint16_t)rec_len;
+            de->name_len = (uint8_t)name_len;
+            de->file_type = type;
+            memcpy(de->name, name, name_len);
+            de->name[name_len] = '\0';
+            return 0;
+        }
+        off += rec_len;
+    }
+    return -1;
+}
+
+static void dirblock_remove(uint8_t* block, uint32_t offset, int32_t prev) {
+    simplefs_dirent_t* de = (simplefs_dirent_t*)(block + offset);
+    if (prev >= 0) {
+        // Give the space back to the record in front
+        simplefs_dirent_t* before = (simplefs_dirent_t*)(block + prev);
+        before->rec_len = (uint16_t)(before->rec_len + de->rec_len);
+    } else {
+        de->inode = 0;
+        de->name_len = 0;
+    }
+}
+
+static uint32_t dx_search(const simplefs_dx_node_t* node, uint32_t hash) {
+    /* Last entry whose range starts at or below hash. */
+    uint32_t lo = 1;
+    uint32_t hi = node->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (node->entries[mid].hash <= hash) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo - 1;
+}
+
+static int dx_read_node(simplefs_data_t* fs_data, uint32_t block_num, simplefs_dx_node_t* node) {
+    if (read_block(fs_data, block_num, node) != 0 || node->magic != SIMPLEFS_DX_MAGIC ||
+        node->count == 0 || node->count > SIMPLEFS_DX_ENTRIES) {
+        return -1;
+    }
+    return 0;
+}
+
+typedef struct {
+    uint32_t root_pos;
+    uint32_t node_block;         // Interior node, 0 when the root points at leaves
+    uint32_t node_pos;
+    uint32_t leaf;
+} dx_path_t;
+
+static int dx_lookup(simplefs_data_t* fs_data, simplefs_inode_t* dir, uint32_t hash,
+                     simplefs_dx_node_t* root, simplefs_dx_node_t* node, dx_path_t* path) {
+    /* Walk from the root to the leaf that holds (or would hold) hash. */
+    if (dx_read_node(fs_data, dir->block_ptrs[0], root) != 0 || root->levels > 1) {
+        return -1;
+    }
+    path->root_pos = dx_search(root, hash);
+    path->node_block = 0;
+    path->node_pos = 0;
+    path->leaf = root->entries[path->root_pos].block;
+    if (root->levels == 0) {
+        return 0;
+    }
+
+    path->node_block = path->leaf;
+    if (dx_read_node(fs_data, path->node_block, node) != 0) {
+        return -1;
+    }
+    path->node_pos = dx_search(node, hash);
+    path->leaf = node->entries[path->node_pos].block;
+    return 0;
+}
+
+static uint32_t dir_block_at(simplefs_data_t* fs_data, simplefs_inode_t* dir, uint32_t n) {
+    /* The n-th block of directory entries (leaves in hash order), 0 past the end. */
+    if (!(dir->flags & SIMPLEFS_FL_INDEX)) {
+        return n < SIMPLEFS_DIRECT_BLOCKS ? dir->block_ptrs[n] : 0;
+    }
+
+    simplefs_dx_node_t node;
+    if (dx_read_node(fs_data, dir->block_ptrs[0], &node) != 0) {
+        return 0;
+    }
+    if (node.levels == 0) {
+        return n < node.count ? node.entries[n].block : 0;
+    }
+
+    uint32_t children = node.count;
+    uint32_t child_blocks[SIMPLEFS_DX_ENTRIES];
+    for (uint32_t i = 0; i < children; i++) {
+        child_blocks[i] = node.entries[i].block;
+    }
+    for (uint32_t i = 0; i < children; i++) {
+        if (dx_read_node(fs_data, child_blocks[i], &node) != 0) {
+            return 0;
+        }
+        if (n < node.count) {
+            return node.entries[n].block;
+        }
+        n -= node.count;
+    }
+    return 0;
+}
+
+static int dir_find(simplefs_data_t* fs_data, simplefs_inode_t* dir, const char* name, uint8_t* block,
+                    uint32_t* block_num, uint32_t* offset, int32_t* prev) {
+    /* Read the block holding name into `block`; 0 when found. */
+    uint32_t name_len = strlen(name);
+    if (name_len == 0 || name_len > SIMPLEFS_MAX_FILENAME) {
+        return -1;
+    }
+
+    if (dir->flags & SIMPLEFS_FL_INDEX) {
+        simplefs_dx_node_t root;
+        simplefs_dx_node_t node;
+        dx_path_t path;
+        if (dx_lookup(fs_data, dir, dx_hash(name, name_len), &root, &node, &path) != 0 ||
+            read_block(fs_data, path.leaf, block) != 0) {
+            return -1;
+        }
+        *block_num = path.leaf;
+        return dirblock_find(block, name, name_len, offset, prev);
+    }
+
+    for (uint32_t i = 0; i < SIMPLEFS_DIRECT_BLOCKS && dir->block_ptrs[i] != 0; i++) {
+        if (read_block(fs_data, dir->block_ptrs[i], block) != 0) {
+            continue;
+        }
+        if (dirblock_find(block, name, name_len, offset, prev) == 0) {
+            *block_num = dir->block_ptrs[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int dir_is_empty(simplefs_data_t* fs_data, simplefs_inode_t* dir) {
+    uint8_t block[SIMPLEFS_BLOCK_SIZE];
+    uint32_t block_num;
+    for (uint32_t n = 0; (block_num = dir_block_at(fs_data, dir, n)) != 0; n++) {
+        if (read_block(fs_data, block_num, block) != 0) {
+            return 0;  // Unreadable: refuse to remove it
+        }
+        simplefs_dirent_t* de;
+        for (uint32_t off = 0; (de = dirblock_entry(block, off)) != NULL; off += de->rec_len) {
+            if (de->inode != 0) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static void dx_sort(uint32_t* hashes, uint32_t* keys, uint32_t count) {
+    /* Insertion sort by hash; keys travel with their hash. */
+    for (uint32_t i = 1; i < count; i++) {
+        uint32_t hash = hashes[i];
+        uint32_t key = keys[i];
+        uint32_t j = i;
+        while (j > 0 && hashes[j - 1] > hash) {
+            hashes[j] = hashes[j - 1];
+            keys[j] = keys[j - 1];
+            j--;
+        }
+        hashes[j] = hash;
+        keys[j] = key;
+    }
+}
+
+static void dx_insert_entry(simplefs_dx_node_t* node, uint32_t pos, uint32_t hash, uint32_t block_num) {
+    for (uint32_t i = node->count; i > pos; i--) {
+        node->entries[i] = node->entries[i - 1];
+    }
+    node->entries[pos].hash = hash;
+    node->entries[pos].block = block_num;
+    node->count++;
+}
+
+static int dx_split_leaf(simplefs_data_t* fs_data, simplefs_inode_t* dir, simplefs_dx_node_t* parent,
+                         uint32_t parent_block, uint32_t pos, uint32_t leaf_block, uint8_t* leaf) {
+    /* Move the upper half of a full leaf, by hash, into a new leaf after it. */
+    uint32_t hashes[DIRENT_MAX_PER_BLOCK];
+    uint32_t offsets[DIRENT_MAX_PER_BLOCK];
+    uint32_t count = 0;
+    simplefs_dirent_t* de;
+
+    for (uint32_t off = 0; (de = dirblock_entry(leaf, off)) != NULL && count < DIRENT_MAX_PER_BLOCK; off += de->rec_len) {
+        if (de->inode != 0) {
+            hashes[count] = dx_hash(de->name, de->name_len);
+            offsets[count] = off;
+            count++;
+        }
+    }
+    dx_sort(hashes, offsets, count);
+
+    // Never split a run of equal hashes: a lookup only visits one leaf
+    uint32_t split = count / 2;
+    while (split < count && split > 0 && hashes[split] == hashes[split - 1]) {
+        split++;
+    }
+    if (split >= count) {
+        split = count / 2;
+        while (split > 0 && hashes[split] == hashes[split - 1]) {
+            split--;
+        }
+    }
+    if (split == 0) {
+        return VFS_ERR_NOSPACE;
+    }
+
+    uint32_t new_block = alloc_block(fs_data);
+    if (new_block == 0) {
+        return VFS_ERR_NOSPACE;
+    }
+    uint8_t* halves = (uint8_t*)kmalloc(SIMPLEFS_BLOCK_SIZE * 2);
+    if (!halves) {
+        free_block_num(fs_data, new_block);
+        return VFS_ERR_NOSPACE;
+    }
+    memset(halves, 0, SIMPLEFS_BLOCK_SIZE * 2);
+    for (uint32_t i = 0; i < count; i++) {
+        de = (simplefs_dirent_t*)(leaf + offsets[i]);
+        uint8_t* half = halves + (i < split ? 0 : SIMPLEFS_BLOCK_SIZE);
+        dirblock_insert(half, de->name, de->name_len, de->inode, de->file_type);
+    }
+
+    int result = VFS_OK;
+    dx_insert_entry(parent, pos + 1, hashes[split], new_block);
+    dir->blocks++;
+    if (write_block(fs_data, new_block, halves + SIMPLEFS_BLOCK_SIZE) != 0 ||
+        write_block(fs_data, leaf_block, halves) != 0 ||
+        write_block(fs_data, parent_block, parent) != 0) {
+        result = VFS_ERR_IO;
+    }
+    kfree(halves);
+    return result;
+}
+
+static int dx_split_node(simplefs_data_t* fs_data, simplefs_inode_t* dir, simplefs_dx_node_t* root,
+                         uint32_t pos, simplefs_dx_node_t* node, uint32_t node_block) {
+    /* Move the upper half of a full interior node into a new node after it. */
+    uint32_t new_block = alloc_block(fs_data);
+    if (new_block == 0) {
+        return VFS_ERR_NOSPACE;
+    }
+
+    simplefs_dx_node_t upper;
+    memset(&upper, 0, sizeof(upper));
+    upper.magic = SIMPLEFS_DX_MAGIC;
+    uint32_t split = node->count / 2;
+    upper.count = (uint16_t)(node->count - split);
+    memcpy(upper.entries, &node->entries[split], upper.count * sizeof(simplefs_dx_entry_t));
+    node->count = (uint16_t)split;
+
+    dx_insert_entry(root, pos + 1, upper.entries[0].hash, new_block);
+    dir->blocks++;
+    if (write_block(fs_data, new_block, &upper) != 0 ||
+        write_block(fs_data, node_block, node) != 0 ||
+        write_block(fs_data, dir->block_ptrs[0], root) != 0) {
+        return VFS_ERR_IO;
+    }
+    return VFS_OK;
+}
+
+static int dx_grow_root(simplefs_data_t* fs_data, simplefs_inode_t* dir, simplefs_dx_node_t* root) {
+    /* Push a full leaf-level root down into an interior node. */
+    uint32_t new_block = alloc_block(fs_data);
+    if (new_block == 0) {
+        return VFS_ERR_NOSPACE;
+    }
+
+    simplefs_dx_node_t child = *root;
+    child.levels = 0;
+    root->levels = 1;
+    root->count = 1;
+    root->entries[0].hash = 0;
+    root->entries[0].block = new_block;
+    dir->blocks++;
+    if (write_block(fs_data, new_block, &child) != 0 || write_block(fs_data, dir->block_ptrs[0], root) != 0) {
+        return VFS_ERR_IO;
+    }
+    return VFS_OK;
+}
+
+static int dx_add(simplefs_data_t* fs_data, simplefs_inode_t* dir, const char* name, uint32_t name_len,
+                  uint32_t inode_num, uint8_t type) {
+    uint32_t hash = dx_hash(name, name_len);
+    simplefs_dx_node_t root;
+    simplefs_dx_node_t node;
+    uint8_t leaf[SIMPLEFS_BLOCK_SIZE];
+    dx_path_t path;
+
+    // Each pass either inserts or makes room one level up, then looks up again
+    for (uint32_t pass = 0; pass < 6; pass++) {
+        if (dx_lookup(fs_data, dir, hash, &root, &node, &path) != 0 ||
+            read_block(fs_data, path.leaf, leaf) != 0) {
+            return VFS_ERR_IO;
+        }
+        if (dirblock_insert(leaf, name, name_len, inode_num, type) == 0) {
+            return write_block(fs_data, path.leaf, leaf) == 0 ? VFS_OK : VFS_ERR_IO;
         }
-        
-        // Allocate level 2 indirect block if needed
-        if (l1_block[l1_idx] == 0) {
-            l1_block[l1_idx] = alloc_block(fs_data);
-            if (l1_block[l1_idx] == 0) {
-                return -1;
+
+        int result;
+        if (path.node_block == 0) {
+            if (root.count < SIMPLEFS_DX_ENTRIES) {
+                result = dx_split_leaf(fs_data, dir, &root, dir->block_ptrs[0], path.root_pos, path.leaf, leaf);
+            } else {
+                result = dx_grow_root(fs_data, dir, &root);
             }
-            write_block(fs_data, inode->double_indirect_ptr, l1_block);
+        } else if (node.count < SIMPLEFS_DX_ENTRIES) {
+            result = dx_split_leaf(fs_data, dir, &node, path.node_block, path.node_pos, path.leaf, leaf);
+        } else if (root.count < SIMPLEFS_DX_ENTRIES) {
+            result = dx_split_node(fs_data, dir, &root, path.root_pos, &node, path.node_block);
+        } else {
+            result = VFS_ERR_NOSPACE;  // Both levels full
         }
-        
-        uint32_t l2_block[ptrs_per_block];
-        if (read_block(fs_data, l1_block[l1_idx], l2_block) != 0) {
-            return -1;
+        if (result != VFS_OK) {
+            return result;
         }
-        
-        l2_block[l2_idx] = block_num;
-        
-        return write_block(fs_data, l1_block[l1_idx], l2_block);
     }
-    
-    // Beyond double indirect (not supported yet)
-    return -1;
+    return VFS_ERR_NOSPACE;
 }
 
-static uint32_t alloc_inode(simplefs_data_t* fs_data) {
-    // serial_puts("alloc_inode: searching for free inode...\n");
-    // serial_puts("alloc_inode: total_inodes=");
-    // itoa(fs_data->superblock.total_inodes, buf, 10);
-    // serial_puts(buf);
-    // serial_puts(", free_inodes=");
-    // itoa(fs_data->superblock.free_inodes, buf, 10);
-    // serial_puts(buf);
-    // serial_puts("\n");
-    
-    // Find free inode in bitmap
-    for (uint32_t i = 1; i < fs_data->superblock.total_inodes; i++) { // Start from 1, 0 is reserved
-        uint32_t byte_idx = i / 8;
-        uint32_t bit_idx = i % 8;
-        
-        if (!(fs_data->inode_bitmap[byte_idx] & (1 << bit_idx))) {
-            // Found free inode
-            // serial_puts("alloc_inode: found free inode ");
-            // itoa(i, buf, 10);
-            // serial_puts(buf);
-            // serial_puts("\n");
-            
-            // Mark as allocated
-            fs_data->inode_bitmap[byte_idx] |= (1 << bit_idx);
-            fs_data->superblock.free_inodes--;
-            
-            // Write back bitmap
-            write_block(fs_data, fs_data->superblock.inode_bitmap_block, fs_data->inode_bitmap);
-            
-            // Write back superblock
-            write_block(fs_data, 0, &fs_data->superblock);
-            
-            // Initialize inode
-            simplefs_inode_t* inode = &fs_data->inode_table[i];
-            memset(inode, 0, sizeof(simplefs_inode_t));
-            
-            return i;
+static int dx_convert(simplefs_data_t* fs_data, simplefs_inode_t* dir) {
+    /* Rebuild a full linear directory as an index root over hash-ordered leaves. */
+    uint32_t nblocks = 0;
+    while (nblocks < SIMPLEFS_DIRECT_BLOCKS && dir->block_ptrs[nblocks] != 0) {
+        nblocks++;
+    }
+
+    uint32_t max_entries = nblocks * DIRENT_MAX_PER_BLOCK;
+    uint8_t* blocks = (uint8_t*)kmalloc(nblocks * SIMPLEFS_BLOCK_SIZE);
+    uint32_t* hashes = (uint32_t*)kmalloc(max_entries * sizeof(uint32_t));
+    uint32_t* refs = (uint32_t*)kmalloc(max_entries * sizeof(uint32_t));
+    uint8_t* leaf = (uint8_t*)kmalloc(SIMPLEFS_BLOCK_SIZE);
+    int result = VFS_OK;
+    if (!blocks || !hashes || !refs || !leaf) {
+        result = VFS_ERR_NOSPACE;
+        goto out;
+    }
+
+    // Gather every live record as (hash, position in `blocks`)
+    uint32_t count = 0;
+    for (uint32_t b = 0; b < nblocks; b++) {
+        uint8_t* block = blocks + b * SIMPLEFS_BLOCK_SIZE;
+        if (read_block(fs_data, dir->block_ptrs[b], block) != 0) {
+            result = VFS_ERR_IO;
+            goto out;
+        }
+        simplefs_dirent_t* de;
+        for (uint32_t off = 0; (de = dirblock_entry(block, off)) != NULL && count < max_entries; off += de->rec_len) {
+            if (de->inode != 0) {
+                hashes[count] = dx_hash(de->name, de->name_len);
+                refs[count] = b * SIMPLEFS_BLOCK_SIZE + off;
+                count++;
+            }
         }
     }
-    
-    // serial_puts("alloc_inode: NO FREE INODES FOUND!\n");
-    return 0; // No free inodes
-}
+    dx_sort(hashes, refs, count);
 
-static void free_block_num(simplefs_data_t* fs_data, uint32_t block_num) {
-    if (block_num == 0 || block_num >= fs_data->superblock.total_blocks) {
-        return;
+    uint32_t root_block = alloc_block(fs_data);
+    if (root_block == 0) {
+        result = VFS_ERR_NOSPACE;
+        goto out;
     }
-    
-    uint32_t byte_idx = block_num / 8;
-    uint32_t bit_idx = block_num % 8;
-    
-    // Check if block is already free
-    if (!(fs_data->block_bitmap[byte_idx] & (1 << bit_idx))) {
-        return; // Already free
+    simplefs_dx_node_t root;
+    memset(&root, 0, sizeof(root));
+    root.magic = SIMPLEFS_DX_MAGIC;
+
+    // Fill leaves to DX_LEAF_FILL, closing one only between distinct hashes
+    uint32_t i = 0;
+    do {
+        uint32_t leaf_block = (root.count < SIMPLEFS_DX_ENTRIES) ? alloc_block(fs_data) : 0;
+        if (leaf_block == 0) {
+            result = VFS_ERR_NOSPACE;
+            break;
+        }
+        root.entries[root.count].hash = (root.count == 0) ? 0 : hashes[i];
+        root.entries[root.count].block = leaf_block;
+        root.count++;
+
+        memset(leaf, 0, SIMPLEFS_BLOCK_SIZE);
+        uint32_t used = 0;
+        while (i < count) {
+            simplefs_dirent_t* de = (simplefs_dirent_t*)(blocks + refs[i]);
+            uint32_t size = dirent_size(de->name_len);
+            int same_hash = (used != 0 && hashes[i] == hashes[i - 1]);
+            if (used != 0 && used + size > DX_LEAF_FILL && !same_hash) {
+                break;
+            }
+            if (dirblock_insert(leaf, de->name, de->name_len, de->inode, de->file_type) != 0) {
+                result = VFS_ERR_NOSPACE;  // A run of equal hashes overflows one leaf
+                break;
+            }
+            used += size;
+            i++;
+        }
+        if (result == VFS_OK && write_block(fs_data, leaf_block, leaf) != 0) {
+            result = VFS_ERR_IO;
+        }
+    } while (result == VFS_OK && i < count);
+
+    if (result == VFS_OK && write_block(fs_data, root_block, &root) != 0) {
+        result = VFS_ERR_IO;
     }
-    
-    fs_data->block_bitmap[byte_idx] &= ~(1 << bit_idx);
-    fs_data->superblock.free_blocks++;
-    
-    // Write back bitmap and superblock
-    write_block(fs_data, fs_data->superblock.block_bitmap_block, fs_data->block_bitmap);
-    write_block(fs_data, 0, &fs_data->superblock);
+    if (result != VFS_OK) {
+        // The linear blocks are untouched; drop the partial index
+        for (uint32_t e = 0; e < root.count; e++) {
+            free_block_num(fs_data, root.entries[e].block);
+        }
+        free_block_num(fs_data, root_block);
+        goto out;
+    }
+
+    for (uint32_t b = 0; b < nblocks; b++) {
+        free_block_num(fs_data, dir->block_ptrs[b]);
+        dir->block_ptrs[b] = 0;
+    }
+    dir->block_ptrs[0] = root_block;
+    dir->blocks = 1 + root.count;
+    dir->flags |= SIMPLEFS_FL_INDEX;
+
+out:
+    if (blocks) kfree(blocks);
+    if (hashes) kfree(hashes);
+    if (refs) kfree(refs);
+    if (leaf) kfree(leaf);
+    return result;
 }
 
-static void free_inode(simplefs_data_t* fs_data, uint32_t inode_num) {
-    if (inode_num == 0 || inode_num >= fs_data->superblock.total_inodes) {
-        return;
+static void dx_free(simplefs_data_t* fs_data, simplefs_inode_t* dir) {
+    /* Release every index node and leaf of an indexed directory. */
+    simplefs_dx_node_t root;
+    if (dx_read_node(fs_data, dir->block_ptrs[0], &root) == 0) {
+        for (uint32_t i = 0; i < root.count; i++) {
+            simplefs_dx_node_t node;
+            if (root.levels != 0 && dx_read_node(fs_data, root.entries[i].block, &node) == 0) {
+                for (uint32_t j = 0; j < node.count; j++) {
+                    free_block_num(fs_data, node.entries[j].block);
+                }
+            }
+            free_block_num(fs_data, root.entries[i].block);
+        }
     }
-    
-    uint32_t byte_idx = inode_num / 8;
-    uint32_t bit_idx = inode_num % 8;
-    
-    fs_data->inode_bitmap[byte_idx] &= ~(1 << bit_idx);
-    fs_data->superblock.free_inodes++;
-    
-    // Write back bitmap and superblock
-    write_block(fs_data, fs_data->superblock.inode_bitmap_block, fs_data->inode_bitmap);
-    write_block(fs_data, 0, &fs_data->superblock);
+    free_block_num(fs_data, dir->block_ptrs[0]);
+    dir->block_ptrs[0] = 0;
+    dir->flags &= ~SIMPLEFS_FL_INDEX;
+}
+
+static int dir_add_entry(simplefs_data_t* fs_data, uint32_t dir_inode_num, const char* name,
+                         uint32_t inode_num, uint8_t type) {
+    /* Link name -> inode_num into a directory, growing or indexing it as needed. */
+    simplefs_inode_t* dir = &fs_data->inode_table[dir_inode_num];
+    uint32_t name_len = strlen(name);
+    if (name_len == 0 || name_len > SIMPLEFS_MAX_FILENAME) {
+        return VFS_ERR_INVALID;
+    }
+
+    int result = VFS_ERR_NOSPACE;
+    if (!(dir->flags & SIMPLEFS_FL_INDEX)) {
+        uint8_t block[SIMPLEFS_BLOCK_SIZE];
+        uint32_t block_idx = 0;
+        for (; block_idx < SIMPLEFS_DIRECT_BLOCKS && dir->block_ptrs[block_idx] != 0; block_idx++) {
+            if (read_block(fs_data, dir->block_ptrs[block_idx], block) == 0 &&
+                dirblock_insert(block, name, name_len, inode_num, type) == 0) {
+                return write_block(fs_data, dir->block_ptrs[block_idx], block) == 0 ? VFS_OK : VFS_ERR_IO;
+            }
+        }
+
+        if (block_idx < SIMPLEFS_DIR_LINEAR_BLOCKS) {
+            uint32_t new_block = alloc_block(fs_data);
+            if (new_block == 0) {
+                return VFS_ERR_NOSPACE;
+            }
+            memset(block, 0, SIMPLEFS_BLOCK_SIZE);
+            dirblock_insert(block, name, name_len, inode_num, type);
+            dir->block_ptrs[block_idx] = new_block;
+            dir->blocks++;
+            result = write_block(fs_data, new_block, block) == 0 ? VFS_OK : VFS_ERR_IO;
+            write_inode(fs_data, dir_inode_num);
+            return result;
+        }
+
+        result = dx_convert(fs_data, dir);
+        if (result != VFS_OK) {
+            return result;
+        }
+    }
+
+    result = dx_add(fs_data, dir, name, name_len, inode_num, type);
+    write_inode(fs_data, dir_inode_num);
+    return result;
 }
 
 static void free_inode_blocks(simplefs_data_t* fs_data, uint32_t inode_num) {
@@ -492,6 +1799,24 @@ static void free_inode_blocks(simplefs_data_t* fs_data, uint32_t inode_num) {
     simplefs_inode_t* inode = &fs_data->inode_table[inode_num];
     uint32_t ptrs_per_block = SIMPLEFS_BLOCK_SIZE / sizeof(uint32_t);
     
+    if (inode->flags & SIMPLEFS_FL_EXTENTS) {
+        // Buffered appends never reached the disk; just drop them
+        simplefs_delalloc_t* da = delalloc_find(fs_data, inode_num);
+        if (da) {
+            delalloc_release(fs_data, da);
+        }
+        extent_free_all(fs_data, inode);
+        write_alloc_maps(fs_data);
+        inode->blocks = 0;
+        inode->size = 0;
+        write_inode(fs_data, inode_num);
+        return;
+    }
+    
+    if (inode->flags & SIMPLEFS_FL_INDEX) {
+        dx_free(fs_data, inode);
+    }
+    
     // Free all direct blocks
     for (uint32_t i = 0; i < SIMPLEFS_DIRECT_BLOCKS; i++) {
         if (inode->block_ptrs[i] != 0) {
@@ -542,6 +1867,7 @@ static void free_inode_blocks(simplefs_data_t* fs_data, uint32_t inode_num) {
 }
 
 static int write_inode(simplefs_data_t* fs_data, uint32_t inode_num) {
+    lazy_clear(fs_data, inode_num);
     if (inode_num >= fs_data->superblock.total_inodes) {
         return -1;
     }
@@ -557,7 +1883,16 @@ static int write_inode(simplefs_data_t* fs_data, uint32_t inode_num) {
         return -1;
     }
     
-    memcpy(block + offset, &fs_data->inode_table[inode_num], sizeof(simplefs_inode_t));
+    simplefs_inode_t* disk = (simplefs_inode_t*)(block + offset);
+    memcpy(disk, &fs_data->inode_table[inode_num], sizeof(simplefs_inode_t));
+    
+    // Blocks still buffered have no disk location yet: the on-disk size
+    // stops at the placed ones, so a crash never exposes unwritten blocks
+    simplefs_delalloc_t* da = inode_num != 0 ? delalloc_find(fs_data, inode_num) : NULL;
+    if (da && da->count != 0 && disk->size > da->file_block * SIMPLEFS_BLOCK_SIZE) {
+        disk->size = da->file_block * SIMPLEFS_BLOCK_SIZE;
+        disk->size_high = 0;
+    }
     
     return write_block(fs_data, block_num, block);
 }
@@ -635,12 +1970,13 @@ static vnode_t* simplefs_inode_to_vnode(simplefs_data_t* fs_data, uint32_t inode
 // Filesystem operations implementation
 
 static int simplefs_mount(filesystem_t* fs, const char* source, uint32_t flags) {
-    (void)flags;
-    
     // serial_puts("SimpleFS: Mounting filesystem...\n");
     
-    if (!ata_drive_available()) {
-        // serial_puts("SimpleFS: No ATA drive available\n");
+    // Source names the disk and start LBA (`dev=vda lba=2048`); default is disk 0, LBA 0
+    uint32_t dev = 0;
+    uint32_t start_lba = 0;
+    if (blk_parse_source(source, &dev, &start_lba) != 0 || !blk_get_device(dev)) {
+        // serial_puts("SimpleFS: No such block device\n");
         return VFS_ERR_IO;
     }
     
@@ -651,7 +1987,9 @@ static int simplefs_mount(filesystem_t* fs, const char* source, uint32_t flags)
     }
     
     memset(fs_data, 0, sizeof(simplefs_data_t));
-    fs_data->start_lba = simplefs_parse_source_lba(source);
+    fs_data->dev = dev;
+    fs_data->start_lba = start_lba;
+    fs_data->mount_flags = flags;
     
     // Read superblock
     if (read_block(fs_data, 0, &fs_data->superblock) != 0) {
@@ -667,12 +2005,23 @@ static int simplefs_mount(filesystem_t* fs, const char* source, uint32_t flags)
         return VFS_ERR_INVALID;
     }
     
-    // Verify version
-    if (fs_data->superblock.version != SIMPLEFS_VERSION) {
+    // Replay a committed transaction before anything reads metadata
+    if (fs_data->superblock.journal_size >= SIMPLEFS_JOURNAL_MIN_SIZE &&
+        simplefs_journal_recover(fs_data) > 0 &&
+        read_block(fs_data, 0, &fs_data->superblock) != 0) {
+        kfree(fs_data);
+        return VFS_ERR_IO;
+    }
+    
+    // Verify version; v2 volumes are upgraded in place, their files
+    // switching to extents the next time they are written
+    if (fs_data->superblock.version != SIMPLEFS_VERSION &&
+        fs_data->superblock.version != SIMPLEFS_VERSION_BLOCKMAP) {
         // serial_puts("SimpleFS: Unsupported version\n");
         kfree(fs_data);
         return VFS_ERR_INVALID;
     }
+    fs_data->superblock.version = SIMPLEFS_VERSION;
     
     // serial_puts("SimpleFS: Valid superblock found (version ");
     // char buf[16];
@@ -684,18 +2033,8 @@ static int simplefs_mount(filesystem_t* fs, const char* source, uint32_t flags)
     fs_data->superblock.mount_count++;
     fs_data->superblock.last_mount_time = get_current_time();
     
-    // Check if journal recovery needed
-    if (fs_data->superblock.state != SIMPLEFS_JOURNAL_CLEAN) {
-        // serial_puts("SimpleFS: Filesystem not clean, recovery needed\n");
-        fs_data->superblock.state = SIMPLEFS_JOURNAL_RECOVERING;
-        write_block(fs_data, 0, &fs_data->superblock);
-        
-        // TODO: Implement journal recovery
-        // simplefs_journal_recover(fs_data);
-        
-        fs_data->superblock.state = SIMPLEFS_JOURNAL_CLEAN;
-    }
-    
+    // Any committed transaction was replayed above; the rest never reached home blocks
+    fs_data->superblock.state = SIMPLEFS_JOURNAL_CLEAN;
     write_block(fs_data, 0, &fs_data->superblock);
     
     // Allocate and read bitmaps
@@ -762,10 +2101,30 @@ static int simplefs_mount(filesystem_t* fs, const char* source, uint32_t flags)
         }
     }
     
-    // Initialize journal data
-    fs_data->journal_seq = 0;
-    fs_data->journal_enabled = (fs_data->superblock.journal_size > 0) ? 1 : 0;
+    // Initialize journal data; without room for the images, metadata is written synchronously
+    fs_data->journal_enabled = 0;
     fs_data->dirty_count = 0;
+    if (fs_data->superblock.journal_size >= SIMPLEFS_JOURNAL_MIN_SIZE) {
+        fs_data->txn_limit = fs_data->superblock.journal_size - 3;
+        if (fs_data->txn_limit > SIMPLEFS_JOURNAL_MAX_BLOCKS) {
+            fs_data->txn_limit = SIMPLEFS_JOURNAL_MAX_BLOCKS;
+        }
+        fs_data->txn[0].images = (uint8_t*)kmalloc(fs_data->txn_limit * SIMPLEFS_BLOCK_SIZE);
+        fs_data->txn[1].images = (uint8_t*)kmalloc(fs_data->txn_limit * SIMPLEFS_BLOCK_SIZE);
+        if (fs_data->txn[0].images && fs_data->txn[1].images) {
+            fs_data->journal_enabled = 1;
+        }
+    }
+    
+    // Let the journal thread group-commit this mount and age its lazy timestamps
+    process_set_preempt_disabled(1);
+    for (uint32_t i = 0; i < SIMPLEFS_MAX_MOUNTS; i++) {
+        if (!simplefs_mounts[i]) {
+            simplefs_mounts[i] = fs_data;
+            break;
+        }
+    }
+    process_set_preempt_disabled(0);
     
     fs->fs_data = fs_data;
     
@@ -780,15 +2139,39 @@ static int simplefs_unmount(filesystem_t* fs) {
     
     simplefs_data_t* fs_data = (simplefs_data_t*)fs->fs_data;
     
+    // Take the mount away from the journal thread and let running handles finish
+    process_set_preempt_disabled(1);
+    for (uint32_t i = 0; i < SIMPLEFS_MAX_MOUNTS; i++) {
+        if (simplefs_mounts[i] == fs_data) {
+            simplefs_mounts[i] = NULL;
+        }
+    }
+    process_set_preempt_disabled(0);
+    while (fs_data->journal_handles != 0 && process_can_block()) {
+        process_sleep(1);
+    }
+    
+    // Place buffered appends before the final superblock write
+    simplefs_flush_all(fs_data);
+    
     // Mark filesystem as clean before unmount
     fs_data->superblock.state = SIMPLEFS_JOURNAL_CLEAN;
     fs_data->superblock.last_write_time = get_current_time();
     write_block(fs_data, 0, &fs_data->superblock);
+    if (fs_data->journal_enabled) {
+        simplefs_journal_commit(fs_data);
+    }
+    bcache_flush(fs_data->dev);
     
     // Free allocated memory
     if (fs_data->block_bitmap) kfree(fs_data->block_bitmap);
     if (fs_data->inode_bitmap) kfree(fs_data->inode_bitmap);
     if (fs_data->inode_table) kfree(fs_data->inode_table);
+    for (uint32_t i = 0; i < SIMPLEFS_DELALLOC_SLOTS; i++) {
+        if (fs_data->delalloc[i].data) kfree(fs_data->delalloc[i].data);
+    }
+    if (fs_data->txn[0].images) kfree(fs_data->txn[0].images);
+    if (fs_data->txn[1].images) kfree(fs_data->txn[1].images);
     kfree(fs_data);
     
     fs->fs_data = NULL;
@@ -796,6 +2179,22 @@ static int simplefs_unmount(filesystem_t* fs) {
     return VFS_OK;
 }
 
+static int simplefs_fs_sync(filesystem_t* fs) {
+    if (!fs || !fs->fs_data) {
+        return VFS_ERR_INVALID;
+    }
+    
+    simplefs_data_t* fs_data = (simplefs_data_t*)fs->fs_data;
+    simplefs_journal_start(fs_data, SIMPLEFS_JOURNAL_CREDITS_FLUSH * SIMPLEFS_DELALLOC_SLOTS);
+    int result = simplefs_flush_all(fs_data);
+    simplefs_journal_stop(fs_data);
+    if (fs_data->journal_enabled && simplefs_journal_commit_idle(fs_data) != 0) {
+        result = VFS_ERR_IO;
+    }
+    bcache_flush(fs_data->dev);
+    return result;
+}
+
 static vnode_t* simplefs_get_root(filesystem_t* fs) {
     if (!fs || !fs->fs_data) {
         return NULL;
@@ -829,7 +2228,38 @@ static int simplefs_vnode_open(vnode_t* node, uint32_t flags) {
 }
 
 static int simplefs_vnode_close(vnode_t* node) {
-    (void)node;
+    if (!node || !node->fs || !node->fs->fs_data) {
+        return VFS_OK;
+    }
+    
+    // Place whatever this file still has buffered
+    simplefs_data_t* fs_data = (simplefs_data_t*)node->fs->fs_data;
+    simplefs_journal_start(fs_data, SIMPLEFS_JOURNAL_CREDITS_FLUSH);
+    int result = simplefs_flush_inode(fs_data, (uint32_t)(uintptr_t)node->fs_data);
+    simplefs_journal_stop(fs_data);
+    return result;
+}
+
+static int map_file_block(simplefs_data_t* fs_data, simplefs_inode_t* inode, uint32_t inode_num, uint32_t block_idx, uint32_t* block_num) {
+    /* Look up a file block, allocating and linking a new one for holes. */
+    *block_num = get_file_block(fs_data, inode, block_idx);
+    if (*block_num != 0) {
+        return VFS_OK;
+    }
+
+    uint32_t new_block = alloc_block(fs_data);
+    if (new_block == 0) {
+        return VFS_ERR_NOSPACE;
+    }
+
+    // Use new set_file_block function that handles indirect blocks
+    if (set_file_block(fs_data, inode, block_idx, new_block, inode_num) != 0) {
+        free_block_num(fs_data, new_block);
+        return VFS_ERR_IO;
+    }
+
+    inode->blocks++;
+    *block_num = new_block;
     return VFS_OK;
 }
 
@@ -865,30 +2295,148 @@ static int simplefs_vnode_read(vnode_t* node, void* buffer, uint32_t size, uint3
             bytes_in_block = bytes_to_read - bytes_read;
         }
         
-        // Use new get_file_block function that handles indirect blocks
-        uint32_t block_num = get_file_block(fs_data, inode, block_idx);
+        uint32_t block_num = 0;
+        uint32_t extent_run = 0;
+        if (inode->flags & SIMPLEFS_FL_EXTENTS) {
+            if (block_idx >= inode->blocks) {
+                // Not placed yet: a buffered append, or zeros
+                simplefs_delalloc_t* da = delalloc_find(fs_data, inode_num);
+                if (da && block_idx - da->file_block < da->count) {
+                    memcpy((uint8_t*)buffer + bytes_read,
+                           da->data + (block_idx - da->file_block) * SIMPLEFS_BLOCK_SIZE + block_offset,
+                           bytes_in_block);
+                } else {
+                    memset((uint8_t*)buffer + bytes_read, 0, bytes_in_block);
+                }
+                bytes_read += bytes_in_block;
+                continue;
+            }
+            if (extent_map(fs_data, inode, block_idx, &block_num, &extent_run) != 0) {
+                return bytes_read > 0 ? (int32_t)bytes_read : VFS_ERR_IO;
+            }
+        } else {
+            // Use new get_file_block function that handles indirect blocks
+            block_num = get_file_block(fs_data, inode, block_idx);
+        }
+        
+        if (block_num == 0) {
+            // Sparse file - return zeros
+            memset((uint8_t*)buffer + bytes_read, 0, bytes_in_block);
+        } else if (bytes_in_block == SIMPLEFS_BLOCK_SIZE) {
+            // Whole blocks: read the physically contiguous run in one request
+            uint32_t run = 1;
+            if (extent_run != 0) {
+                // The extent already says how far the run goes
+                run = extent_run;
+                if (run > (bytes_to_read - bytes_read) / SIMPLEFS_BLOCK_SIZE) {
+                    run = (bytes_to_read - bytes_read) / SIMPLEFS_BLOCK_SIZE;
+                }
+                if (run > SIMPLEFS_MAX_RUN_BLOCKS) {
+                    run = SIMPLEFS_MAX_RUN_BLOCKS;
+                }
+            }
+            while (extent_run == 0 && run < SIMPLEFS_MAX_RUN_BLOCKS &&
+                   bytes_to_read - bytes_read >= (run + 1) * SIMPLEFS_BLOCK_SIZE &&
+                   get_file_block(fs_data, inode, block_idx + run) == block_num + run) {
+                run++;
+            }
+            if (read_blocks(fs_data, block_num, run, (uint8_t*)buffer + bytes_read) != 0) {
+                return bytes_read > 0 ? (int32_t)bytes_read : VFS_ERR_IO;
+            }
+            bytes_in_block = run * SIMPLEFS_BLOCK_SIZE;
+        } else {
+            if (read_block(fs_data, block_num, block_buffer) != 0) {
+                return bytes_read > 0 ? (int32_t)bytes_read : VFS_ERR_IO;
+            }
+            memcpy((uint8_t*)buffer + bytes_read, block_buffer + block_offset, bytes_in_block);
+        }
+        
+        bytes_read += bytes_in_block;
+    }
+    
+    simplefs_update_atime(fs_data, inode, inode_num);
+    
+    return bytes_read;
+}
+
+static void simplefs_write_done(vnode_t* node, simplefs_data_t* fs_data, simplefs_inode_t* inode,
+                                uint32_t inode_num, uint32_t offset, uint32_t bytes_written) {
+    // Update size if we wrote past the end
+    if (offset + bytes_written > inode->size) {
+        inode->size = offset + bytes_written;
+        inode->size_high = ((uint64_t)(offset + bytes_written)) >> 32;
+        node->size = offset + bytes_written;
+    }
+    
+    // Update modification time
+    inode->mtime = get_current_time();
+    
+    // Write back inode
+    write_inode(fs_data, inode_num);
+}
+
+static int simplefs_write_extents(simplefs_data_t* fs_data, simplefs_inode_t* inode, uint32_t inode_num,
+                                  const void* buffer, uint32_t size, uint32_t offset) {
+    /* Overwrite mapped blocks in place; anything past the mapped end is buffered for delayed allocation. */
+    uint32_t bytes_written = 0;
+    uint8_t block_buffer[SIMPLEFS_BLOCK_SIZE];
+    
+    while (bytes_written < size) {
+        uint32_t block_idx = (offset + bytes_written) / SIMPLEFS_BLOCK_SIZE;
+        uint32_t block_offset = (offset + bytes_written) % SIMPLEFS_BLOCK_SIZE;
+        const uint8_t* src = (const uint8_t*)buffer + bytes_written;
+        
+        if (block_idx >= inode->blocks) {
+            int taken = delalloc_write(fs_data, inode_num, block_idx, block_offset, src, size - bytes_written);
+            if (taken < 0) {
+                return bytes_written > 0 ? (int32_t)bytes_written : taken;
+            }
+            bytes_written += (uint32_t)taken;
+            continue;
+        }
+        
+        uint32_t block_num = 0;
+        uint32_t run = 0;
+        if (extent_map(fs_data, inode, block_idx, &block_num, &run) != 0) {
+            return bytes_written > 0 ? (int32_t)bytes_written : VFS_ERR_IO;
+        }
+        
+        uint32_t bytes_in_block = SIMPLEFS_BLOCK_SIZE - block_offset;
+        if (bytes_in_block > size - bytes_written) {
+            bytes_in_block = size - bytes_written;
+        }
         
-        if (block_num == 0) {
-            // Sparse file - return zeros
-            memset((uint8_t*)buffer + bytes_read, 0, bytes_in_block);
-        } else {
-            if (read_block(fs_data, block_num, block_buffer) != 0) {
-                return bytes_read > 0 ? (int32_t)bytes_read : VFS_ERR_IO;
+        if (bytes_in_block == SIMPLEFS_BLOCK_SIZE) {
+            // Whole blocks within one extent go out as one request
+            uint32_t whole = (size - bytes_written) / SIMPLEFS_BLOCK_SIZE;
+            if (run > whole) {
+                run = whole;
             }
-            memcpy((uint8_t*)buffer + bytes_read, block_buffer + block_offset, bytes_in_block);
+            if (run > SIMPLEFS_MAX_RUN_BLOCKS) {
+                run = SIMPLEFS_MAX_RUN_BLOCKS;
+            }
+            if (write_blocks(fs_data, block_num, run, src) != 0) {
+                return bytes_written > 0 ? (int32_t)bytes_written : VFS_ERR_IO;
+            }
+            bytes_written += run * SIMPLEFS_BLOCK_SIZE;
+            continue;
         }
         
-        bytes_read += bytes_in_block;
+        // Read-modify-write for partial blocks
+        if (read_block(fs_data, block_num, block_buffer) != 0) {
+            return bytes_written > 0 ? (int32_t)bytes_written : VFS_ERR_IO;
+        }
+        memcpy(block_buffer + block_offset, src, bytes_in_block);
+        if (write_data_block(fs_data, block_num, block_buffer) != 0) {
+            return bytes_written > 0 ? (int32_t)bytes_written : VFS_ERR_IO;
+        }
+        bytes_written += bytes_in_block;
     }
     
-    // Update access time
-    inode->atime = get_current_time();
-    write_inode(fs_data, inode_num);
-    
-    return bytes_read;
+    return (int)bytes_written;
 }
 
-static int simplefs_vnode_write(vnode_t* node, const void* buffer, uint32_t size, uint32_t offset) {
+static int simplefs_do_write(vnode_t* node, const void* buffer, uint32_t size, uint32_t offset) {
     if (!node || !buffer) {
         // serial_puts("SimpleFS: write failed - null node or buffer\n");
         return VFS_ERR_INVALID;
@@ -910,6 +2458,19 @@ static int simplefs_vnode_write(vnode_t* node, const void* buffer, uint32_t size
     // serial_puts(buf);
     // serial_puts("\n");
     
+    // v2 files move to extents on their first write after the upgrade
+    if (SIMPLEFS_ISREG(inode->mode) && !(inode->flags & SIMPLEFS_FL_EXTENTS)) {
+        simplefs_convert_inode(fs_data, inode_num);
+    }
+    
+    if (inode->flags & SIMPLEFS_FL_EXTENTS) {
+        int written = simplefs_write_extents(fs_data, inode, inode_num, buffer, size, offset);
+        if (written > 0) {
+            simplefs_write_done(node, fs_data, inode, inode_num, offset, (uint32_t)written);
+        }
+        return written;
+    }
+    
     uint32_t bytes_written = 0;
     uint8_t block_buffer[SIMPLEFS_BLOCK_SIZE];
     
@@ -922,36 +2483,30 @@ static int simplefs_vnode_write(vnode_t* node, const void* buffer, uint32_t size
             bytes_in_block = size - bytes_written;
         }
         
-        // Get existing block number or 0 if not allocated
-        uint32_t block_num = get_file_block(fs_data, inode, block_idx);
+        // Get existing block number, allocating it if necessary
+        uint32_t block_num = 0;
+        int map_result = map_file_block(fs_data, inode, inode_num, block_idx, &block_num);
+        if (map_result != VFS_OK) {
+            return bytes_written > 0 ? (int32_t)bytes_written : map_result;
+        }
         
-        // Allocate block if necessary
-        if (block_num == 0) {
-            // serial_puts("SimpleFS: Allocating new block for index ");
-            // itoa(block_idx, buf, 10);
-            // serial_puts(buf);
-            // serial_puts("\n");
-            
-            uint32_t new_block = alloc_block(fs_data);
-            if (new_block == 0) {
-                // serial_puts("SimpleFS: Failed to allocate block - no space\n");
-                return bytes_written > 0 ? (int32_t)bytes_written : VFS_ERR_NOSPACE;
+        if (bytes_in_block == SIMPLEFS_BLOCK_SIZE) {
+            // Whole blocks: extend over physically contiguous blocks and write them in one request
+            uint32_t run = 1;
+            while (run < SIMPLEFS_MAX_RUN_BLOCKS &&
+                   size - bytes_written >= (run + 1) * SIMPLEFS_BLOCK_SIZE) {
+                uint32_t next_block = 0;
+                if (map_file_block(fs_data, inode, inode_num, block_idx + run, &next_block) != VFS_OK ||
+                    next_block != block_num + run) {
+                    break;  // A mapped but non-contiguous block is written on a later pass
+                }
+                run++;
             }
-            
-            // Use new set_file_block function that handles indirect blocks
-            if (set_file_block(fs_data, inode, block_idx, new_block, inode_num) != 0) {
-                // serial_puts("SimpleFS: Failed to set file block\n");
-                free_block_num(fs_data, new_block);
+            if (write_blocks(fs_data, block_num, run, (const uint8_t*)buffer + bytes_written) != 0) {
                 return bytes_written > 0 ? (int32_t)bytes_written : VFS_ERR_IO;
             }
-            
-            block_num = new_block;
-            inode->blocks++;
-            
-            // serial_puts("SimpleFS: Allocated block ");
-            // itoa(new_block, buf, 10);
-            // serial_puts(buf);
-            // serial_puts("\n");
+            bytes_written += run * SIMPLEFS_BLOCK_SIZE;
+            continue;
         }
         
         // Read-modify-write for partial blocks
@@ -974,7 +2529,7 @@ static int simplefs_vnode_write(vnode_t* node, const void* buffer, uint32_t size
         // serial_puts(buf);
         // serial_puts("\n");
         
-        if (write_block(fs_data, block_num, block_buffer) != 0) {
+        if (write_data_block(fs_data, block_num, block_buffer) != 0) {
             // serial_puts("SimpleFS: Failed to write block\n");
             return bytes_written > 0 ? (int32_t)bytes_written : VFS_ERR_IO;
         }
@@ -982,19 +2537,7 @@ static int simplefs_vnode_write(vnode_t* node, const void* buffer, uint32_t size
         bytes_written += bytes_in_block;
     }
     
-    // Update size if we wrote past the end
-    if (offset + bytes_written > inode->size) {
-        inode->size = offset + bytes_written;
-        inode->size_high = ((uint64_t)(offset + bytes_written)) >> 32;
-        node->size = offset + bytes_written;
-    }
-    
-    // Update modification time
-    inode->mtime = get_current_time();
-    
-    // Write back inode
-    write_inode(fs_data, inode_num);
-    
+    simplefs_write_done(node, fs_data, inode, inode_num, offset, bytes_written);
     return bytes_written;
 }
 
@@ -1008,33 +2551,17 @@ static vnode_t* simplefs_vnode_finddir(vnode_t* node, const char* name) {
     simplefs_inode_t* inode = &fs_data->inode_table[inode_num];
     
     uint8_t block_buffer[SIMPLEFS_BLOCK_SIZE];
-    
-    // Search through directory entries
-    for (uint32_t block_idx = 0; block_idx < SIMPLEFS_DIRECT_BLOCKS && inode->block_ptrs[block_idx] != 0; block_idx++) {
-        if (read_block(fs_data, inode->block_ptrs[block_idx], block_buffer) != 0) {
-            continue;
-        }
-        
-        uint32_t offset = 0;
-        while (offset < SIMPLEFS_BLOCK_SIZE) {
-            simplefs_dirent_t* dirent = (simplefs_dirent_t*)(block_buffer + offset);
-            
-            if (dirent->inode == 0 || dirent->rec_len == 0) {
-                break;
-            }
-            
-            if (dirent->name_len > 0 && strcmp(dirent->name, name) == 0) {
-                return simplefs_inode_to_vnode(fs_data, dirent->inode, dirent->name, node->fs);
-            }
-            
-            offset += dirent->rec_len;
-        }
+    uint32_t block_num;
+    uint32_t offset;
+    if (dir_find(fs_data, inode, name, block_buffer, &block_num, &offset, NULL) != 0) {
+        return NULL;
     }
     
-    return NULL;
+    simplefs_dirent_t* dirent = (simplefs_dirent_t*)(block_buffer + offset);
+    return simplefs_inode_to_vnode(fs_data, dirent->inode, dirent->name, node->fs);
 }
 
-static vnode_t* simplefs_vnode_create(vnode_t* parent, const char* name, uint32_t flags) {
+static vnode_t* simplefs_do_create(vnode_t* parent, const char* name, uint32_t flags) {
     if (!parent || !name || parent->type != VFS_DIRECTORY) {
         // serial_puts("SimpleFS: create failed - invalid parent or name or not a directory\n");
         return NULL;
@@ -1084,7 +2611,7 @@ static vnode_t* simplefs_vnode_create(vnode_t* parent, const char* name, uint32_
     new_inode->dtime = 0;
     new_inode->links_count = 1;
     new_inode->blocks = 0;
-    new_inode->flags = 0;
+    new_inode->flags = SIMPLEFS_FL_EXTENTS;
     new_inode->indirect_ptr = 0;
     new_inode->double_indirect_ptr = 0;
     new_inode->triple_indirect_ptr = 0;
@@ -1094,81 +2621,16 @@ static vnode_t* simplefs_vnode_create(vnode_t* parent, const char* name, uint32_
     
     // Add directory entry to parent
     uint32_t parent_inode_num = (uint32_t)(uintptr_t)parent->fs_data;
-    simplefs_inode_t* parent_inode = &fs_data->inode_table[parent_inode_num];
-    
-    // serial_puts("SimpleFS: Adding directory entry to parent inode ");
-    // itoa(parent_inode_num, buf, 10);
-    // serial_puts(buf);
-    // serial_puts("\n");
-    
-    // Find space for new directory entry
-    uint8_t block_buffer[SIMPLEFS_BLOCK_SIZE];
-    
-    for (uint32_t block_idx = 0; block_idx < SIMPLEFS_DIRECT_BLOCKS; block_idx++) {
-        if (parent_inode->block_ptrs[block_idx] == 0) {
-            // Allocate new block for directory
-            // serial_puts("SimpleFS: Allocating new directory block\n");
-            uint32_t new_block = alloc_block(fs_data);
-            if (new_block == 0) {
-                // serial_puts("SimpleFS: Failed to allocate directory block\n");
-                free_inode(fs_data, new_inode_num);
-                return NULL;
-            }
-            parent_inode->block_ptrs[block_idx] = new_block;
-            parent_inode->blocks++;
-            memset(block_buffer, 0, SIMPLEFS_BLOCK_SIZE);
-            
-            // serial_puts("SimpleFS: Allocated directory block ");
-            // itoa(new_block, buf, 10);
-            // serial_puts(buf);
-            // serial_puts("\n");
-        } else {
-            read_block(fs_data, parent_inode->block_ptrs[block_idx], block_buffer);
-        }
-        
-        // Find free space in block
-        uint32_t offset = 0;
-        while (offset < SIMPLEFS_BLOCK_SIZE - sizeof(simplefs_dirent_t)) {
-            simplefs_dirent_t* dirent = (simplefs_dirent_t*)(block_buffer + offset);
-            
-            if (dirent->inode == 0) {
-                // Found free space
-                // serial_puts("SimpleFS: Found free space at offset ");
-                // itoa(offset, buf, 10);
-                // serial_puts(buf);
-                // serial_puts("\n");
-                
-                dirent->inode = new_inode_num;
-                dirent->rec_len = sizeof(simplefs_dirent_t);
-                dirent->name_len = strlen(name);
-                dirent->file_type = VFS_FILE; // Regular file
-                strncpy(dirent->name, name, SIMPLEFS_MAX_FILENAME);
-                dirent->name[SIMPLEFS_MAX_FILENAME] = '\0';
-                
-                // serial_puts("SimpleFS: Writing directory block\n");
-                write_block(fs_data, parent_inode->block_ptrs[block_idx], block_buffer);
-                write_inode(fs_data, parent_inode_num);
-                
-                // serial_puts("SimpleFS: File created successfully\n");
-                return simplefs_inode_to_vnode(fs_data, new_inode_num, name, parent->fs);
-            }
-            
-            if (dirent->rec_len == 0) {
-                offset = SIMPLEFS_BLOCK_SIZE; // End of entries
-                break;
-            }
-            
-            offset += dirent->rec_len;
-        }
+    if (dir_add_entry(fs_data, parent_inode_num, name, new_inode_num, VFS_FILE) != VFS_OK) {
+        // serial_puts("SimpleFS: No space for new directory entry\n");
+        free_inode(fs_data, new_inode_num);
+        return NULL;
     }
     
-    // No space for new entry
-    // serial_puts("SimpleFS: No space for new directory entry\n");
-    free_inode(fs_data, new_inode_num);
-    return NULL;
+    return simplefs_inode_to_vnode(fs_data, new_inode_num, name, parent->fs);
 }
 
-static int simplefs_vnode_unlink(vnode_t* parent, const char* name) {
+static int simplefs_do_unlink(vnode_t* parent, const char* name) {
     if (!parent || !name || parent->type != VFS_DIRECTORY) {
         // serial_puts("SimpleFS: unlink failed - invalid parent or name\n");
         return VFS_ERR_INVALID;
@@ -1183,68 +2645,39 @@ static int simplefs_vnode_unlink(vnode_t* parent, const char* name) {
     simplefs_inode_t* parent_inode = &fs_data->inode_table[parent_inode_num];
     
     uint8_t block_buffer[SIMPLEFS_BLOCK_SIZE];
+    uint32_t block_num;
+    uint32_t offset;
+    int32_t prev;
     
     // Search for the file in parent directory
-    for (uint32_t block_idx = 0; block_idx < SIMPLEFS_DIRECT_BLOCKS && parent_inode->block_ptrs[block_idx] != 0; block_idx++) {
-        if (read_block(fs_data, parent_inode->block_ptrs[block_idx], block_buffer) != 0) {
-            continue;
-        }
-        
-        uint32_t offset = 0;
-        while (offset < SIMPLEFS_BLOCK_SIZE) {
-            simplefs_dirent_t* dirent = (simplefs_dirent_t*)(block_buffer + offset);
-            
-            if (dirent->inode == 0 || dirent->rec_len == 0) {
-                break;
-            }
-            
-            if (dirent->name_len > 0 && strcmp(dirent->name, name) == 0) {
-                uint32_t inode_num = dirent->inode;
-                simplefs_inode_t* inode = &fs_data->inode_table[inode_num];
-                
-                // Check if it's a directory and not empty
-                if (SIMPLEFS_ISDIR(inode->mode)) {
-                    // Check if directory is empty
-                    for (uint32_t i = 0; i < SIMPLEFS_DIRECT_BLOCKS && inode->block_ptrs[i] != 0; i++) {
-                        uint8_t dir_block[SIMPLEFS_BLOCK_SIZE];
-                        if (read_block(fs_data, inode->block_ptrs[i], dir_block) == 0) {
-                            simplefs_dirent_t* entry = (simplefs_dirent_t*)dir_block;
-                            if (entry->inode != 0) {
-                                // serial_puts("SimpleFS: Directory not empty\n");
-                                return VFS_ERR_NOTEMPTY;
-                            }
-                        }
-                    }
-                }
-                
-                // serial_puts("SimpleFS: Freeing inode blocks\n");
-                // Free all blocks used by the file/directory
-                free_inode_blocks(fs_data, inode_num);
-                
-                // serial_puts("SimpleFS: Freeing inode\n");
-                // Free the inode
-                free_inode(fs_data, inode_num);
-                
-                // Mark directory entry as free
-                dirent->inode = 0;
-                dirent->name_len = 0;
-                
-                // Write back directory block
-                write_block(fs_data, parent_inode->block_ptrs[block_idx], block_buffer);
-                
-                // serial_puts("SimpleFS: File deleted successfully\n");
-                return VFS_OK;
-            }
-            
-            offset += dirent->rec_len;
-        }
+    if (dir_find(fs_data, parent_inode, name, block_buffer, &block_num, &offset, &prev) != 0) {
+        // serial_puts("SimpleFS: File not found\n");
+        return VFS_ERR_NOTFOUND;
     }
     
-    // serial_puts("SimpleFS: File not found\n");
-    return VFS_ERR_NOTFOUND;
+    simplefs_dirent_t* dirent = (simplefs_dirent_t*)(block_buffer + offset);
+    uint32_t inode_num = dirent->inode;
+    simplefs_inode_t* inode = &fs_data->inode_table[inode_num];
+    
+    // Directories must be empty
+    if (SIMPLEFS_ISDIR(inode->mode) && !dir_is_empty(fs_data, inode)) {
+        // serial_puts("SimpleFS: Directory not empty\n");
+        return VFS_ERR_NOTEMPTY;
+    }
+    
+    // Free all blocks used by the file/directory, then the inode
+    free_inode_blocks(fs_data, inode_num);
+    free_inode(fs_data, inode_num);
+    
+    // Drop the directory entry and write back its block
+    dirblock_remove(block_buffer, offset, prev);
+    write_block(fs_data, block_num, block_buffer);
+    
+    // serial_puts("SimpleFS: File deleted successfully\n");
+    return VFS_OK;
 }
 
-static int simplefs_vnode_mkdir(vnode_t* parent, const char* name) {
+static int simplefs_do_mkdir(vnode_t* parent, const char* name) {
     if (!parent || !name || parent->type != VFS_DIRECTORY) {
         return VFS_ERR_INVALID;
     }
@@ -1290,53 +2723,13 @@ static int simplefs_vnode_mkdir(vnode_t* parent, const char* name) {
     
     // Add directory entry to parent (similar to create)
     uint32_t parent_inode_num = (uint32_t)(uintptr_t)parent->fs_data;
-    simplefs_inode_t* parent_inode = &fs_data->inode_table[parent_inode_num];
-    
-    uint8_t block_buffer[SIMPLEFS_BLOCK_SIZE];
-    
-    for (uint32_t block_idx = 0; block_idx < SIMPLEFS_DIRECT_BLOCKS; block_idx++) {
-        if (parent_inode->block_ptrs[block_idx] == 0) {
-            uint32_t new_block = alloc_block(fs_data);
-            if (new_block == 0) {
-                free_inode(fs_data, new_inode_num);
-                return VFS_ERR_NOSPACE;
-            }
-            parent_inode->block_ptrs[block_idx] = new_block;
-            parent_inode->blocks++;
-            memset(block_buffer, 0, SIMPLEFS_BLOCK_SIZE);
-        } else {
-            read_block(fs_data, parent_inode->block_ptrs[block_idx], block_buffer);
-        }
-        
-        uint32_t offset = 0;
-        while (offset < SIMPLEFS_BLOCK_SIZE - sizeof(simplefs_dirent_t)) {
-            simplefs_dirent_t* dirent = (simplefs_dirent_t*)(block_buffer + offset);
-            
-            if (dirent->inode == 0) {
-                dirent->inode = new_inode_num;
-                dirent->rec_len = sizeof(simplefs_dirent_t);
-                dirent->name_len = strlen(name);
-                dirent->file_type = VFS_DIRECTORY; // Directory
-                strncpy(dirent->name, name, SIMPLEFS_MAX_FILENAME);
-                dirent->name[SIMPLEFS_MAX_FILENAME] = '\0';
-                
-                write_block(fs_data, parent_inode->block_ptrs[block_idx], block_buffer);
-                write_inode(fs_data, parent_inode_num);
-                
-                return VFS_OK;
-            }
-            
-            if (dirent->rec_len == 0) {
-                offset = SIMPLEFS_BLOCK_SIZE;
-                break;
-            }
-            
-            offset += dirent->rec_len;
-        }
+    int result = dir_add_entry(fs_data, parent_inode_num, name, new_inode_num, VFS_DIRECTORY);
+    if (result != VFS_OK) {
+        free_inode(fs_data, new_inode_num);
+        return result;
     }
     
-    free_inode(fs_data, new_inode_num);
-    return VFS_ERR_NOSPACE;
+    return VFS_OK;
 }
 
 static int simplefs_vnode_readdir(vnode_t* node, uint32_t index, dirent_t* dirent) {
@@ -1350,18 +2743,17 @@ static int simplefs_vnode_readdir(vnode_t* node, uint32_t index, dirent_t* diren
     
     uint8_t block_buffer[SIMPLEFS_BLOCK_SIZE];
     uint32_t current_index = 0;
+    uint32_t block_num;
     
-    for (uint32_t block_idx = 0; block_idx < SIMPLEFS_DIRECT_BLOCKS && inode->block_ptrs[block_idx] != 0; block_idx++) {
-        if (read_block(fs_data, inode->block_ptrs[block_idx], block_buffer) != 0) {
+    for (uint32_t n = 0; (block_num = dir_block_at(fs_data, inode, n)) != 0; n++) {
+        if (read_block(fs_data, block_num, block_buffer) != 0) {
             continue;
         }
         
-        uint32_t offset = 0;
-        while (offset < SIMPLEFS_BLOCK_SIZE) {
-            simplefs_dirent_t* dir_ent = (simplefs_dirent_t*)(block_buffer + offset);
-            
-            if (dir_ent->inode == 0 || dir_ent->rec_len == 0) {
-                break;
+        simplefs_dirent_t* dir_ent;
+        for (uint32_t offset = 0; (dir_ent = dirblock_entry(block_buffer, offset)) != NULL; offset += dir_ent->rec_len) {
+            if (dir_ent->inode == 0) {
+                continue;
             }
             
             if (current_index == index) {
@@ -1373,7 +2765,6 @@ static int simplefs_vnode_readdir(vnode_t* node, uint32_t index, dirent_t* diren
             }
             
             current_index++;
-            offset += dir_ent->rec_len;
         }
     }
     
@@ -1445,6 +2836,9 @@ int simplefs_format(uint32_t start_lba, uint32_t num_blocks) {
         num_blocks = SIMPLEFS_MAX_BLOCKS;
     }
     
+    // The format writes the disk directly; drop stale (and dirty) cached blocks first
+    bcache_invalidate(BCACHE_DEV_ATA0, start_lba, num_blocks);
+    
     // Create superblock
     simplefs_superblock_t superblock;
     memset(&superblock, 0, sizeof(superblock));
@@ -1668,71 +3062,349 @@ int simplefs_getxattr(const char* path, const char* name, void* value, uint32_t
 
 // Journaling operations
 
-int simplefs_journal_start(simplefs_data_t* fs_data) {
-    if (!fs_data || !fs_data->journal_enabled) {
+/*
+ * Vnode operations that change metadata run inside one journal handle, so
+ * the group commit never captures half of an operation's block updates.
+ * Writes take one handle per delalloc-sized chunk: a large write's extent
+ * updates would not fit one transaction, and only each chunk must be whole.
+ */
+
+static uint32_t simplefs_write_credits(simplefs_data_t* fs_data, vnode_t* node) {
+    /* A v2 file converts on its first write: worst case one extent block per SIMPLEFS_EXTENTS_PER_BLOCK blocks. */
+    simplefs_inode_t* inode = &fs_data->inode_table[(uint32_t)(uintptr_t)node->fs_data];
+    uint32_t credits = SIMPLEFS_JOURNAL_CREDITS_WRITE;
+    if (SIMPLEFS_ISREG(inode->mode) && !(inode->flags & SIMPLEFS_FL_EXTENTS)) {
+        credits += inode->size / SIMPLEFS_BLOCK_SIZE / SIMPLEFS_EXTENTS_PER_BLOCK + 2;
+    }
+    return credits;
+}
+
+static int simplefs_vnode_write(vnode_t* node, const void* buffer, uint32_t size, uint32_t offset) {
+    simplefs_data_t* fs_data = (node && node->fs) ? (simplefs_data_t*)node->fs->fs_data : NULL;
+    if (!fs_data || !buffer) {
+        return simplefs_do_write(node, buffer, size, offset);
+    }
+    
+    uint32_t done = 0;
+    do {
+        uint32_t len = size - done;
+        if (len > SIMPLEFS_DELALLOC_BLOCKS * SIMPLEFS_BLOCK_SIZE) {
+            len = SIMPLEFS_DELALLOC_BLOCKS * SIMPLEFS_BLOCK_SIZE;
+        }
+        simplefs_journal_start(fs_data, simplefs_write_credits(fs_data, node));
+        int result = simplefs_do_write(node, (const uint8_t*)buffer + done, len, offset + done);
+        simplefs_journal_stop(fs_data);
+        if (result < 0) {
+            return done > 0 ? (int)done : result;
+        }
+        done += (uint32_t)result;
+        if ((uint32_t)result < len) {
+            break;
+        }
+    } while (done < size);
+    return (int)done;
+}
+
+static vnode_t* simplefs_vnode_create(vnode_t* parent, const char* name, uint32_t flags) {
+    simplefs_data_t* fs_data = (parent && parent->fs) ? (simplefs_data_t*)parent->fs->fs_data : NULL;
+    simplefs_journal_start(fs_data, SIMPLEFS_JOURNAL_CREDITS_DIROP);
+    vnode_t* result = simplefs_do_create(parent, name, flags);
+    simplefs_journal_stop(fs_data);
+    return result;
+}
+
+static int simplefs_vnode_unlink(vnode_t* parent, const char* name) {
+    simplefs_data_t* fs_data = (parent && parent->fs) ? (simplefs_data_t*)parent->fs->fs_data : NULL;
+    simplefs_journal_start(fs_data, SIMPLEFS_JOURNAL_CREDITS_DIROP);
+    int result = simplefs_do_unlink(parent, name);
+    simplefs_journal_stop(fs_data);
+    return result;
+}
+
+static int simplefs_vnode_mkdir(vnode_t* parent, const char* name) {
+    simplefs_data_t* fs_data = (parent && parent->fs) ? (simplefs_data_t*)parent->fs->fs_data : NULL;
+    simplefs_journal_start(fs_data, SIMPLEFS_JOURNAL_CREDITS_DIROP);
+    int result = simplefs_do_mkdir(parent, name);
+    simplefs_journal_stop(fs_data);
+    return result;
+}
+
+static pid_t simplefs_journal_pid = -1;
+
+int simplefs_journal_start(simplefs_data_t* fs_data, uint32_t credits) {
+    // Handles are counted without a journal too: they keep the background thread out
+    if (!fs_data) {
         return -1;
     }
+    if (credits > fs_data->txn_limit) {
+        credits = fs_data->txn_limit;
+    }
     
-    // Mark filesystem as dirty
-    fs_data->superblock.state = SIMPLEFS_JOURNAL_DIRTY;
-    write_block(fs_data, 0, &fs_data->superblock);
+    for (;;) {
+        process_set_preempt_disabled(1);
+        simplefs_txn_t* txn = &fs_data->txn[fs_data->txn_running];
+        if (!fs_data->journal_enabled ||
+            (!fs_data->txn_locked && txn->count + fs_data->txn_reserved + credits <= fs_data->txn_limit)) {
+            fs_data->journal_handles++;
+            fs_data->txn_reserved += credits;
+            process_set_preempt_disabled(0);
+            return 0;
+        }
+        
+        // No room: keep new handles out and close the transaction once the open ones finish
+        fs_data->txn_locked = 1;
+        int idle = fs_data->journal_handles == 0;
+        process_set_preempt_disabled(0);
+        if (idle) {
+            simplefs_journal_commit(fs_data);
+        } else {
+            process_sleep(1);
+        }
+    }
+}
+
+void simplefs_journal_stop(simplefs_data_t* fs_data) {
+    if (!fs_data) {
+        return;
+    }
     
-    return 0;
+    process_set_preempt_disabled(1);
+    if (fs_data->journal_handles > 0) {
+        fs_data->journal_handles--;
+    }
+    if (fs_data->journal_handles == 0) {
+        fs_data->txn_reserved = 0;  // Credits are returned together, by the last handle
+    }
+    process_set_preempt_disabled(0);
+}
+
+static int simplefs_journal_commit_idle(simplefs_data_t* fs_data) {
+    /* Commit between operations: hold off new handles until the open ones finish. */
+    for (;;) {
+        process_set_preempt_disabled(1);
+        fs_data->txn_locked = 1;
+        int idle = fs_data->journal_handles == 0;
+        process_set_preempt_disabled(0);
+        if (idle) {
+            return simplefs_journal_commit(fs_data);
+        }
+        process_sleep(1);
+    }
 }
 
 int simplefs_journal_commit(simplefs_data_t* fs_data) {
+    /*
+     * Group commit of the running transaction:
+     *   1. descriptor + block images as one sequential log write, then flush
+     *      (file data already in the cache goes out with it: ordered mode)
+     *   2. commit record, then flush: the transaction is now durable
+     *   3. checkpoint: images to their home blocks, then flush
+     *   4. header advanced past the transaction, then flush
+     * Updates arriving meanwhile join the next transaction.
+     */
     if (!fs_data || !fs_data->journal_enabled) {
         return -1;
     }
     
-    // Mark filesystem as clean
-    fs_data->superblock.state = SIMPLEFS_JOURNAL_CLEAN;
-    fs_data->superblock.last_write_time = get_current_time();
-    write_block(fs_data, 0, &fs_data->superblock);
+    // One commit at a time
+    for (;;) {
+        process_set_preempt_disabled(1);
+        if (!fs_data->txn_committing) {
+            break;
+        }
+        process_set_preempt_disabled(0);
+        process_sleep(1);
+    }
+    simplefs_txn_t* txn = &fs_data->txn[fs_data->txn_running];
+    fs_data->txn_locked = 0;
+    if (txn->count == 0) {
+        process_set_preempt_disabled(0);
+        return 0;
+    }
+    fs_data->txn_committing = 1;
+    fs_data->txn_running ^= 1;
+    fs_data->txn_reserved = 0;
+    process_set_preempt_disabled(0);
+    
+    uint32_t seq = fs_data->journal_seq;
+    uint32_t log_start = fs_data->superblock.journal_block;
+    uint32_t checksum = calculate_checksum(txn->images, txn->count * SIMPLEFS_BLOCK_SIZE);
+    int result = 0;
+    
+    simplefs_journal_desc_t desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.magic = SIMPLEFS_JOURNAL_DESC_MAGIC;
+    desc.seq = seq;
+    desc.count = txn->count;
+    desc.checksum = checksum;
+    memcpy(desc.blocks, txn->blocks, txn->count * sizeof(uint32_t));
+    if (journal_write_raw(fs_data, log_start + 1, 1, &desc) != 0 ||
+        journal_write_raw(fs_data, log_start + 2, txn->count, txn->images) != 0 ||
+        bcache_flush(fs_data->dev) != 0) {
+        result = -1;
+    }
+    
+    if (result == 0) {
+        simplefs_journal_commit_t commit;
+        memset(&commit, 0, sizeof(commit));
+        commit.magic = SIMPLEFS_JOURNAL_COMMIT_MAGIC;
+        commit.seq = seq;
+        commit.checksum = checksum;
+        if (journal_write_raw(fs_data, log_start + 2 + txn->count, 1, &commit) != 0 ||
+            bcache_flush(fs_data->dev) != 0) {
+            result = -1;
+        }
+    }
     
-    return 0;
+    // Checkpoint even a failed commit: the updates must reach the disk somehow
+    for (uint32_t i = 0; i < txn->count; i++) {
+        if (journal_write_raw(fs_data, txn->blocks[i], 1, txn->images + i * SIMPLEFS_BLOCK_SIZE) != 0) {
+            result = -1;
+        }
+    }
+    if (bcache_flush(fs_data->dev) != 0) {
+        result = -1;
+    }
+    
+    simplefs_journal_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SIMPLEFS_JOURNAL_MAGIC;
+    header.seq = seq + 1;
+    if (journal_write_raw(fs_data, log_start, 1, &header) != 0 || bcache_flush(fs_data->dev) != 0) {
+        result = -1;
+    }
+    
+    process_set_preempt_disabled(1);
+    fs_data->journal_seq = seq + 1;
+    fs_data->journal_commits++;
+    fs_data->journal_logged += txn->count;
+    txn->count = 0;
+    fs_data->txn_committing = 0;
+    process_set_preempt_disabled(0);
+    return result;
 }
 
 int simplefs_journal_recover(simplefs_data_t* fs_data) {
-    if (!fs_data || !fs_data->journal_enabled) {
+    /*
+     * Replay the logged transaction if its commit record made it to disk.
+     * Runs at mount before journaling starts; returns 1 if a transaction was
+     * replayed, 0 if there was nothing to do, -1 on error.
+     */
+    if (!fs_data || fs_data->superblock.journal_size < SIMPLEFS_JOURNAL_MIN_SIZE) {
         return -1;
     }
     
-    // serial_puts("SimpleFS: Journal recovery started\n");
+    uint32_t log_start = fs_data->superblock.journal_block;
+    uint32_t limit = fs_data->superblock.journal_size - 3;
+    if (limit > SIMPLEFS_JOURNAL_MAX_BLOCKS) {
+        limit = SIMPLEFS_JOURNAL_MAX_BLOCKS;
+    }
     
-    // Read journal entries and replay them
-    simplefs_journal_entry_t entry;
-    for (uint32_t i = 0; i < fs_data->superblock.journal_size; i++) {
-        if (read_block(fs_data, fs_data->superblock.journal_block + i, &entry) != 0) {
-            continue;
-        }
-        
-        // Check if entry is valid
-        if (entry.seq_num == 0 || entry.block_num == 0) {
-            continue;
+    simplefs_journal_header_t header;
+    if (read_block(fs_data, log_start, &header) != 0) {
+        return -1;
+    }
+    if (header.magic != SIMPLEFS_JOURNAL_MAGIC) {
+        // Fresh journal area (new or upgraded volume): start an empty log
+        memset(&header, 0, sizeof(header));
+        header.magic = SIMPLEFS_JOURNAL_MAGIC;
+        header.seq = 1;
+        fs_data->journal_seq = 1;
+        if (journal_write_raw(fs_data, log_start, 1, &header) != 0) {
+            return -1;
         }
-        
-        // Verify checksum
-        uint32_t checksum = calculate_checksum(entry.data, SIMPLEFS_BLOCK_SIZE - 12);
-        if (checksum != entry.checksum) {
-            // serial_puts("SimpleFS: Journal entry checksum mismatch, skipping\n");
-            continue;
+        return bcache_flush(fs_data->dev) == 0 ? 0 : -1;
+    }
+    fs_data->journal_seq = header.seq;
+    
+    simplefs_journal_desc_t desc;
+    if (read_block(fs_data, log_start + 1, &desc) != 0 ||
+        desc.magic != SIMPLEFS_JOURNAL_DESC_MAGIC || desc.seq != header.seq ||
+        desc.count == 0 || desc.count > limit) {
+        return 0;  // Nothing logged since the last checkpoint
+    }
+    
+    uint8_t* images = (uint8_t*)kmalloc(desc.count * SIMPLEFS_BLOCK_SIZE);
+    if (!images) {
+        return -1;
+    }
+    
+    simplefs_journal_commit_t commit;
+    if (read_blocks(fs_data, log_start + 2, desc.count, images) != 0 ||
+        calculate_checksum(images, desc.count * SIMPLEFS_BLOCK_SIZE) != desc.checksum ||
+        read_block(fs_data, log_start + 2 + desc.count, &commit) != 0 ||
+        commit.magic != SIMPLEFS_JOURNAL_COMMIT_MAGIC || commit.seq != desc.seq ||
+        commit.checksum != desc.checksum) {
+        // Never committed: its home blocks were never touched either
+        kfree(images);
+        return 0;
+    }
+    
+    int result = 1;
+    for (uint32_t i = 0; i < desc.count; i++) {
+        if (desc.blocks[i] < fs_data->superblock.total_blocks &&
+            journal_write_raw(fs_data, desc.blocks[i], 1, images + i * SIMPLEFS_BLOCK_SIZE) != 0) {
+            result = -1;
         }
+    }
+    kfree(images);
+    if (bcache_flush(fs_data->dev) != 0) {
+        result = -1;
+    }
+    
+    header.seq = desc.seq + 1;
+    fs_data->journal_seq = header.seq;
+    if (journal_write_raw(fs_data, log_start, 1, &header) != 0 || bcache_flush(fs_data->dev) != 0) {
+        result = -1;
+    }
+    
+    serial_puts("SimpleFS: Replayed journal transaction\n");
+    return result;
+}
+
+static void simplefs_journal_thread(void) {
+    for (;;) {
+        process_sleep(SIMPLEFS_JOURNAL_COMMIT_MS);
         
-        // Replay the write
-        if (write_block(fs_data, entry.block_num, entry.data) != 0) {
-            // serial_puts("SimpleFS: Failed to replay journal entry\n");
-            return -1;
+        for (uint32_t i = 0; i < SIMPLEFS_MAX_MOUNTS; i++) {
+            // Work only between operations; holding a handle keeps unmount waiting,
+            // and the lock keeps new operations out of the transaction until it closes
+            process_set_preempt_disabled(1);
+            simplefs_data_t* fs_data = simplefs_mounts[i];
+            int idle = fs_data && fs_data->journal_handles == 0;
+            if (idle) {
+                fs_data->journal_handles++;
+                fs_data->txn_locked = fs_data->journal_enabled;
+            }
+            process_set_preempt_disabled(0);
+            if (!idle) {
+                continue;
+            }
+            
+            if (fs_data->lazy_count != 0 &&
+                ktime_get_ms() - fs_data->lazy_since_ms >= SIMPLEFS_LAZYTIME_EXPIRE_MS) {
+                simplefs_flush_lazytime(fs_data);
+            }
+            simplefs_flush_aged(fs_data);
+            if (fs_data->journal_enabled) {
+                simplefs_journal_commit(fs_data);  // Unlocks, even with nothing to commit
+            }
+            
+            simplefs_journal_stop(fs_data);
         }
     }
-    
-    // Clear journal
-    uint8_t zero_block[SIMPLEFS_BLOCK_SIZE];
-    memset(zero_block, 0, SIMPLEFS_BLOCK_SIZE);
-    for (uint32_t i = 0; i < fs_data->superblock.journal_size; i++) {
-        write_block(fs_data, fs_data->superblock.journal_block + i, zero_block);
+}
+
+int simplefs_start_journal_thread(void) {
+    if (simplefs_journal_pid > 0) {
+        return simplefs_journal_pid;
     }
     
-    // serial_puts("SimpleFS: Journal recovery complete\n");
-    return 0;
+    pid_t pid = process_create_kernel_thread("sfsjournal", simplefs_journal_thread, PRIORITY_NORMAL);
+    if (pid < 0) {
+        serial_puts("SimpleFS: failed to start journal thread\n");
+        return -1;
+    }
+    simplefs_journal_pid = pid;
+    return pid;
 }
@@ -9,6 +9,7 @@
 
 
 #include <fs/vfs.h>
+#include <fs/bcache.h>
 #include <string.h>
 #include <stdlib.h>
 #include <serial.h>
@@ -268,6 +269,54 @@ int vfs_unmount(const char* target) {
     return VFS_ERR_NOTFOUND;
 }
 
+int vfs_parse_mount_options(const char* options, uint32_t* flags) {
+    if (!options || !flags) {
+        return VFS_ERR_INVALID;
+    }
+    
+    uint32_t result = *flags;
+    const char* p = options;
+    while (*p) {
+        const char* end = p;
+        while (*end && *end != ',') end++;
+        uint32_t len = (uint32_t)(end - p);
+        
+        if (len == 7 && strncmp(p, "noatime", 7) == 0) {
+            result = (result & ~VFS_MOUNT_RELATIME) | VFS_MOUNT_NOATIME;
+        } else if (len == 8 && strncmp(p, "relatime", 8) == 0) {
+            result = (result & ~VFS_MOUNT_NOATIME) | VFS_MOUNT_RELATIME;
+        } else if (len == 11 && strncmp(p, "strictatime", 11) == 0) {
+            result &= ~(VFS_MOUNT_NOATIME | VFS_MOUNT_RELATIME);
+        } else if (len == 8 && strncmp(p, "lazytime", 8) == 0) {
+            result |= VFS_MOUNT_LAZYTIME;
+        } else if (len == 10 && strncmp(p, "nolazytime", 10) == 0) {
+            result &= ~VFS_MOUNT_LAZYTIME;
+        } else if (len != 0) {
+            return VFS_ERR_INVALID;
+        }
+        p = (*end == ',') ? end + 1 : end;
+    }
+    
+    *flags = result;
+    return VFS_OK;
+}
+
+int vfs_sync(void) {
+    int result = VFS_OK;
+
+    for (uint32_t i = 0; i < mount_count; i++) {
+        filesystem_t* fs = mount_table[i].fs;
+        if (fs && fs->ops && fs->ops->sync && fs->ops->sync(fs) != VFS_OK) {
+            result = VFS_ERR_IO;
+        }
+    }
+    if (bcache_sync() != 0) {
+        result = VFS_ERR_IO;
+    }
+
+    return result;
+}
+
 // Normalize path (resolve . and .., remove duplicate /)
 char* vfs_normalize_path(const char* path) {
     /*
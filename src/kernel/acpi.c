@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <arch_paging.h>
+#include <fs/vfs.h>
 
 #define MADT_SIGNATURE "APIC"
 
@@ -574,6 +575,9 @@ const acpi_state_t* acpi_get_state(void) {
 void acpi_shutdown(void) {
     serial_puts("ACPI: Initiating shutdown (S5)...\n");
     
+    // Write back cached filesystem data while the disk driver still runs
+    vfs_sync();
+    
     // Disable interrupts
     asm volatile("cli");
     
@@ -634,6 +638,9 @@ void acpi_shutdown(void) {
 void acpi_reboot(void) {
     serial_puts("ACPI: Initiating reboot...\n");
     
+    // Write back cached filesystem data while the disk driver still runs
+    vfs_sync();
+    
     // Disable interrupts
     asm volatile("cli");
     
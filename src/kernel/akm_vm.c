@@ -585,9 +585,8 @@ static int dispatch_api(akm_vm_t* vm, uint8_t api_id, uint8_t argc) {
                 }
 
                 net_packet_t packet;
-                packet.data = (uint8_t*)(uintptr_t)args[1];
-                packet.len = (uint32_t)args[2];
-                packet.capacity = packet.len;
+                net_packet_wrap(&packet, (uint8_t*)(uintptr_t)args[1],
+                                (uint32_t)args[2], (uint32_t)args[2]);
 
                 result = net_receive_packet(iface, &packet);
             }
@@ -104,7 +104,9 @@ static int elf_load_segments_32(const uint8_t* elf_data, size_t size, process_t*
             flags |= VMM_WRITE;
         }
 
-        if (!vmm_alloc_at(current->address_space, vaddr_start, (size_t)(vaddr_end - vaddr_start), flags)) {
+        // Map writable while loading; CR0.WP makes read-only pages fault even
+        // for kernel writes, so text is protected only after it is copied.
+        if (!vmm_alloc_at(current->address_space, vaddr_start, (size_t)(vaddr_end - vaddr_start), flags | VMM_WRITE)) {
             serial_puts("ELF32: Failed to allocate memory for segment\n");
             return -1;
         }
@@ -116,6 +118,10 @@ static int elf_load_segments_32(const uint8_t* elf_data, size_t size, process_t*
         if (ph->p_memsz > ph->p_filesz) {
             memset((void*)(seg_vaddr + seg_filesz), 0, (size_t)(seg_memsz - seg_filesz));
         }
+
+        if (!(flags & VMM_WRITE)) {
+            vmm_protect(current->address_space, vaddr_start, (size_t)(vaddr_end - vaddr_start), flags);
+        }
     }
 
     return 0;
@@ -183,7 +189,9 @@ static int elf_load_segments_64(const uint8_t* elf_data, size_t size, process_t*
             flags |= VMM_WRITE;
         }
 
-        if (!vmm_alloc_at(current->address_space, vaddr_start, (size_t)(vaddr_end - vaddr_start), flags)) {
+        // Map writable while loading; CR0.WP makes read-only pages fault even
+        // for kernel writes, so text is protected only after it is copied.
+        if (!vmm_alloc_at(current->address_space, vaddr_start, (size_t)(vaddr_end - vaddr_start), flags | VMM_WRITE)) {
             serial_puts("ELF64: Failed to allocate memory for segment\n");
             return -1;
         }
@@ -195,6 +203,10 @@ static int elf_load_segments_64(const uint8_t* elf_data, size_t size, process_t*
         if (ph->p_memsz > ph->p_filesz) {
             memset((void*)(seg_vaddr + seg_filesz), 0, (size_t)(seg_memsz - seg_filesz));
         }
+
+        if (!(flags & VMM_WRITE)) {
+            vmm_protect(current->address_space, vaddr_start, (size_t)(vaddr_end - vaddr_start), flags);
+        }
     }
 
     return 0;
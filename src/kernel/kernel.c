@@ -13,12 +13,14 @@
 #include <arch.h>              // Architecture-independent interface
 #include <arch_paging.h>       // Architecture-independent paging interface
 #include <vmm.h>               // For virtual memory manager
+#include <kheap.h>             // For kernel heap region
 #include <fs/vfs.h>            // For Virtual File System
 #include <fs/ramfs.h>          // For RAM-based filesystem
 #include <fs/simplefs.h>       // For storage-based filesystem
 #include <fs/fat32.h>          // For FAT32 filesystem
 #include <fs/devfs.h>          // For device pseudo-files
 #include <fs/procfs.h>         // For process pseudo-files
+#include <fs/bcache.h>         // For the block buffer cache
 #include <dev/ata.h>           // For ATA/IDE disk driver
 #include <serial.h>
 #include <io.h>
@@ -66,6 +68,8 @@
 #include <dev/e1000.h> // For e1000 NIC driver (v0.8.0)
 #include <dev/pcnet.h> // For PCnet NIC driver (v0.8.1)
 #include <dev/virtio_net.h> // For VirtIO-Net NIC driver
+#include <dev/virtio_blk.h> // For VirtIO-Blk disk driver
+#include <dev/blkdev.h>     // For block device table
 #include <acpi.h>      // For ACPI power management (v0.8.2)
 #include <apm.h>       // For aOS Package Manager (v0.8.5)
 #include <krm.h>       // For Kernel Recovery Mode (v0.8.8)
@@ -73,6 +77,8 @@
 #include <bug_report.h> // For bug tracking, crash reports, and rollback recovery
 #include <bgtask.h>    // For asynchronous background tasks
 #include <cpu.h>       // For CPU topology/model/feature detection
+#include <smp.h>       // For application processor bring-up
+#include <clockevent.h> // For LAPIC/TSC clock events
 
 // Simple kernel print function (prints to VGA for now)
 // Ensure vga_puts is available and initialized before kprint is used extensively.
@@ -256,6 +262,8 @@ void kernel_main(uint32_t multiboot_magic, void *raw_boot_info) {
     // Reserve the full loaded kernel image (code/data/bss/boot tables) so PMM
     // does not hand out frames that back active kernel state.
     pmm_reserve_region((uint32_t)(uintptr_t)&__kernel_start, (uint32_t)(uintptr_t)&__kernel_end);
+    // Reserve the fixed kernel heap window so its frames are never handed out twice.
+    pmm_reserve_region(KHEAP_START, KHEAP_END);
     // Reserve multiboot module memory (used by installer payload and other boot modules).
     if (multiboot_info && multiboot_info->mods_count > 0 && multiboot_info->mods_addr) {
         const multiboot_module_t* mods = (const multiboot_module_t*)(uintptr_t)multiboot_info->mods_addr;
@@ -370,6 +378,12 @@ void kernel_main(uint32_t multiboot_magic, void *raw_boot_info) {
     ata_init();
     serial_puts("ATA driver initialized successfully.\n");
 
+    // VirtIO disks register after ATA so the ATA master stays block device 0
+    virtio_blk_init();
+    
+    // Block buffer cache in front of the disk for SimpleFS/FAT32
+    bcache_init();
+
     // Initialize partition manager before mounting root so installed layouts can be detected.
     serial_puts("About to initialize partition manager...\n");
     init_partitions();
@@ -387,9 +401,11 @@ void kernel_main(uint32_t multiboot_magic, void *raw_boot_info) {
     
     // Try to mount SimpleFS as root filesystem
     serial_puts("About to mount root filesystem...\n");
-    if (ata_drive_available()) {
+    if (blk_device_count() > 0) {
         partition_t* root_part = NULL;
         char root_source[48] = {0};
+        // Reads of the root filesystem should not turn into inode writes
+        const uint32_t root_flags = VFS_MOUNT_RELATIME | VFS_MOUNT_LAZYTIME;
         int root_part_id = partition_find_first_by_type_and_fs(PART_TYPE_DATA, PART_FS_SIMPLEFS);
         if (root_part_id < 0) {
             root_part_id = partition_find_first_by_type_and_fs(PART_TYPE_DATA, PART_FS_FAT32);
@@ -404,9 +420,8 @@ void kernel_main(uint32_t multiboot_magic, void *raw_boot_info) {
             root_part = partition_get(root_part_id);
         }
 
-        if (root_part && root_part->sector_count > 0) {
-            snprintf(root_source, sizeof(root_source), "lba=%u", root_part->start_sector);
-
+        if (root_part && root_part->sector_count > 0 &&
+            partition_mount_source(root_part, root_source, sizeof(root_source)) == 0) {
             const char* primary_fs = "simplefs";
             const char* secondary_fs = "fat32";
             if (root_part->filesystem_type == PART_FS_FAT32) {
@@ -415,9 +430,9 @@ void kernel_main(uint32_t multiboot_magic, void *raw_boot_info) {
             }
 
             serial_puts("Detected installed partition layout, attempting root mount from partition...\n");
-            if (vfs_mount(root_source, "/", primary_fs, 0) != VFS_OK) {
+            if (vfs_mount(root_source, "/", primary_fs, root_flags) != VFS_OK) {
                 serial_puts("Primary partition filesystem mount failed, trying fallback filesystem...\n");
-                if (vfs_mount(root_source, "/", secondary_fs, 0) != VFS_OK) {
+                if (vfs_mount(root_source, "/", secondary_fs, root_flags) != VFS_OK) {
                     serial_puts("Partition root mount failed.\n");
                     serial_puts("Falling back to direct disk filesystem probe...\n");
                     root_part = NULL;
@@ -433,9 +448,9 @@ void kernel_main(uint32_t multiboot_magic, void *raw_boot_info) {
 
         if (!root_part || !simplefs_mounted) {
             // Legacy fallback: probe filesystem at LBA 0.
-            if (vfs_mount(NULL, "/", "simplefs", 0) != VFS_OK) {
+            if (vfs_mount(NULL, "/", "simplefs", root_flags) != VFS_OK) {
                 serial_puts("SimpleFS mount failed - trying FAT32...\n");
-                if (vfs_mount(NULL, "/", "fat32", 0) != VFS_OK) {
+                if (vfs_mount(NULL, "/", "fat32", root_flags) != VFS_OK) {
                     serial_puts("FAT32 mount failed - disk appears unformatted\n");
                     serial_puts("Falling back to ramfs. Use 'install' or 'format' command to initialize disk.\n");
                     unformatted_disk_detected = 1;  // Set flag for shell notification
@@ -453,7 +468,7 @@ void kernel_main(uint32_t multiboot_magic, void *raw_boot_info) {
             // Partition root mount path already succeeded.
         }
     } else {
-        serial_puts("No ATA drive available, using ramfs\n");
+        serial_puts("No disk available, using ramfs\n");
         simplefs_mounted = 0;  // No disk, using ramfs
         goto use_ramfs;
     }
@@ -562,6 +577,13 @@ mount_done:
     serial_puts("Initializing process manager...\n");
     init_process_manager();
     serial_puts("Process manager initialized.\n");
+    
+    // Dirty cached blocks are written back by a kernel thread from here on
+    bcache_start_writeback();
+    // SimpleFS metadata transactions are group-committed once a second
+    simplefs_start_journal_thread();
+    // Received packets are processed by the network bottom half from here on
+    net_start_rx_thread();
     register_component_task("kernel.core", TASK_TYPE_KERNEL, PRIORITY_HIGH);
     register_component_task("driver.keyboard", TASK_TYPE_DRIVER, PRIORITY_NORMAL);
     register_component_task("driver.mouse", TASK_TYPE_DRIVER, PRIORITY_NORMAL);
@@ -635,6 +657,12 @@ mount_done:
     arch_timer_init(100);
     serial_puts("System timer initialized.\n");
     
+    // Move from the PIT tick to per-CPU LAPIC clock events when available
+    clockevent_init();
+    
+    // Start the application processors (needs the timer for INIT/SIPI delays)
+    smp_init();
+    
     // Switch to multi-user runlevel and start multi-user services
     serial_puts("Starting multi-user services...\n");
     init_set_runlevel(RUNLEVEL_MULTI);
@@ -561,6 +561,21 @@ void kmodule_v2_timer_tick(void) {
     }
 }
 
+uint32_t kmodule_v2_timer_next_event(void) {
+    uint32_t now = arch_timer_get_ticks();
+    uint32_t next = 0xFFFFFFFFU;
+
+    for (int i = 0; i < MAX_MODULE_TIMERS; i++) {
+        mod_timer_entry_t* timer = &module_timers[i];
+        if (!timer->in_use || !timer->running || !timer->callback) continue;
+
+        int32_t delta = (int32_t)(timer->next_fire_tick - now);
+        if (delta <= 0) return 0;
+        if ((uint32_t)delta < next) next = (uint32_t)delta;
+    }
+    return next;
+}
+
 // --- System Info ---
 static int api_get_sysinfo(kmod_ctx_t* ctx, kmod_sysinfo_t* info) {
     if (!ctx || !check_cap(ctx, KMOD_CAP_SYSINFO)) return KMOD_ERR_CAPABILITY;
@@ -18,12 +18,13 @@
 
 
 #include <partition.h>
-#include <dev/ata.h>
+#include <dev/blkdev.h>
 #include <string.h>
 #include <serial.h>
 #include <fs/vfs.h>
 
 static partition_table_t global_partition_table;
+static uint32_t partition_table_disks = 0;  // Bit per block device that holds a table
 
 #define APT_DISK_MAGIC_0 'A'
 #define APT_DISK_MAGIC_1 'P'
@@ -42,6 +43,18 @@ typedef struct __attribute__((packed)) {
     uint32_t filesystem_type;
 } partition_disk_entry_t;
 
+// Legacy tables stored raw partition_t records as they were laid out then
+typedef struct {
+    char name[PARTITION_NAME_LEN];
+    uint8_t type;
+    uint8_t active;
+    uint32_t start_sector;
+    uint32_t sector_count;
+    uint32_t filesystem_type;
+    char mount_point[32];
+    int mounted;
+} partition_legacy_t;
+
 static void partition_reset_runtime_fields(partition_t* part) {
     if (!part) {
         return;
@@ -54,6 +67,7 @@ void init_partitions(void) {
     serial_puts("Initializing partition manager...\n");
     memset(&global_partition_table, 0, sizeof(partition_table_t));
     global_partition_table.count = 0;
+    partition_table_disks = 0;
     
     // Try to load existing partition table
     if (partition_load_table() != 0) {
@@ -78,6 +92,7 @@ int partition_create(const char* name, uint8_t type, uint32_t start_sector, uint
     part->start_sector = start_sector;
     part->sector_count = size_sectors;
     part->filesystem_type = PART_FS_UNKNOWN;
+    part->dev = 0;
     partition_reset_runtime_fields(part);
     
     global_partition_table.count++;
@@ -142,14 +157,28 @@ int partition_find_first_by_type_and_fs(uint8_t type, uint32_t filesystem_type)
     return -1;
 }
 
-int partition_mount(int partition_id, const char* mount_point, const char* fs_type) {
+int partition_mount_source(const partition_t* part, char* buf, uint32_t size) {
+    blk_device_t* dev = part ? blk_get_device(part->dev) : NULL;
+    if (!dev || !buf || size == 0) {
+        return -1;
+    }
+    snprintf(buf, size, "dev=%s lba=%u", dev->name, part->start_sector);
+    return 0;
+}
+
+int partition_mount(int partition_id, const char* mount_point, const char* fs_type, uint32_t flags) {
     partition_t* part = partition_get(partition_id);
     if (!part || part->mounted) {
         return -1;
     }
     
+    char source[48];
+    if (partition_mount_source(part, source, sizeof(source)) != 0) {
+        return -1;
+    }
+
     // Mount using VFS
-    if (vfs_mount(NULL, mount_point, fs_type, 0) != 0) {
+    if (vfs_mount(source, mount_point, fs_type, flags) != 0) {
         return -1;
     }
     
@@ -177,11 +206,12 @@ int partition_unmount(int partition_id) {
 
 int partition_scan_disk(void) {
     // For now, create a single partition using entire disk
-    if (!ata_drive_available()) {
+    blk_device_t* disk = blk_get_device(0);
+    if (!disk) {
         return -1;
     }
     
-    uint32_t total_sectors = ata_get_sector_count();
+    uint32_t total_sectors = disk->total_sectors;
     
     // Create default partition if none exist
     if (global_partition_table.count == 0) {
@@ -198,12 +228,7 @@ int partition_scan_disk(void) {
     return 0;
 }
 
-int partition_save_table(void) {
-    // Save partition table to sector 1 (sector 0 is boot sector)
-    if (!ata_drive_available()) {
-        return -1;
-    }
-    
+static int partition_save_device(uint32_t dev) {
     uint8_t buffer[512];
     memset(buffer, 0, sizeof(buffer));
 
@@ -212,15 +237,19 @@ int partition_save_table(void) {
     buffer[2] = APT_DISK_MAGIC_2;
     buffer[3] = APT_DISK_MARKER;
     buffer[4] = APT_DISK_VERSION;
-    buffer[5] = (uint8_t)global_partition_table.count;
-
-    uint32_t entry_bytes = sizeof(partition_disk_entry_t) * (uint32_t)global_partition_table.count;
-    if (APT_DISK_HEADER_SIZE + entry_bytes > sizeof(buffer)) {
-        return -1;
-    }
 
+    uint32_t count = 0;
     for (int i = 0; i < global_partition_table.count; i++) {
         const partition_t* src = &global_partition_table.partitions[i];
+        if (src->dev != dev) {
+            continue;
+        }
+
+        uint32_t offset = APT_DISK_HEADER_SIZE + count * (uint32_t)sizeof(partition_disk_entry_t);
+        if (offset + sizeof(partition_disk_entry_t) > sizeof(buffer)) {
+            return -1;
+        }
+
         partition_disk_entry_t entry;
         memset(&entry, 0, sizeof(entry));
         strncpy(entry.name, src->name, PARTITION_NAME_LEN - 1);
@@ -230,21 +259,48 @@ int partition_save_table(void) {
         entry.sector_count = src->sector_count;
         entry.filesystem_type = src->filesystem_type;
 
-        memcpy(buffer + APT_DISK_HEADER_SIZE + (i * sizeof(partition_disk_entry_t)),
-               &entry,
-               sizeof(entry));
+        memcpy(buffer + offset, &entry, sizeof(entry));
+        count++;
     }
+    buffer[5] = (uint8_t)count;
 
-    return ata_write_sectors(1, 1, buffer);
+    return blk_write(dev, 1, 1, buffer);
 }
 
-int partition_load_table(void) {
-    if (!ata_drive_available()) {
+int partition_save_table(void) {
+    // Save each disk's partitions to its sector 1 (sector 0 is boot sector)
+    uint32_t disks = blk_device_count();
+    if (disks == 0) {
         return -1;
     }
-    
+
+    int result = 0;
+    for (uint32_t dev = 0; dev < disks; dev++) {
+        int has_entries = 0;
+        for (int i = 0; i < global_partition_table.count; i++) {
+            if (global_partition_table.partitions[i].dev == dev) {
+                has_entries = 1;
+                break;
+            }
+        }
+
+        // Rewrite a disk that had a table even when its partitions are all gone
+        if (!has_entries && !(partition_table_disks & (1u << dev))) {
+            continue;
+        }
+        if (partition_save_device(dev) != 0) {
+            result = -1;
+            continue;
+        }
+        partition_table_disks |= (1u << dev);
+    }
+    return result;
+}
+
+static int partition_load_device(uint32_t dev) {
+    /* Append the partitions recorded on one disk to the global table. */
     uint8_t buffer[512];
-    if (ata_read_sectors(1, 1, buffer) != 0) {
+    if (blk_read(dev, 1, 1, buffer) != 0) {
         return -1;
     }
     
@@ -253,30 +309,27 @@ int partition_load_table(void) {
         return -1;  // Invalid signature
     }
 
-
-    memset(&global_partition_table, 0, sizeof(global_partition_table));
+    int base = global_partition_table.count;
 
     // New on-disk table format
     if (buffer[3] == APT_DISK_MARKER && buffer[4] == APT_DISK_VERSION) {
-        global_partition_table.count = (int)buffer[5];
-        if (global_partition_table.count < 0 || global_partition_table.count > MAX_PARTITIONS) {
-            global_partition_table.count = 0;
+        int count = (int)buffer[5];
+        if (count > MAX_PARTITIONS - base) {
             return -1;
         }
 
-        uint32_t entry_bytes = sizeof(partition_disk_entry_t) * (uint32_t)global_partition_table.count;
+        uint32_t entry_bytes = sizeof(partition_disk_entry_t) * (uint32_t)count;
         if (APT_DISK_HEADER_SIZE + entry_bytes > sizeof(buffer)) {
-            global_partition_table.count = 0;
             return -1;
         }
 
-        for (int i = 0; i < global_partition_table.count; i++) {
+        for (int i = 0; i < count; i++) {
             partition_disk_entry_t entry;
             memcpy(&entry,
                    buffer + APT_DISK_HEADER_SIZE + (i * sizeof(partition_disk_entry_t)),
                    sizeof(entry));
 
-            partition_t* dst = &global_partition_table.partitions[i];
+            partition_t* dst = &global_partition_table.partitions[base + i];
             memset(dst, 0, sizeof(*dst));
             strncpy(dst->name, entry.name, PARTITION_NAME_LEN - 1);
             dst->name[PARTITION_NAME_LEN - 1] = '\0';
@@ -285,37 +338,72 @@ int partition_load_table(void) {
             dst->start_sector = entry.start_sector;
             dst->sector_count = entry.sector_count;
             dst->filesystem_type = entry.filesystem_type;
+            dst->dev = dev;
             partition_reset_runtime_fields(dst);
         }
 
-        serial_puts("Loaded partition table from disk\n");
+        global_partition_table.count = base + count;
+        partition_table_disks |= (1u << dev);
         return 0;
     }
 
     // Legacy format compatibility:
     //  [0..2] magic "APT"
     //  [3]    count
-    //  [4..]  raw partition_t array
-    global_partition_table.count = (int)buffer[3];
-    if (global_partition_table.count < 0 || global_partition_table.count > MAX_PARTITIONS) {
-        global_partition_table.count = 0;
+    //  [4..]  raw partition_legacy_t array
+    int count = (int)buffer[3];
+    if (count > MAX_PARTITIONS - base) {
         return -1;
     }
 
-    uint32_t legacy_bytes = sizeof(partition_t) * (uint32_t)global_partition_table.count;
+    uint32_t legacy_bytes = sizeof(partition_legacy_t) * (uint32_t)count;
     if (4 + legacy_bytes > sizeof(buffer)) {
-        global_partition_table.count = 0;
         return -1;
     }
 
-    memcpy(&global_partition_table.partitions, buffer + 4, legacy_bytes);
-    for (int i = 0; i < global_partition_table.count; i++) {
-        partition_reset_runtime_fields(&global_partition_table.partitions[i]);
-        if (global_partition_table.partitions[i].filesystem_type == 0) {
-            global_partition_table.partitions[i].filesystem_type = PART_FS_UNKNOWN;
+    for (int i = 0; i < count; i++) {
+        partition_legacy_t entry;
+        memcpy(&entry, buffer + 4 + (i * sizeof(partition_legacy_t)), sizeof(entry));
+
+        partition_t* dst = &global_partition_table.partitions[base + i];
+        memset(dst, 0, sizeof(*dst));
+        memcpy(dst->name, entry.name, PARTITION_NAME_LEN);
+        dst->name[PARTITION_NAME_LEN - 1] = '\0';
+        dst->type = entry.type;
+        dst->active = entry.active;
+        dst->start_sector = entry.start_sector;
+        dst->sector_count = entry.sector_count;
+        dst->filesystem_type = entry.filesystem_type;
+        if (dst->filesystem_type == 0) {
+            dst->filesystem_type = PART_FS_UNKNOWN;
         }
+        dst->dev = dev;
+        partition_reset_runtime_fields(dst);
     }
 
-    serial_puts("Loaded partition table from disk\n");
+    global_partition_table.count = base + count;
+    partition_table_disks |= (1u << dev);
     return 0;
 }
+
+int partition_load_table(void) {
+    uint32_t disks = blk_device_count();
+    if (disks == 0) {
+        return -1;
+    }
+
+    memset(&global_partition_table, 0, sizeof(global_partition_table));
+    partition_table_disks = 0;
+
+    int loaded = 0;
+    for (uint32_t dev = 0; dev < disks; dev++) {
+        if (partition_load_device(dev) == 0) {
+            blk_device_t* disk = blk_get_device(dev);
+            serial_puts("Loaded partition table from ");
+            serial_puts(disk->name);
+            serial_puts("\n");
+            loaded++;
+        }
+    }
+    return loaded ? 0 : -1;
+}
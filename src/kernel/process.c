@@ -10,6 +10,7 @@
 
 #include <process.h>
 #include <string.h>
+#include <stdlib.h>
 #include <serial.h>
 #include <arch.h>
 #include <arch_paging.h>
@@ -21,12 +22,23 @@
 #include <fileperm.h>
 #include <init.h>
 #include <kmodule.h>
+#include <smp.h>
+#include <ktime.h>
+#include <clockevent.h>
 
 /*
  * Process manager overview:
  *
  * - `process_table` is the authoritative process registry.
- * - Ready queues are priority-bucket FIFO lists (`PRIORITY_IDLE..REALTIME`).
+ * - Every CPU owns a run queue: priority-bucket FIFO lists
+ *   (`PRIORITY_IDLE..REALTIME`) with head/tail pointers and a non-empty
+ *   bitmap, so enqueue, dequeue and picking the next task are all O(1).
+ *   New tasks go to the least loaded CPU; a CPU with an empty queue steals
+ *   from the busiest one before falling back to its idle task.
+ * - Queues, the sleep wheel and the process table are serialised by the SMP
+ *   kernel lock (see smp.h), which every caller already holds.
+ * - Sleepers live in a hierarchical timer wheel keyed by wake tick; a tick
+ *   only touches the bucket that expires now instead of the whole table.
  * - Scheduling is preemptive tick-based with per-priority time slices.
  * - Context switching is delegated to arch-specific switch routines.
  *
@@ -36,16 +48,43 @@
 
 // Process table
 static process_t process_table[MAX_PROCESSES];
-static process_t* current_process = NULL;
 static process_t* idle_process = NULL;
 static pid_t next_pid = 1;
 
-// Ready queues (one per priority level)
-static process_t* ready_queue[5] = {NULL, NULL, NULL, NULL, NULL};
+// Task running on this CPU
+#define current_process (smp_this_cpu()->current)
 
-// Ticks counter for scheduler
+// Per-CPU ready queues (one FIFO per priority level)
+typedef struct {
+    process_t* head[5];
+    process_t* tail[5];
+    /*
+     * Bit (PRIORITY_REALTIME - p) is set while head[p] is non-empty, so the
+     * lowest set bit (bsf) is always the highest runnable priority.
+     */
+    uint32_t bitmap;
+    uint32_t nr_running;            // Queued tasks, used for placement/stealing
+} runqueue_t;
+
+static runqueue_t runqueues[SMP_MAX_CPUS];
+#define READY_BIT(priority) (1u << (PRIORITY_REALTIME - (priority)))
+
+// Ticks counter for scheduler (same origin as ktime_get_ticks())
 static uint32_t scheduler_ticks = 0;
-static volatile uint32_t preempt_disable_depth = 0;
+
+/*
+ * Sleep timer wheel: 4 levels of 64 slots. Level 0 holds sleepers due within
+ * 64 ticks at single-tick resolution; each higher level covers 64x the range
+ * of the one below and is cascaded down when the lower level wraps.
+ */
+#define TIMER_WHEEL_BITS   6
+#define TIMER_WHEEL_SLOTS  (1u << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK   (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_MAX_DELTA ((1u << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+static process_t* timer_wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+static uint32_t timer_wheel_tick = 0;  // Next tick the wheel will expire
 
 // Time slice per priority (in ticks)
 static const uint32_t time_slices[5] = {
@@ -78,41 +117,219 @@ const char* process_task_type_name(task_type_t type) {
     }
 }
 
+static void timer_wheel_remove(process_t* proc);
+
 static void enqueue_process(process_t* proc) {
     /*
      * Insert process at tail of its priority queue (round-robin within level).
      * Only schedulable tasks are queue-managed.
      */
     if (!proc || !proc->schedulable) return;
-    
+
+    timer_wheel_remove(proc);
+    proc->state = PROCESS_READY;
+    if (proc->on_runqueue) return;  // Already queued, keep its position
+
     int priority = clamp_priority(proc->priority);
-    
+    runqueue_t* rq = &runqueues[proc->cpu];
+
     proc->next = NULL;
-    proc->state = PROCESS_READY;
-    
-    if (!ready_queue[priority]) {
-        ready_queue[priority] = proc;
+    proc->prev = rq->tail[priority];
+    if (rq->tail[priority]) {
+        rq->tail[priority]->next = proc;
     } else {
-        process_t* current = ready_queue[priority];
-        while (current->next) {
-            current = current->next;
-        }
-        current->next = proc;
+        rq->head[priority] = proc;
+    }
+    rq->tail[priority] = proc;
+    proc->on_runqueue = 1;
+    rq->bitmap |= READY_BIT(priority);
+    rq->nr_running++;
+
+    // An idle CPU may be halted until its next deadline: wake it up
+    cpu_local_t* owner = smp_cpu(proc->cpu);
+    if (owner->current == owner->idle) {
+        smp_send_reschedule(proc->cpu);
     }
 }
 
-static process_t* dequeue_process(int priority) {
+static void runqueue_remove(process_t* proc) {
+    /* Unlink a queued process in O(1), e.g. when it is killed or blocked. */
+    if (!proc || !proc->on_runqueue) return;
+
+    int priority = clamp_priority(proc->priority);
+    runqueue_t* rq = &runqueues[proc->cpu];
+
+    if (proc->prev) {
+        proc->prev->next = proc->next;
+    } else {
+        rq->head[priority] = proc->next;
+    }
+    if (proc->next) {
+        proc->next->prev = proc->prev;
+    } else {
+        rq->tail[priority] = proc->prev;
+    }
+    proc->next = NULL;
+    proc->prev = NULL;
+    proc->on_runqueue = 0;
+    rq->nr_running--;
+
+    if (!rq->head[priority]) {
+        rq->bitmap &= ~READY_BIT(priority);
+    }
+}
+
+static process_t* dequeue_process(uint32_t cpu, int priority) {
     /* Pop next runnable process from the selected priority queue. */
     if (priority < PRIORITY_IDLE || priority > PRIORITY_REALTIME) return NULL;
-    if (!ready_queue[priority]) return NULL;
-    
-    process_t* proc = ready_queue[priority];
-    ready_queue[priority] = proc->next;
-    proc->next = NULL;
-    
+
+    process_t* proc = runqueues[cpu].head[priority];
+    if (!proc) return NULL;
+
+    runqueue_remove(proc);
     return proc;
 }
 
+static process_t* dequeue_local(uint32_t cpu) {
+    /* Pop the head of the highest non-empty priority queue of `cpu`. */
+    uint32_t bitmap = runqueues[cpu].bitmap;
+    if (!bitmap) return NULL;
+    return dequeue_process(cpu, PRIORITY_REALTIME - __builtin_ctz(bitmap));
+}
+
+static process_t* dequeue_highest(uint32_t cpu) {
+    /*
+     * Local work first; an otherwise idle CPU pulls the best task from the
+     * busiest queue so runnable work never waits behind a loaded CPU.
+     */
+    process_t* proc = dequeue_local(cpu);
+    if (proc) return proc;
+
+    uint32_t busiest = cpu;
+    uint32_t busiest_load = 0;
+    for (uint32_t i = 0; i < smp_cpu_count(); i++) {
+        if (i == cpu || !smp_cpu(i)->online) continue;
+        if (runqueues[i].nr_running > busiest_load) {
+            busiest = i;
+            busiest_load = runqueues[i].nr_running;
+        }
+    }
+    if (busiest == cpu) return NULL;
+
+    proc = dequeue_local(busiest);
+    if (proc) {
+        proc->cpu = (uint8_t)cpu;
+    }
+    return proc;
+}
+
+static uint32_t select_cpu(void) {
+    /* Place a new task on the online CPU with the shortest ready queue. */
+    uint32_t best = smp_cpu_index();
+    for (uint32_t i = 0; i < smp_cpu_count(); i++) {
+        if (!smp_cpu(i)->online) continue;
+        if (runqueues[i].nr_running < runqueues[best].nr_running) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+static void timer_wheel_insert(process_t* proc) {
+    /* File a sleeper into the wheel level whose range covers its wake tick. */
+    uint32_t expires = proc->wake_time;
+    uint32_t delta = expires - timer_wheel_tick;
+    uint32_t level = 0;
+
+    if ((int32_t)delta < 0) {
+        // Already due: expire on the very next wheel step
+        expires = timer_wheel_tick;
+        delta = 0;
+    } else if (delta > TIMER_WHEEL_MAX_DELTA) {
+        // Beyond the wheel horizon: park at the top and re-file on cascade
+        expires = timer_wheel_tick + TIMER_WHEEL_MAX_DELTA;
+        delta = TIMER_WHEEL_MAX_DELTA;
+    }
+
+    while (level < TIMER_WHEEL_LEVELS - 1 &&
+           delta >= (1u << (TIMER_WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+
+    uint32_t slot = (expires >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+
+    proc->timer_level = (uint8_t)level;
+    proc->timer_slot = (uint8_t)slot;
+    proc->timer_prev = NULL;
+    proc->timer_next = timer_wheel[level][slot];
+    if (proc->timer_next) {
+        proc->timer_next->timer_prev = proc;
+    }
+    timer_wheel[level][slot] = proc;
+    proc->on_timer_wheel = 1;
+}
+
+static void timer_wheel_remove(process_t* proc) {
+    if (!proc || !proc->on_timer_wheel) return;
+
+    if (proc->timer_prev) {
+        proc->timer_prev->timer_next = proc->timer_next;
+    } else {
+        timer_wheel[proc->timer_level][proc->timer_slot] = proc->timer_next;
+    }
+    if (proc->timer_next) {
+        proc->timer_next->timer_prev = proc->timer_prev;
+    }
+    proc->timer_next = NULL;
+    proc->timer_prev = NULL;
+    proc->on_timer_wheel = 0;
+}
+
+static int timer_wheel_cascade(uint32_t level) {
+    /* Re-file one bucket of `level` into the finer levels below it. */
+    uint32_t slot = (timer_wheel_tick >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    process_t* proc = timer_wheel[level][slot];
+
+    timer_wheel[level][slot] = NULL;
+    while (proc) {
+        process_t* next = proc->timer_next;
+        proc->on_timer_wheel = 0;
+        timer_wheel_insert(proc);
+        proc = next;
+    }
+    return (int)slot;
+}
+
+static void timer_wheel_advance(void) {
+    /* Expire every wheel step up to and including the current tick. */
+    while ((int32_t)(scheduler_ticks - timer_wheel_tick) >= 0) {
+        uint32_t slot = timer_wheel_tick & TIMER_WHEEL_MASK;
+
+        if (slot == 0) {
+            for (uint32_t level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+                if (timer_wheel_cascade(level) != 0) break;
+            }
+        }
+
+        process_t* proc = timer_wheel[0][slot];
+        timer_wheel[0][slot] = NULL;
+        while (proc) {
+            process_t* next = proc->timer_next;
+            proc->timer_next = NULL;
+            proc->timer_prev = NULL;
+            proc->on_timer_wheel = 0;
+            // Sleepers, and waiters whose wait_queue_wait() timed out
+            if (proc->schedulable && (proc->state == PROCESS_SLEEPING ||
+                                      (proc->state == PROCESS_BLOCKED && proc->wait_queue))) {
+                enqueue_process(proc);
+            }
+            proc = next;
+        }
+
+        timer_wheel_tick++;
+    }
+}
+
 static process_t* allocate_process(void) {
     /*
      * Reuse dead slots to avoid dynamic table growth and keep PID ownership
@@ -130,7 +347,7 @@ static process_t* allocate_process(void) {
 
 static void idle_task(void) {
     while (1) {
-        asm volatile("hlt");  // Halt until next interrupt
+        smp_wait_for_interrupt();  // Halt until next interrupt
     }
 }
 
@@ -195,7 +412,8 @@ void init_process_manager(void) {
         idle_process->file_descriptors[i] = -1;
     }
     
-    enqueue_process(idle_process);
+    // Never queued: schedule() falls back to the CPU's idle task
+    smp_this_cpu()->idle = idle_process;
     
     // Create initial kernel process (current context)
     current_process = allocate_process();
@@ -340,6 +558,9 @@ int process_mark_task_state(pid_t pid, process_state_t state) {
 
     if (proc->schedulable && state == PROCESS_READY) {
         enqueue_process(proc);
+    } else {
+        runqueue_remove(proc);
+        timer_wheel_remove(proc);
     }
 
     return 0;
@@ -356,7 +577,15 @@ int process_set_current_identity(const char* name, task_type_t type, int priorit
     }
 
     current_process->task_type = type;
-    current_process->priority = clamp_priority(priority);
+    if (current_process->on_runqueue) {
+        // Re-file under the new priority so the queue bitmap stays exact
+        runqueue_remove(current_process);
+        current_process->priority = clamp_priority(priority);
+        enqueue_process(current_process);
+        current_process->state = PROCESS_RUNNING;
+    } else {
+        current_process->priority = clamp_priority(priority);
+    }
     current_process->time_slice = time_slices[current_process->priority];
     current_process->privilege_level = privilege_level;
     current_process->schedulable = 1;
@@ -406,10 +635,10 @@ pid_t process_create(const char* name, void (*entry_point)(void), int priority)
     }
     proc->kernel_stack = (uintptr_t)kernel_stack_mem + 8192;  // 8KB kernel stack
     
-    // Allocate user stack
+    // Reserve the user stack; pages are backed as the stack grows into them
     proc->user_stack = VMM_USER_STACK_TOP;
-    vmm_alloc_at(proc->address_space, proc->user_stack - 8192, 8192, 
-                 VMM_PRESENT | VMM_WRITE | VMM_USER);
+    vmm_alloc_at(proc->address_space, VMM_USER_STACK_BASE, VMM_USER_STACK_RESERVE,
+                 VMM_PRESENT | VMM_WRITE | VMM_USER | VMM_DEMAND);
     
     // Initialize context
     proc->context.eip = (uintptr_t)entry_point;
@@ -454,6 +683,7 @@ pid_t process_create(const char* name, void (*entry_point)(void), int priority)
     proc->privilege_level = 3;  // User mode by default
     
     // Add to ready queue
+    proc->cpu = (uint8_t)select_cpu();
     enqueue_process(proc);
     
     return proc->pid;
@@ -531,6 +761,7 @@ pid_t process_create_kernel_thread(const char* name, void (*entry_point)(void),
         proc->parent = current_process;
     }
 
+    proc->cpu = (uint8_t)select_cpu();
     enqueue_process(proc);
     return proc->pid;
 }
@@ -539,6 +770,8 @@ pid_t process_create_kernel_thread(const char* name, void (*entry_point)(void),
 void process_exit(int status) {
     if (!current_process) return;
     
+    runqueue_remove(current_process);
+    timer_wheel_remove(current_process);
     current_process->exit_status = status;
     current_process->state = PROCESS_ZOMBIE;
     
@@ -558,7 +791,7 @@ void process_yield(void) {
     if (!current_process || !current_process->schedulable) return;
     
     // Put current process back in ready queue
-    if (current_process->state == PROCESS_RUNNING) {
+    if (current_process->state == PROCESS_RUNNING && current_process != smp_this_cpu()->idle) {
         enqueue_process(current_process);
     }
     
@@ -570,99 +803,280 @@ void process_yield(void) {
 void process_sleep(uint32_t milliseconds) {
     if (!current_process || !current_process->schedulable) return;
     
+    // Wake in the first tick that starts at or after the deadline, so a
+    // sleep never ends early; always wait at least one tick
+    uint64_t deadline = ktime_get_ns() + (uint64_t)milliseconds * NSEC_PER_MSEC;
+    uint32_t wake = ktime_ns_to_ticks(deadline + ktime_tick_ns() - 1);
+
+    uintptr_t irq = arch_irq_save();
+    if ((int32_t)(wake - scheduler_ticks) <= 0) {
+        wake = scheduler_ticks + 1;
+    }
+    runqueue_remove(current_process);
     current_process->state = PROCESS_SLEEPING;
-    current_process->wake_time = scheduler_ticks + (milliseconds / 10);  // Assume 10ms tick
+    current_process->wake_time = wake;
+    timer_wheel_insert(current_process);
+    arch_irq_restore(irq);
+    
+    // Only the BSP runs the wheel; let it re-arm for an earlier deadline
+    if (smp_cpu_index() != 0 && clockevent_is_oneshot()) {
+        smp_send_reschedule(0);
+    }
     
     schedule();
 }
 
-// Scheduler tick (called from timer interrupt)
+// Periodic scheduler tick (PIT IRQ0 on the BSP until clock events take over)
 void scheduler_tick(void) {
-    scheduler_ticks++;
+    scheduler_advance(scheduler_ticks + 1);
+    
+    // Application processors account their own slices from the forwarded tick
+    smp_send_tick();
+    scheduler_tick_local(1);
+}
+
+void scheduler_advance(uint32_t now) {
+    /*
+     * Global tick work, run on the BSP only. A tickless BSP may skip many
+     * ticks; the wheel catches up bucket by bucket.
+     */
+    if ((int32_t)(now - scheduler_ticks) <= 0) return;
+    scheduler_ticks = now;
 
     // Service module timers on each scheduler tick.
     kmodule_v2_timer_tick();
     
-    // Wake up sleeping processes
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (process_table[i].schedulable && process_table[i].state == PROCESS_SLEEPING) {
-            if (scheduler_ticks >= process_table[i].wake_time) {
-                enqueue_process(&process_table[i]);
-            }
-        }
+    // Wake up sleepers whose wheel bucket expired by now
+    timer_wheel_advance();
+}
+
+void scheduler_tick_local(uint32_t elapsed) {
+    /* Charge `elapsed` ticks to this CPU's task; 0 is a reschedule kick. */
+    cpu_local_t* cpu = smp_this_cpu();
+    process_t* proc = cpu->current;
+    cpu->ticks += elapsed;
+
+    if (!proc || cpu->preempt_disable_depth != 0) return;
+
+    // The idle task yields as soon as there is anything to run or steal
+    if (proc == cpu->idle) {
+        schedule();
+        return;
     }
     
     // Decrement time slice of current process
-    if (current_process && current_process->schedulable && current_process->state == PROCESS_RUNNING) {
-        if (current_process->time_slice > 0) {
-            current_process->time_slice--;
-        }
+    if (proc->schedulable && proc->state == PROCESS_RUNNING) {
+        proc->time_slice = (proc->time_slice > elapsed) ? proc->time_slice - elapsed : 0;
         
-        if (current_process->time_slice == 0) {
-            // Time slice expired, reschedule unless kernel preemption is suppressed.
-            if (preempt_disable_depth == 0) {
-                schedule();
+        if (proc->time_slice == 0) {
+            // Time slice expired, reschedule
+            schedule();
+        }
+    }
+}
+
+static uint32_t timer_wheel_next_expiry(void) {
+    /*
+     * First tick with a level-0 sleeper, or the next level-0 wrap if outer
+     * levels hold sleepers that a cascade may move closer.
+     */
+    int outer_pending = 0;
+    for (uint32_t level = 1; level < TIMER_WHEEL_LEVELS && !outer_pending; level++) {
+        for (uint32_t slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            if (timer_wheel[level][slot]) {
+                outer_pending = 1;
+                break;
             }
         }
     }
+
+    for (uint32_t i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+        uint32_t tick = timer_wheel_tick + i;
+        if (timer_wheel[0][tick & TIMER_WHEEL_MASK]) return tick;
+        if (outer_pending && i != 0 && (tick & TIMER_WHEEL_MASK) == 0) return tick;
+    }
+    return outer_pending ? timer_wheel_tick + TIMER_WHEEL_SLOTS : timer_wheel_tick + TIMER_WHEEL_MAX_DELTA;
+}
+
+uint32_t scheduler_next_event(uint32_t now) {
+    /*
+     * Ticks from `now` until this CPU needs a clock event: the running
+     * task's slice expiry and, on the BSP, the next sleeper or module timer.
+     * An idle AP has no deadline of its own (0xFFFFFFFF).
+     */
+    cpu_local_t* cpu = smp_this_cpu();
+    process_t* proc = cpu->current;
+    uint32_t next = 0xFFFFFFFFu;
+
+    if (proc && proc != cpu->idle && proc->schedulable && proc->state == PROCESS_RUNNING) {
+        next = proc->time_slice ? proc->time_slice : 1;
+    }
+
+    if (cpu->index == 0) {
+        int32_t wheel = (int32_t)(timer_wheel_next_expiry() - now);
+        uint32_t wheel_ticks = wheel > 0 ? (uint32_t)wheel : 0;
+        if (wheel_ticks < next) next = wheel_ticks;
+
+        uint32_t module_ticks = kmodule_v2_timer_next_event();
+        if (module_ticks < next) next = module_ticks;
+    }
+    return next;
 }
 
 void process_set_preempt_disabled(int disabled) {
+    cpu_local_t* cpu = smp_this_cpu();
     if (disabled) {
-        preempt_disable_depth++;
-    } else if (preempt_disable_depth > 0) {
-        preempt_disable_depth--;
+        cpu->preempt_disable_depth++;
+    } else if (cpu->preempt_disable_depth > 0) {
+        cpu->preempt_disable_depth--;
     }
 }
 
 int process_is_preempt_disabled(void) {
-    return preempt_disable_depth != 0;
+    return smp_this_cpu()->preempt_disable_depth != 0;
+}
+
+void wait_queue_init(wait_queue_t* wq) {
+    wq->head = NULL;
+}
+
+static void wait_queue_unlink(process_t* proc) {
+    wait_queue_t* wq = proc->wait_queue;
+    if (!wq) return;
+
+    process_t** link = &wq->head;
+    while (*link) {
+        if (*link == proc) {
+            *link = proc->wait_next;
+            break;
+        }
+        link = &(*link)->wait_next;
+    }
+    proc->wait_next = NULL;
+    proc->wait_queue = NULL;
+}
+
+int process_can_block(void) {
+    /*
+     * Idle tasks, boot code, preempt-disabled sections and code running
+     * with interrupts off (nothing could wake it) must not sleep.
+     */
+    cpu_local_t* cpu = smp_this_cpu();
+    process_t* proc = cpu->current;
+    uintptr_t flags = arch_irq_save();
+    arch_irq_restore(flags);
+
+    return (flags & 0x200) && proc && proc->schedulable && proc != cpu->idle &&
+           cpu->preempt_disable_depth == 0;
+}
+
+int wait_queue_wait(wait_queue_t* wq, volatile uint32_t* condition, uint32_t timeout_ms) {
+    if (!wq || !condition) return -1;
+
+    uint32_t wake = 0;
+    if (timeout_ms) {
+        uint64_t deadline = ktime_get_ns() + (uint64_t)timeout_ms * NSEC_PER_MSEC;
+        wake = ktime_ns_to_ticks(deadline + ktime_tick_ns() - 1);
+    }
+
+    for (;;) {
+        // The condition is re-checked with interrupts off so a wake-up from
+        // the IRQ handler cannot slip in between the check and the block
+        uintptr_t irq = arch_irq_save();
+        if (*condition) {
+            arch_irq_restore(irq);
+            return 0;
+        }
+        if (timeout_ms && (int32_t)(scheduler_ticks - wake) >= 0) {
+            arch_irq_restore(irq);
+            return -1;
+        }
+
+        runqueue_remove(current_process);
+        current_process->state = PROCESS_BLOCKED;
+        current_process->wait_queue = wq;
+        current_process->wait_next = wq->head;
+        wq->head = current_process;
+        if (timeout_ms) {
+            current_process->wake_time = wake;
+            timer_wheel_insert(current_process);
+        }
+        arch_irq_restore(irq);
+
+        if (timeout_ms && smp_cpu_index() != 0 && clockevent_is_oneshot()) {
+            smp_send_reschedule(0);
+        }
+        schedule();
+
+        irq = arch_irq_save();
+        wait_queue_unlink(current_process);
+        timer_wheel_remove(current_process);
+        arch_irq_restore(irq);
+    }
+}
+
+void wait_queue_wake_all(wait_queue_t* wq) {
+    if (!wq) return;
+
+    uintptr_t irq = arch_irq_save();
+    process_t* proc = wq->head;
+    wq->head = NULL;
+    while (proc) {
+        process_t* next = proc->wait_next;
+        proc->wait_next = NULL;
+        proc->wait_queue = NULL;
+        if (proc->state == PROCESS_BLOCKED) {
+            enqueue_process(proc);
+        }
+        proc = next;
+    }
+    arch_irq_restore(irq);
 }
 
 // Main scheduler
 void schedule(void) {
+    cpu_local_t* cpu = smp_this_cpu();
+
     if (!current_process) {
         // First time scheduling
-        for (int priority = 4; priority >= 0; priority--) {
-            process_t* next = dequeue_process(priority);
-            if (next) {
-                current_process = next;
-                current_process->state = PROCESS_RUNNING;
-                current_process->time_slice = time_slices[current_process->priority];
-                
-                // Switch address space
-                switch_address_space(current_process->address_space);
+        process_t* next = dequeue_highest(cpu->index);
+        if (next) {
+            current_process = next;
+            current_process->state = PROCESS_RUNNING;
+            current_process->time_slice = time_slices[current_process->priority];
+            
+            // Switch address space
+            switch_address_space(current_process->address_space);
 #ifdef ARCH_HAS_SEGMENTATION
-                arch_set_kernel_stack(current_process->kernel_stack);
+            arch_set_kernel_stack(current_process->kernel_stack);
 #endif
-                
-                return;
-            }
+            
+            return;
         }
         panic("No processes to schedule!");
     }
     
     process_t* old_process = current_process;
+    int old_runnable = old_process->schedulable && old_process->state == PROCESS_RUNNING;
     
-    // Save old process state if still running
-    if (old_process->schedulable && old_process->state == PROCESS_RUNNING) {
+    // Save old process state if still running (idle tasks are never queued)
+    if (old_runnable && old_process != cpu->idle) {
+        if (!old_process->on_runqueue) {
+            old_process->cpu = (uint8_t)cpu->index;
+        }
         enqueue_process(old_process);
     }
     
     // Find next process to run (highest priority first)
-    process_t* next = NULL;
-    for (int priority = 4; priority >= 0; priority--) {
-        next = dequeue_process(priority);
-        if (next) break;
-    }
+    process_t* next = dequeue_highest(cpu->index);
     
     if (!next) {
         // No process ready, continue with current or idle
-        if (old_process->schedulable && old_process->state == PROCESS_RUNNING) {
+        if (old_runnable) {
             return;  // Keep running current
         }
-        if (idle_process) {
-            next = idle_process;
+        if (cpu->idle) {
+            next = cpu->idle;
         } else {
             panic("No processes to schedule!");
         }
@@ -679,12 +1093,57 @@ void schedule(void) {
     arch_set_kernel_stack(current_process->kernel_stack);
 #endif
     
+    // Tickless: the next clock event depends on the new task's slice
+    clockevent_reprogram();
+    
     // Perform context switch if different process
     if (old_process != current_process) {
         switch_context(&old_process->context, &current_process->context);
     }
 }
 
+void process_run_cpu_idle(void) {
+    /*
+     * Entered once per application processor (kernel lock held) after its
+     * LAPIC and descriptor tables are live. The boot stack becomes the idle
+     * task's stack, and the loop below only runs while nothing is runnable.
+     */
+    cpu_local_t* cpu = smp_this_cpu();
+    process_t* idle = allocate_process();
+    if (!idle) {
+        panic("Failed to create AP idle task");
+    }
+
+    char index[12];
+    itoa(cpu->index, index, 10);
+    strcpy(idle->name, "idle/");
+    strcat(idle->name, index);
+    idle->task_type = TASK_TYPE_KERNEL;
+    idle->schedulable = 1;
+    idle->priority = PRIORITY_IDLE;
+    idle->state = PROCESS_RUNNING;
+    idle->parent_pid = 0;
+    idle->address_space = kernel_address_space;
+    idle->kernel_stack = cpu->stack_top;
+    idle->cpu = (uint8_t)cpu->index;
+    sandbox_create(&idle->sandbox, CAGE_NONE);
+    idle->owner_type = OWNER_SYSTEM;
+    idle->owner_id = 0;
+    idle->privilege_level = 0;
+    for (int i = 0; i < MAX_OPEN_FILES; i++) {
+        idle->file_descriptors[i] = -1;
+    }
+
+    cpu->idle = idle;
+    cpu->current = idle;
+    switch_address_space(kernel_address_space);
+
+    while (1) {
+        schedule();
+        smp_wait_for_interrupt();
+    }
+}
+
 // Memory management - sbrk
 void* process_sbrk(int increment) {
     if (!current_process || !current_process->address_space) {
@@ -695,24 +1154,34 @@ void* process_sbrk(int increment) {
     uintptr_t old_heap = as->heap_end;
     
     if (increment > 0) {
-        // Expand heap
+        // Expand heap: only reserve the new pages, they are backed on first touch
         uintptr_t new_heap = old_heap + (uintptr_t)increment;
-        if (new_heap < old_heap) {
+        if (new_heap < old_heap || new_heap > VMM_USER_STACK_BASE) {
             return (void*)-1;
         }
-        if (vmm_alloc_at(as, old_heap, (size_t)increment, VMM_PRESENT | VMM_WRITE | VMM_USER)) {
-            as->heap_end = new_heap;
-            return (void*)old_heap;
+        uintptr_t map_start = PAGE_ALIGN_UP(old_heap);
+        uintptr_t map_end = PAGE_ALIGN_UP(new_heap);
+        if (map_end > map_start &&
+            !vmm_alloc_at(as, map_start, (size_t)(map_end - map_start),
+                          VMM_PRESENT | VMM_WRITE | VMM_USER | VMM_DEMAND)) {
+            return (void*)-1;
         }
-        return (void*)-1;
+        as->heap_end = new_heap;
+        return (void*)old_heap;
     } else if (increment < 0) {
-        // Shrink heap
+        // Shrink heap, releasing only pages that no longer hold any heap byte
         uintptr_t shrink = (uintptr_t)(-increment);
         if (shrink > (old_heap - as->heap_start)) {
             return (void*)-1;  // Can't shrink below start
         }
-        as->heap_end -= shrink;
-        vmm_free_pages(as, as->heap_end, (size_t)(shrink / PAGE_SIZE));
+        uintptr_t new_heap = old_heap - shrink;
+        uintptr_t unmap_start = PAGE_ALIGN_UP(new_heap);
+        uintptr_t unmap_end = PAGE_ALIGN_UP(old_heap);
+        if (unmap_end > unmap_start &&
+            vmm_free_pages(as, unmap_start, (size_t)((unmap_end - unmap_start) / PAGE_SIZE)) != 0) {
+            return (void*)-1;
+        }
+        as->heap_end = new_heap;
         return (void*)as->heap_end;
     }
     
@@ -742,17 +1211,13 @@ int process_fork(void) {
     child->parent = current_process;
     child->time_slice = time_slices[child->priority];
     
-    // Create address space (copy-on-write would be ideal, but we'll do full copy)
-    child->address_space = create_address_space();
+    // Share the parent's memory copy-on-write; only page tables are copied
+    child->address_space = vmm_fork_address_space(current_process->address_space);
     if (!child->address_space) {
         child->state = PROCESS_DEAD;
         return -1;
     }
     
-    // Copy address space (simplified - full copy)
-    // In real OS, use copy-on-write
-    // TODO: Implement proper memory copying
-    
     // Allocate kernel stack
     void* child_kernel_stack_mem = kmalloc(8192);
     if (!child_kernel_stack_mem) {
@@ -773,6 +1238,7 @@ int process_fork(void) {
     current_process->children = child;
     
     // Add to ready queue
+    child->cpu = (uint8_t)select_cpu();
     enqueue_process(child);
     
     return child->pid;  // Parent returns child PID
@@ -883,6 +1349,9 @@ int process_kill(int pid, int signal) {
     if (proc == current_process) {
         process_exit(128 + signal);
     } else {
+        runqueue_remove(proc);
+        timer_wheel_remove(proc);
+        wait_queue_unlink(proc);
         proc->exit_status = 128 + signal;
         proc->state = PROCESS_ZOMBIE;
         
@@ -930,11 +1399,10 @@ int process_execve(const char* path, char* const argv[], char* const envp[]) {
         return -1;
     }
     
-    // Setup new user stack
+    // Setup new user stack (reserved, backed on demand)
     current_process->user_stack = VMM_USER_STACK_TOP;
-    vmm_alloc_at(current_process->address_space, 
-                 current_process->user_stack - 8192, 8192,
-                 VMM_PRESENT | VMM_WRITE | VMM_USER);
+    vmm_alloc_at(current_process->address_space, VMM_USER_STACK_BASE, VMM_USER_STACK_RESERVE,
+                 VMM_PRESENT | VMM_WRITE | VMM_USER | VMM_DEMAND);
     
     // Switch to new address space
     switch_address_space(current_process->address_space);
@@ -942,7 +1410,9 @@ int process_execve(const char* path, char* const argv[], char* const envp[]) {
     // Enter ring 3 and execute the program
     // This function does not return
     extern void enter_usermode(uintptr_t entry_point, uintptr_t user_stack, int argc, char** argv);
-    enter_usermode(entry_point, current_process->user_stack, argc, (char**)argv);
+    uintptr_t user_stack = current_process->user_stack;
+    smp_kernel_unlock();  // User mode never runs with the kernel lock held
+    enter_usermode(entry_point, user_stack, argc, (char**)argv);
     
     // Never reached
     return 0;
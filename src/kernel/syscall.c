@@ -27,6 +27,7 @@
 #include <acpi.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <smp.h>
 
 /*
  * Syscall subsystem notes:
@@ -315,7 +316,7 @@ static intptr_t syscall_getchar(uintptr_t a, uintptr_t b, uintptr_t c, uintptr_t
             }
         }
         // Wait for next interrupt instead of burning CPU in a tight loop.
-        __asm__ volatile ("hlt");
+        smp_wait_for_interrupt();
     }
 }
 
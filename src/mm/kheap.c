@@ -0,0 +1,353 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * src/mm/kheap.c
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+
+#include <kheap.h>
+#include <serial.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arch.h>
+
+/*
+ * Kernel heap (kheap)
+ *
+ * Serves kmalloc requests too large for the slab classes but smaller than a
+ * page, plus any allocation made before the VMM is online.
+ *
+ * Layout:
+ * - The region is a contiguous sequence of blocks, each with a 16-byte
+ *   boundary-tag header recording its own size and the previous block's size.
+ * - Free blocks are kept in segregated lists binned by power-of-two size;
+ *   a bitmap of non-empty bins lets allocation skip straight to a usable list.
+ * - Freed blocks coalesce with free physical neighbours immediately, so the
+ *   region never holds two adjacent free blocks.
+ */
+
+#define KHEAP_BLOCK_MAGIC   0x4B48424CU     // "KHBL"
+#define KHEAP_USED          0x1U
+#define KHEAP_MIN_BLOCK     32              // Header + free-list links, aligned
+#define KHEAP_MIN_SHIFT     5               // Bin 0 holds 32..63 byte blocks
+
+typedef struct kheap_block {
+    uint32_t magic;
+    uint32_t size;              // Block size incl. header; bit 0 = in use
+    uint32_t prev_size;         // Size of the physically previous block (0 = first)
+    uint32_t requested;         // Payload bytes asked for (stats only)
+} kheap_block_t;
+
+// Free-list links live in the payload of free blocks
+typedef struct kheap_links {
+    kheap_block_t *next;
+    kheap_block_t *prev;
+} kheap_links_t;
+
+static kheap_block_t *bins[KHEAP_BIN_COUNT];
+static uint32_t bin_bitmap = 0;
+static int kheap_ready = 0;
+
+static uint32_t free_bytes = 0;
+static uint32_t used_blocks = 0;
+static uint32_t free_blocks = 0;
+static uint32_t alloc_count = 0;
+static uint32_t free_count = 0;
+static uint32_t failed_allocs = 0;
+
+static inline uint32_t block_size(const kheap_block_t *block) {
+    return block->size & ~KHEAP_USED;
+}
+
+static inline int block_used(const kheap_block_t *block) {
+    return (block->size & KHEAP_USED) != 0;
+}
+
+static inline kheap_links_t *block_links(kheap_block_t *block) {
+    return (kheap_links_t *)(block + 1);
+}
+
+static inline kheap_block_t *block_next(kheap_block_t *block) {
+    uintptr_t next = (uintptr_t)block + block_size(block);
+    return (next < KHEAP_END) ? (kheap_block_t *)next : NULL;
+}
+
+static inline kheap_block_t *block_prev(kheap_block_t *block) {
+    return block->prev_size ? (kheap_block_t *)((uintptr_t)block - block->prev_size) : NULL;
+}
+
+static inline uint32_t bin_for_size(uint32_t size) {
+    uint32_t bin = 31U - (uint32_t)__builtin_clz(size);
+    bin = (bin > KHEAP_MIN_SHIFT) ? bin - KHEAP_MIN_SHIFT : 0;
+    return (bin < KHEAP_BIN_COUNT) ? bin : KHEAP_BIN_COUNT - 1;
+}
+
+static void bin_insert(kheap_block_t *block) {
+    uint32_t bin = bin_for_size(block_size(block));
+    kheap_links_t *links = block_links(block);
+
+    links->prev = NULL;
+    links->next = bins[bin];
+    if (bins[bin]) {
+        block_links(bins[bin])->prev = block;
+    }
+    bins[bin] = block;
+    bin_bitmap |= 1U << bin;
+
+    free_bytes += block_size(block);
+    free_blocks++;
+}
+
+static void bin_remove(kheap_block_t *block) {
+    uint32_t bin = bin_for_size(block_size(block));
+    kheap_links_t *links = block_links(block);
+
+    if (links->prev) {
+        block_links(links->prev)->next = links->next;
+    } else {
+        bins[bin] = links->next;
+    }
+    if (links->next) {
+        block_links(links->next)->prev = links->prev;
+    }
+    if (!bins[bin]) {
+        bin_bitmap &= ~(1U << bin);
+    }
+
+    free_bytes -= block_size(block);
+    free_blocks--;
+}
+
+static void kheap_init(void) {
+    /* Whole region starts as one free block. */
+    memset(bins, 0, sizeof(bins));
+    bin_bitmap = 0;
+
+    kheap_block_t *block = (kheap_block_t *)KHEAP_START;
+    block->magic = KHEAP_BLOCK_MAGIC;
+    block->size = (uint32_t)(KHEAP_END - KHEAP_START);
+    block->prev_size = 0;
+    block->requested = 0;
+    bin_insert(block);
+
+    kheap_ready = 1;
+    serial_puts("KHEAP: Initialized segregated free-list heap (2MB)\n");
+}
+
+// Search bins from the request's size class upward for a block that fits
+static kheap_block_t *find_fit(uint32_t need) {
+    uint32_t bin = bin_for_size(need);
+
+    // The request's own bin may hold smaller blocks, so first-fit it
+    for (kheap_block_t *block = bins[bin]; block; block = block_links(block)->next) {
+        if (block_size(block) >= need) {
+            return block;
+        }
+    }
+
+    // Any block in a higher bin is large enough
+    uint32_t higher = (bin + 1 < 32) ? (bin_bitmap & (0xFFFFFFFFU << (bin + 1))) : 0;
+    if (!higher) {
+        return NULL;
+    }
+    return bins[__builtin_ctz(higher)];
+}
+
+void *kheap_alloc(size_t size) {
+    if (size == 0 || size > (KHEAP_END - KHEAP_START) - sizeof(kheap_block_t)) {
+        return NULL;
+    }
+
+    uint32_t need = (uint32_t)((size + sizeof(kheap_block_t) + KHEAP_ALIGN - 1) & ~(size_t)(KHEAP_ALIGN - 1));
+    if (need < KHEAP_MIN_BLOCK) {
+        need = KHEAP_MIN_BLOCK;
+    }
+
+    uintptr_t irq = arch_irq_save();
+    if (!kheap_ready) {
+        kheap_init();
+    }
+
+    kheap_block_t *block = find_fit(need);
+    if (!block) {
+        failed_allocs++;
+        arch_irq_restore(irq);
+        return NULL;
+    }
+    bin_remove(block);
+
+    // Split off the tail when the remainder can stand as its own block
+    uint32_t total = block_size(block);
+    if (total - need >= KHEAP_MIN_BLOCK) {
+        kheap_block_t *rest = (kheap_block_t *)((uintptr_t)block + need);
+        rest->magic = KHEAP_BLOCK_MAGIC;
+        rest->size = total - need;
+        rest->prev_size = need;
+        rest->requested = 0;
+
+        kheap_block_t *after = block_next(rest);
+        if (after) {
+            after->prev_size = rest->size;
+        }
+        bin_insert(rest);
+        total = need;
+    }
+
+    block->size = total | KHEAP_USED;
+    block->requested = (uint32_t)size;
+    used_blocks++;
+    alloc_count++;
+    arch_irq_restore(irq);
+
+    return (void *)(block + 1);
+}
+
+int kheap_owns(const void *ptr) {
+    uintptr_t addr = (uintptr_t)ptr;
+    return addr >= KHEAP_START + sizeof(kheap_block_t) && addr < KHEAP_END;
+}
+
+int kheap_is_live_block(const void *ptr) {
+    if (!kheap_ready || !kheap_owns(ptr) || ((uintptr_t)ptr & (KHEAP_ALIGN - 1)) != 0) {
+        return 0;
+    }
+
+    const kheap_block_t *block = ((const kheap_block_t *)ptr) - 1;
+    if (block->magic != KHEAP_BLOCK_MAGIC) {
+        return 0;
+    }
+    return block_used(block) ? 1 : -1;
+}
+
+size_t kheap_free(void *ptr) {
+    if (kheap_is_live_block(ptr) != 1) {
+        return 0;
+    }
+
+    uintptr_t irq = arch_irq_save();
+    kheap_block_t *block = ((kheap_block_t *)ptr) - 1;
+    size_t requested = block->requested;
+
+    block->size &= ~KHEAP_USED;
+    block->requested = 0;
+    used_blocks--;
+    free_count++;
+
+    // Merge with the following block
+    kheap_block_t *next = block_next(block);
+    if (next && !block_used(next)) {
+        bin_remove(next);
+        next->magic = 0;
+        block->size += block_size(next);
+    }
+
+    // Merge into the preceding block
+    kheap_block_t *prev = block_prev(block);
+    if (prev && !block_used(prev)) {
+        bin_remove(prev);
+        prev->size += block_size(block);
+        block->magic = 0;
+        block = prev;
+    }
+
+    next = block_next(block);
+    if (next) {
+        next->prev_size = block_size(block);
+    }
+    bin_insert(block);
+    arch_irq_restore(irq);
+
+    return requested;
+}
+
+int kheap_validate(void) {
+    /* Walk every block physically and cross-check against the free lists. */
+    if (!kheap_ready) {
+        return 0;
+    }
+
+    int errors = 0;
+    uint32_t walked_free = 0;
+    uint32_t walked_free_blocks = 0;
+    uint32_t walked_used_blocks = 0;
+    uint32_t prev_size = 0;
+    int prev_free = 0;
+
+    uintptr_t irq = arch_irq_save();
+    uintptr_t addr = KHEAP_START;
+    while (addr < KHEAP_END) {
+        kheap_block_t *block = (kheap_block_t *)addr;
+        uint32_t size = block_size(block);
+
+        if (block->magic != KHEAP_BLOCK_MAGIC || size < KHEAP_MIN_BLOCK ||
+            (size & (KHEAP_ALIGN - 1)) != 0 || addr + size > KHEAP_END) {
+            serial_puts("KHEAP: corrupt block header at 0x");
+            char buf[16];
+            itoa((uint32_t)addr, buf, 16);
+            serial_puts(buf);
+            serial_puts("\n");
+            errors++;
+            break;
+        }
+        if (block->prev_size != prev_size) {
+            serial_puts("KHEAP: boundary tag mismatch\n");
+            errors++;
+        }
+
+        if (block_used(block)) {
+            walked_used_blocks++;
+            prev_free = 0;
+        } else {
+            if (prev_free) {
+                serial_puts("KHEAP: adjacent free blocks were not coalesced\n");
+                errors++;
+            }
+            walked_free += size;
+            walked_free_blocks++;
+            prev_free = 1;
+        }
+
+        prev_size = size;
+        addr += size;
+    }
+
+    if (walked_free != free_bytes || walked_free_blocks != free_blocks ||
+        walked_used_blocks != used_blocks) {
+        serial_puts("KHEAP: free-list accounting does not match heap walk\n");
+        errors++;
+    }
+    arch_irq_restore(irq);
+
+    return errors;
+}
+
+void kheap_get_stats(kheap_stats_t *stats) {
+    if (!stats) {
+        return;
+    }
+
+    uintptr_t irq = arch_irq_save();
+    stats->total_bytes = (uint32_t)(KHEAP_END - KHEAP_START);
+    stats->free_bytes = kheap_ready ? free_bytes : stats->total_bytes;
+    stats->used_bytes = stats->total_bytes - stats->free_bytes;
+    stats->used_blocks = used_blocks;
+    stats->free_blocks = kheap_ready ? free_blocks : 1;
+    stats->alloc_count = alloc_count;
+    stats->free_count = free_count;
+    stats->failed_allocs = failed_allocs;
+
+    // Largest block sits in the highest non-empty bin
+    stats->largest_free = kheap_ready ? 0 : stats->total_bytes;
+    if (bin_bitmap) {
+        uint32_t top = 31U - (uint32_t)__builtin_clz(bin_bitmap);
+        for (kheap_block_t *block = bins[top]; block; block = block_links(block)->next) {
+            if (block_size(block) > stats->largest_free) {
+                stats->largest_free = block_size(block);
+            }
+        }
+    }
+    arch_irq_restore(irq);
+}
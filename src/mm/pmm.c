@@ -22,8 +22,15 @@
  *
  * Allocation strategy:
  * - Global frame bitmap is source-of-truth for ownership.
+ * - Free frames are additionally indexed by a binary buddy allocator
+ *   (orders 0..BUDDY_MAX_ORDER). Each order keeps a three-level bitmap of free
+ *   block heads, so finding a block is a handful of word scans regardless of
+ *   memory size.
  * - Zoned allocation preference: NORMAL -> DMA -> HIGH.
- * - Small LIFO frame stack accelerates frequent single-page alloc/free cycles.
+ *
+ * Invariant:
+ * - A frame is covered by exactly one free buddy block iff its bitmap bit is
+ *   clear. pmm_validate_integrity() cross-checks both structures.
  *
  * Safety:
  * - Bounds checks guard frame index operations.
@@ -44,10 +51,44 @@ static uint32_t used_frames = 0;
 // Memory zones
 static pmm_zone_stats_t zones[PMM_ZONE_COUNT];
 
-// Stack-based allocator for fast single page allocation
-#define FRAME_STACK_SIZE 256
-static uint32_t frame_stack[FRAME_STACK_SIZE];
-static int frame_stack_top = -1;
+/*
+ * Buddy allocator state.
+ * Zone boundaries (16MB, 896MB) are aligned to the largest block size, so a
+ * block never straddles two zones.
+ */
+#define BUDDY_MAX_ORDER     10
+#define BUDDY_ORDER_COUNT   (BUDDY_MAX_ORDER + 1)
+#define BUDDY_L0_WORDS      ((MAX_FRAMES / 32) * 2 + BUDDY_ORDER_COUNT)
+#define BUDDY_L1_WORDS      (BUDDY_L0_WORDS / 32 + BUDDY_ORDER_COUNT)
+#define BUDDY_L2_WORDS      (BUDDY_L1_WORDS / 32 + BUDDY_ORDER_COUNT)
+
+typedef struct {
+    uint32_t *l0;        // one bit per free block head of this order
+    uint32_t *l1;        // one bit per non-empty l0 word
+    uint32_t *l2;        // one bit per non-empty l1 word
+    uint32_t blocks;     // number of whole blocks of this order in memory
+    uint32_t l0_words;
+    uint32_t l1_words;
+    uint32_t l2_words;
+} buddy_order_t;
+
+static uint32_t buddy_l0_pool[BUDDY_L0_WORDS];
+static uint32_t buddy_l1_pool[BUDDY_L1_WORDS];
+static uint32_t buddy_l2_pool[BUDDY_L2_WORDS];
+static buddy_order_t buddy_orders[BUDDY_ORDER_COUNT];
+static uint32_t buddy_free_blocks[PMM_ZONE_COUNT][BUDDY_ORDER_COUNT];
+
+/*
+ * Frame share counts for copy-on-write.
+ * Only frames mapped by more than one owner carry a count (the number of
+ * owners beyond the first). Leaves of this sparse table come from the DMA
+ * zone on first use, so address spaces that never fork pay nothing.
+ */
+#define FRAME_REFS_PER_LEAF (PAGE_SIZE / sizeof(uint16_t))
+#define FRAME_REF_LEAVES    (MAX_FRAMES / FRAME_REFS_PER_LEAF)
+#define FRAME_REF_MAX       0xFFFF
+static uint16_t *frame_ref_leaves[FRAME_REF_LEAVES];
+static uint32_t shared_frames = 0;   // Frames with at least two owners
 
 // Memory region list
 static pmm_region_t *region_list = NULL;
@@ -159,58 +200,302 @@ static inline uint8_t test_frame(uint32_t frame_index) {
     return (frame_bitmap[index] & (1 << offset)) != 0;
 }
 
-// Find free frame in specific zone
-static int find_free_frame_in_zone(pmm_zone_t zone) {
-    /* Scan bitmap for first free frame in zone respecting reserved constraints. */
-    uint32_t start_frame = zones[zone].start_frame;
-    uint32_t end_frame = zones[zone].end_frame;
-    
-    // Ensure we don't allocate reserved frames
-    if (zone == PMM_ZONE_DMA && start_frame < KERNEL_RESERVED) {
-        start_frame = KERNEL_RESERVED;
+// Zone lookup for a frame (PMM_ZONE_COUNT when outside every zone)
+static pmm_zone_t zone_of_frame(uint32_t frame) {
+    for (int z = 0; z < PMM_ZONE_COUNT; z++) {
+        if (zones[z].total_frames > 0 &&
+            frame >= zones[z].start_frame && frame < zones[z].end_frame) {
+            return (pmm_zone_t)z;
+        }
     }
-    
-    uint32_t start_bitmap = start_frame / 32;
-    uint32_t end_bitmap = (end_frame + 31) / 32;
-    
-    for (uint32_t i = start_bitmap; i < end_bitmap; i++) {
-        if (frame_bitmap[i] != 0xFFFFFFFF) {
-            for (int j = 0; j < 32; j++) {
-                uint32_t frame = i * 32 + j;
-                if (frame >= start_frame && frame < end_frame && 
-                    frame >= KERNEL_RESERVED && frame < total_frames && 
-                    !(frame_bitmap[i] & (1 << j))) {
-                    return frame;
+    return PMM_ZONE_COUNT;
+}
+
+static inline uint32_t bit_mask_from(uint32_t bit) {
+    return 0xFFFFFFFFU << (bit & 31);
+}
+
+// Lay out per-order bitmaps for the detected frame count and mark all empty
+static void buddy_reset(void) {
+    uint32_t l0_off = 0;
+    uint32_t l1_off = 0;
+    uint32_t l2_off = 0;
+
+    for (uint32_t order = 0; order < BUDDY_ORDER_COUNT; order++) {
+        buddy_order_t *o = &buddy_orders[order];
+        o->blocks = total_frames >> order;
+        o->l0_words = (o->blocks + 31) / 32;
+        if (o->l0_words == 0) {
+            o->l0_words = 1;
+        }
+        o->l1_words = (o->l0_words + 31) / 32;
+        o->l2_words = (o->l1_words + 31) / 32;
+
+        o->l0 = &buddy_l0_pool[l0_off];
+        o->l1 = &buddy_l1_pool[l1_off];
+        o->l2 = &buddy_l2_pool[l2_off];
+        memset(o->l0, 0, o->l0_words * sizeof(uint32_t));
+        memset(o->l1, 0, o->l1_words * sizeof(uint32_t));
+        memset(o->l2, 0, o->l2_words * sizeof(uint32_t));
+
+        l0_off += o->l0_words;
+        l1_off += o->l1_words;
+        l2_off += o->l2_words;
+    }
+
+    memset(buddy_free_blocks, 0, sizeof(buddy_free_blocks));
+}
+
+static inline int buddy_test(uint32_t order, uint32_t block) {
+    const buddy_order_t *o = &buddy_orders[order];
+    if (block >= o->blocks) {
+        return 0;
+    }
+    return (o->l0[block >> 5] & (1U << (block & 31))) != 0;
+}
+
+static void buddy_mark(uint32_t order, uint32_t block) {
+    buddy_order_t *o = &buddy_orders[order];
+    uint32_t w0 = block >> 5;
+    uint32_t w1 = w0 >> 5;
+
+    if (o->l0[w0] == 0) {
+        if (o->l1[w1] == 0) {
+            o->l2[w1 >> 5] |= 1U << (w1 & 31);
+        }
+        o->l1[w1] |= 1U << (w0 & 31);
+    }
+    o->l0[w0] |= 1U << (block & 31);
+}
+
+static void buddy_unmark(uint32_t order, uint32_t block) {
+    buddy_order_t *o = &buddy_orders[order];
+    uint32_t w0 = block >> 5;
+    uint32_t w1 = w0 >> 5;
+
+    o->l0[w0] &= ~(1U << (block & 31));
+    if (o->l0[w0] == 0) {
+        o->l1[w1] &= ~(1U << (w0 & 31));
+        if (o->l1[w1] == 0) {
+            o->l2[w1 >> 5] &= ~(1U << (w1 & 31));
+        }
+    }
+}
+
+// First free block index in [first, last) for an order, or -1
+static int32_t buddy_find(uint32_t order, uint32_t first, uint32_t last) {
+    const buddy_order_t *o = &buddy_orders[order];
+    if (last > o->blocks) {
+        last = o->blocks;
+    }
+    if (first >= last) {
+        return -1;
+    }
+
+    uint32_t w0 = first >> 5;
+    uint32_t bits = o->l0[w0] & bit_mask_from(first);
+    if (!bits) {
+        // Next non-empty l0 word via l1, then via l2 if this l1 word is exhausted
+        uint32_t next0 = w0 + 1;
+        if (next0 >= o->l0_words) {
+            return -1;
+        }
+        uint32_t w1 = next0 >> 5;
+        uint32_t bits1 = o->l1[w1] & bit_mask_from(next0);
+        if (!bits1) {
+            uint32_t next1 = w1 + 1;
+            if (next1 >= o->l1_words) {
+                return -1;
+            }
+            uint32_t w2 = next1 >> 5;
+            uint32_t bits2 = o->l2[w2] & bit_mask_from(next1);
+            while (!bits2) {
+                if (++w2 >= o->l2_words) {
+                    return -1;
                 }
+                bits2 = o->l2[w2];
+            }
+            w1 = w2 * 32 + (uint32_t)__builtin_ctz(bits2);
+            bits1 = o->l1[w1];
+        }
+        w0 = w1 * 32 + (uint32_t)__builtin_ctz(bits1);
+        bits = o->l0[w0];
+    }
+
+    uint32_t block = w0 * 32 + (uint32_t)__builtin_ctz(bits);
+    return (block < last) ? (int32_t)block : -1;
+}
+
+static void buddy_insert(uint32_t frame, uint32_t order, pmm_zone_t zone) {
+    buddy_mark(order, frame >> order);
+    buddy_free_blocks[zone][order]++;
+}
+
+static void buddy_remove(uint32_t frame, uint32_t order, pmm_zone_t zone) {
+    buddy_unmark(order, frame >> order);
+    buddy_free_blocks[zone][order]--;
+}
+
+// Return a free block to the allocator, merging with free buddies
+static void buddy_release(uint32_t frame, uint32_t order) {
+    pmm_zone_t zone = zone_of_frame(frame);
+    if (zone == PMM_ZONE_COUNT) {
+        return;
+    }
+
+    while (order < BUDDY_MAX_ORDER) {
+        uint32_t buddy = frame ^ (1U << order);
+        if (buddy >= total_frames || zone_of_frame(buddy) != zone ||
+            !buddy_test(order, buddy >> order)) {
+            break;
+        }
+        buddy_remove(buddy, order, zone);
+        frame &= ~(1U << order);
+        order++;
+    }
+    buddy_insert(frame, order, zone);
+}
+
+// Release [start, end) as the largest naturally aligned blocks that fit
+static void buddy_release_range(uint32_t start, uint32_t end, int coalesce) {
+    while (start < end) {
+        uint32_t order = 0;
+        while (order < BUDDY_MAX_ORDER &&
+               (start & ((2U << order) - 1)) == 0 &&
+               start + (2U << order) <= end) {
+            order++;
+        }
+
+        if (coalesce) {
+            buddy_release(start, order);
+        } else {
+            pmm_zone_t zone = zone_of_frame(start);
+            if (zone != PMM_ZONE_COUNT) {
+                buddy_insert(start, order, zone);
             }
         }
+        start += 1U << order;
+    }
+}
+
+// Take a block of the requested order out of a zone, splitting larger blocks
+static int32_t buddy_alloc_block(pmm_zone_t zone, uint32_t order) {
+    if (zone >= PMM_ZONE_COUNT || zones[zone].total_frames == 0) {
+        return -1;
+    }
+
+    uint32_t zone_start = zones[zone].start_frame;
+    uint32_t zone_end = zones[zone].end_frame;
+    if (zone_start < KERNEL_RESERVED) {
+        zone_start = KERNEL_RESERVED;
+    }
+
+    for (uint32_t k = order; k < BUDDY_ORDER_COUNT; k++) {
+        if (buddy_free_blocks[zone][k] == 0) {
+            continue;
+        }
+
+        uint32_t first = (zone_start + (1U << k) - 1) >> k;
+        int32_t block = buddy_find(k, first, zone_end >> k);
+        if (block < 0) {
+            continue;
+        }
+
+        uint32_t frame = (uint32_t)block << k;
+        buddy_remove(frame, k, zone);
+        while (k > order) {
+            k--;
+            buddy_insert(frame + (1U << k), k, zone);
+        }
+        return (int32_t)frame;
     }
     return -1;
 }
 
-// Fast allocation from stack
-static void* alloc_from_stack(void) {
-    /* Fast path for page allocation from freelist stack. */
-    if (frame_stack_top >= 0) {
-        uint32_t frame = frame_stack[frame_stack_top--];
-        if (frame < KERNEL_RESERVED || frame >= total_frames) {
-            serial_puts("WARNING: Invalid frame from stack\n");
-            return alloc_page(); // Fallback to regular allocation
+// Pull a single free frame out of whatever block currently covers it
+static void buddy_claim_frame(uint32_t frame) {
+    pmm_zone_t zone = zone_of_frame(frame);
+    if (zone == PMM_ZONE_COUNT) {
+        return;
+    }
+
+    for (uint32_t k = 0; k < BUDDY_ORDER_COUNT; k++) {
+        uint32_t head = frame & ~((1U << k) - 1);
+        if (!buddy_test(k, head >> k)) {
+            continue;
         }
-        set_frame(frame);
-        alloc_count++;
-        return (void*)(uintptr_t)(frame * PAGE_SIZE);
+
+        buddy_remove(head, k, zone);
+        while (k > 0) {
+            k--;
+            uint32_t half = 1U << k;
+            if (frame >= head + half) {
+                buddy_insert(head, k, zone);
+                head += half;
+            } else {
+                buddy_insert(head + half, k, zone);
+            }
+        }
+        return;
+    }
+}
+
+// Rebuild buddy free lists from the ownership bitmap
+static void buddy_rebuild(void) {
+    buddy_reset();
+
+    uint32_t frame = 0;
+    while (frame < total_frames) {
+        if (frame_bitmap[frame / 32] == 0xFFFFFFFFU && (frame % 32) == 0) {
+            frame += 32;
+            continue;
+        }
+        if (test_frame(frame)) {
+            frame++;
+            continue;
+        }
+
+        // Free runs are split at zone boundaries so blocks stay zone-local
+        pmm_zone_t zone = zone_of_frame(frame);
+        uint32_t run_limit = (zone == PMM_ZONE_COUNT) ? total_frames : zones[zone].end_frame;
+        uint32_t run_end = frame;
+        while (run_end < run_limit && !test_frame(run_end)) {
+            run_end++;
+        }
+
+        buddy_release_range(frame, run_end, 0);
+        frame = run_end;
     }
-    return NULL;
 }
 
-// Add frame to stack for fast reallocation
-static void add_to_stack(uint32_t frame) {
-    /* Cache recently freed frame for fast reallocation if stack has room. */
-    if (frame_stack_top < FRAME_STACK_SIZE - 1) {
-        frame_stack[++frame_stack_top] = frame;
+static uint32_t order_for_pages(size_t num_pages) {
+    uint32_t order = 0;
+    while ((1UL << order) < num_pages) {
+        order++;
     }
-    // If stack is full, frame goes back to bitmap (slower allocation path)
+    return order;
+}
+
+// Hand out a block from the zone list in preference order and mark it owned
+static int32_t alloc_frames_in_zones(const pmm_zone_t *order_list, int count, size_t num_pages) {
+    uint32_t order = order_for_pages(num_pages);
+
+    for (int i = 0; i < count; i++) {
+        int32_t frame = buddy_alloc_block(order_list[i], order);
+        if (frame < 0) {
+            continue;
+        }
+
+        uint32_t start = (uint32_t)frame;
+        for (size_t n = 0; n < num_pages; n++) {
+            set_frame(start + (uint32_t)n);
+        }
+        // Trim the unused tail of a rounded-up block back into the allocator
+        buddy_release_range(start + (uint32_t)num_pages, start + (1U << order), 1);
+        alloc_count += (uint32_t)num_pages;
+        return frame;
+    }
+    return -1;
 }
 
 // Initialize zone boundaries
@@ -295,7 +580,6 @@ void init_pmm(uint32_t mem_size) {
     alloc_count = 0;
     free_count = 0;
     failed_alloc_count = 0;
-    frame_stack_top = -1;
     region_list = NULL;
     region_pool_index = 0;
     
@@ -305,7 +589,9 @@ void init_pmm(uint32_t mem_size) {
         set_frame(i);
     }
 
-    serial_puts("PMM initialized successfully with zone-based allocation.\n");
+    buddy_rebuild();
+
+    serial_puts("PMM initialized successfully with zone-based buddy allocation.\n");
 }
 
 void init_pmm_advanced(uint32_t mem_size, void *mmap_addr, uint32_t mmap_length) {
@@ -371,6 +657,9 @@ void init_pmm_advanced(uint32_t mem_size, void *mmap_addr, uint32_t mmap_length)
     // Keep early kernel memory permanently reserved regardless of map data.
     mark_frame_range(0, min_u32(KERNEL_RESERVED, total_frames), 1);
 
+    // Bitmap changed wholesale; re-derive buddy blocks from it.
+    buddy_rebuild();
+
     char buf[16];
     serial_puts("PMM: Parsed memory-map entries: ");
     itoa(parsed_entries, buf, 10);
@@ -383,24 +672,8 @@ void init_pmm_advanced(uint32_t mem_size, void *mmap_addr, uint32_t mmap_length)
 }
 
 void* alloc_page() {
-    // Try fast path first (stack allocator)
-    void *page = alloc_from_stack();
-    if (page) {
-        return page;
-    }
-    
-    // Try Normal zone first (most common allocation)
-    int frame = find_free_frame_in_zone(PMM_ZONE_NORMAL);
-    
-    // Fallback to DMA zone if Normal zone is exhausted
-    if (frame == -1 && zones[PMM_ZONE_DMA].total_frames > 0) {
-        frame = find_free_frame_in_zone(PMM_ZONE_DMA);
-    }
-    
-    // Last resort: try High zone
-    if (frame == -1 && zones[PMM_ZONE_HIGH].total_frames > 0) {
-        frame = find_free_frame_in_zone(PMM_ZONE_HIGH);
-    }
+    static const pmm_zone_t preference[] = {PMM_ZONE_NORMAL, PMM_ZONE_DMA, PMM_ZONE_HIGH};
+    int32_t frame = alloc_frames_in_zones(preference, PMM_ZONE_COUNT, 1);
     
     if (frame == -1) {
         failed_alloc_count++;
@@ -418,9 +691,7 @@ void* alloc_page() {
         panic("Out of physical memory!");
     }
     
-    set_frame(frame);
-    alloc_count++;
-    return (void*)(uintptr_t)(frame * PAGE_SIZE);
+    return (void*)(uintptr_t)((uint32_t)frame * PAGE_SIZE);
 }
 
 void* alloc_page_from_zone(pmm_zone_t zone) {
@@ -429,45 +700,26 @@ void* alloc_page_from_zone(pmm_zone_t zone) {
         return NULL;
     }
     
-    int frame = find_free_frame_in_zone(zone);
+    int32_t frame = alloc_frames_in_zones(&zone, 1, 1);
     if (frame == -1) {
         failed_alloc_count++;
         return NULL;
     }
     
-    set_frame(frame);
-    alloc_count++;
-    zones[zone].used_frames++;
-    return (void*)(uintptr_t)(frame * PAGE_SIZE);
+    return (void*)(uintptr_t)((uint32_t)frame * PAGE_SIZE);
 }
 
 void* alloc_pages_contiguous(size_t num_pages) {
-    if (num_pages == 0 || num_pages > 1024) {
+    if (num_pages == 0 || num_pages > (1U << BUDDY_MAX_ORDER)) {
         serial_puts("ERROR: Invalid contiguous allocation size\n");
         return NULL;
     }
     
-    // Search for contiguous free frames
-    for (uint32_t start = KERNEL_RESERVED; start <= total_frames - num_pages; start++) {
-        int found = 1;
-        
-        // Check if all frames in range are free
-        for (size_t i = 0; i < num_pages; i++) {
-            if (test_frame(start + i)) {
-                found = 0;
-                start += i; // Skip ahead
-                break;
-            }
-        }
-        
-        if (found) {
-            // Allocate all frames
-            for (size_t i = 0; i < num_pages; i++) {
-                set_frame(start + i);
-            }
-            alloc_count += num_pages;
-            return (void*)(uintptr_t)(start * PAGE_SIZE);
-        }
+    // Low memory first, matching the historical bottom-up search
+    static const pmm_zone_t preference[] = {PMM_ZONE_DMA, PMM_ZONE_NORMAL, PMM_ZONE_HIGH};
+    int32_t frame = alloc_frames_in_zones(preference, PMM_ZONE_COUNT, num_pages);
+    if (frame != -1) {
+        return (void*)(uintptr_t)((uint32_t)frame * PAGE_SIZE);
     }
     
     failed_alloc_count++;
@@ -513,11 +765,59 @@ void free_page(void* page) {
         return;
     }
     
+    // A shared frame just loses one owner
+    uint16_t *leaf = frame_ref_leaves[frame / FRAME_REFS_PER_LEAF];
+    if (leaf && leaf[frame % FRAME_REFS_PER_LEAF] > 0) {
+        if (--leaf[frame % FRAME_REFS_PER_LEAF] == 0) {
+            shared_frames--;
+        }
+        return;
+    }
+    
     clear_frame(frame);
-    add_to_stack(frame);
+    buddy_release(frame, 0);
     free_count++;
 }
 
+int pmm_page_ref(void* page) {
+    /* Add an owner to an allocated frame; free_page() drops one. */
+    uint32_t frame = (uint32_t)((uintptr_t)page / PAGE_SIZE);
+    if (frame >= total_frames || frame < KERNEL_RESERVED || !test_frame(frame)) {
+        serial_puts("ERROR: pmm_page_ref - frame not allocated\n");
+        return -1;
+    }
+    
+    uint32_t leaf_index = frame / FRAME_REFS_PER_LEAF;
+    uint16_t *leaf = frame_ref_leaves[leaf_index];
+    if (!leaf) {
+        leaf = (uint16_t *)alloc_page_from_zone(PMM_ZONE_DMA);
+        if (!leaf) {
+            return -1;
+        }
+        memset(leaf, 0, PAGE_SIZE);
+        frame_ref_leaves[leaf_index] = leaf;
+    }
+    
+    uint16_t *count = &leaf[frame % FRAME_REFS_PER_LEAF];
+    if (*count == FRAME_REF_MAX) {
+        return -1;
+    }
+    if ((*count)++ == 0) {
+        shared_frames++;
+    }
+    return 0;
+}
+
+uint32_t pmm_page_refcount(void* page) {
+    uint32_t frame = (uint32_t)((uintptr_t)page / PAGE_SIZE);
+    if (frame >= total_frames || !test_frame(frame)) {
+        return 0;
+    }
+    
+    uint16_t *leaf = frame_ref_leaves[frame / FRAME_REFS_PER_LEAF];
+    return 1 + (leaf ? leaf[frame % FRAME_REFS_PER_LEAF] : 0);
+}
+
 int pmm_is_valid_frame(uint32_t frame_addr) {
     uint32_t frame = frame_addr / PAGE_SIZE;
     return (frame >= KERNEL_RESERVED && frame < total_frames);
@@ -552,6 +852,9 @@ void pmm_reserve_region(uint32_t start, uint32_t end) {
     uint32_t end_frame = (end + PAGE_SIZE - 1) / PAGE_SIZE;
     
     for (uint32_t frame = start_frame; frame < end_frame && frame < total_frames; frame++) {
+        if (!test_frame(frame)) {
+            buddy_claim_frame(frame);
+        }
         set_frame(frame);
     }
     
@@ -584,17 +887,16 @@ void pmm_get_zone_stats(pmm_zone_t zone, pmm_zone_stats_t *stats) {
     }
     
     stats->total_frames = zones[zone].total_frames;
-    stats->used_frames = 0;
     stats->reserved_frames = zones[zone].reserved_frames;
     stats->start_frame = zones[zone].start_frame;
     stats->end_frame = zones[zone].end_frame;
     
-    // Count actually used frames in this zone
-    for (uint32_t frame = zones[zone].start_frame; frame < zones[zone].end_frame; frame++) {
-        if (test_frame(frame)) {
-            stats->used_frames++;
-        }
+    // Every free frame in the zone is covered by exactly one buddy block
+    uint32_t free = 0;
+    for (uint32_t order = 0; order < BUDDY_ORDER_COUNT; order++) {
+        free += buddy_free_blocks[zone][order] << order;
     }
+    stats->used_frames = zones[zone].total_frames - free;
 }
 
 void pmm_print_memory_map(void) {
@@ -666,6 +968,9 @@ void pmm_print_detailed_stats(void) {
     serial_puts("\n  Failed Allocations: ");
     itoa(failed_alloc_count, buf, 10);
     serial_puts(buf);
+    serial_puts("\n  Shared (COW) Frames: ");
+    itoa(shared_frames, buf, 10);
+    serial_puts(buf);
     serial_puts("\n");
     
     serial_puts("\nMemory Zones:\n");
@@ -681,6 +986,12 @@ void pmm_print_detailed_stats(void) {
         serial_puts(" frames, Reserved: ");
         itoa(zones[i].reserved_frames, buf, 10);
         serial_puts(buf);
+        serial_puts("\n    Free blocks by order:");
+        for (uint32_t order = 0; order < BUDDY_ORDER_COUNT; order++) {
+            serial_puts(" ");
+            itoa(buddy_free_blocks[i][order], buf, 10);
+            serial_puts(buf);
+        }
         serial_puts("\n");
     }
     
@@ -725,6 +1036,59 @@ int pmm_validate_integrity(void) {
         }
     }
     
+    // Every buddy block must cover bitmap-free frames inside a single zone
+    uint32_t buddy_free = 0;
+    int buddy_errors = 0;
+    for (uint32_t order = 0; order < BUDDY_ORDER_COUNT; order++) {
+        const buddy_order_t *o = &buddy_orders[order];
+        uint32_t counted_blocks = 0;
+        for (uint32_t w = 0; w < o->l0_words; w++) {
+            uint32_t bits = o->l0[w];
+            while (bits) {
+                uint32_t bit = (uint32_t)__builtin_ctz(bits);
+                uint32_t head = (w * 32 + bit) << order;
+                pmm_zone_t zone = zone_of_frame(head);
+                for (uint32_t f = head; f < head + (1U << order); f++) {
+                    if (test_frame(f) || zone_of_frame(f) != zone) {
+                        buddy_errors++;
+                        break;
+                    }
+                }
+                bits &= bits - 1;
+                counted_blocks++;
+            }
+        }
+        
+        uint32_t tracked_blocks = 0;
+        for (int z = 0; z < PMM_ZONE_COUNT; z++) {
+            tracked_blocks += buddy_free_blocks[z][order];
+        }
+        if (counted_blocks != tracked_blocks) {
+            buddy_errors++;
+        }
+        buddy_free += counted_blocks << order;
+    }
+    
+    if (buddy_free != total_frames - counted_used) {
+        serial_puts("ERROR: buddy free frames disagree with bitmap! Buddy: ");
+        char buf[16];
+        itoa(buddy_free, buf, 10);
+        serial_puts(buf);
+        serial_puts(" Bitmap: ");
+        itoa(total_frames - counted_used, buf, 10);
+        serial_puts(buf);
+        serial_puts("\n");
+        errors++;
+    }
+    if (buddy_errors > 0) {
+        serial_puts("ERROR: buddy blocks inconsistent with bitmap: ");
+        char buf[16];
+        itoa(buddy_errors, buf, 10);
+        serial_puts(buf);
+        serial_puts("\n");
+        errors++;
+    }
+    
     if (errors == 0) {
         serial_puts("PMM: Integrity check passed!\n");
     } else {
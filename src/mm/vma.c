@@ -0,0 +1,516 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * src/mm/vma.c
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+
+#include <vmm.h>
+#include <serial.h>
+#include <stdlib.h>
+
+/*
+ * VMA tree
+ *
+ * Every address space keeps its VMAs in a red-black tree keyed by start
+ * address. Each node is augmented with subtree_gap, the largest hole
+ * between a VMA and its address-order predecessor anywhere in its subtree,
+ * so a free range of a given size is found in O(log n) without touching
+ * page tables. The VMAs are also threaded on a doubly linked list in
+ * address order; the list gives O(1) neighbours for gap bookkeeping and
+ * keeps simple walkers (stats, teardown) unchanged.
+ */
+
+// Hole between this VMA and the previous one (address 0 for the first VMA)
+static inline uintptr_t vma_gap_before(const vma_t *vma) {
+    return vma->start_addr - (vma->prev ? vma->prev->end_addr : 0);
+}
+
+static inline uintptr_t vma_subtree_gap(const vma_t *vma) {
+    return vma ? vma->subtree_gap : 0;
+}
+
+static inline int vma_is_red(const vma_t *vma) {
+    return vma && vma->rb_color == VMA_RB_RED;
+}
+
+static void vma_update_gap(vma_t *vma) {
+    uintptr_t gap = vma_gap_before(vma);
+    uintptr_t left = vma_subtree_gap(vma->rb_left);
+    uintptr_t right = vma_subtree_gap(vma->rb_right);
+    if (left > gap) gap = left;
+    if (right > gap) gap = right;
+    vma->subtree_gap = gap;
+}
+
+// Recompute subtree_gap from vma up to the root
+static void vma_propagate_gap(vma_t *vma) {
+    while (vma) {
+        vma_update_gap(vma);
+        vma = vma->rb_parent;
+    }
+}
+
+static void vma_replace_child(address_space_t *as, vma_t *parent, vma_t *old, vma_t *new_child) {
+    if (!parent) {
+        as->vma_root = new_child;
+    } else if (parent->rb_left == old) {
+        parent->rb_left = new_child;
+    } else {
+        parent->rb_right = new_child;
+    }
+}
+
+// Rotations keep the node set under the rotated position, so only the two
+// rotated nodes need their gap recomputed.
+static void vma_rotate_left(address_space_t *as, vma_t *x) {
+    vma_t *y = x->rb_right;
+    x->rb_right = y->rb_left;
+    if (y->rb_left) y->rb_left->rb_parent = x;
+    y->rb_parent = x->rb_parent;
+    vma_replace_child(as, x->rb_parent, x, y);
+    y->rb_left = x;
+    x->rb_parent = y;
+    vma_update_gap(x);
+    vma_update_gap(y);
+}
+
+static void vma_rotate_right(address_space_t *as, vma_t *x) {
+    vma_t *y = x->rb_left;
+    x->rb_left = y->rb_right;
+    if (y->rb_right) y->rb_right->rb_parent = x;
+    y->rb_parent = x->rb_parent;
+    vma_replace_child(as, x->rb_parent, x, y);
+    y->rb_right = x;
+    x->rb_parent = y;
+    vma_update_gap(x);
+    vma_update_gap(y);
+}
+
+static void vma_insert_fixup(address_space_t *as, vma_t *node) {
+    while (vma_is_red(node->rb_parent)) {
+        vma_t *parent = node->rb_parent;
+        vma_t *grand = parent->rb_parent;
+
+        if (parent == grand->rb_left) {
+            vma_t *uncle = grand->rb_right;
+            if (vma_is_red(uncle)) {
+                parent->rb_color = VMA_RB_BLACK;
+                uncle->rb_color = VMA_RB_BLACK;
+                grand->rb_color = VMA_RB_RED;
+                node = grand;
+                continue;
+            }
+            if (node == parent->rb_right) {
+                vma_rotate_left(as, parent);
+                node = parent;
+                parent = node->rb_parent;
+            }
+            parent->rb_color = VMA_RB_BLACK;
+            grand->rb_color = VMA_RB_RED;
+            vma_rotate_right(as, grand);
+        } else {
+            vma_t *uncle = grand->rb_left;
+            if (vma_is_red(uncle)) {
+                parent->rb_color = VMA_RB_BLACK;
+                uncle->rb_color = VMA_RB_BLACK;
+                grand->rb_color = VMA_RB_RED;
+                node = grand;
+                continue;
+            }
+            if (node == parent->rb_left) {
+                vma_rotate_right(as, parent);
+                node = parent;
+                parent = node->rb_parent;
+            }
+            parent->rb_color = VMA_RB_BLACK;
+            grand->rb_color = VMA_RB_RED;
+            vma_rotate_left(as, grand);
+        }
+    }
+    as->vma_root->rb_color = VMA_RB_BLACK;
+}
+
+// x may be NULL, so its parent is passed explicitly
+static void vma_erase_fixup(address_space_t *as, vma_t *x, vma_t *parent) {
+    while (x != as->vma_root && !vma_is_red(x)) {
+        if (x == parent->rb_left) {
+            vma_t *w = parent->rb_right;
+            if (vma_is_red(w)) {
+                w->rb_color = VMA_RB_BLACK;
+                parent->rb_color = VMA_RB_RED;
+                vma_rotate_left(as, parent);
+                w = parent->rb_right;
+            }
+            if (!vma_is_red(w->rb_left) && !vma_is_red(w->rb_right)) {
+                w->rb_color = VMA_RB_RED;
+                x = parent;
+                parent = x->rb_parent;
+                continue;
+            }
+            if (!vma_is_red(w->rb_right)) {
+                w->rb_left->rb_color = VMA_RB_BLACK;
+                w->rb_color = VMA_RB_RED;
+                vma_rotate_right(as, w);
+                w = parent->rb_right;
+            }
+            w->rb_color = parent->rb_color;
+            parent->rb_color = VMA_RB_BLACK;
+            w->rb_right->rb_color = VMA_RB_BLACK;
+            vma_rotate_left(as, parent);
+            x = as->vma_root;
+        } else {
+            vma_t *w = parent->rb_left;
+            if (vma_is_red(w)) {
+                w->rb_color = VMA_RB_BLACK;
+                parent->rb_color = VMA_RB_RED;
+                vma_rotate_right(as, parent);
+                w = parent->rb_left;
+            }
+            if (!vma_is_red(w->rb_left) && !vma_is_red(w->rb_right)) {
+                w->rb_color = VMA_RB_RED;
+                x = parent;
+                parent = x->rb_parent;
+                continue;
+            }
+            if (!vma_is_red(w->rb_left)) {
+                w->rb_right->rb_color = VMA_RB_BLACK;
+                w->rb_color = VMA_RB_RED;
+                vma_rotate_left(as, w);
+                w = parent->rb_left;
+            }
+            w->rb_color = parent->rb_color;
+            parent->rb_color = VMA_RB_BLACK;
+            w->rb_left->rb_color = VMA_RB_BLACK;
+            vma_rotate_right(as, parent);
+            x = as->vma_root;
+        }
+    }
+    if (x) x->rb_color = VMA_RB_BLACK;
+}
+
+void vma_insert(address_space_t *as, vma_t *vma) {
+    /* Caller guarantees vma does not overlap an existing VMA. */
+    if (!as || !vma) return;
+
+    vma_t *parent = 0;
+    vma_t *node = as->vma_root;
+    vma_t *prev = 0;
+    vma_t *next = 0;
+    while (node) {
+        parent = node;
+        if (vma->start_addr < node->start_addr) {
+            next = node;
+            node = node->rb_left;
+        } else {
+            prev = node;
+            node = node->rb_right;
+        }
+    }
+
+    // Thread onto the address-ordered list
+    vma->prev = prev;
+    vma->next = next;
+    if (prev) {
+        prev->next = vma;
+    } else {
+        as->vma_list = vma;
+    }
+    if (next) next->prev = vma;
+
+    // Link as a red leaf
+    vma->rb_parent = parent;
+    vma->rb_left = 0;
+    vma->rb_right = 0;
+    vma->rb_color = VMA_RB_RED;
+    if (!parent) {
+        as->vma_root = vma;
+    } else if (vma->start_addr < parent->start_addr) {
+        parent->rb_left = vma;
+    } else {
+        parent->rb_right = vma;
+    }
+
+    // The new node and its successor both have a new gap before them
+    vma_propagate_gap(vma);
+    if (next) vma_propagate_gap(next);
+
+    vma_insert_fixup(as, vma);
+    as->vma_count++;
+}
+
+void vma_remove(address_space_t *as, vma_t *vma) {
+    if (!as || !vma) return;
+
+    vma_t *next = vma->next;
+
+    // Unlink from the address-ordered list
+    if (vma->prev) {
+        vma->prev->next = next;
+    } else {
+        as->vma_list = next;
+    }
+    if (next) next->prev = vma->prev;
+
+    vma_t *x;
+    vma_t *x_parent;
+    uint32_t removed_color = vma->rb_color;
+
+    if (!vma->rb_left || !vma->rb_right) {
+        x = vma->rb_left ? vma->rb_left : vma->rb_right;
+        x_parent = vma->rb_parent;
+        if (x) x->rb_parent = x_parent;
+        vma_replace_child(as, vma->rb_parent, vma, x);
+    } else {
+        // Two children: splice in the in-order successor, which is next
+        vma_t *succ = next;
+        removed_color = succ->rb_color;
+        x = succ->rb_right;
+        if (succ->rb_parent == vma) {
+            x_parent = succ;
+        } else {
+            x_parent = succ->rb_parent;
+            x_parent->rb_left = x;
+            if (x) x->rb_parent = x_parent;
+            succ->rb_right = vma->rb_right;
+            succ->rb_right->rb_parent = succ;
+        }
+        succ->rb_left = vma->rb_left;
+        succ->rb_left->rb_parent = succ;
+        succ->rb_parent = vma->rb_parent;
+        succ->rb_color = vma->rb_color;
+        vma_replace_child(as, vma->rb_parent, vma, succ);
+    }
+
+    // Gaps changed below x_parent (structure) and at next (merged hole)
+    vma_propagate_gap(x_parent);
+    if (next) vma_propagate_gap(next);
+
+    if (removed_color == VMA_RB_BLACK) {
+        vma_erase_fixup(as, x, x_parent);
+    }
+
+    vma->next = 0;
+    vma->prev = 0;
+    vma->rb_parent = 0;
+    vma->rb_left = 0;
+    vma->rb_right = 0;
+    as->vma_count--;
+}
+
+void vma_resize(address_space_t *as, vma_t *vma, uintptr_t start_addr, uintptr_t end_addr) {
+    /*
+     * Shrink or grow a VMA in place. The new range must stay between its
+     * neighbours, so tree order is unchanged and only gaps need updating.
+     */
+    if (!as || !vma) return;
+
+    vma->start_addr = start_addr;
+    vma->end_addr = end_addr;
+    vma_propagate_gap(vma);
+    if (vma->next) vma_propagate_gap(vma->next);
+}
+
+vma_t *vma_find_intersection(address_space_t *as, uintptr_t start_addr, uintptr_t end_addr) {
+    /* Lowest VMA overlapping [start_addr, end_addr), or NULL. */
+    if (!as) return 0;
+
+    // VMAs are disjoint, so end_addr is ordered like start_addr
+    vma_t *candidate = 0;
+    vma_t *node = as->vma_root;
+    while (node) {
+        if (node->end_addr > start_addr) {
+            candidate = node;
+            node = node->rb_left;
+        } else {
+            node = node->rb_right;
+        }
+    }
+
+    if (candidate && candidate->start_addr < end_addr) {
+        return candidate;
+    }
+    return 0;
+}
+
+vma_t *vma_find(address_space_t *as, uintptr_t addr) {
+    if (!as) return 0;
+
+    vma_t *node = as->vma_root;
+    while (node) {
+        if (addr < node->start_addr) {
+            node = node->rb_left;
+        } else if (addr >= node->end_addr) {
+            node = node->rb_right;
+        } else {
+            return node;
+        }
+    }
+    return 0;
+}
+
+// Lowest address in the hole before vma that fits [low, high) and length
+static int vma_gap_fits(const vma_t *vma, uintptr_t low, uintptr_t high, size_t length,
+                        uintptr_t *out) {
+    uintptr_t lo = vma->prev ? vma->prev->end_addr : 0;
+    uintptr_t hi = vma->start_addr;
+    if (lo < low) lo = low;
+    if (hi > high) hi = high;
+    if (hi > lo && hi - lo >= length) {
+        *out = lo;
+        return 1;
+    }
+    return 0;
+}
+
+static int vma_gap_search(const vma_t *node, uintptr_t low, uintptr_t high, size_t length,
+                          uintptr_t *out) {
+    /* In-order walk pruned by subtree_gap and by the [low, high) window. */
+    if (!node || node->subtree_gap < length) {
+        return 0;
+    }
+
+    // Holes in the left subtree all end at or before node->start_addr
+    if (node->start_addr > low &&
+        vma_gap_search(node->rb_left, low, high, length, out)) {
+        return 1;
+    }
+
+    if (vma_gap_fits(node, low, high, length, out)) {
+        return 1;
+    }
+
+    // Holes in the right subtree all start at or after node->end_addr
+    if (node->end_addr < high) {
+        return vma_gap_search(node->rb_right, low, high, length, out);
+    }
+    return 0;
+}
+
+uintptr_t vma_find_gap(address_space_t *as, uintptr_t low, uintptr_t high, size_t length) {
+    /*
+     * Return the lowest page-aligned address in [low, high) with length
+     * bytes free of VMAs, or 0 if none. low/high/length must be page-aligned.
+     */
+    if (!as || length == 0 || low >= high || high - low < length) {
+        return 0;
+    }
+
+    uintptr_t addr;
+    if (vma_gap_search(as->vma_root, low, high, length, &addr)) {
+        return addr;
+    }
+
+    // Hole after the highest VMA
+    vma_t *last = as->vma_root;
+    while (last && last->rb_right) {
+        last = last->rb_right;
+    }
+    addr = low;
+    if (last && last->end_addr > addr) {
+        addr = last->end_addr;
+    }
+    if (addr < high && high - addr >= length) {
+        return addr;
+    }
+    return 0;
+}
+
+// Returns black height, or -1 on a violation (errors counted in *errors)
+static int vma_validate_node(const vma_t *node, int *errors) {
+    if (!node) return 1;
+
+    if (node->rb_left && node->rb_left->rb_parent != node) {
+        serial_puts("ERROR: VMA tree parent link broken\n");
+        (*errors)++;
+    }
+    if (node->rb_right && node->rb_right->rb_parent != node) {
+        serial_puts("ERROR: VMA tree parent link broken\n");
+        (*errors)++;
+    }
+    if (vma_is_red(node) && (vma_is_red(node->rb_left) || vma_is_red(node->rb_right))) {
+        serial_puts("ERROR: VMA tree has adjacent red nodes\n");
+        (*errors)++;
+    }
+
+    uintptr_t gap = vma_gap_before(node);
+    if (vma_subtree_gap(node->rb_left) > gap) gap = vma_subtree_gap(node->rb_left);
+    if (vma_subtree_gap(node->rb_right) > gap) gap = vma_subtree_gap(node->rb_right);
+    if (node->subtree_gap != gap) {
+        serial_puts("ERROR: VMA tree gap annotation stale at 0x");
+        char buf[16];
+        itoa((uint32_t)node->start_addr, buf, 16);
+        serial_puts(buf);
+        serial_puts("\n");
+        (*errors)++;
+    }
+
+    int left = vma_validate_node(node->rb_left, errors);
+    int right = vma_validate_node(node->rb_right, errors);
+    if (left < 0 || right < 0) return -1;
+    if (left != right) {
+        serial_puts("ERROR: VMA tree black height mismatch\n");
+        (*errors)++;
+        return -1;
+    }
+    return left + (node->rb_color == VMA_RB_BLACK ? 1 : 0);
+}
+
+int vma_validate(address_space_t *as) {
+    /* Check list order, overlaps and tree invariants. Returns error count. */
+    int errors = 0;
+    if (!as) return 0;
+
+    uint32_t count = 0;
+    vma_t *prev = 0;
+    for (vma_t *vma = as->vma_list; vma; vma = vma->next) {
+        if (++count > as->vma_count) {
+            serial_puts("ERROR: VMA list longer than VMA count (cycle?)\n");
+            errors++;
+            break;
+        }
+        if (vma->magic != 0 && vma->magic != VMA_MAGIC) {
+            serial_puts("ERROR: VMA magic corrupted\n");
+            errors++;
+        }
+        if (vma->start_addr >= vma->end_addr) {
+            serial_puts("ERROR: Invalid VMA range\n");
+            errors++;
+        }
+        if (vma->prev != prev) {
+            serial_puts("ERROR: VMA list back link broken\n");
+            errors++;
+        }
+        if (prev && prev->end_addr > vma->start_addr) {
+            serial_puts("ERROR: Overlapping or unordered VMAs\n");
+            errors++;
+        }
+        if (vma_find(as, vma->start_addr) != vma) {
+            serial_puts("ERROR: VMA missing from tree\n");
+            errors++;
+        }
+        prev = vma;
+    }
+
+    if (count != as->vma_count) {
+        serial_puts("ERROR: VMA count mismatch\n");
+        errors++;
+    }
+
+    if (as->vma_root) {
+        if (as->vma_root->rb_parent) {
+            serial_puts("ERROR: VMA tree root has a parent\n");
+            errors++;
+        }
+        if (vma_is_red(as->vma_root)) {
+            serial_puts("ERROR: VMA tree root is red\n");
+            errors++;
+        }
+        vma_validate_node(as->vma_root, &errors);
+    }
+
+    return errors;
+}
@@ -16,13 +16,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <panic.h>
+#include <arch.h>
+#include <kheap.h>
 
 /*
  * Virtual Memory Manager (VMM)
  *
  * Responsibilities:
  * - Track active address spaces (`current_address_space`, `kernel_address_space`)
- * - Provide kernel heap allocation (`kmalloc`/`kfree`) via slab-backed paths
+ * - Provide kernel heap allocation (`kmalloc`/`kfree`): slab caches for small
+ *   objects, the kheap free-list heap up to a page, and VMA-backed pages beyond
  * - Manage virtual mappings and VMAs for user and kernel allocations
  *
  * Early-boot note:
@@ -45,18 +48,21 @@
 #ifndef GUARD_MAGIC_FREED
 #define GUARD_MAGIC_FREED   0xFEEEFEEE  // Marker for freed memory (double-free detection)
 #endif
+#define GUARD_MAGIC_ALIGNED 0xA11C0DE5  // Tag in front of kmalloc_aligned() pointers
+
+// Stored immediately below a pointer returned by kmalloc_aligned()
+typedef struct {
+    uint32_t magic;
+    uint32_t reserved;
+    void *original;             // Pointer returned by the underlying kmalloc()
+} kmalloc_align_tag_t;
 
 // Current address spaces
-address_space_t *current_address_space = 0;
 address_space_t *kernel_address_space = 0;
 
 // Static kernel address space (to avoid kmalloc during initialization)
 static address_space_t kernel_as_static;
 
-// Simple kernel heap allocator (before we have a proper heap)
-static uintptr_t kernel_heap_ptr = (uintptr_t)0x500000;  // Start at 5MB
-static uintptr_t kernel_heap_end = (uintptr_t)0x700000;  // End at 7MB
-
 // Allocation statistics
 static uint32_t total_allocations = 0;
 static uint32_t total_frees = 0;
@@ -64,6 +70,12 @@ static uint32_t bytes_allocated = 0;
 static uint32_t bytes_freed = 0;
 static uint32_t peak_usage = 0;
 
+// Shared all-zero frame mapped read-only for untouched demand pages
+static uintptr_t zero_frame = 0;
+
+// Magazine layers for the kernel slab caches
+static slab_depot_t kernel_slab_depots[NUM_SLAB_CACHES];
+
 // Slab cache sizes
 static const uint32_t slab_sizes[NUM_SLAB_CACHES] = {
     SLAB_SIZE_8, SLAB_SIZE_16, SLAB_SIZE_32, SLAB_SIZE_64,
@@ -75,11 +87,11 @@ static const uint32_t slab_sizes[NUM_SLAB_CACHES] = {
 static void init_slab_cache(slab_cache_t *cache, uint32_t obj_size);
 static void *slab_alloc(slab_cache_t *cache);
 static void slab_free(slab_cache_t *cache, void *ptr);
+#if SLAB_DEBUG
 static uint32_t calculate_checksum(void *ptr, size_t size);
-#ifdef ARCH_X86_64
-static int vmm_addr_in_vma(address_space_t *as, uintptr_t addr);
 #endif
 
+#if SLAB_DEBUG
 // Simple checksum calculation for integrity checking
 static uint32_t calculate_checksum(void *ptr, size_t size) {
     /* Lightweight rolling checksum for allocation metadata integrity checks. */
@@ -91,23 +103,25 @@ static uint32_t calculate_checksum(void *ptr, size_t size) {
     }
     return sum;
 }
+#endif
 
-#ifdef ARCH_X86_64
-static int vmm_addr_in_vma(address_space_t *as, uintptr_t addr) {
-    if (!as) {
-        return 0;
+// Drop one owner of a mapped frame; the shared zero frame is never freed
+static void vmm_put_frame(uintptr_t phys) {
+    phys = PAGE_ALIGN_DOWN(phys);
+    if (phys && phys != zero_frame) {
+        free_page((void *)phys);
     }
+}
 
-    vma_t *vma = as->vma_list;
-    while (vma) {
-        if (addr >= vma->start_addr && addr < vma->end_addr) {
-            return 1;
-        }
-        vma = vma->next;
+// Unmap and free the first num_pages pages of a failed allocation
+static void vmm_unwind_pages(address_space_t *as, uintptr_t virtual_addr, size_t num_pages) {
+    for (size_t j = 0; j < num_pages; j++) {
+        uintptr_t unmap_addr = virtual_addr + (j * PAGE_SIZE);
+        uintptr_t phys = get_physical_address(as->page_dir, unmap_addr);
+        unmap_page(as->page_dir, unmap_addr);
+        if (phys) free_page((void *)phys);
     }
-    return 0;
 }
-#endif
 
 // Initialize a slab cache
 static void init_slab_cache(slab_cache_t *cache, uint32_t obj_size) {
@@ -118,95 +132,228 @@ static void init_slab_cache(slab_cache_t *cache, uint32_t obj_size) {
     cache->free_list = NULL;
     cache->total_objects = 0;
     cache->free_objects = 0;
+    cache->cached_objects = 0;
     cache->total_slabs = 0;
+    cache->color_next = 0;
     cache->slab_pages = NULL;
+    cache->depot = NULL;
 }
 
-// Allocate from slab cache
-static void *slab_alloc(slab_cache_t *cache) {
-    /*
-     * Allocate object from slab cache; lazily provisions backing page when
-     * free list is empty.
-     */
-    if (!cache) return NULL;
+// Attach the magazine layer to a cache (kernel caches only)
+static void init_slab_depot(slab_cache_t *cache, slab_depot_t *depot) {
+    memset(depot, 0, sizeof(slab_depot_t));
+    
+    uint32_t next = 0;
+    for (uint32_t cpu = 0; cpu < SLAB_MAX_CPUS; cpu++) {
+        depot->cpu[cpu].loaded = &depot->pool[next++];
+        depot->cpu[cpu].previous = &depot->pool[next++];
+    }
+    while (depot->empty_count < SLAB_DEPOT_MAGAZINES) {
+        depot->empty[depot->empty_count++] = &depot->pool[next++];
+    }
     
-    // Check if we need to allocate a new slab
-    if (cache->free_list == NULL) {
-        // Allocate a new page for this slab
-        // Use DMA zone to ensure we get identity-mapped memory (0-8MB)
-        void *page = alloc_page_from_zone(PMM_ZONE_DMA);
+    cache->depot = depot;
+}
+
+// Stride between objects in a slab page (header + payload [+ end guard])
+static inline uint32_t slab_obj_stride(const slab_cache_t *cache) {
+    uint32_t stride = cache->obj_size + sizeof(slab_obj_t);
+#if SLAB_DEBUG
+    stride += sizeof(uint32_t);
+#endif
+    return (stride + 7) & ~7U;
+}
+
+// Magazine of the executing CPU. CPUs past SLAB_MAX_CPUS share one; that
+// is safe because every CPU allocates under the big kernel lock.
+static inline uint32_t slab_cpu_index(void) {
+    return smp_cpu_index() % SLAB_MAX_CPUS;
+}
+
+// Carve a fresh page into objects, rotating the starting color per slab
+static int slab_grow(slab_cache_t *cache) {
+    // Use DMA zone to ensure we get identity-mapped memory (0-8MB)
+    void *page = alloc_page_from_zone(PMM_ZONE_DMA);
+    if (!page) {
+        // Fallback to regular allocation if DMA zone exhausted
+        page = alloc_page();
         if (!page) {
-            // Fallback to regular allocation if DMA zone exhausted
-            page = alloc_page();
-            if (!page) {
-                serial_puts("SLAB: Failed to allocate page for slab\n");
-                return NULL;
-            }
+            serial_puts("SLAB: Failed to allocate page for slab\n");
+            return -1;
         }
-        
-        // Get the physical address
-        uintptr_t page_addr = (uintptr_t)page;
-        
-        // For addresses beyond identity-mapped region, we need to skip for now
-        // This is a safety check - identity mapping covers 0-32MB during early boot
-        if (page_addr >= 0x2000000) {
-            serial_puts("SLAB: Allocated page beyond identity-mapped region, freeing\n");
-            free_page(page);
-            return NULL;
+    }
+    
+    // For addresses beyond identity-mapped region, we need to skip for now
+    // This is a safety check - identity mapping covers 0-32MB during early boot
+    if ((uintptr_t)page >= 0x2000000) {
+        serial_puts("SLAB: Allocated page beyond identity-mapped region, freeing\n");
+        free_page(page);
+        return -1;
+    }
+    
+    uint32_t stride = slab_obj_stride(cache);
+    uint32_t objects_per_slab = PAGE_SIZE / stride;
+    if (objects_per_slab == 0) {
+        serial_puts("SLAB: Object size too large for slab\n");
+        free_page(page);
+        return -1;
+    }
+    
+    // Spread object offsets across cache lines using the slack at the page end
+    uint32_t slack = PAGE_SIZE - objects_per_slab * stride;
+    uint32_t color = cache->color_next;
+    if (color > slack) {
+        color = 0;
+    }
+    cache->color_next = color + SLAB_COLOR_ALIGN;
+    
+    cache->total_slabs++;
+    
+    // Use the physical address directly (identity mapped)
+    uint8_t *slab_mem = (uint8_t *)page + color;
+    for (uint32_t i = 0; i < objects_per_slab; i++) {
+        slab_obj_t *obj = (slab_obj_t *)(slab_mem + (i * stride));
+        obj->magic_start = GUARD_MAGIC_FREED;
+        obj->size = cache->obj_size;
+        obj->next = cache->free_list;
+        obj->checksum = 0;
+#if SLAB_DEBUG
+        uint32_t *end_guard = (uint32_t *)((uint8_t *)(obj + 1) + cache->obj_size);
+        *end_guard = GUARD_MAGIC_END;
+#endif
+        cache->free_list = obj;
+        cache->total_objects++;
+        cache->free_objects++;
+    }
+    return 0;
+}
+
+// Pop one object header from the slab free list, growing the cache if empty
+static slab_obj_t *slab_pop(slab_cache_t *cache) {
+    if (cache->free_list == NULL && slab_grow(cache) != 0) {
+        return NULL;
+    }
+    
+    slab_obj_t *obj = cache->free_list;
+    cache->free_list = obj->next;
+    cache->free_objects--;
+    return obj;
+}
+
+static void slab_push(slab_cache_t *cache, slab_obj_t *obj) {
+    obj->next = cache->free_list;
+    cache->free_list = obj;
+    cache->free_objects++;
+}
+
+// Fill an empty magazine from the slab free list in one pass
+static void slab_magazine_fill(slab_cache_t *cache, slab_magazine_t *mag) {
+    while (mag->rounds < SLAB_MAGAZINE_ROUNDS) {
+        slab_obj_t *obj = slab_pop(cache);
+        if (!obj) {
+            break;
         }
-        
-        cache->total_slabs++;
-        
-        // Calculate how many objects fit in a page
-        uint32_t obj_total_size = cache->obj_size + sizeof(slab_obj_t) + sizeof(uint32_t); // +4 for end guard
-        uint32_t objects_per_slab = PAGE_SIZE / obj_total_size;
-        
-        if (objects_per_slab == 0) {
-            serial_puts("SLAB: Object size too large for slab\n");
-            free_page(page);
-            return NULL;
+        mag->objs[mag->rounds++] = (void *)(obj + 1);
+        cache->free_objects++;
+        cache->cached_objects++;
+    }
+    cache->depot->refills++;
+}
+
+// Return every object of a magazine to the slab free list
+static void slab_magazine_drain(slab_cache_t *cache, slab_magazine_t *mag) {
+    while (mag->rounds > 0) {
+        slab_obj_t *obj = ((slab_obj_t *)mag->objs[--mag->rounds]) - 1;
+        cache->free_objects--;
+        cache->cached_objects--;
+        slab_push(cache, obj);
+    }
+    cache->depot->flushes++;
+}
+
+// Take one object from this CPU's magazines; refills from depot or slab
+static void *slab_magazine_get(slab_cache_t *cache) {
+    slab_depot_t *depot = cache->depot;
+    slab_cpu_cache_t *cc = &depot->cpu[slab_cpu_index()];
+    
+    if (cc->loaded->rounds == 0) {
+        slab_magazine_t *tmp = cc->loaded;
+        if (cc->previous->rounds > 0) {
+            cc->loaded = cc->previous;
+            cc->previous = tmp;
+        } else if (depot->full_count > 0) {
+            depot->empty[depot->empty_count++] = cc->previous;
+            cc->previous = tmp;
+            cc->loaded = depot->full[--depot->full_count];
+        } else {
+            slab_magazine_fill(cache, cc->loaded);
+            if (cc->loaded->rounds == 0) {
+                return NULL;
+            }
         }
-        
-        // Initialize free list from this slab
-        // Use the physical address directly (identity mapped)
-        uint8_t *slab_mem = (uint8_t *)page;
-        for (uint32_t i = 0; i < objects_per_slab; i++) {
-            slab_obj_t *obj = (slab_obj_t *)(slab_mem + (i * obj_total_size));
-            obj->magic_start = GUARD_MAGIC_START;
-            obj->size = cache->obj_size;
-            obj->next = cache->free_list;
-            obj->checksum = 0; // Will be set on allocation
-            
-            // Add end guard
-            uint32_t *end_guard = (uint32_t *)((uint8_t *)(obj + 1) + cache->obj_size);
-            *end_guard = GUARD_MAGIC_END;
-            
-            cache->free_list = obj;
-            cache->total_objects++;
-            cache->free_objects++;
+    }
+    
+    cache->free_objects--;
+    cache->cached_objects--;
+    return cc->loaded->objs[--cc->loaded->rounds];
+}
+
+// Park one object in this CPU's magazines; spills to depot or slab
+static void slab_magazine_put(slab_cache_t *cache, void *ptr) {
+    slab_depot_t *depot = cache->depot;
+    slab_cpu_cache_t *cc = &depot->cpu[slab_cpu_index()];
+    
+    if (cc->loaded->rounds == SLAB_MAGAZINE_ROUNDS) {
+        slab_magazine_t *tmp = cc->loaded;
+        if (cc->previous->rounds == 0) {
+            cc->loaded = cc->previous;
+            cc->previous = tmp;
+        } else if (depot->empty_count > 0) {
+            depot->full[depot->full_count++] = cc->previous;
+            cc->previous = tmp;
+            cc->loaded = depot->empty[--depot->empty_count];
+        } else {
+            slab_magazine_drain(cache, cc->loaded);
         }
     }
     
-    // Pop from free list
-    slab_obj_t *obj = cache->free_list;
-    if (!obj) return NULL;
+    cc->loaded->objs[cc->loaded->rounds++] = ptr;
+    cache->free_objects++;
+    cache->cached_objects++;
+}
+
+// Allocate from slab cache
+static void *slab_alloc(slab_cache_t *cache) {
+    /*
+     * Fast path: pop from the per-CPU magazine. Slow path refills a magazine
+     * from the depot or in bulk from the slab free list.
+     */
+    if (!cache) return NULL;
     
-    cache->free_list = obj->next;
-    cache->free_objects--;
+    slab_obj_t *obj;
+    if (cache->depot) {
+        uintptr_t irq = arch_irq_save();
+        void *ptr = slab_magazine_get(cache);
+        arch_irq_restore(irq);
+        if (!ptr) return NULL;
+        obj = ((slab_obj_t *)ptr) - 1;
+    } else {
+        obj = slab_pop(cache);
+        if (!obj) return NULL;
+    }
     
+    obj->magic_start = GUARD_MAGIC_START;
+#if SLAB_DEBUG
     // Calculate checksum for the header
     obj->checksum = calculate_checksum(obj, sizeof(slab_obj_t) - sizeof(uint32_t));
+#endif
     
     // Return pointer after header
     return (void *)(obj + 1);
 }
 
-// Free to slab cache with enhanced safety checks
+// Free to slab cache; SLAB_DEBUG builds verify guards and poison payloads
 static void slab_free(slab_cache_t *cache, void *ptr) {
-    /*
-     * Return object to slab cache with guard/checksum verification to detect
-     * corruption, overflow, and double-free patterns.
-     */
     if (!cache || !ptr) {
         serial_puts("ERROR: slab_free - NULL cache or pointer\n");
         return;
@@ -215,6 +362,7 @@ static void slab_free(slab_cache_t *cache, void *ptr) {
     // Get header
     slab_obj_t *obj = ((slab_obj_t *)ptr) - 1;
     
+#if SLAB_DEBUG
     // Validate object is not obviously corrupt
     uintptr_t obj_addr = (uintptr_t)obj;
     if (obj_addr < (uintptr_t)0x100000 || obj_addr > (uintptr_t)0x20000000) {
@@ -222,13 +370,6 @@ static void slab_free(slab_cache_t *cache, void *ptr) {
         return;
     }
     
-    // Check for double-free
-    if (obj->magic_start == GUARD_MAGIC_FREED) {
-        // Double-free detected - silently ignore to prevent corruption
-        // Memory not returned to pool (already freed)
-        return;
-    }
-    
     // Validate guards and checksum
     if (obj->magic_start != GUARD_MAGIC_START) {
         serial_puts("WARNING: Memory corruption - start guard invalid at 0x");
@@ -243,16 +384,6 @@ static void slab_free(slab_cache_t *cache, void *ptr) {
         return;
     }
     
-    // Validate size
-    if (obj->size == 0 || obj->size > SLAB_SIZE_2048) {
-        serial_puts("ERROR: slab_free - corrupted object size: ");
-        char buf[16];
-        itoa(obj->size, buf, 10);
-        serial_puts(buf);
-        serial_puts("\n");
-        return;
-    }
-    
     uint32_t *end_guard = (uint32_t *)((uint8_t *)ptr + obj->size);
     if (*end_guard != GUARD_MAGIC_END) {
         serial_puts("WARNING: Buffer corruption - end guard invalid at 0x");
@@ -278,17 +409,30 @@ static void slab_free(slab_cache_t *cache, void *ptr) {
         // Continue anyway - checksum might have been updated
     }
     
-    // Mark as freed to catch double-frees
-    obj->magic_start = GUARD_MAGIC_FREED;
-    
     // Poison the freed memory (fill with recognizable pattern)
     // This helps detect use-after-free bugs
     memset(ptr, 0xFE, obj->size);
+#endif
     
-    // Add back to free list
-    obj->next = cache->free_list;
-    cache->free_list = obj;
-    cache->free_objects++;
+    // Mark as freed to catch double-frees
+    obj->magic_start = GUARD_MAGIC_FREED;
+    
+    if (cache->depot) {
+        uintptr_t irq = arch_irq_save();
+        slab_magazine_put(cache, ptr);
+        arch_irq_restore(irq);
+    } else {
+        slab_push(cache, obj);
+    }
+}
+
+// Map a request size to its power-of-two slab class
+static inline int slab_class_index(size_t size) {
+    if (size <= SLAB_SIZE_8) {
+        return 0;
+    }
+    int index = (int)(sizeof(unsigned long) * 8) - __builtin_clzl((unsigned long)(size - 1)) - 3;
+    return (index < NUM_SLAB_CACHES) ? index : -1;
 }
 
 void init_vmm(void) {
@@ -306,13 +450,23 @@ void init_vmm(void) {
     
     // Use existing kernel page directory
     kernel_address_space->page_dir = kernel_directory;
-    kernel_address_space->heap_start = kernel_heap_ptr;
-    kernel_address_space->heap_end = kernel_heap_ptr;
+    // heap_start/heap_end describe the sbrk heap of the ring 3 shell, which
+    // runs in the kernel address space; kmalloc's own heap is kheap
+    kernel_address_space->heap_start = VMM_USER_HEAP_START;
+    kernel_address_space->heap_end = VMM_USER_HEAP_START;
     kernel_address_space->stack_top = 0; // Kernel doesn't use user stack
     
-    // Initialize slab caches for kernel
+    // Initialize slab caches for kernel, fronted by per-CPU magazines
     for (int i = 0; i < NUM_SLAB_CACHES; i++) {
         init_slab_cache(&kernel_address_space->slab_caches[i], slab_sizes[i]);
+        init_slab_depot(&kernel_address_space->slab_caches[i], &kernel_slab_depots[i]);
+    }
+    
+    // Zero frame for demand-paged reads (DMA zone: identity-mapped on all arches)
+    void *zero = alloc_page_from_zone(PMM_ZONE_DMA);
+    if (zero) {
+        memset(zero, 0, PAGE_SIZE);
+        zero_frame = (uintptr_t)zero;
     }
     
     current_address_space = kernel_address_space;
@@ -374,10 +528,16 @@ void destroy_address_space(address_space_t *as) {
         return;
     }
     
-    // Free all VMAs
+    // Release the frames behind every user VMA (shared COW frames lose one
+    // owner) and free the VMAs themselves
     vma_t *vma = as->vma_list;
     while (vma) {
         vma_t *next = vma->next;
+        if (vma->flags & PAGE_USER) {
+            for (uintptr_t vaddr = vma->start_addr; vaddr < vma->end_addr; vaddr += PAGE_SIZE) {
+                vmm_put_frame(get_physical_address(as->page_dir, vaddr));
+            }
+        }
         kfree(vma);
         vma = next;
     }
@@ -396,6 +556,194 @@ void switch_address_space(address_space_t *as) {
     switch_page_directory(as->page_dir);
 }
 
+static void vmm_clear_boot_mappings(address_space_t *as, uintptr_t start, uintptr_t end) {
+    /*
+     * x86_64 address spaces inherit the boot identity map: supervisor-only
+     * 2 MiB pages over the low 4 GiB, so demand ranges start out "present".
+     * Punch them out so a first touch from either ring faults as not-present
+     * and gets a private user frame, instead of landing on whatever physical
+     * memory the identity map points at.
+     */
+#ifdef ARCH_X86_64
+    int cleared = 0;
+    for (uintptr_t vaddr = start; vaddr < end; vaddr += PAGE_SIZE) {
+        if (is_page_present(as->page_dir, vaddr)) {
+            unmap_page(as->page_dir, vaddr);
+            cleared = 1;
+        }
+    }
+    if (cleared) {
+        smp_tlb_shootdown(as);
+    }
+#else
+    (void)as;
+    (void)start;
+    (void)end;
+#endif
+}
+
+address_space_t *vmm_fork_address_space(address_space_t *parent) {
+    /*
+     * Duplicate parent's VMAs into a new address space without copying data.
+     * Every present user page becomes read-only + PAGE_COW in both parent
+     * and child, and the frame gains an owner; the first write to either side
+     * takes a fault and gets a private copy (vmm_handle_cow_fault).
+     *
+     * Page tables are not shared: the child gets its own leaf tables, filled
+     * PTE by PTE, so fork costs one PTE copy and one frame reference per
+     * resident page (but no page copies). Sharing leaf tables would need an
+     * unshare step in every PTE writer of both paging layers (map, unmap,
+     * set_page_flags, the fault paths and teardown).
+     */
+    if (!parent) return 0;
+    
+    address_space_t *child = create_address_space();
+    if (!child) return 0;
+    
+    child->heap_start = parent->heap_start;
+    child->heap_end = parent->heap_end;
+    child->stack_top = parent->stack_top;
+    
+    for (vma_t *vma = parent->vma_list; vma; vma = vma->next) {
+        // Kernel allocations are global, never per-process copies
+        if (!(vma->flags & PAGE_USER)) {
+            continue;
+        }
+        
+        vma_t *copy = (vma_t *)kmalloc(sizeof(vma_t));
+        if (!copy) {
+            destroy_address_space(child);
+            return 0;
+        }
+        copy->start_addr = vma->start_addr;
+        copy->end_addr = vma->end_addr;
+        copy->flags = vma->flags;
+        copy->magic = VMA_MAGIC;
+        vma_insert(child, copy);
+        
+        // Pages the parent never touched must fault in the child too
+        if (vma->flags & VMM_DEMAND) {
+            vmm_clear_boot_mappings(child, vma->start_addr, vma->end_addr);
+        }
+        
+        for (uintptr_t vaddr = vma->start_addr; vaddr < vma->end_addr; vaddr += PAGE_SIZE) {
+            uint32_t flags = get_page_flags(parent->page_dir, vaddr);
+            if (!(flags & PAGE_PRESENT)) {
+                continue;
+            }
+            uintptr_t phys = PAGE_ALIGN_DOWN(get_physical_address(parent->page_dir, vaddr));
+            
+            if (phys != zero_frame && pmm_page_ref((void *)phys) != 0) {
+                serial_puts("VMM: fork - cannot share frame\n");
+                destroy_address_space(child);
+                return 0;
+            }
+            
+            if (flags & PAGE_WRITE) {
+                flags = (flags & ~PAGE_WRITE) | PAGE_COW;
+                set_page_flags(parent->page_dir, vaddr, flags);
+            }
+            map_page(child->page_dir, vaddr, phys, flags & ~(PAGE_ACCESSED | PAGE_DIRTY));
+        }
+    }
+    
+    // Other threads of the parent may still cache the writable entries
+    smp_tlb_shootdown(parent);
+    return child;
+}
+
+static int vmm_handle_cow_fault(address_space_t *as, uintptr_t vaddr) {
+    uint32_t flags = get_page_flags(as->page_dir, vaddr);
+    if (!(flags & PAGE_PRESENT) || !(flags & PAGE_COW)) {
+        return 0;
+    }
+    
+    uintptr_t phys = PAGE_ALIGN_DOWN(get_physical_address(as->page_dir, vaddr));
+    uint32_t new_flags = (flags | PAGE_WRITE) & ~(PAGE_COW | PAGE_ACCESSED | PAGE_DIRTY);
+    
+    // Last owner: the frame is ours again, just make it writable
+    if (phys != zero_frame && pmm_page_refcount((void *)phys) <= 1) {
+        return set_page_flags(as->page_dir, vaddr, new_flags) == 0;
+    }
+    
+    void *frame = alloc_page();
+    if (!frame) {
+        serial_puts("VMM: COW break failed - out of memory\n");
+        return 0;
+    }
+    
+    // First write to a demand page that was only read so far
+    if (phys == zero_frame) {
+        unmap_page(as->page_dir, vaddr);
+        map_page(as->page_dir, vaddr, (uintptr_t)frame, new_flags);
+        memset((void *)vaddr, 0, PAGE_SIZE);
+        return 1;
+    }
+    
+    // The new frame is not necessarily kernel-addressable, so copy through
+    // a bounce buffer while the faulting mapping is swapped underneath.
+    static uint8_t cow_bounce[PAGE_SIZE];
+    uintptr_t irq = arch_irq_save();
+    memcpy(cow_bounce, (void *)vaddr, PAGE_SIZE);
+    unmap_page(as->page_dir, vaddr);
+    map_page(as->page_dir, vaddr, (uintptr_t)frame, new_flags);
+    memcpy((void *)vaddr, cow_bounce, PAGE_SIZE);
+    arch_irq_restore(irq);
+    
+    free_page((void *)phys);
+    return 1;
+}
+
+static int vmm_handle_demand_fault(address_space_t *as, uintptr_t vaddr, int write) {
+    /*
+     * First touch of a page inside a VMM_DEMAND VMA. Reads share the zero
+     * frame (read-only, COW if the VMA is writable); writes get a private
+     * frame zeroed here rather than at reservation time.
+     */
+    vma_t *vma = vma_find(as, vaddr);
+    if (!vma || !(vma->flags & VMM_DEMAND)) {
+        return 0;
+    }
+    
+    uint32_t flags = (vma->flags & (PAGE_WRITE | PAGE_USER | PAGE_NOCACHE)) | PAGE_PRESENT;
+    if (write && !(flags & PAGE_WRITE)) {
+        return 0;
+    }
+    
+    if (!write && zero_frame) {
+        if (flags & PAGE_WRITE) {
+            flags = (flags & ~PAGE_WRITE) | PAGE_COW;
+        }
+        map_page(as->page_dir, vaddr, zero_frame, flags);
+        return 1;
+    }
+    
+    void *frame = alloc_page();
+    if (!frame) {
+        serial_puts("VMM: demand fault - out of memory\n");
+        return 0;
+    }
+    
+    uint32_t fill_flags = flags | PAGE_WRITE;
+    map_page(as->page_dir, vaddr, (uintptr_t)frame, fill_flags);
+    memset((void *)vaddr, 0, PAGE_SIZE);
+    if (fill_flags != flags) {
+        set_page_flags(as->page_dir, vaddr, flags);
+    }
+    return 1;
+}
+
+int vmm_handle_page_fault(uintptr_t fault_addr, int present, int write) {
+    address_space_t *as = current_address_space;
+    if (!as) return 0;
+    
+    uintptr_t vaddr = PAGE_ALIGN_DOWN(fault_addr);
+    if (present) {
+        return write ? vmm_handle_cow_fault(as, vaddr) : 0;
+    }
+    return vmm_handle_demand_fault(as, vaddr, write);
+}
+
 void *vmm_alloc_pages(address_space_t *as, uintptr_t virtual_addr, size_t num_pages, uint32_t flags) {
     if (!as) return 0;
     
@@ -406,51 +754,63 @@ void *vmm_alloc_pages(address_space_t *as, uintptr_t virtual_addr, size_t num_pa
     }
     
     virtual_addr = PAGE_ALIGN_DOWN(virtual_addr);
+    if (num_pages == 0 || virtual_addr + (num_pages * PAGE_SIZE) < virtual_addr) {
+        return 0;
+    }
+    
+    uintptr_t end_addr = virtual_addr + (num_pages * PAGE_SIZE);
+    
+    // Never overlap an address range already owned by a tracked VMA
+    if (vma_find_intersection(as, virtual_addr, end_addr)) {
+        return 0;
+    }
+    
+    // Demand-paged reservation: record the VMA, the fault handler maps frames
+    if (flags & VMM_DEMAND) {
+#ifndef ARCH_X86_64
+        for (uintptr_t vaddr = virtual_addr; vaddr < end_addr; vaddr += PAGE_SIZE) {
+            if (is_page_present(as->page_dir, vaddr)) {
+                return 0;
+            }
+        }
+#endif
+        vmm_clear_boot_mappings(as, virtual_addr, end_addr);
+        // Extend an adjacent reservation (successive sbrk calls) in place
+        vma_t *prev = virtual_addr ? vma_find(as, virtual_addr - 1) : 0;
+        if (prev && prev->end_addr == virtual_addr && prev->flags == flags) {
+            vma_resize(as, prev, prev->start_addr, end_addr);
+            return (void *)virtual_addr;
+        }
+        
+        vma_t *vma = (vma_t *)kmalloc(sizeof(vma_t));
+        if (!vma) return 0;
+        vma->start_addr = virtual_addr;
+        vma->end_addr = end_addr;
+        vma->flags = flags;
+        vma->magic = VMA_MAGIC;
+        vma_insert(as, vma);
+        return (void *)virtual_addr;
+    }
     
     // Allocate physical pages and map them
     for (size_t i = 0; i < num_pages; i++) {
         uintptr_t vaddr = virtual_addr + (i * PAGE_SIZE);
         
-        // Check if already mapped
+#ifndef ARCH_X86_64
+        // Check if already mapped. x86_64 boot tables pre-map broad identity
+        // ranges that are not tracked as VMAs, so remapping is allowed there.
         if (is_page_present(as->page_dir, vaddr)) {
-#ifdef ARCH_X86_64
-            /*
-             * x86_64 boot tables may pre-map broad identity ranges that are not
-             * tracked as VMAs. Allow remap in that case, but never overwrite an
-             * address that is already owned by a tracked VMA allocation.
-             */
-            if (vmm_addr_in_vma(as, vaddr)) {
-                // Unmap what we've allocated so far
-                for (size_t j = 0; j < i; j++) {
-                    uintptr_t unmap_addr = virtual_addr + (j * PAGE_SIZE);
-                    uintptr_t phys = get_physical_address(as->page_dir, unmap_addr);
-                    unmap_page(as->page_dir, unmap_addr);
-                    if (phys) free_page((void *)phys);
-                }
-                return 0;
-            }
-#else
             // Unmap what we've allocated so far
-            for (size_t j = 0; j < i; j++) {
-                uintptr_t unmap_addr = virtual_addr + (j * PAGE_SIZE);
-                uintptr_t phys = get_physical_address(as->page_dir, unmap_addr);
-                unmap_page(as->page_dir, unmap_addr);
-                if (phys) free_page((void *)phys);
-            }
+            vmm_unwind_pages(as, virtual_addr, i);
             return 0;
-#endif
         }
+#endif
         
         // Allocate physical page
         void *phys_page = alloc_page();
         if (!phys_page) {
             // Clean up on failure
-            for (size_t j = 0; j < i; j++) {
-                uintptr_t unmap_addr = virtual_addr + (j * PAGE_SIZE);
-                uintptr_t phys = get_physical_address(as->page_dir, unmap_addr);
-                unmap_page(as->page_dir, unmap_addr);
-                if (phys) free_page((void *)phys);
-            }
+            vmm_unwind_pages(as, virtual_addr, i);
             return 0;
         }
         
@@ -469,9 +829,8 @@ void *vmm_alloc_pages(address_space_t *as, uintptr_t virtual_addr, size_t num_pa
         vma->start_addr = virtual_addr;
         vma->end_addr = virtual_addr + (num_pages * PAGE_SIZE);
         vma->flags = flags;
-        vma->magic = 0xDEADBEEF;  // Set magic for validation
-        vma->next = as->vma_list;
-        as->vma_list = vma;
+        vma->magic = VMA_MAGIC;  // Set magic for validation
+        vma_insert(as, vma);
     }
     
     return (void *)virtual_addr;
@@ -483,51 +842,61 @@ void *vmm_alloc_at(address_space_t *as, uintptr_t virtual_addr, size_t size, uin
 }
 
 void *vmm_alloc_anywhere(address_space_t *as, size_t size, uint32_t flags) {
-    if (!as) return 0;
+    if (!as || size == 0) return 0;
     
     size_t num_pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    size_t length = num_pages * PAGE_SIZE;
     
     // Find free virtual address space
     uintptr_t start_addr = (flags & PAGE_USER) ? VMM_USER_HEAP_START : VMM_KERNEL_HEAP_START;
-    uintptr_t end_addr = (flags & PAGE_USER) ? (uintptr_t)KERNEL_VIRTUAL_BASE : UINTPTR_MAX;
+    uintptr_t end_addr = (flags & PAGE_USER) ? (uintptr_t)KERNEL_VIRTUAL_BASE : PAGE_ALIGN_DOWN(UINTPTR_MAX);
     
-    // Simple linear search for free space
-    for (uintptr_t addr = start_addr; addr < end_addr - (num_pages * PAGE_SIZE); addr += PAGE_SIZE) {
-        int free_space = 1;
-        
-        // Check if this range is free
-        for (size_t i = 0; i < num_pages; i++) {
-            uintptr_t check_addr = addr + (i * PAGE_SIZE);
-            if (is_page_present(as->page_dir, check_addr)) {
+    // The VMA tree yields the lowest hole that fits in O(log n)
+    uintptr_t addr = vma_find_gap(as, start_addr, end_addr, length);
+    while (addr) {
 #ifdef ARCH_X86_64
-                /*
-                 * x86_64 bootstrap keeps broad identity mappings installed.
-                 * If the page is not owned by a tracked VMA, treat it as
-                 * remappable space for dynamic allocations.
-                 */
-                if (vmm_addr_in_vma(as, check_addr)) {
-                    free_space = 0;
-                    break;
-                }
+        /*
+         * x86_64 bootstrap keeps broad identity mappings installed. Pages
+         * not owned by a tracked VMA are remappable space.
+         */
+        return vmm_alloc_pages(as, addr, num_pages, flags);
 #else
-                free_space = 0;
+        // Skip past pages mapped outside of any VMA (boot/higher-half tables)
+        uintptr_t busy = 0;
+        for (size_t i = 0; i < num_pages; i++) {
+            if (is_page_present(as->page_dir, addr + (i * PAGE_SIZE))) {
+                busy = addr + (i * PAGE_SIZE);
                 break;
-#endif
             }
         }
-        
-        if (free_space) {
+        if (!busy) {
             return vmm_alloc_pages(as, addr, num_pages, flags);
         }
+        addr = vma_find_gap(as, busy + PAGE_SIZE, end_addr, length);
+#endif
     }
     
     return 0; // No free space found
 }
 
-void vmm_free_pages(address_space_t *as, uintptr_t virtual_addr, size_t num_pages) {
-    if (!as) return;
+int vmm_free_pages(address_space_t *as, uintptr_t virtual_addr, size_t num_pages) {
+    if (!as || num_pages == 0) return 0;
     
     virtual_addr = PAGE_ALIGN_DOWN(virtual_addr);
+    uintptr_t end_addr = virtual_addr + (num_pages * PAGE_SIZE);
+    if (end_addr < virtual_addr) return -1;
+    
+    // A hole punched in the middle of a VMA needs a node for the tail; get
+    // it before anything is unmapped so failure leaves the range intact
+    vma_t *tail = 0;
+    vma_t *split = vma_find_intersection(as, virtual_addr, end_addr);
+    if (split && split->start_addr < virtual_addr && split->end_addr > end_addr) {
+        tail = (vma_t *)kmalloc(sizeof(vma_t));
+        if (!tail) {
+            serial_puts("VMM: No memory to split VMA, range not freed\n");
+            return -1;
+        }
+    }
     
     // Unmap and free physical pages
     for (size_t i = 0; i < num_pages; i++) {
@@ -536,21 +905,39 @@ void vmm_free_pages(address_space_t *as, uintptr_t virtual_addr, size_t num_page
         
         if (phys) {
             unmap_page(as->page_dir, vaddr);
-            free_page((void *)phys);
+            vmm_put_frame(phys);
         }
     }
+    // Freed frames cannot be reallocated before this returns: the caller
+    // holds the kernel lock, so remote TLBs are clean before reuse.
+    smp_tlb_shootdown(as);
     
-    // Remove VMA entry
-    vma_t **vma_ptr = &as->vma_list;
-    while (*vma_ptr) {
-        vma_t *vma = *vma_ptr;
-        if (vma->start_addr == virtual_addr) {
-            *vma_ptr = vma->next;
+    // Drop, trim or split every VMA overlapping the freed range
+    vma_t *vma = vma_find_intersection(as, virtual_addr, end_addr);
+    while (vma && vma->start_addr < end_addr) {
+        vma_t *next = vma->next;
+        
+        if (vma->start_addr >= virtual_addr && vma->end_addr <= end_addr) {
+            vma_remove(as, vma);
             kfree(vma);
-            break;
+        } else if (vma->start_addr < virtual_addr && vma->end_addr > end_addr) {
+            // Hole punched in the middle: keep the head, re-insert the tail
+            uintptr_t old_end = vma->end_addr;
+            vma_resize(as, vma, vma->start_addr, virtual_addr);
+            tail->start_addr = end_addr;
+            tail->end_addr = old_end;
+            tail->flags = vma->flags;
+            tail->magic = VMA_MAGIC;
+            vma_insert(as, tail);
+        } else if (vma->start_addr < virtual_addr) {
+            vma_resize(as, vma, vma->start_addr, virtual_addr);
+        } else {
+            vma_resize(as, vma, end_addr, vma->end_addr);
         }
-        vma_ptr = &vma->next;
+        
+        vma = next;
     }
+    return 0;
 }
 
 void *kmalloc_pages(size_t num_pages) {
@@ -605,43 +992,27 @@ void *kmalloc(size_t size) {
     
     // Use slab allocator for small allocations if VMM is initialized
     if (kernel_address_space) {
-        for (int i = 0; i < NUM_SLAB_CACHES; i++) {
-            if (size <= slab_sizes[i]) {
-                void *ptr = slab_alloc(&kernel_address_space->slab_caches[i]);
-                if (ptr) {
-                    // Zero the memory for safety (prevents info leaks)
-                    memset(ptr, 0, size);
-                    return ptr;
-                }
-                // If slab allocation failed, fall through to page allocator
-                break;
+        int index = slab_class_index(size);
+        if (index >= 0) {
+            void *ptr = slab_alloc(&kernel_address_space->slab_caches[index]);
+            if (ptr) {
+                // Zero the memory for safety (prevents info leaks)
+                memset(ptr, 0, size);
+                return ptr;
             }
+            // If slab allocation failed, fall through to page allocator
         }
     }
     
     // For allocations that don't fit in slabs or before VMM is initialized
-    // Use bump allocator for allocations smaller than a page
-    if (size < PAGE_SIZE && kernel_heap_ptr + size + sizeof(uint32_t) * 2 <= kernel_heap_end) {
-        // Add guards
-        uint32_t *start_guard = (uint32_t *)kernel_heap_ptr;
-        *start_guard = GUARD_MAGIC_START;
-        kernel_heap_ptr += sizeof(uint32_t);
-        
-        void *ptr = (void *)kernel_heap_ptr;
-        
-        // Zero the memory for safety
-        memset(ptr, 0, size);
-        
-        kernel_heap_ptr += size;
-        
-        // Align to 8 bytes
-        kernel_heap_ptr = (kernel_heap_ptr + 7) & ~7;
-        
-        uint32_t *end_guard = (uint32_t *)kernel_heap_ptr;
-        *end_guard = GUARD_MAGIC_END;
-        kernel_heap_ptr += sizeof(uint32_t);
-        
-        return ptr;
+    // use the free-list heap for anything smaller than a page
+    if (size < PAGE_SIZE) {
+        void *ptr = kheap_alloc(size);
+        if (ptr) {
+            // Zero the memory for safety
+            memset(ptr, 0, size);
+            return ptr;
+        }
     }
     
     // For large allocations, use page allocator
@@ -682,22 +1053,42 @@ void *kmalloc_aligned(size_t size, size_t alignment) {
         return ptr;
     }
     
-    // For smaller alignments, allocate extra space
-    void *ptr = kmalloc(size + alignment);
+    // kmalloc() already guarantees 8-byte alignment
+    if (alignment <= 8) {
+        return kmalloc(size);
+    }
+    
+    if (size > SIZE_MAX - alignment - sizeof(kmalloc_align_tag_t)) {
+        serial_puts("ERROR: Overflow in aligned allocation\n");
+        return NULL;
+    }
+    
+    // Over-allocate, then tag the aligned pointer with the original so kfree()
+    // can release the whole block
+    void *ptr = kmalloc(size + alignment - 1 + sizeof(kmalloc_align_tag_t));
     if (!ptr) return NULL;
     
-    // Calculate aligned address
-    uintptr_t addr = (uintptr_t)ptr;
+    uintptr_t addr = (uintptr_t)ptr + sizeof(kmalloc_align_tag_t);
     uintptr_t aligned_addr = (addr + alignment - 1) & ~(alignment - 1);
     
-    // If already aligned, return as-is
-    if (aligned_addr == addr) {
-        return ptr;
+    kmalloc_align_tag_t *tag = ((kmalloc_align_tag_t *)aligned_addr) - 1;
+    tag->magic = GUARD_MAGIC_ALIGNED;
+    tag->reserved = 0;
+    tag->original = ptr;
+    return (void *)aligned_addr;
+}
+
+// Release a kmalloc_aligned() pointer if ptr carries an alignment tag
+static int kfree_aligned_tag(void *ptr) {
+    kmalloc_align_tag_t *tag = ((kmalloc_align_tag_t *)ptr) - 1;
+    if (tag->magic != GUARD_MAGIC_ALIGNED) {
+        return 0;
     }
     
-    // Note: This is a simplified implementation
-    // A production version should store the original pointer for proper freeing
-    return ptr;
+    void *original = tag->original;
+    tag->magic = 0;
+    kfree(original);
+    return 1;
 }
 
 void kfree(void *ptr) {
@@ -711,126 +1102,90 @@ void kfree(void *ptr) {
         return;
     }
     
-    // Check if pointer is in early bump allocator range
-    if (addr >= (uintptr_t)0x500000 && addr < (uintptr_t)0x700000) {
-        // Validate alignment
-        if (addr % 4 != 0) {
-            serial_puts("WARNING: kfree - misaligned pointer in bump allocator region\n");
-        }
-        
-        // Check guards for bump allocator allocations
-        uint32_t *start_guard = (uint32_t *)(addr - sizeof(uint32_t));
-        
-        // Additional validation for guard location
-        if ((uintptr_t)start_guard < (uintptr_t)0x500000) {
-            serial_puts("ERROR: kfree - guard outside bump allocator range\n");
-            return;
-        }
-        
-        if (*start_guard == GUARD_MAGIC_FREED) {
-            // serial_puts("ERROR: Double-free detected in bump allocator region!\n");
-            // Silently block double-free to avoid panicking during boot - just skip the free
-            return;
-        }
-        
-        if (*start_guard != GUARD_MAGIC_START) {
-            serial_puts("WARNING: kfree - start guard corrupted in bump allocator region\n");
+    // Everything below the identity-mapped limit (heap, slab pages) can be
+    // inspected directly without risking a fault
+    int identity_mapped = addr < (uintptr_t)0x2000000;
+    
+    // General-purpose heap allocations. The alignment tag is only read once
+    // the pointer is known to lie inside a heap block, after its start.
+    if (kheap_owns(ptr)) {
+        int state = kheap_is_live_block(ptr);
+        if (state == 1) {
+            bytes_freed += kheap_free(ptr);
+            total_frees++;
+        } else if (state == 0) {
+            // Interior pointers can only come from kmalloc_aligned()
+            if (kheap_owns((kmalloc_align_tag_t *)ptr - 1) && kfree_aligned_tag(ptr)) {
+                return;
+            }
+            serial_puts("WARNING: kfree - pointer inside kernel heap is not a block start\n");
         }
-        
-        // Mark as freed to detect double-frees
-        *start_guard = GUARD_MAGIC_FREED;
-        
-        // Memory from bump allocator cannot be freed (no tracking)
-        // This is acceptable as bump allocator is only used during early boot
-        bytes_freed += 64; // Estimate
-        total_frees++;
+        // state == -1: double-free, silently ignored like the slab path
         return;
     }
     
-    // For VMM-allocated memory, search for the VMA and free it
-    if (kernel_address_space && kernel_address_space->vma_list) {
-        // Align down to page boundary
-        uintptr_t page_addr = PAGE_ALIGN_DOWN(addr);
+    // Slab objects live in identity-mapped slab pages and are never
+    // page-aligned (the header precedes them in the same page), so the
+    // header can be inspected without touching unmapped memory.
+    uintptr_t page_offset = addr & (PAGE_SIZE - 1);
+    if (kernel_address_space && identity_mapped &&
+        page_offset >= sizeof(slab_obj_t)) {
+        slab_obj_t *obj = ((slab_obj_t *)ptr) - 1;
         
-        // Find the VMA that contains this address
-        vma_t *vma = kernel_address_space->vma_list;
-        int iterations = 0;
-        while (vma && iterations < 1000) { // Safety limit
-            // Validate VMA magic
-            if (vma->magic != 0 && vma->magic != 0xDEADBEEF) {
-                serial_puts("ERROR: VMA corruption detected!\n");
-                return;
-            }
-            
-            if (page_addr >= vma->start_addr && page_addr < vma->end_addr) {
-                // Found the VMA, free all pages in this allocation
-                size_t num_pages = (vma->end_addr - vma->start_addr) / PAGE_SIZE;
-                bytes_freed += num_pages * PAGE_SIZE;
+        // Double-free: silently skip to avoid corrupting the free list
+        if (obj->magic_start == GUARD_MAGIC_FREED) {
+            return;
+        }
+        
+        if (obj->magic_start == GUARD_MAGIC_START) {
+            int index = slab_class_index(obj->size);
+            if (index >= 0 && slab_sizes[index] == obj->size) {
+                bytes_freed += obj->size;
                 total_frees++;
-                vmm_free_pages(kernel_address_space, vma->start_addr, num_pages);
+                slab_free(&kernel_address_space->slab_caches[index], ptr);
                 return;
             }
-            vma = vma->next;
-            iterations++;
-        }
-        
-        if (iterations >= 1000) {
-            serial_puts("ERROR: VMA list corrupted (infinite loop detected)\n");
+            serial_puts("ERROR: kfree - corrupted slab object size\n");
             return;
         }
     }
-
-    // Try to free from slab caches (only after VMA lookup to avoid reading
-    // before page-backed allocations where ptr-1 may be unmapped).
+    
+    // Not an object start: an aligned pointer into a slab object, whose
+    // tag sits in the same identity-mapped page
+    if (kernel_address_space && identity_mapped && page_offset >= sizeof(kmalloc_align_tag_t) &&
+        kfree_aligned_tag(ptr)) {
+        return;
+    }
+    
+    // For VMM-allocated memory, look up the owning VMA and free it
     if (kernel_address_space) {
-        // Check if this is a slab allocation by examining the header
-        slab_obj_t *obj = ((slab_obj_t *)ptr) - 1;
-        
-        // Validate header is accessible
-        if ((uintptr_t)obj < (uintptr_t)0x100000) {
-            serial_puts("ERROR: kfree - slab header pointer invalid\n");
-            return;
-        }
-        
-        // Check for double-free first
-        if (obj->magic_start == GUARD_MAGIC_FREED) {
-          //  serial_puts("ERROR: Double-free detected in slab allocator!\n");
-          //  char buf[16];
-          //  serial_puts("Address: 0x");
-          //  itoa(addr, buf, 16);
-          //  serial_puts(buf);
-          //  serial_puts("\n");
-          // Silently block double-free to avoid panicking during boot - just skip the free
-            return;
-        }
-        
-        // Verify if this looks like a slab object
-        if (obj->magic_start == GUARD_MAGIC_START) {
-            // Validate size is reasonable
-            if (obj->size == 0 || obj->size > SLAB_SIZE_2048) {
-                serial_puts("ERROR: kfree - corrupted slab object size\n");
+        vma_t *vma = vma_find(kernel_address_space, addr);
+        if (vma) {
+            // Validate VMA magic
+            if (vma->magic != 0 && vma->magic != VMA_MAGIC) {
+                serial_puts("ERROR: VMA corruption detected!\n");
                 return;
             }
             
-            // Find the appropriate cache
-            for (int i = 0; i < NUM_SLAB_CACHES; i++) {
-                if (obj->size == slab_sizes[i]) {
-                    // Mark as freed before actually freeing
-                    obj->magic_start = GUARD_MAGIC_FREED;
-                    
-                    slab_free(&kernel_address_space->slab_caches[i], ptr);
-                    
-                    bytes_freed += obj->size;
-                    total_frees++;
+            // Interior pointers can only come from kmalloc_aligned()
+            if (addr != vma->start_addr) {
+                if (addr >= vma->start_addr + sizeof(kmalloc_align_tag_t) &&
+                    kfree_aligned_tag(ptr)) {
                     return;
                 }
+                serial_puts("WARNING: kfree - interior pointer into page allocation\n");
+                return;
             }
             
-            // Restore if we couldn't find the cache
-            serial_puts("WARNING: kfree - slab object with unknown cache\n");
+            // Found the VMA, free all pages in this allocation
+            size_t num_pages = (vma->end_addr - vma->start_addr) / PAGE_SIZE;
+            bytes_freed += num_pages * PAGE_SIZE;
+            total_frees++;
+            vmm_free_pages(kernel_address_space, vma->start_addr, num_pages);
+            return;
         }
     }
-    
+
     // If we get here, the pointer is not tracked
     // Could be an early allocation or invalid pointer
     serial_puts("WARNING: kfree - untracked pointer: 0x");
@@ -868,6 +1223,31 @@ int vmm_unmap(address_space_t *as, uintptr_t virtual_addr, size_t size) {
         unmap_page(as->page_dir, vaddr);
     }
     
+    smp_tlb_shootdown(as);
+    return 0;
+}
+
+int vmm_protect(address_space_t *as, uintptr_t virtual_addr, size_t size, uint32_t flags) {
+    if (!as) return -1;
+    
+    virtual_addr = PAGE_ALIGN_DOWN(virtual_addr);
+    size_t num_pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    
+    for (size_t i = 0; i < num_pages; i++) {
+        uintptr_t vaddr = virtual_addr + (i * PAGE_SIZE);
+        set_page_flags(as->page_dir, vaddr, flags);
+    }
+    smp_tlb_shootdown(as);
+    
+    // Keep the flags of VMAs wholly inside the range in sync
+    uintptr_t end_addr = virtual_addr + (num_pages * PAGE_SIZE);
+    for (vma_t *vma = vma_find_intersection(as, virtual_addr, end_addr);
+         vma && vma->start_addr < end_addr; vma = vma->next) {
+        if (vma->start_addr >= virtual_addr && vma->end_addr <= end_addr) {
+            vma->flags = flags;
+        }
+    }
+    
     return 0;
 }
 
@@ -881,21 +1261,39 @@ uintptr_t vmm_virt_to_phys(address_space_t *as, uintptr_t virtual_addr) {
     return get_physical_address(as->page_dir, virtual_addr);
 }
 
+void vmm_get_usage(address_space_t *as, size_t *virtual_bytes, size_t *resident_bytes) {
+    /* Virtual size of user VMAs vs. pages actually backed by a private or
+     * COW-shared frame (zero-frame mappings are not resident). */
+    size_t virt = 0;
+    size_t resident = 0;
+    
+    if (as) {
+        for (vma_t *vma = as->vma_list; vma; vma = vma->next) {
+            if (!(vma->flags & PAGE_USER)) {
+                continue;
+            }
+            virt += vma->end_addr - vma->start_addr;
+            for (uintptr_t vaddr = vma->start_addr; vaddr < vma->end_addr; vaddr += PAGE_SIZE) {
+                uintptr_t phys = PAGE_ALIGN_DOWN(get_physical_address(as->page_dir, vaddr));
+                if (phys && phys != zero_frame) {
+                    resident += PAGE_SIZE;
+                }
+            }
+        }
+    }
+    
+    if (virtual_bytes) *virtual_bytes = virt;
+    if (resident_bytes) *resident_bytes = resident;
+}
+
 void vmm_print_stats(address_space_t *as) {
     if (!as) return;
     
     serial_puts("Address Space Statistics:\n");
     
-    int vma_count = 0;
-    vma_t *vma = as->vma_list;
-    while (vma) {
-        vma_count++;
-        vma = vma->next;
-    }
-    
     char buf[32];
     serial_puts("  VMAs: ");
-    itoa(vma_count, buf, 10);
+    itoa(as->vma_count, buf, 10);
     serial_puts(buf);
     serial_puts("\n");
     
@@ -936,11 +1334,10 @@ int vmm_check_guards(void *ptr) {
     
     uintptr_t addr = (uintptr_t)ptr;
     
-    // Check bump allocator guards
-    if (addr >= (uintptr_t)0x500000 && addr < (uintptr_t)0x700000) {
-        uint32_t *start_guard = (uint32_t *)(addr - sizeof(uint32_t));
-        if (*start_guard != GUARD_MAGIC_START) {
-            serial_puts("ERROR: Start guard corrupted at 0x");
+    // Check kernel heap block header
+    if (kheap_owns(ptr)) {
+        if (kheap_is_live_block(ptr) != 1) {
+            serial_puts("ERROR: Heap block header invalid at 0x");
             char buf[16];
             itoa((uint32_t)addr, buf, 16);
             serial_puts(buf);
@@ -953,6 +1350,7 @@ int vmm_check_guards(void *ptr) {
     // Check slab guards
     slab_obj_t *obj = ((slab_obj_t *)ptr) - 1;
     if (obj->magic_start == GUARD_MAGIC_START) {
+#if SLAB_DEBUG
         uint32_t *end_guard = (uint32_t *)((uint8_t *)ptr + obj->size);
         if (*end_guard != GUARD_MAGIC_END) {
             serial_puts("ERROR: End guard corrupted at 0x");
@@ -973,6 +1371,7 @@ int vmm_check_guards(void *ptr) {
             serial_puts("\n");
             return 0;
         }
+#endif
         return 1;
     }
     
@@ -1057,7 +1456,10 @@ void vmm_print_detailed_stats(void) {
                 itoa(cache->free_objects, buf, 10);
                 vga_puts(buf);
                 vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
-                vga_puts(" free) in ");
+                vga_puts(" free, ");
+                itoa(cache->cached_objects, buf, 10);
+                vga_puts(buf);
+                vga_puts(" in magazines) in ");
                 vga_set_color(VGA_ATTR(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
                 itoa(cache->total_slabs, buf, 10);
                 vga_puts(buf);
@@ -1068,25 +1470,27 @@ void vmm_print_detailed_stats(void) {
         }
     }
     
+    kheap_stats_t heap;
+    kheap_get_stats(&heap);
+    
     kprint("");
-    vga_puts("Kernel Heap: ");
+    vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+    kprint("Kernel Heap (free-list):");
+    vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    
+    vga_puts("  Used:          ");
     vga_set_color(VGA_ATTR(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
-    vga_puts("0x");
-    itoa(kernel_heap_ptr, buf, 16);
+    itoa(heap.used_bytes, buf, 10);
     vga_puts(buf);
     vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
     vga_puts(" / ");
     vga_set_color(VGA_ATTR(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
-    vga_puts("0x");
-    itoa(kernel_heap_end, buf, 16);
+    itoa(heap.total_bytes, buf, 10);
     vga_puts(buf);
     vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
     
-    uintptr_t heap_used = kernel_heap_ptr - (uintptr_t)0x500000;
-    uintptr_t heap_total = kernel_heap_end - (uintptr_t)0x500000;
-    uint32_t heap_pct = (heap_total != 0) ? (uint32_t)((heap_used * 100) / heap_total) : 0;
-    
-    vga_puts(" (");
+    uint32_t heap_pct = (heap.total_bytes >= 100) ? heap.used_bytes / (heap.total_bytes / 100) : 0;
+    vga_puts(" bytes (");
     if (heap_pct > 90) {
         vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
     } else if (heap_pct > 75) {
@@ -1100,6 +1504,45 @@ void vmm_print_detailed_stats(void) {
     vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
     kprint("");
     
+    vga_puts("  Blocks:        ");
+    vga_set_color(VGA_ATTR(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+    itoa(heap.used_blocks, buf, 10);
+    vga_puts(buf);
+    vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    vga_puts(" used, ");
+    vga_set_color(VGA_ATTR(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+    itoa(heap.free_blocks, buf, 10);
+    vga_puts(buf);
+    vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    vga_puts(" free (largest ");
+    vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+    itoa(heap.largest_free, buf, 10);
+    vga_puts(buf);
+    vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    vga_puts(" bytes)");
+    kprint("");
+    
+    vga_puts("  Allocs/Frees:  ");
+    vga_set_color(VGA_ATTR(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+    itoa(heap.alloc_count, buf, 10);
+    vga_puts(buf);
+    vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    vga_puts(" / ");
+    vga_set_color(VGA_ATTR(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+    itoa(heap.free_count, buf, 10);
+    vga_puts(buf);
+    vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    if (heap.failed_allocs > 0) {
+        vga_puts(" (");
+        vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        itoa(heap.failed_allocs, buf, 10);
+        vga_puts(buf);
+        vga_puts(" failed");
+        vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+        vga_puts(")");
+    }
+    kprint("");
+    
     kprint("");
     vga_set_color(VGA_ATTR(VGA_COLOR_DARK_GREY, VGA_COLOR_BLACK));
     kprint("===============================");
@@ -1116,28 +1559,8 @@ int vmm_validate_integrity(void) {
         return 1;
     }
     
-    // Check VMA list integrity
-    vma_t *vma = kernel_address_space->vma_list;
-    int vma_count = 0;
-    while (vma && vma_count < 1000) { // Prevent infinite loop
-        if (vma->start_addr >= vma->end_addr) {
-            serial_puts("ERROR: Invalid VMA range\n");
-            errors++;
-        }
-        
-        if (vma->magic != 0 && vma->magic != 0xDEADBEEF) {
-            serial_puts("ERROR: VMA magic corrupted\n");
-            errors++;
-        }
-        
-        vma = vma->next;
-        vma_count++;
-    }
-    
-    if (vma_count >= 1000) {
-        serial_puts("ERROR: VMA list appears to be circular\n");
-        errors++;
-    }
+    // Check VMA list and tree integrity
+    errors += vma_validate(kernel_address_space);
     
     // Validate slab caches
     for (int i = 0; i < NUM_SLAB_CACHES; i++) {
@@ -1150,6 +1573,26 @@ int vmm_validate_integrity(void) {
             serial_puts(" has more free objects than total\n");
             errors++;
         }
+        
+        // Objects parked in magazines must match the cache's accounting
+        if (cache->depot) {
+            uint32_t rounds = 0;
+            slab_depot_t *depot = cache->depot;
+            for (uint32_t cpu = 0; cpu < SLAB_MAX_CPUS; cpu++) {
+                rounds += depot->cpu[cpu].loaded->rounds + depot->cpu[cpu].previous->rounds;
+            }
+            for (uint32_t m = 0; m < depot->full_count; m++) {
+                rounds += depot->full[m]->rounds;
+            }
+            if (rounds != cache->cached_objects || rounds > cache->free_objects) {
+                serial_puts("ERROR: Slab cache ");
+                char buf[16];
+                itoa(cache->obj_size, buf, 10);
+                serial_puts(buf);
+                serial_puts(" magazine count mismatch\n");
+                errors++;
+            }
+        }
     }
     
     if (errors == 0) {
@@ -1192,6 +1635,7 @@ int vmm_validate_allocation(void *ptr) {
                 return 0;
             }
             
+#if SLAB_DEBUG
             // Check end guard
             uint32_t *end_guard = (uint32_t *)((uint8_t *)ptr + obj->size);
             if (*end_guard != GUARD_MAGIC_END) {
@@ -1205,6 +1649,7 @@ int vmm_validate_allocation(void *ptr) {
                 serial_puts("ERROR: Checksum mismatch\n");
                 return 0;
             }
+#endif
             
             return 1; // Valid slab allocation
         } else if (obj->magic_start == GUARD_MAGIC_FREED) {
@@ -1213,16 +1658,14 @@ int vmm_validate_allocation(void *ptr) {
         }
     }
     
-    // Check bump allocator range
-    if (addr >= (uintptr_t)0x500000 && addr < (uintptr_t)0x700000) {
-        uint32_t *start_guard = (uint32_t *)(addr - sizeof(uint32_t));
-        if ((uintptr_t)start_guard >= (uintptr_t)0x500000) {
-            if (*start_guard == GUARD_MAGIC_START) {
-                return 1; // Valid bump allocation
-            } else if (*start_guard == GUARD_MAGIC_FREED) {
-                serial_puts("ERROR: Use-after-free in bump allocator\n");
-                return 0;
-            }
+    // Check kernel heap range
+    if (kheap_owns(ptr)) {
+        int state = kheap_is_live_block(ptr);
+        if (state == 1) {
+            return 1; // Valid heap allocation
+        } else if (state == -1) {
+            serial_puts("ERROR: Use-after-free in kernel heap\n");
+            return 0;
         }
     }
     
@@ -1283,16 +1726,8 @@ int vmm_check_heap_consistency(void) {
     
     int errors = 0;
     
-    // Validate heap pointers
-    if (kernel_heap_ptr < (uintptr_t)0x500000 || kernel_heap_ptr > kernel_heap_end) {
-        serial_puts("ERROR: Kernel heap pointer out of range\n");
-        errors++;
-    }
-    
-    if (kernel_heap_end < kernel_heap_ptr || kernel_heap_end > (uintptr_t)0x700000) {
-        serial_puts("ERROR: Kernel heap end pointer invalid\n");
-        errors++;
-    }
+    // Walk heap blocks and free lists
+    errors += kheap_validate();
     
     // Validate allocation counters
     if (bytes_freed > bytes_allocated) {
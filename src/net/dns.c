@@ -21,6 +21,8 @@
 #include <stdlib.h>
 #include <serial.h>
 #include <arch/pit.h>
+#include <ktime.h>
+#include <smp.h>
 
 /*
  * DNS resolver subsystem.
@@ -69,7 +71,7 @@ static void dns_yield(void) {
     // HLT waits for next interrupt (timer tick, NIC interrupt, etc.)
     // This is critical - without it, we spin too fast for the NIC to process
     __asm__ volatile("sti");  // Ensure interrupts enabled
-    __asm__ volatile("hlt");  // Wait for interrupt
+    smp_wait_for_interrupt();  // Wait for interrupt
 }
 
 // Small delay with interrupt yielding
@@ -253,7 +255,7 @@ int dns_cache_add(const char* hostname, uint32_t ip_addr, uint32_t ttl) {
             if (strcmp(dns_cache[i].hostname, hostname) == 0) {
                 dns_cache[i].ip_addr = ip_addr;
                 dns_cache[i].ttl = ttl;
-                dns_cache[i].timestamp = get_tick_count();
+                dns_cache[i].timestamp = ktime_get_ms();
                 return 0;
             }
         } else if (free_slot < 0) {
@@ -277,7 +279,7 @@ int dns_cache_add(const char* hostname, uint32_t ip_addr, uint32_t ttl) {
         dns_cache[free_slot].hostname[sizeof(dns_cache[free_slot].hostname) - 1] = '\0';
         dns_cache[free_slot].ip_addr = ip_addr;
         dns_cache[free_slot].ttl = ttl;
-        dns_cache[free_slot].timestamp = get_tick_count();
+        dns_cache[free_slot].timestamp = ktime_get_ms();
         dns_cache[free_slot].valid = 1;
         return 0;
     }
@@ -290,12 +292,12 @@ int dns_cache_lookup(const char* hostname, uint32_t* ip_addr) {
         return -1;
     }
     
-    uint32_t current_time = get_tick_count();
+    uint32_t current_time = ktime_get_ms();
     
     for (int i = 0; i < DNS_CACHE_SIZE; i++) {
         if (dns_cache[i].valid && strcmp(dns_cache[i].hostname, hostname) == 0) {
-            uint32_t age_ticks = current_time - dns_cache[i].timestamp;
-            uint32_t age_secs = age_ticks / 1000;
+            uint32_t age_ms = current_time - dns_cache[i].timestamp;
+            uint32_t age_secs = age_ms / 1000;
             
             if (age_secs < dns_cache[i].ttl) {
                 *ip_addr = dns_cache[i].ip_addr;
@@ -575,10 +577,10 @@ int dns_resolve(const char* hostname, uint32_t* ip_addr) {
         uint32_t src_ip;
         uint16_t src_port;
         
-        uint32_t start_time = get_tick_count();
+        uint32_t start_time = ktime_get_ms();
         uint32_t poll_count = 0;
         
-        while ((get_tick_count() - start_time) < dns_config.timeout_ms) {
+        while ((ktime_get_ms() - start_time) < dns_config.timeout_ms) {
             // Yield and poll network for incoming packets
             dns_yield();
             dns_poll_network();
@@ -589,7 +591,7 @@ int dns_resolve(const char* hostname, uint32_t* ip_addr) {
             if (poll_count % 500 == 0) {
                 serial_puts("DNS: Still waiting (");
                 char tbuf[16];
-                itoa(get_tick_count() - start_time, tbuf, 10);
+                itoa(ktime_get_ms() - start_time, tbuf, 10);
                 serial_puts(tbuf);
                 serial_puts("ms elapsed)\n");
             }
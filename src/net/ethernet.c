@@ -32,48 +32,52 @@ int eth_receive(net_interface_t* iface, net_packet_t* packet) {
     eth_header_t* eth_hdr = (eth_header_t*)packet->data;
     uint16_t ethertype = ntohs(eth_hdr->ethertype);
     
-    // Create new packet for payload (skip Ethernet header)
-    net_packet_t payload_packet;
-    payload_packet.data = packet->data + ETH_HEADER_LEN;
-    payload_packet.len = packet->len - ETH_HEADER_LEN;
-    payload_packet.capacity = packet->capacity - ETH_HEADER_LEN;
+    // Strip the Ethernet header in place; the payload stays in the RX buffer
+    net_packet_pull(packet, ETH_HEADER_LEN);
     
     // Dispatch based on EtherType
     switch (ethertype) {
         case ETH_TYPE_ARP:
-            return arp_receive(iface, &payload_packet);
+            return arp_receive(iface, packet);
         case ETH_TYPE_IPV4:
-            return ipv4_receive(iface, &payload_packet);
+            return ipv4_receive(iface, packet);
         default:
             // Unknown protocol, drop packet
             return -1;
     }
 }
 
-int eth_transmit(net_interface_t* iface, const mac_addr_t* dest_mac,
-                 uint16_t ethertype, const uint8_t* payload, uint32_t payload_len) {
-    if (!iface || !dest_mac || !payload) {
+int eth_transmit_packet(net_interface_t* iface, const mac_addr_t* dest_mac,
+                        uint16_t ethertype, net_packet_t* packet) {
+    if (!iface || !dest_mac || !packet) {
         return -1;
     }
     
-    uint32_t total_len = ETH_HEADER_LEN + payload_len;
-    net_packet_t* packet = net_packet_alloc(total_len);
-    if (!packet) {
+    // Prepend the Ethernet header in the packet's headroom
+    eth_header_t* eth_hdr = (eth_header_t*)net_packet_push(packet, ETH_HEADER_LEN);
+    if (!eth_hdr) {
         return -1;
     }
-    
-    // Fill Ethernet header
-    eth_header_t* eth_hdr = (eth_header_t*)packet->data;
     mac_copy(&eth_hdr->dest, dest_mac);
     mac_copy(&eth_hdr->src, &iface->mac_addr);
     eth_hdr->ethertype = htons(ethertype);
     
-    // Copy payload
-    memcpy(packet->data + ETH_HEADER_LEN, payload, payload_len);
-    packet->len = total_len;
+    return net_transmit_packet(iface, packet);
+}
+
+int eth_transmit(net_interface_t* iface, const mac_addr_t* dest_mac,
+                 uint16_t ethertype, const uint8_t* payload, uint32_t payload_len) {
+    if (!iface || !dest_mac || !payload) {
+        return -1;
+    }
+    
+    net_packet_t* packet = net_packet_alloc(payload_len);
+    if (!packet) {
+        return -1;
+    }
+    memcpy(net_packet_put(packet, payload_len), payload, payload_len);
     
-    // Transmit packet
-    int ret = net_transmit_packet(iface, packet);
+    int ret = eth_transmit_packet(iface, dest_mac, ethertype, packet);
     
     net_packet_free(packet);
     return ret;
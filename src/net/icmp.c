@@ -111,10 +111,11 @@ int icmp_send_echo_request(uint32_t dest_ip, uint16_t id, uint16_t sequence,
     
     // Build ICMP packet
     uint32_t total_len = ICMP_HEADER_LEN + data_len;
-    uint8_t* packet_data = (uint8_t*)kmalloc(total_len);
-    if (!packet_data) {
+    net_packet_t* packet = net_packet_alloc(total_len);
+    if (!packet) {
         return -1;
     }
+    uint8_t* packet_data = net_packet_put(packet, total_len);
     
     icmp_header_t* icmp_hdr = (icmp_header_t*)packet_data;
     icmp_hdr->type = ICMP_TYPE_ECHO_REQUEST;
@@ -136,10 +137,7 @@ int icmp_send_echo_request(uint32_t dest_ip, uint16_t id, uint16_t sequence,
     ping_start_time = get_tick_count();
     
     // Send via IPv4
-    int ret = ipv4_send(iface, dest_ip, IP_PROTO_ICMP, packet_data, total_len);
-    
-    kfree(packet_data);
-    return ret;
+    return ipv4_send_packet(iface, dest_ip, IP_PROTO_ICMP, packet);
 }
 
 int icmp_send_echo_reply(net_interface_t* iface, uint32_t dest_ip,
@@ -147,10 +145,11 @@ int icmp_send_echo_reply(net_interface_t* iface, uint32_t dest_ip,
                          const uint8_t* data, uint32_t data_len) {
     // Build ICMP packet
     uint32_t total_len = ICMP_HEADER_LEN + data_len;
-    uint8_t* packet_data = (uint8_t*)kmalloc(total_len);
-    if (!packet_data) {
+    net_packet_t* packet = net_packet_alloc(total_len);
+    if (!packet) {
         return -1;
     }
+    uint8_t* packet_data = net_packet_put(packet, total_len);
     
     icmp_header_t* icmp_hdr = (icmp_header_t*)packet_data;
     icmp_hdr->type = ICMP_TYPE_ECHO_REPLY;
@@ -168,10 +167,7 @@ int icmp_send_echo_reply(net_interface_t* iface, uint32_t dest_ip,
     icmp_hdr->checksum = ipv4_checksum(packet_data, total_len);
     
     // Send via IPv4
-    int ret = ipv4_send(iface, dest_ip, IP_PROTO_ICMP, packet_data, total_len);
-    
-    kfree(packet_data);
-    return ret;
+    return ipv4_send_packet(iface, dest_ip, IP_PROTO_ICMP, packet);
 }
 
 void icmp_set_ping_callback(ping_callback_t callback) {
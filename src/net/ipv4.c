@@ -24,6 +24,7 @@
 #include <vmm.h>
 #include <serial.h>
 #include <arch/pit.h>
+#include <smp.h>
 
 /*
  * IPv4 network layer.
@@ -46,8 +47,7 @@ static uint16_t ip_id_counter = 1;
 #define ARP_RESOLVE_RETRY_INTERVAL_MS 500
 
 typedef struct {
-    uint8_t* data;              // Packet data
-    uint32_t len;               // Packet length
+    net_packet_t* packet;       // IPv4 datagram; the queue owns this reference
     uint32_t dest_ip;           // Destination IP
     uint32_t gateway_ip;        // Gateway to resolve (may differ from dest)
     net_interface_t* iface;     // Interface to send on
@@ -110,23 +110,23 @@ int ipv4_receive(net_interface_t* iface, net_packet_t* packet) {
     uint8_t ihl = (ip_hdr->version_ihl & 0x0F) * 4;
     uint16_t total_len = ntohs(ip_hdr->total_len);
     
-    if (total_len > packet->len || ihl > total_len) {
+    if (total_len > packet->len || ihl < IPV4_HEADER_LEN || ihl > total_len) {
         return -1;
     }
     
-    net_packet_t payload_packet;
-    payload_packet.data = packet->data + ihl;
-    payload_packet.len = total_len - ihl;
-    payload_packet.capacity = packet->capacity - ihl;
+    // Drop link-layer padding, then strip the header in place
+    uint8_t protocol = ip_hdr->protocol;
+    packet->len = total_len;
+    net_packet_pull(packet, ihl);
     
     // Dispatch based on protocol
-    switch (ip_hdr->protocol) {
+    switch (protocol) {
         case IP_PROTO_ICMP:
-            return icmp_receive(iface, src_ip, &payload_packet);
+            return icmp_receive(iface, src_ip, packet);
         case IP_PROTO_TCP:
-            return tcp_receive(iface, src_ip, dest_ip, &payload_packet);
+            return tcp_receive(iface, src_ip, dest_ip, packet);
         case IP_PROTO_UDP:
-            return udp_receive(iface, src_ip, dest_ip, &payload_packet);
+            return udp_receive(iface, src_ip, dest_ip, packet);
         default:
             return -1;
     }
@@ -137,42 +137,26 @@ int ipv4_receive(net_interface_t* iface, net_packet_t* packet) {
 
 
 // Internal: Actually send the packet (MAC already resolved)
-static int ipv4_send_internal(net_interface_t* iface, uint32_t dest_ip,
-                               const mac_addr_t* dest_mac, 
-                               const uint8_t* packet_data, uint32_t total_len) {
-    /* Send fully prepared IPv4 frame once destination MAC is known. */
-    (void)dest_ip;
-    int ret;
-    
+static int ipv4_send_internal(net_interface_t* iface, const mac_addr_t* dest_mac,
+                               net_packet_t* packet) {
+    /* Send fully prepared IPv4 datagram once destination MAC is known. */
     if (iface->flags & IFF_LOOPBACK) {
-        net_packet_t packet;
-        packet.data = (uint8_t*)packet_data;
-        packet.len = total_len;
-        packet.capacity = total_len;
-        ret = net_transmit_packet(iface, &packet);
-    } else {
-        ret = eth_transmit(iface, dest_mac, ETH_TYPE_IPV4, packet_data, total_len);
+        return net_transmit_packet(iface, packet);
     }
-    
-    return ret;
+    return eth_transmit_packet(iface, dest_mac, ETH_TYPE_IPV4, packet);
 }
 
 // Queue a packet for later transmission after ARP resolves
 static int ipv4_queue_packet(net_interface_t* iface, uint32_t dest_ip, 
-                              uint32_t gateway_ip, const uint8_t* data, uint32_t len) {
+                              uint32_t gateway_ip, net_packet_t* packet) {
     /* Queue outbound packet while awaiting ARP resolution for next hop. */
     // Find free slot
     for (int i = 0; i < MAX_PENDING_PACKETS; i++) {
         if (!pending_packets[i].valid) {
             pending_packet_t* pp = &pending_packets[i];
             
-            pp->data = (uint8_t*)kmalloc(len);
-            if (!pp->data) {
-                return -1;
-            }
-            
-            memcpy(pp->data, data, len);
-            pp->len = len;
+            // The datagram is parked as is; no copy
+            pp->packet = net_packet_get(packet);
             pp->dest_ip = dest_ip;
             pp->gateway_ip = gateway_ip;
             pp->iface = iface;
@@ -202,7 +186,8 @@ void ipv4_process_pending(void) {
         // Check timeout
         if (now - pp->timestamp > ARP_RESOLVE_TIMEOUT_MS) {
             // Timed out, drop packet
-            kfree(pp->data);
+            net_packet_free(pp->packet);
+            pp->packet = NULL;
             pp->valid = 0;
             continue;
         }
@@ -211,8 +196,9 @@ void ipv4_process_pending(void) {
         mac_addr_t dest_mac;
         if (arp_cache_lookup(pp->gateway_ip, &dest_mac) == 0) {
             // MAC resolved! Send the packet
-            ipv4_send_internal(pp->iface, pp->dest_ip, &dest_mac, pp->data, pp->len);
-            kfree(pp->data);
+            ipv4_send_internal(pp->iface, &dest_mac, pp->packet);
+            net_packet_free(pp->packet);
+            pp->packet = NULL;
             pp->valid = 0;
         } else {
             // Not resolved yet, send another ARP request if interval passed
@@ -225,9 +211,10 @@ void ipv4_process_pending(void) {
 }
 
 // Public send function with automatic ARP resolution
-int ipv4_send(net_interface_t* iface, uint32_t dest_ip, uint8_t protocol,
-              const uint8_t* payload, uint32_t payload_len) {
-    if (!iface || !payload) {
+int ipv4_send_packet(net_interface_t* iface, uint32_t dest_ip, uint8_t protocol,
+                     net_packet_t* packet) {
+    if (!iface || !packet) {
+        net_packet_free(packet);
         return -1;
     }
     
@@ -239,17 +226,15 @@ int ipv4_send(net_interface_t* iface, uint32_t dest_ip, uint8_t protocol,
         }
     }
     
-    // Allocate packet buffer
-    uint32_t total_len = IPV4_HEADER_LEN + payload_len;
-    uint8_t* packet_data = (uint8_t*)kmalloc(total_len);
-    if (!packet_data) {
+    // Build the IPv4 header in front of the payload
+    ipv4_header_t* ip_hdr = (ipv4_header_t*)net_packet_push(packet, IPV4_HEADER_LEN);
+    if (!ip_hdr) {
+        net_packet_free(packet);
         return -1;
     }
-    
-    // Build IPv4 header
-    ipv4_header_t* ip_hdr = (ipv4_header_t*)packet_data;
     memset(ip_hdr, 0, IPV4_HEADER_LEN);
     
+    uint32_t total_len = packet->len;
     ip_hdr->version_ihl = (IPV4_VERSION << 4) | 5;
     ip_hdr->tos = 0;
     uint16_t current_id = ip_id_counter++;
@@ -265,26 +250,19 @@ int ipv4_send(net_interface_t* iface, uint32_t dest_ip, uint8_t protocol,
     ip_hdr->checksum = 0;
     ip_hdr->checksum = ipv4_checksum(ip_hdr, IPV4_HEADER_LEN);
     
-    // Copy payload
-    memcpy(packet_data + IPV4_HEADER_LEN, payload, payload_len);
-    
     int ret = -1;
     
     // Route and send packet
     if (iface->flags & IFF_LOOPBACK) {
         // Loopback: send directly
-        net_packet_t packet;
-        packet.data = packet_data;
-        packet.len = total_len;
-        packet.capacity = total_len;
-        ret = net_transmit_packet(iface, &packet);
+        ret = net_transmit_packet(iface, packet);
     } else {
         mac_addr_t dest_mac;
         
         // Check if destination is broadcast
         if (dest_ip == 0xFFFFFFFF || dest_ip == (iface->ip_addr | ~iface->netmask)) {
             memset(&dest_mac, 0xFF, sizeof(mac_addr_t));
-            ret = eth_transmit(iface, &dest_mac, ETH_TYPE_IPV4, packet_data, total_len);
+            ret = eth_transmit_packet(iface, &dest_mac, ETH_TYPE_IPV4, packet);
         } else {
             // Determine next-hop (gateway or direct)
             uint32_t gateway_ip = dest_ip;
@@ -296,10 +274,10 @@ int ipv4_send(net_interface_t* iface, uint32_t dest_ip, uint8_t protocol,
             
             if (arp_cache_lookup(gateway_ip, &dest_mac) == 0) {
                 // MAC found in cache
-                ret = eth_transmit(iface, &dest_mac, ETH_TYPE_IPV4, packet_data, total_len);
+                ret = eth_transmit_packet(iface, &dest_mac, ETH_TYPE_IPV4, packet);
             } else {
                 // Queue packet and initiate ARP resolution
-                if (ipv4_queue_packet(iface, dest_ip, gateway_ip, packet_data, total_len) == 0) {
+                if (ipv4_queue_packet(iface, dest_ip, gateway_ip, packet) == 0) {
                     arp_send_request(iface, gateway_ip);
                     ret = 0;  // Queued successfully (will be sent when ARP resolves)
                 } else {
@@ -309,10 +287,25 @@ int ipv4_send(net_interface_t* iface, uint32_t dest_ip, uint8_t protocol,
         }
     }
     
-    kfree(packet_data);
+    net_packet_free(packet);
     return ret;
 }
 
+int ipv4_send(net_interface_t* iface, uint32_t dest_ip, uint8_t protocol,
+              const uint8_t* payload, uint32_t payload_len) {
+    if (!iface || !payload) {
+        return -1;
+    }
+    
+    net_packet_t* packet = net_packet_alloc(payload_len);
+    if (!packet) {
+        return -1;
+    }
+    memcpy(net_packet_put(packet, payload_len), payload, payload_len);
+    
+    return ipv4_send_packet(iface, dest_ip, protocol, packet);
+}
+
 
 // Blocking ARP Resolution
 
@@ -343,7 +336,7 @@ int ipv4_resolve_arp(net_interface_t* iface, uint32_t ip, mac_addr_t* mac,
     while ((get_tick_count() - start) < timeout_ms) {
         // Yield to allow interrupts (critical for packet reception)
         __asm__ volatile("sti");
-        __asm__ volatile("hlt");
+        smp_wait_for_interrupt();
         
         // Poll network for incoming packets
         net_poll();
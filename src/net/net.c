@@ -10,11 +10,16 @@
 
 #include <net/net.h>
 #include <net/ipv4.h>
+#include <net/tcp.h>
 #include <string.h>
 #include <stdlib.h>
 #include <vmm.h>
 #include <serial.h>
 #include <panic.h>
+#include <process.h>
+#include <arch.h>
+#include <smp.h>
+#include <ktime.h>
 
 /*
  * Core networking runtime state.
@@ -31,6 +36,20 @@ static int net_interface_count_val = 0;
 // IP address string buffer (for ip_to_string)
 static char ip_string_buffer[16];
 
+// Packet buffer pool
+static net_packet_t net_pool_packets[NET_PACKET_POOL_SIZE];
+static uint8_t net_pool_bufs[NET_PACKET_POOL_SIZE][NET_PACKET_BUF_SIZE] __attribute__((aligned(64)));
+static net_packet_t* net_pool_free = NULL;
+static net_packet_stats_t net_packet_stats;
+
+// Receive bottom half
+static net_napi_t* net_napi_list = NULL;
+static wait_queue_t net_rx_wait;            // The netrx thread sleeps here
+static wait_queue_t net_waiters;            // Tasks blocked in net_wait()
+static volatile uint32_t net_rx_pending = 0;
+static volatile uint32_t net_rx_running = 0;
+static pid_t net_rx_pid = 0;
+
 void net_init(void) {
     /*
      * Reset in-memory network state for cold boot.
@@ -42,6 +61,20 @@ void net_init(void) {
     for (int i = 0; i < MAX_NET_INTERFACES; i++) {
         net_interfaces[i] = NULL;
     }
+    wait_queue_init(&net_rx_wait);
+    wait_queue_init(&net_waiters);
+    
+    // Thread the packet pool onto its free list
+    net_pool_free = NULL;
+    for (int i = NET_PACKET_POOL_SIZE - 1; i >= 0; i--) {
+        net_pool_packets[i].head = net_pool_bufs[i];
+        net_pool_packets[i].flags = NET_PACKET_F_POOL;
+        net_pool_packets[i].next = net_pool_free;
+        net_pool_free = &net_pool_packets[i];
+    }
+    memset(&net_packet_stats, 0, sizeof(net_packet_stats));
+    net_packet_stats.pool_size = NET_PACKET_POOL_SIZE;
+    net_packet_stats.pool_free = NET_PACKET_POOL_SIZE;
     
     serial_puts("Network subsystem initialized.\n");
 }
@@ -138,28 +171,84 @@ int net_interface_set_ip(net_interface_t* iface, uint32_t ip, uint32_t netmask)
 }
 
 net_packet_t* net_packet_alloc(uint32_t size) {
-    net_packet_t* packet = (net_packet_t*)kmalloc(sizeof(net_packet_t));
-    if (!packet) return NULL;
+    net_packet_t* packet = NULL;
+    
+    if (size <= NET_PACKET_BUF_SIZE - NET_PACKET_HEADROOM) {
+        uintptr_t irq = arch_irq_save();
+        packet = net_pool_free;
+        if (packet) {
+            net_pool_free = packet->next;
+            net_packet_stats.pool_free--;
+        }
+        net_packet_stats.allocs++;
+        arch_irq_restore(irq);
+    }
     
-    packet->data = (uint8_t*)kmalloc(size);
-    if (!packet->data) {
-        kfree(packet);
-        return NULL;
+    if (packet) {
+        packet->data = packet->head;
+        packet->capacity = NET_PACKET_BUF_SIZE;
+    } else {
+        // Oversized, or the pool ran dry
+        packet = (net_packet_t*)kmalloc(sizeof(net_packet_t));
+        if (!packet) return NULL;
+        
+        packet->head = (uint8_t*)kmalloc(NET_PACKET_HEADROOM + size);
+        if (!packet->head) {
+            kfree(packet);
+            return NULL;
+        }
+        packet->data = packet->head;
+        packet->capacity = NET_PACKET_HEADROOM + size;
+        packet->flags = 0;
+        net_packet_stats.heap_allocs++;
     }
     
     packet->len = 0;
-    packet->capacity = size;
+    packet->refcount = 1;
+    packet->next = NULL;
+    net_packet_reserve(packet, NET_PACKET_HEADROOM);
     
     return packet;
 }
 
+net_packet_t* net_packet_get(net_packet_t* packet) {
+    if (packet && !(packet->flags & NET_PACKET_F_BORROWED)) {
+        uintptr_t irq = arch_irq_save();
+        packet->refcount++;
+        arch_irq_restore(irq);
+    }
+    return packet;
+}
+
 void net_packet_free(net_packet_t* packet) {
-    if (packet) {
-        if (packet->data) {
-            kfree(packet->data);
-        }
-        kfree(packet);
+    if (!packet || (packet->flags & NET_PACKET_F_BORROWED)) {
+        return;
     }
+    
+    uintptr_t irq = arch_irq_save();
+    if (packet->refcount == 0 || --packet->refcount != 0) {
+        arch_irq_restore(irq);
+        return;
+    }
+    if (packet->flags & NET_PACKET_F_POOL) {
+        packet->next = net_pool_free;
+        net_pool_free = packet;
+        net_packet_stats.pool_free++;
+        arch_irq_restore(irq);
+        return;
+    }
+    arch_irq_restore(irq);
+    
+    kfree(packet->head);
+    kfree(packet);
+}
+
+void net_packet_get_stats(net_packet_stats_t* stats) {
+    if (!stats) return;
+    
+    uintptr_t irq = arch_irq_save();
+    *stats = net_packet_stats;
+    arch_irq_restore(irq);
 }
 
 int net_transmit_packet(net_interface_t* iface, net_packet_t* packet) {
@@ -255,21 +344,149 @@ uint32_t string_to_ip(const char* str) {
     return ip;
 }
 
+void net_napi_add(net_napi_t* napi) {
+    if (!napi) return;
+
+    uintptr_t irq = arch_irq_save();
+    napi->scheduled = 0;
+    napi->next = net_napi_list;
+    net_napi_list = napi;
+    arch_irq_restore(irq);
+}
+
+void net_napi_schedule(net_napi_t* napi) {
+    if (!napi) return;
+
+    napi->scheduled = 1;
+    net_rx_pending = 1;
+    wait_queue_wake_all(&net_rx_wait);
+}
+
+void net_rx_kick(void) {
+    for (net_napi_t* napi = net_napi_list; napi; napi = napi->next) {
+        napi->scheduled = 1;
+    }
+    if (net_rx_pid > 0) {
+        net_rx_pending = 1;
+        wait_queue_wake_all(&net_rx_wait);
+    }
+}
+
+static int net_rx_action(void) {
+    /*
+     * One bottom-half round: give every scheduled ring up to a budget of
+     * packets. Returns non-zero when a ring is still in poll mode.
+     */
+    uintptr_t irq = arch_irq_save();
+    if (net_rx_running) {
+        arch_irq_restore(irq);
+        return 0;  // Re-entered from a protocol handler's polling loop
+    }
+    net_rx_running = 1;
+    arch_irq_restore(irq);
+
+    // The budget bounds how long other tasks wait on this non-preemptible round
+    process_set_preempt_disabled(1);
+
+    int again = 0;
+    uint32_t handled = 0;
+    for (net_napi_t* napi = net_napi_list; napi; napi = napi->next) {
+        if (!napi->scheduled) {
+            continue;
+        }
+
+        int done = napi->poll(napi, NET_NAPI_BUDGET);
+        napi->polls++;
+        napi->packets += (uint32_t)done;
+        handled += (uint32_t)done;
+
+        if (done >= NET_NAPI_BUDGET) {
+            napi->budget_exhausted++;
+            again = 1;  // Stay polled with the interrupt masked
+            continue;
+        }
+
+        // Clear before unmasking: a new interrupt must be able to reschedule
+        napi->scheduled = 0;
+        if (napi->irq_enable && napi->irq_enable(napi)) {
+            napi->scheduled = 1;
+            again = 1;
+        }
+    }
+
+    // Packets queued behind ARP resolution go out once replies are in
+    ipv4_process_pending();
+
+    // Every round doubles as the TCP timer tick (at least each kick, ~100ms)
+    tcp_timer();
+
+    net_rx_running = 0;
+    process_set_preempt_disabled(0);
+
+    if (handled) {
+        wait_queue_wake_all(&net_waiters);
+    }
+    return again;
+}
+
+static void net_rx_thread(void) {
+    for (;;) {
+        wait_queue_wait(&net_rx_wait, &net_rx_pending, 0);
+        net_rx_pending = 0;
+
+        if (net_rx_action()) {
+            // Busy rings: let other tasks run between rounds
+            net_rx_pending = 1;
+            process_yield();
+        }
+    }
+}
+
+int net_start_rx_thread(void) {
+    if (net_rx_pid > 0) {
+        return net_rx_pid;
+    }
+
+    // Rings scheduled by interrupts before now are drained on the first round
+    net_rx_pending = 1;
+    pid_t pid = process_create_kernel_thread("netrx", net_rx_thread, PRIORITY_NORMAL);
+    if (pid < 0) {
+        serial_puts("NET: failed to start receive thread\n");
+        return -1;
+    }
+    net_rx_pid = pid;
+    return pid;
+}
+
+int net_wait(volatile uint32_t* cond, uint32_t timeout_ms) {
+    if (!cond) return -1;
+    if (*cond) return 0;
+
+    if (net_rx_pid > 0 && process_can_block()) {
+        return wait_queue_wait(&net_waiters, cond, timeout_ms);
+    }
+
+    // Nothing would wake us: drive the rings from here until the next interrupt
+    uint32_t start = ktime_get_ms();
+    while (!*cond) {
+        __asm__ volatile("sti");
+        smp_wait_for_interrupt();
+        net_poll();
+        if (timeout_ms && (ktime_get_ms() - start) >= timeout_ms) {
+            break;
+        }
+    }
+    return *cond ? 0 : -1;
+}
+
 // Network polling - call this regularly to process incoming packets
 void net_poll(void) {
     /*
-     * Cooperative polling loop used when interrupt-driven networking is not
-     * yet fully wired or when running in simplified emulation setups.
+     * Inline receive for callers the bottom half cannot serve: boot code
+     * before the netrx thread exists and loops running with interrupts off.
      */
-    // Poll hardware for incoming packets (all active NIC drivers)
-    extern void e1000_handle_interrupt(void);
-    extern void pcnet_handle_interrupt(void);
-    extern void virtio_net_handle_interrupt(void);
-    
-    e1000_handle_interrupt();
-    pcnet_handle_interrupt();
-    virtio_net_handle_interrupt();
-    
-    // Process pending ARP resolutions
-    ipv4_process_pending();
+    for (net_napi_t* napi = net_napi_list; napi; napi = napi->next) {
+        napi->scheduled = 1;
+    }
+    net_rx_action();
 }
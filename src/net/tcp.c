@@ -14,6 +14,7 @@
  */
 
 #include <net/tcp.h>
+#include <net/tcp_cong.h>
 #include <net/ipv4.h>
 #include <net/net.h>
 #include <string.h>
@@ -21,20 +22,78 @@
 #include <vmm.h>
 #include <serial.h>
 #include <arch/pit.h>
+#include <ktime.h>
+#include <process.h>
 
 /*
  * TCP transport layer.
  *
  * Implements socket table management, connection state transitions, segment
  * checksum handling, retransmission timing, and RX/TX buffering semantics.
+ *
+ * Sent data stays in the socket's send ring until acknowledged. tcp_output()
+ * cuts MSS-sized segments from it as far as both the peer's window and the
+ * congestion window allow. Three duplicate ACKs start NewReno fast recovery;
+ * when the RFC 6298 timeout expires instead, tcp_timer() collapses cwnd and
+ * resends from SND.UNA (go-back-N). The growth policy comes from the
+ * socket's pluggable congestion-control algorithm (tcp_cong.h). The receive
+ * path and timer run in the netrx bottom half; socket calls from process
+ * context disable preemption around any change to the shared send state.
+ *
+ * The handshake negotiates MSS, window scaling, SACK and timestamps. Data
+ * arriving past a hole is stored in the receive ring at its final offset
+ * and reported back in SACK blocks; the sender uses those to resend only
+ * the holes during recovery. The receive ring starts small and doubles,
+ * up to tcp_rmem_max, while the reader keeps draining it faster than one
+ * buffer per round trip.
  */
 
 #define MAX_TCP_SOCKETS 32
 #define TCP_RX_BUFFER_SIZE 16384
-#define TCP_TX_BUFFER_SIZE 4096
+#define TCP_TX_BUFFER_SIZE 32768
 #define TCP_CONNECT_TIMEOUT_MS 10000
-#define TCP_RETRANSMIT_TIMEOUT_MS 1000
-#define TCP_MAX_RETRANSMITS 5
+#define TCP_MAX_RETRANSMITS 8
+#define TCP_MSS_DEFAULT 536             // RFC 1122 default without a better route MTU
+#define TCP_MSS_MAX 1460                // One segment per packet-pool buffer
+#define TCP_MSS_MIN 88                  // Floor for a peer-announced MSS
+#define TCP_RTO_INITIAL_MS 1000
+#define TCP_RTO_MIN_MS 200
+#define TCP_RTO_MAX_MS 60000
+#define TCP_TIMER_GRANULARITY_MS 100    // The bottom half runs the timer every kick
+#define TCP_DUPACK_THRESHOLD 3
+#define TCP_LINGER_MS 4000              // Orphaned FIN_WAIT_2/TIME_WAIT lifetime
+#define TCP_WAIT_SLICE_MS 100           // Longest sleep between timeout checks
+#define TCP_RMEM_MAX_DEFAULT 262144     // Autotuning ceiling for the receive ring
+#define TCP_RMEM_CEILING (4U * 1024 * 1024)
+#define TCP_RCV_ROUND_MIN_MS 10         // Shortest autotuning measurement round
+#define TCP_MAX_WSCALE 14               // RFC 7323 2.3
+
+// TCP option kinds and lengths
+#define TCP_OPT_EOL 0
+#define TCP_OPT_NOP 1
+#define TCP_OPT_MSS 2
+#define TCP_OPT_WSCALE 3
+#define TCP_OPT_SACK_PERM 4
+#define TCP_OPT_SACK 5
+#define TCP_OPT_TIMESTAMP 8
+#define TCP_OPT_MAX_LEN 40
+#define TCP_OPTLEN_TIMESTAMP 12         // NOP, NOP, kind, len, TSval, TSecr
+#define TCP_OPT_MAX_SACK_BLOCKS 4
+#define TCP_WSCALE_NONE 0xFF
+
+// Options parsed from one incoming segment
+typedef struct {
+    uint16_t mss;                       // 0 when absent
+    uint8_t wscale;                     // TCP_WSCALE_NONE when absent
+    uint8_t sack_ok;
+    uint8_t ts_present;
+    uint8_t sack_count;
+    uint32_t tsval;
+    uint32_t tsecr;
+    tcp_seq_range_t sack[TCP_OPT_MAX_SACK_BLOCKS];
+} tcp_options_t;
+
+static uint32_t tcp_rmem_max = TCP_RMEM_MAX_DEFAULT;
 
 // TCP socket table
 static tcp_socket_t tcp_sockets[MAX_TCP_SOCKETS];
@@ -193,6 +252,8 @@ void tcp_init(void) {
     /* Initialize TCP socket table and put all sockets in CLOSED state. */
     serial_puts("Initializing TCP...\n");
     
+    tcp_cong_init();
+    
     memset(tcp_sockets, 0, sizeof(tcp_sockets));
     memset(accept_queues, 0, sizeof(accept_queues));
     
@@ -243,55 +304,64 @@ static tcp_socket_t* tcp_find_socket(uint16_t local_port, uint32_t remote_ip,
 // Receive Buffer Management
 
 
-static int tcp_rx_buffer_write(tcp_socket_t* sock, const uint8_t* data, uint32_t len) {
-    /* Append payload bytes into circular receive buffer with bounds checks. */
-    if (!sock || !data || len == 0) {
-        return -1;
+static int tcp_rx_buffer_alloc(tcp_socket_t* sock) {
+    if (sock->rx_buffer) {
+        return 0;
     }
-    
-    // Validate length is reasonable
-    if (len > TCP_RX_BUFFER_SIZE) {
-        serial_puts("TCP: Excessive data length, truncating\n");
-        len = TCP_RX_BUFFER_SIZE;
+    sock->rx_buffer = (uint8_t*)kmalloc(TCP_RX_BUFFER_SIZE);
+    if (!sock->rx_buffer) {
+        return -1;
     }
-    
+    sock->rx_head = 0;
+    sock->rx_tail = 0;
+    sock->rx_size = TCP_RX_BUFFER_SIZE;
+    return 0;
+}
+
+static uint32_t tcp_rx_buffer_available(tcp_socket_t* sock) {
     if (!sock->rx_buffer) {
-        sock->rx_buffer = (uint8_t*)kmalloc(TCP_RX_BUFFER_SIZE);
-        if (!sock->rx_buffer) {
-            return -1;
-        }
-        sock->rx_head = 0;
-        sock->rx_tail = 0;
-        sock->rx_size = TCP_RX_BUFFER_SIZE;
+        return 0;
     }
-    
-    uint32_t available = (sock->rx_head - sock->rx_tail - 1 + sock->rx_size) % sock->rx_size;
-    if (available == 0) available = sock->rx_size - 1;
-    
-    if (len > available) {
-        len = available;
+    return (sock->rx_tail - sock->rx_head + sock->rx_size) % sock->rx_size;
+}
+
+static uint32_t tcp_rx_buffer_store(tcp_socket_t* sock, uint32_t offset,
+                                    const uint8_t* data, uint32_t len) {
+    /*
+     * Copy payload offset bytes past the ring's tail, clipped to the free
+     * space. The tail only moves once the bytes before it are in place.
+     */
+    uint32_t space = sock->rx_size - 1 - tcp_rx_buffer_available(sock);
+    if (offset >= space) {
+        return 0;
     }
-    
-    for (uint32_t i = 0; i < len; i++) {
-        sock->rx_buffer[sock->rx_tail] = data[i];
-        sock->rx_tail = (sock->rx_tail + 1) % sock->rx_size;
+    if (len > space - offset) {
+        len = space - offset;
     }
     
+    uint32_t pos = (sock->rx_tail + offset) % sock->rx_size;
+    uint32_t first = sock->rx_size - pos;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(sock->rx_buffer + pos, data, first);
+    memcpy(sock->rx_buffer, data + first, len - first);
     return len;
 }
 
+static void tcp_rx_buffer_advance(tcp_socket_t* sock, uint32_t len) {
+    /* Make len stored bytes at RCV.NXT readable. */
+    sock->rx_tail = (sock->rx_tail + len) % sock->rx_size;
+    sock->ack_num += len;
+}
+
 static int tcp_rx_buffer_read(tcp_socket_t* sock, uint8_t* buffer, uint32_t len) {
     /* Drain payload bytes from circular receive buffer into caller buffer. */
     if (!sock || !buffer || len == 0) {
         return 0;
     }
     
-    if (!sock->rx_buffer) {
-        return 0;
-    }
-    
-    uint32_t available = (sock->rx_tail - sock->rx_head + sock->rx_size) % sock->rx_size;
-    
+    uint32_t available = tcp_rx_buffer_available(sock);
     if (available == 0) {
         return 0;
     }
@@ -300,48 +370,275 @@ static int tcp_rx_buffer_read(tcp_socket_t* sock, uint8_t* buffer, uint32_t len)
         len = available;
     }
     
-    for (uint32_t i = 0; i < len; i++) {
-        buffer[i] = sock->rx_buffer[sock->rx_head];
-        sock->rx_head = (sock->rx_head + 1) % sock->rx_size;
+    uint32_t first = sock->rx_size - sock->rx_head;
+    if (first > len) {
+        first = len;
     }
+    memcpy(buffer, sock->rx_buffer + sock->rx_head, first);
+    memcpy(buffer + first, sock->rx_buffer, len - first);
+    sock->rx_head = (sock->rx_head + len) % sock->rx_size;
     
     return len;
 }
 
-static uint32_t tcp_rx_buffer_available(tcp_socket_t* sock) {
+static void tcp_rx_buffer_grow(tcp_socket_t* sock, uint32_t size) {
+    /* Move the ring into a larger buffer, keeping unread and out-of-order data. */
+    uint8_t* buffer = (uint8_t*)kmalloc(size);
+    if (!buffer) {
+        return;     // Keep going at the current size
+    }
+    
+    uint32_t used = tcp_rx_buffer_available(sock);
+    uint32_t keep = used;
+    if (sock->ooo_count > 0) {
+        keep += sock->ooo[sock->ooo_count - 1].end - sock->ack_num;
+    }
+    uint32_t first = sock->rx_size - sock->rx_head;
+    if (first > keep) {
+        first = keep;
+    }
+    memcpy(buffer, sock->rx_buffer + sock->rx_head, first);
+    memcpy(buffer + first, sock->rx_buffer, keep - first);
+    
+    kfree(sock->rx_buffer);
+    sock->rx_buffer = buffer;
+    sock->rx_size = size;
+    sock->rx_head = 0;
+    sock->rx_tail = used;
+}
+
+static uint32_t tcp_rx_window(tcp_socket_t* sock) {
+    /* Free receive-buffer space: the peer may send this much beyond RCV.NXT. */
     if (!sock->rx_buffer) {
+        return TCP_RX_BUFFER_SIZE - 1;
+    }
+    return sock->rx_size - 1 - tcp_rx_buffer_available(sock);
+}
+
+
+// Sequence Range Sets
+
+
+static int tcp_range_add(tcp_seq_range_t* ranges, uint8_t* count, uint32_t max,
+                         uint32_t start, uint32_t end) {
+    /* Insert [start, end) into a sorted, disjoint set, merging neighbours. */
+    uint32_t i = 0;
+    while (i < *count && TCP_SEQ_LT(ranges[i].end, start)) {
+        i++;
+    }
+    
+    if (i == *count || TCP_SEQ_LT(end, ranges[i].start)) {
+        if (*count >= max) {
+            return -1;
+        }
+        memmove(&ranges[i + 1], &ranges[i], (*count - i) * sizeof(*ranges));
+        ranges[i].start = start;
+        ranges[i].end = end;
+        (*count)++;
         return 0;
     }
-    return (sock->rx_tail - sock->rx_head + sock->rx_size) % sock->rx_size;
+    
+    // Overlaps or touches ranges[i]: widen it, then absorb what it now reaches
+    if (TCP_SEQ_LT(start, ranges[i].start)) {
+        ranges[i].start = start;
+    }
+    if (TCP_SEQ_GT(end, ranges[i].end)) {
+        ranges[i].end = end;
+    }
+    while (i + 1 < *count && TCP_SEQ_LEQ(ranges[i + 1].start, ranges[i].end)) {
+        if (TCP_SEQ_GT(ranges[i + 1].end, ranges[i].end)) {
+            ranges[i].end = ranges[i + 1].end;
+        }
+        memmove(&ranges[i + 1], &ranges[i + 2], (*count - i - 2) * sizeof(*ranges));
+        (*count)--;
+    }
+    return 0;
+}
+
+static void tcp_range_trim(tcp_seq_range_t* ranges, uint8_t* count, uint32_t seq) {
+    /* Drop everything below seq. */
+    uint8_t keep = 0;
+    for (uint8_t i = 0; i < *count; i++) {
+        if (TCP_SEQ_LEQ(ranges[i].end, seq)) {
+            continue;
+        }
+        ranges[keep] = ranges[i];
+        if (TCP_SEQ_LT(ranges[keep].start, seq)) {
+            ranges[keep].start = seq;
+        }
+        keep++;
+    }
+    *count = keep;
 }
 
 
-// Packet Transmission
+// TCP Options
 
 
-int tcp_send(tcp_socket_t* sock, const uint8_t* data, uint32_t len, uint8_t flags) {
-    if (!sock) {
-        return -1;
+static inline uint32_t tcp_get_be32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline void tcp_put_be32(uint8_t* p, uint32_t value) {
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+static void tcp_parse_options(const uint8_t* opt, uint32_t len, tcp_options_t* out) {
+    /* Walk the option list; malformed lengths end the walk. */
+    memset(out, 0, sizeof(*out));
+    out->wscale = TCP_WSCALE_NONE;
+    
+    while (len > 0) {
+        uint8_t kind = opt[0];
+        if (kind == TCP_OPT_EOL) {
+            break;
+        }
+        if (kind == TCP_OPT_NOP) {
+            opt++;
+            len--;
+            continue;
+        }
+        if (len < 2 || opt[1] < 2 || opt[1] > len) {
+            break;
+        }
+        
+        uint8_t olen = opt[1];
+        switch (kind) {
+            case TCP_OPT_MSS:
+                if (olen == 4) {
+                    out->mss = (uint16_t)((opt[2] << 8) | opt[3]);
+                }
+                break;
+            case TCP_OPT_WSCALE:
+                if (olen == 3) {
+                    out->wscale = opt[2] > TCP_MAX_WSCALE ? TCP_MAX_WSCALE : opt[2];
+                }
+                break;
+            case TCP_OPT_SACK_PERM:
+                if (olen == 2) {
+                    out->sack_ok = 1;
+                }
+                break;
+            case TCP_OPT_TIMESTAMP:
+                if (olen == 10) {
+                    out->ts_present = 1;
+                    out->tsval = tcp_get_be32(opt + 2);
+                    out->tsecr = tcp_get_be32(opt + 6);
+                }
+                break;
+            case TCP_OPT_SACK:
+                for (uint32_t i = 0; i + 8 <= (uint32_t)olen - 2 &&
+                     out->sack_count < TCP_OPT_MAX_SACK_BLOCKS; i += 8) {
+                    tcp_seq_range_t* block = &out->sack[out->sack_count++];
+                    block->start = tcp_get_be32(opt + 2 + i);
+                    block->end = tcp_get_be32(opt + 6 + i);
+                }
+                break;
+            default:
+                break;
+        }
+        opt += olen;
+        len -= olen;
+    }
+}
+
+static uint32_t tcp_route_mss(tcp_socket_t* sock) {
+    /* The route's MTU minus IPv4 and TCP headers, without options. */
+    net_interface_t* iface;
+    uint32_t gateway;
+    if (ipv4_route(sock->remote_ip, &iface, &gateway) == 0 && iface->mtu > 40 + TCP_MSS_DEFAULT) {
+        uint32_t mss = iface->mtu - 40;
+        return mss > TCP_MSS_MAX ? TCP_MSS_MAX : mss;
+    }
+    return TCP_MSS_DEFAULT;
+}
+
+static uint32_t tcp_build_options(tcp_socket_t* sock, uint8_t flags, uint32_t payload_len,
+                                  uint8_t* opt) {
+    /*
+     * Options for one outgoing segment, padded to a multiple of four. A SYN
+     * offers everything; a SYN-ACK echoes only what the peer's SYN offered.
+     */
+    uint32_t pos = 0;
+    
+    if (flags & TCP_FLAG_SYN) {
+        int offer = !(flags & TCP_FLAG_ACK);
+        uint32_t mss = tcp_route_mss(sock);
+        opt[pos++] = TCP_OPT_MSS;
+        opt[pos++] = 4;
+        opt[pos++] = (uint8_t)(mss >> 8);
+        opt[pos++] = (uint8_t)mss;
+        if (offer || sock->wscale_ok) {
+            opt[pos++] = TCP_OPT_NOP;
+            opt[pos++] = TCP_OPT_WSCALE;
+            opt[pos++] = 3;
+            opt[pos++] = sock->rcv_wscale;
+        }
+        if (offer || sock->sack_ok) {
+            opt[pos++] = TCP_OPT_NOP;
+            opt[pos++] = TCP_OPT_NOP;
+            opt[pos++] = TCP_OPT_SACK_PERM;
+            opt[pos++] = 2;
+        }
     }
     
-    // Debug output
-    serial_puts("TCP: Tx to ");
-    serial_puts(ip_to_string(sock->remote_ip));
-    serial_puts(":");
-    char port_str[8];
-    itoa(sock->remote_port, port_str, 10);
-    serial_puts(port_str);
-    serial_puts(" flags=0x");
-    char flags_str[8];
-    itoa(flags, flags_str, 16);
-    serial_puts(flags_str);
-    serial_puts(" len=");
-    char len_str[16];
-    itoa(len, len_str, 10);
-    serial_puts(len_str);
-    serial_puts("\n");
+    if (sock->ts_ok || (flags & (TCP_FLAG_SYN | TCP_FLAG_ACK)) == TCP_FLAG_SYN) {
+        opt[pos++] = TCP_OPT_NOP;
+        opt[pos++] = TCP_OPT_NOP;
+        opt[pos++] = TCP_OPT_TIMESTAMP;
+        opt[pos++] = 10;
+        tcp_put_be32(opt + pos, ktime_get_ms());
+        tcp_put_be32(opt + pos + 4, (flags & TCP_FLAG_ACK) ? sock->ts_recent : 0);
+        pos += 8;
+    }
+    
+    // SACK blocks ride on pure ACKs, the segment a hole triggers; the block
+    // holding the newest arrival goes first (RFC 2018 section 4)
+    if (!(flags & TCP_FLAG_SYN) && payload_len == 0 && sock->sack_ok && sock->ooo_count > 0) {
+        uint32_t room = (TCP_OPT_MAX_LEN - pos - 4) / 8;
+        uint32_t blocks = sock->ooo_count < room ? sock->ooo_count : room;
+        uint32_t first = 0;
+        for (uint32_t i = 0; i < sock->ooo_count; i++) {
+            if (TCP_SEQ_LEQ(sock->ooo[i].start, sock->ooo_last) &&
+                TCP_SEQ_LT(sock->ooo_last, sock->ooo[i].end)) {
+                first = i;
+            }
+        }
+        
+        opt[pos++] = TCP_OPT_NOP;
+        opt[pos++] = TCP_OPT_NOP;
+        opt[pos++] = TCP_OPT_SACK;
+        opt[pos++] = (uint8_t)(2 + 8 * blocks);
+        tcp_put_be32(opt + pos, sock->ooo[first].start);
+        tcp_put_be32(opt + pos + 4, sock->ooo[first].end);
+        pos += 8;
+        // Then the rest, highest first
+        for (uint32_t i = sock->ooo_count; i-- > 0 && blocks > 1;) {
+            if (i == first) {
+                continue;
+            }
+            tcp_put_be32(opt + pos, sock->ooo[i].start);
+            tcp_put_be32(opt + pos + 4, sock->ooo[i].end);
+            pos += 8;
+            blocks--;
+        }
+    }
     
-    // Find appropriate interface
+    return pos;
+}
+
+
+
+// Packet Transmission
+
+
+static int tcp_xmit(tcp_socket_t* sock, uint32_t seq, uint8_t flags,
+                    const uint8_t* data, uint32_t len,
+                    const uint8_t* data2, uint32_t len2) {
+    /* Build and send one segment; the payload may arrive in two pieces. */
     net_interface_t* iface;
     uint32_t gateway;
     if (ipv4_route(sock->remote_ip, &iface, &gateway) != 0) {
@@ -349,47 +646,620 @@ int tcp_send(tcp_socket_t* sock, const uint8_t* data, uint32_t len, uint8_t flag
         return -1;
     }
     
-    // Build TCP packet
-    uint32_t total_len = TCP_HEADER_LEN + len;
-    uint8_t* packet_data = (uint8_t*)kmalloc(total_len);
-    if (!packet_data) {
+    // Build the segment straight into a frame buffer; IPv4 and Ethernet
+    // headers are prepended in its headroom on the way down
+    uint8_t options[TCP_OPT_MAX_LEN];
+    uint32_t opt_len = tcp_build_options(sock, flags, len + len2, options);
+    uint32_t hdr_len = TCP_HEADER_LEN + opt_len;
+    uint32_t total_len = hdr_len + len + len2;
+    net_packet_t* packet = net_packet_alloc(total_len);
+    if (!packet) {
         return -1;
     }
+    uint8_t* packet_data = net_packet_put(packet, total_len);
     
     tcp_header_t* tcp_hdr = (tcp_header_t*)packet_data;
     memset(tcp_hdr, 0, TCP_HEADER_LEN);
     
+    // Windows on a SYN are never scaled (RFC 7323 2.2); remember the bytes
+    // actually offered, after the shift rounds them down
+    uint32_t shift = (flags & TCP_FLAG_SYN) ? 0 : sock->rcv_wscale;
+    uint32_t window = tcp_rx_window(sock) >> shift;
+    if (window > 0xFFFF) {
+        window = 0xFFFF;
+    }
+    sock->rcv_wnd = window << shift;
+    
     tcp_hdr->src_port = htons(sock->local_port);
     tcp_hdr->dest_port = htons(sock->remote_port);
-    tcp_hdr->seq_num = htonl(sock->seq_num);
+    tcp_hdr->seq_num = htonl(seq);
     tcp_hdr->ack_num = htonl(sock->ack_num);
-    tcp_hdr->data_offset_flags = (5 << 4);  // 5 * 4 = 20 bytes (no options)
+    tcp_hdr->data_offset_flags = (uint8_t)((hdr_len / 4) << 4);
     tcp_hdr->flags = flags;
-    tcp_hdr->window_size = htons(sock->window_size);
+    tcp_hdr->window_size = htons((uint16_t)window);
     tcp_hdr->urgent_ptr = 0;
     
-    // Copy data if present
-    if (data && len > 0) {
-        memcpy(packet_data + TCP_HEADER_LEN, data, len);
+    memcpy(packet_data + TCP_HEADER_LEN, options, opt_len);
+    if (len > 0) {
+        memcpy(packet_data + hdr_len, data, len);
+    }
+    if (len2 > 0) {
+        memcpy(packet_data + hdr_len + len, data2, len2);
     }
     
-    // Calculate checksum
     tcp_hdr->checksum = 0;
     tcp_hdr->checksum = tcp_checksum(iface->ip_addr, sock->remote_ip, packet_data, total_len);
     
+    return ipv4_send_packet(iface, sock->remote_ip, IP_PROTO_TCP, packet);
+}
+
+static int tcp_xmit_queued(tcp_socket_t* sock, uint32_t seq, uint8_t flags,
+                           uint32_t offset, uint32_t len) {
+    /* Send len bytes of the send ring starting offset bytes past SND.UNA. */
+    uint32_t pos = (sock->tx_head + offset) % sock->tx_size;
+    uint32_t first = sock->tx_size - pos;
+    if (first > len) {
+        first = len;
+    }
+    return tcp_xmit(sock, seq, flags, sock->tx_buffer + pos, first,
+                    sock->tx_buffer, len - first);
+}
+
+int tcp_send(tcp_socket_t* sock, const uint8_t* data, uint32_t len, uint8_t flags) {
+    /* Send a segment at SND.NXT outside the send ring (control segments). */
+    if (!sock) {
+        return -1;
+    }
+    
+    // Connection setup and teardown are logged; plain ACKs would flood serial
+    if (flags & (TCP_FLAG_SYN | TCP_FLAG_FIN | TCP_FLAG_RST)) {
+        serial_puts("TCP: Tx to ");
+        serial_puts(ip_to_string(sock->remote_ip));
+        serial_puts(":");
+        char port_str[8];
+        itoa(sock->remote_port, port_str, 10);
+        serial_puts(port_str);
+        serial_puts(" flags=0x");
+        char flags_str[8];
+        itoa(flags, flags_str, 16);
+        serial_puts(flags_str);
+        serial_puts("\n");
+    }
+    
+    if (!data) {
+        len = 0;
+    }
+    int result = tcp_xmit(sock, sock->seq_num, flags, data, len, NULL, 0);
+    
     // Update sequence number
     if (flags & (TCP_FLAG_SYN | TCP_FLAG_FIN)) {
         sock->seq_num++;
     }
-    if (data && len > 0) {
+    sock->seq_num += len;
+    if (TCP_SEQ_GT(sock->seq_num, sock->snd_max)) {
+        sock->snd_max = sock->seq_num;
+    }
+    
+    return result;
+}
+
+static void tcp_set_mss(tcp_socket_t* sock) {
+    /* Size segments to the route and the peer's MSS, less per-segment options. */
+    uint32_t mss = tcp_route_mss(sock);
+    if (sock->peer_mss && sock->peer_mss < mss) {
+        mss = sock->peer_mss < TCP_MSS_MIN ? TCP_MSS_MIN : sock->peer_mss;
+    }
+    if (sock->ts_ok) {
+        mss -= TCP_OPTLEN_TIMESTAMP;
+    }
+    sock->mss = (uint16_t)mss;
+}
+
+static uint8_t tcp_pick_rcv_wscale(void) {
+    /* Smallest shift that lets a 16-bit window cover tcp_rmem_max. */
+    uint8_t shift = 0;
+    while (shift < TCP_MAX_WSCALE && (tcp_rmem_max >> shift) > 0xFFFF) {
+        shift++;
+    }
+    return shift;
+}
+
+static void tcp_apply_syn_options(tcp_socket_t* sock, const tcp_options_t* opts) {
+    /* Record what the peer's SYN offered; anything it left out stays off. */
+    sock->peer_mss = opts->mss ? opts->mss : TCP_MSS_DEFAULT;
+    sock->wscale_ok = opts->wscale != TCP_WSCALE_NONE;
+    sock->snd_wscale = sock->wscale_ok ? opts->wscale : 0;
+    if (!sock->wscale_ok) {
+        sock->rcv_wscale = 0;
+    }
+    sock->sack_ok = opts->sack_ok;
+    sock->ts_ok = opts->ts_present;
+    sock->ts_recent = opts->ts_present ? opts->tsval : 0;
+}
+
+static void tcp_arm_rto(tcp_socket_t* sock) {
+    sock->rto_deadline = ktime_get_ms() + sock->rto_ms;
+    sock->rto_armed = 1;
+}
+
+static void tcp_rtt_sample(tcp_socket_t* sock, uint32_t rtt) {
+    /* RFC 6298 section 2: fold one measurement into SRTT/RTTVAR and the RTO. */
+    if (rtt == 0) {
+        rtt = 1;
+    }
+    
+    if (sock->srtt == 0) {
+        sock->srtt = rtt << 3;
+        sock->rttvar = rtt << 1;            // RTT/2, scaled by 4
+    } else {
+        // SRTT += (R - SRTT) / 8;  RTTVAR += (|SRTT - R| - RTTVAR) / 4
+        int32_t delta = (int32_t)rtt - (int32_t)(sock->srtt >> 3);
+        sock->srtt = (uint32_t)((int32_t)sock->srtt + delta);
+        if (delta < 0) {
+            delta = -delta;
+        }
+        sock->rttvar = (uint32_t)((int32_t)sock->rttvar + delta - (int32_t)(sock->rttvar >> 2));
+    }
+    
+    // RTO = SRTT + max(G, 4 * RTTVAR); the scaled rttvar already is 4 * RTTVAR
+    uint32_t var = sock->rttvar > TCP_TIMER_GRANULARITY_MS ? sock->rttvar : TCP_TIMER_GRANULARITY_MS;
+    uint32_t rto = (sock->srtt >> 3) + var;
+    if (rto < TCP_RTO_MIN_MS) {
+        rto = TCP_RTO_MIN_MS;
+    }
+    if (rto > TCP_RTO_MAX_MS) {
+        rto = TCP_RTO_MAX_MS;
+    }
+    sock->rto_ms = rto;
+}
+
+static void tcp_cong_start(tcp_socket_t* sock) {
+    /* Initial window per RFC 3390: min(4*MSS, max(2*MSS, 4380 bytes)). */
+    uint32_t iw = 4380;
+    if (iw < 2U * sock->mss) {
+        iw = 2U * sock->mss;
+    }
+    if (iw > 4U * sock->mss) {
+        iw = 4U * sock->mss;
+    }
+    
+    if (!sock->cong) {
+        sock->cong = tcp_cong_default();
+    }
+    sock->cwnd = iw;
+    sock->ssthresh = 0xFFFFFFFF;    // Slow start until the first loss
+    sock->cwnd_cnt = 0;
+    sock->in_recovery = 0;
+    sock->recover = sock->snd_una;
+    memset(sock->cong_priv, 0, sizeof(sock->cong_priv));
+    if (sock->cong->init) {
+        sock->cong->init(sock);
+    }
+}
+
+static int tcp_send_syn(tcp_socket_t* sock, uint8_t flags) {
+    /* Open the connection's sequence space and time the SYN for the RTO. */
+    sock->snd_una = sock->seq_num;
+    sock->snd_max = sock->seq_num;
+    sock->high_rxt = sock->seq_num;
+    if (!(flags & TCP_FLAG_ACK) || sock->wscale_ok) {
+        sock->rcv_wscale = tcp_pick_rcv_wscale();
+    }
+    tcp_set_mss(sock);
+    tcp_cong_start(sock);
+    
+    if (tcp_send(sock, NULL, 0, flags) != 0) {
+        return -1;
+    }
+    
+    sock->rtt_seq = sock->seq_num;
+    sock->rtt_start = ktime_get_ms();
+    sock->rtt_active = 1;
+    tcp_arm_rto(sock);
+    return 0;
+}
+
+static void tcp_output(tcp_socket_t* sock) {
+    /* Send queued data the peer's window has room for, then a pending FIN. */
+    if (sock->state < TCP_ESTABLISHED || sock->state == TCP_FIN_WAIT_2 ||
+        sock->state == TCP_TIME_WAIT) {
+        return;
+    }
+    
+    for (;;) {
+        uint32_t sent = sock->seq_num - sock->snd_una;
+        if (sent > sock->tx_len) {
+            break;  // The FIN is out already
+        }
+        uint32_t unsent = sock->tx_len - sent;
+        uint32_t wnd = sock->snd_wnd < sock->cwnd ? sock->snd_wnd : sock->cwnd;
+        uint32_t usable = wnd > sent ? wnd - sent : 0;
+        
+        uint32_t len = unsent;
+        if (len > sock->mss) {
+            len = sock->mss;
+        }
+        if (len > usable) {
+            len = usable;
+        }
+        
+        if (len == 0) {
+            if (unsent == 0 && sock->fin_pending) {
+                tcp_send(sock, NULL, 0, TCP_FLAG_FIN | TCP_FLAG_ACK);
+                sock->fin_sent = 1;
+            }
+            break;
+        }
+        
+        // Sender-side silly window avoidance (RFC 1122 4.2.3.4): with data in
+        // flight, hold a runt segment until ACKs open the window further
+        if (len < unsent && len < sock->mss && sent > 0) {
+            break;
+        }
+        
+        uint8_t flags = TCP_FLAG_ACK;
+        if (len == unsent) {
+            flags |= TCP_FLAG_PSH;
+        }
+        if (tcp_xmit_queued(sock, sock->seq_num, flags, sent, len) != 0) {
+            break;  // The retransmission timer tries again
+        }
+        
+        if (sock->seq_num != sock->snd_max) {
+            sock->retrans_segs++;   // Resending after a go-back-N rewind
+        } else if (!sock->rtt_active) {
+            sock->rtt_seq = sock->seq_num + len;
+            sock->rtt_start = ktime_get_ms();
+            sock->rtt_active = 1;
+        }
         sock->seq_num += len;
+        if (TCP_SEQ_GT(sock->seq_num, sock->snd_max)) {
+            sock->snd_max = sock->seq_num;
+        }
+    }
+    
+    // Outstanding data needs the timer; so does unsent data behind a zero
+    // window, which the timer then probes
+    if (!sock->rto_armed && (sock->snd_max != sock->snd_una || sock->tx_len > 0)) {
+        tcp_arm_rto(sock);
+    }
+}
+
+static void tcp_retransmit(tcp_socket_t* sock) {
+    /* Resend the oldest unacknowledged segment (go-back-one). */
+    sock->rtt_active = 0;  // Karn: a retransmitted segment gives no RTT sample
+    sock->retrans_segs++;
+    
+    if (sock->state == TCP_SYN_SENT) {
+        tcp_xmit(sock, sock->snd_una, TCP_FLAG_SYN, NULL, 0, NULL, 0);
+        return;
+    }
+    if (sock->state == TCP_SYN_RECEIVED) {
+        tcp_xmit(sock, sock->snd_una, TCP_FLAG_SYN | TCP_FLAG_ACK, NULL, 0, NULL, 0);
+        return;
+    }
+    
+    uint32_t in_flight = sock->seq_num - sock->snd_una;
+    if (in_flight > sock->tx_len) {
+        in_flight = sock->tx_len;   // The FIN is not in the ring
+    }
+    
+    if (in_flight == 0 && sock->tx_len > 0 && sock->snd_wnd > 0) {
+        tcp_output(sock);   // Nothing was lost; an earlier send just failed
+        return;
     }
     
-    // Send via IPv4
-    int ret = ipv4_send(iface, sock->remote_ip, IP_PROTO_TCP, packet_data, total_len);
+    uint32_t len = in_flight < sock->mss ? in_flight : sock->mss;
+    if (len == 0 && sock->tx_len > 0) {
+        // Zero-window probe: push one new byte so the peer must answer
+        len = 1;
+        sock->seq_num = sock->snd_una + 1;
+        if (TCP_SEQ_GT(sock->seq_num, sock->snd_max)) {
+            sock->snd_max = sock->seq_num;
+        }
+    }
     
-    kfree(packet_data);
-    return ret;
+    if (len > 0) {
+        uint8_t flags = TCP_FLAG_ACK;
+        if (len == sock->tx_len) {
+            flags |= TCP_FLAG_PSH;
+        }
+        tcp_xmit_queued(sock, sock->snd_una, flags, 0, len);
+        sock->high_rxt = sock->snd_una + len;
+    } else if (sock->fin_sent) {
+        tcp_xmit(sock, sock->snd_una, TCP_FLAG_FIN | TCP_FLAG_ACK, NULL, 0, NULL, 0);
+    }
+}
+
+static int tcp_sack_retransmit(tcp_socket_t* sock) {
+    /*
+     * Resend the first hole below the highest SACKed byte that recovery has
+     * not resent yet, a simplified RFC 6675 NextSeg(). Returns 0 when there
+     * is no such hole.
+     */
+    if (!sock->sack_ok || sock->sacked_count == 0) {
+        return 0;
+    }
+    
+    uint32_t seq = TCP_SEQ_GT(sock->high_rxt, sock->snd_una) ? sock->high_rxt : sock->snd_una;
+    for (uint8_t i = 0; i < sock->sacked_count; i++) {
+        const tcp_seq_range_t* range = &sock->sacked[i];
+        if (TCP_SEQ_LEQ(range->end, seq)) {
+            continue;
+        }
+        if (TCP_SEQ_LEQ(range->start, seq)) {
+            seq = range->end;   // Already at the peer: skip past it
+            continue;
+        }
+        
+        uint32_t offset = seq - sock->snd_una;
+        if (offset >= sock->tx_len) {
+            return 0;
+        }
+        uint32_t len = range->start - seq;
+        if (len > sock->mss) {
+            len = sock->mss;
+        }
+        if (len > sock->tx_len - offset) {
+            len = sock->tx_len - offset;
+        }
+        if (tcp_xmit_queued(sock, seq, TCP_FLAG_ACK, offset, len) != 0) {
+            return 0;
+        }
+        sock->high_rxt = seq + len;
+        sock->retrans_segs++;
+        sock->rtt_active = 0;
+        return 1;
+    }
+    return 0;
+}
+
+static void tcp_enter_recovery(tcp_socket_t* sock) {
+    /* Fast retransmit and NewReno fast recovery (RFC 6582 3.2 step 2). */
+    sock->ssthresh = sock->cong->ssthresh(sock);
+    sock->recover = sock->snd_max;
+    sock->in_recovery = 1;
+    sock->fast_retransmits++;
+    tcp_retransmit(sock);
+    // Inflate by the three segments the duplicate ACKs say have left the network
+    sock->cwnd = sock->ssthresh + TCP_DUPACK_THRESHOLD * sock->mss;
+    sock->cwnd_cnt = 0;
+    if (sock->cong->event) {
+        sock->cong->event(sock, TCP_CA_EVENT_FAST_RECOVERY);
+    }
+}
+
+static void tcp_update_scoreboard(tcp_socket_t* sock, const tcp_options_t* opts) {
+    /* Fold the peer's SACK blocks into the scoreboard, ignoring stale or bogus ones. */
+    for (uint8_t i = 0; i < opts->sack_count; i++) {
+        uint32_t start = opts->sack[i].start;
+        uint32_t end = opts->sack[i].end;
+        if (!TCP_SEQ_LT(start, end) || TCP_SEQ_LEQ(end, sock->snd_una) ||
+            TCP_SEQ_GT(end, sock->snd_max)) {
+            continue;
+        }
+        if (TCP_SEQ_LT(start, sock->snd_una)) {
+            start = sock->snd_una;
+        }
+        tcp_range_add(sock->sacked, &sock->sacked_count, TCP_SACK_MAX_RANGES, start, end);
+    }
+}
+
+static int tcp_process_ack(tcp_socket_t* sock, uint32_t seq, uint32_t ack,
+                           uint32_t window, uint32_t payload_len, uint8_t flags,
+                           const tcp_options_t* opts) {
+    /*
+     * Apply an incoming ACK to the send side: release acknowledged bytes,
+     * sample the RTT, run loss recovery or window growth, and track the
+     * peer's window. Returns non-zero once our FIN has been acknowledged.
+     */
+    if (!(flags & TCP_FLAG_ACK)) {
+        return 0;
+    }
+    
+    if (TCP_SEQ_GT(ack, sock->snd_max)) {
+        tcp_send(sock, NULL, 0, TCP_FLAG_ACK);  // Acknowledges data never sent
+        return 0;
+    }
+    
+    if (sock->sack_ok && opts->sack_count > 0) {
+        tcp_update_scoreboard(sock, opts);
+    }
+    
+    if (TCP_SEQ_GT(ack, sock->snd_una)) {
+        uint32_t flight = sock->snd_max - sock->snd_una;
+        uint32_t acked = ack - sock->snd_una;
+        uint32_t data_acked = acked;
+        if (data_acked > sock->tx_len) {
+            data_acked = sock->tx_len;  // The rest covers our SYN or FIN
+        }
+        sock->tx_head = sock->tx_len ? (sock->tx_head + data_acked) % sock->tx_size : 0;
+        sock->tx_len -= data_acked;
+        sock->snd_una = ack;
+        if (TCP_SEQ_LT(sock->seq_num, ack)) {
+            sock->seq_num = ack;    // Acked past a go-back-N rewind
+        }
+        tcp_range_trim(sock->sacked, &sock->sacked_count, ack);
+        
+        // An echoed timestamp times every ACK, retransmissions included
+        // (RFC 7323 4.1); otherwise time one segment per round trip
+        if (sock->ts_ok && opts->ts_present && opts->tsecr != 0) {
+            tcp_rtt_sample(sock, ktime_get_ms() - opts->tsecr);
+            sock->rtt_active = 0;
+        } else if (sock->rtt_active && TCP_SEQ_GEQ(ack, sock->rtt_seq)) {
+            tcp_rtt_sample(sock, ktime_get_ms() - sock->rtt_start);
+            sock->rtt_active = 0;
+        }
+        sock->retransmits = 0;
+        
+        if (sock->in_recovery) {
+            if (TCP_SEQ_GEQ(ack, sock->recover)) {
+                // Full ACK: deflate the window and leave recovery
+                sock->cwnd = sock->ssthresh;
+                sock->in_recovery = 0;
+                sock->dup_acks = 0;
+                if (sock->cong->event) {
+                    sock->cong->event(sock, TCP_CA_EVENT_RECOVERY_EXIT);
+                }
+            } else {
+                // Partial ACK: the next hole was lost too, resend it now and
+                // deflate by the amount acked, keeping one segment of credit
+                if (!tcp_sack_retransmit(sock)) {
+                    tcp_retransmit(sock);
+                }
+                sock->cwnd = (sock->cwnd > acked ? sock->cwnd - acked : 0) + sock->mss;
+            }
+        } else {
+            sock->dup_acks = 0;
+            // Only a window that was actually used may grow
+            if (data_acked > 0 && flight + sock->mss >= sock->cwnd) {
+                sock->cong->cong_avoid(sock, data_acked);
+            }
+        }
+        
+        // RFC 6298 5.2/5.3: stop when all is acknowledged, else restart
+        if (sock->snd_una == sock->snd_max && sock->tx_len == 0) {
+            sock->rto_armed = 0;
+        } else {
+            tcp_arm_rto(sock);
+        }
+    } else if (ack == sock->snd_una && payload_len == 0 && window == sock->snd_wnd &&
+               sock->snd_max != sock->snd_una && !(flags & (TCP_FLAG_SYN | TCP_FLAG_FIN))) {
+        // A duplicate ACK: the peer got a segment past a hole at SND.UNA
+        sock->dup_acks++;
+        if (sock->in_recovery) {
+            // Another segment has left the network: spend the credit on the
+            // next SACKed hole, or let it send new data
+            if (!tcp_sack_retransmit(sock)) {
+                sock->cwnd += sock->mss;
+            }
+        } else if (sock->dup_acks == TCP_DUPACK_THRESHOLD &&
+                   TCP_SEQ_GEQ(ack, sock->recover)) {
+            // Duplicates below recover echo a timeout's go-back-N resends
+            tcp_enter_recovery(sock);
+        }
+    }
+    
+    // Only a newer segment may move the window (RFC 793 SND.WL1/SND.WL2 check)
+    if (TCP_SEQ_LT(sock->snd_wl1, seq) ||
+        (sock->snd_wl1 == seq && TCP_SEQ_GEQ(ack, sock->snd_wl2))) {
+        sock->snd_wnd = window;
+        sock->snd_wl1 = seq;
+        sock->snd_wl2 = ack;
+    }
+    
+    return sock->fin_sent && sock->snd_una == sock->snd_max;
+}
+
+static void tcp_receive_data(tcp_socket_t* sock, uint32_t seq,
+                             const uint8_t* payload, uint32_t len) {
+    /* Store payload in the receive ring, in order or past a hole, then ACK. */
+    if (TCP_SEQ_LT(seq, sock->ack_num)) {
+        // Retransmission overlapping data we already have
+        uint32_t dup = sock->ack_num - seq;
+        if (dup >= len) {
+            len = 0;
+        } else {
+            seq += dup;
+            payload += dup;
+            len -= dup;
+        }
+    }
+    
+    if (len > 0 && tcp_rx_buffer_alloc(sock) == 0) {
+        uint32_t offset = seq - sock->ack_num;
+        uint32_t stored = tcp_rx_buffer_store(sock, offset, payload, len);
+        if (stored > 0 && offset == 0) {
+            tcp_rx_buffer_advance(sock, stored);
+            // The segment may have filled a hole: take in what queued behind it
+            while (sock->ooo_count > 0 && TCP_SEQ_LEQ(sock->ooo[0].start, sock->ack_num)) {
+                if (TCP_SEQ_GT(sock->ooo[0].end, sock->ack_num)) {
+                    tcp_rx_buffer_advance(sock, sock->ooo[0].end - sock->ack_num);
+                }
+                tcp_range_trim(sock->ooo, &sock->ooo_count, sock->ack_num);
+            }
+        } else if (stored > 0) {
+            // Past a hole: keep it in place. Data that finds the range set
+            // full is dropped, in effect, and arrives again later
+            if (tcp_range_add(sock->ooo, &sock->ooo_count, TCP_OOO_MAX_RANGES,
+                              seq, seq + stored) == 0) {
+                sock->ooo_last = seq;
+            }
+        }
+    }
+    
+    // Out-of-order data draws a duplicate ACK, whose SACK blocks tell the
+    // sender exactly which segments are missing
+    tcp_send(sock, NULL, 0, TCP_FLAG_ACK);
+}
+
+static void tcp_release(tcp_socket_t* sock) {
+    /* Free buffers and return the slot to the socket table. */
+    if (sock->rx_buffer) {
+        kfree(sock->rx_buffer);
+        sock->rx_buffer = NULL;
+    }
+    if (sock->tx_buffer) {
+        kfree(sock->tx_buffer);
+        sock->tx_buffer = NULL;
+    }
+    sock->tx_len = 0;
+    sock->rto_armed = 0;
+    sock->state = TCP_CLOSED;
+    sock->bound = 0;
+}
+
+static void tcp_enter_linger(tcp_socket_t* sock, tcp_state_t state) {
+    sock->state = state;
+    sock->linger_deadline = ktime_get_ms() + TCP_LINGER_MS;
+}
+
+static void tcp_rx_autotune(tcp_socket_t* sock, uint32_t received) {
+    /*
+     * Once per round trip, double the receive ring if the reader drained
+     * more than half of it: the window, not the reader, is holding the
+     * sender back. A ring larger than the scaled window could cover is
+     * never useful.
+     */
+    uint32_t now = ktime_get_ms();
+    uint32_t round = sock->srtt >> 3;
+    if (round < TCP_RCV_ROUND_MIN_MS) {
+        round = TCP_RCV_ROUND_MIN_MS;
+    }
+    
+    sock->rcv_copied += received;
+    if (now - sock->rcv_round_start < round) {
+        return;
+    }
+    
+    uint32_t limit = (0xFFFFU << sock->rcv_wscale) + 1;
+    if (limit > tcp_rmem_max) {
+        limit = tcp_rmem_max;
+    }
+    if (sock->rcv_copied > sock->rx_size / 2 && sock->rx_size < limit) {
+        uint32_t size = sock->rx_size * 2;
+        tcp_rx_buffer_grow(sock, size < limit ? size : limit);
+    }
+    sock->rcv_copied = 0;
+    sock->rcv_round_start = now;
+}
+
+static void tcp_rx_consumed(tcp_socket_t* sock, uint32_t received) {
+    /* Advertise a window that reading reopened, once it has grown usefully. */
+    process_set_preempt_disabled(1);
+    if (sock->state == TCP_ESTABLISHED || sock->state == TCP_FIN_WAIT_1 ||
+        sock->state == TCP_FIN_WAIT_2) {
+        tcp_rx_autotune(sock, received);
+        uint32_t opened = tcp_rx_window(sock) - sock->rcv_wnd;
+        uint32_t threshold = sock->rx_size / 2;
+        if (threshold > sock->mss) {
+            threshold = sock->mss;
+        }
+        if ((int32_t)opened >= (int32_t)threshold) {
+            tcp_send(sock, NULL, 0, TCP_FLAG_ACK);
+        }
+    }
+    process_set_preempt_disabled(0);
 }
 
 
@@ -416,25 +1286,37 @@ int tcp_receive(net_interface_t* iface, uint32_t src_ip, uint32_t dest_ip,
     uint32_t payload_len = packet->len - data_offset;
     uint8_t* payload = packet->data + data_offset;
     
-    // Debug: log received TCP packet
-    serial_puts("TCP: Rx from ");
-    serial_puts(ip_to_string(src_ip));
-    serial_puts(":");
-    char port_str[8];
-    itoa(src_port, port_str, 10);
-    serial_puts(port_str);
-    serial_puts(" -> port ");
-    itoa(dest_port, port_str, 10);
-    serial_puts(port_str);
-    serial_puts(" flags=0x");
-    char flags_str[8];
-    itoa(flags, flags_str, 16);
-    serial_puts(flags_str);
-    serial_puts(" len=");
-    char len_str[16];
-    itoa(payload_len, len_str, 10);
-    serial_puts(len_str);
-    serial_puts("\n");
+    uint32_t window = ntohs(tcp_hdr->window_size);
+    
+    if (data_offset < TCP_HEADER_LEN || data_offset > packet->len) {
+        return -1;
+    }
+    
+    tcp_options_t opts;
+    tcp_parse_options(packet->data + TCP_HEADER_LEN, data_offset - TCP_HEADER_LEN, &opts);
+    
+    // Connection setup and teardown are logged; data segments would flood serial
+    int log = (flags & (TCP_FLAG_SYN | TCP_FLAG_FIN | TCP_FLAG_RST)) != 0;
+    if (log) {
+        serial_puts("TCP: Rx from ");
+        serial_puts(ip_to_string(src_ip));
+        serial_puts(":");
+        char port_str[8];
+        itoa(src_port, port_str, 10);
+        serial_puts(port_str);
+        serial_puts(" -> port ");
+        itoa(dest_port, port_str, 10);
+        serial_puts(port_str);
+        serial_puts(" flags=0x");
+        char flags_str[8];
+        itoa(flags, flags_str, 16);
+        serial_puts(flags_str);
+        serial_puts(" len=");
+        char len_str[16];
+        itoa(payload_len, len_str, 10);
+        serial_puts(len_str);
+        serial_puts("\n");
+    }
     
     // Find matching socket
     tcp_socket_t* sock = tcp_find_socket(dest_port, src_ip, src_port);
@@ -447,17 +1329,36 @@ int tcp_receive(net_interface_t* iface, uint32_t src_ip, uint32_t dest_ip,
         return -1;
     }
     
+    // Blocked callers re-check the socket once the bottom half wakes them
+    sock->event = 1;
+    
+    if (!(flags & TCP_FLAG_SYN)) {
+        window <<= sock->snd_wscale;
+    }
+    // Echo the timestamp of the segment that will be acknowledged next;
+    // PAWS is not enforced
+    if (sock->ts_ok && opts.ts_present && TCP_SEQ_LEQ(seq_num, sock->ack_num)) {
+        sock->ts_recent = opts.tsval;
+    }
+    
     // Handle RST
     if (flags & TCP_FLAG_RST) {
-        sock->state = TCP_CLOSED;
         sock->error = 1;
+        if (sock->orphan) {
+            tcp_release(sock);
+        } else {
+            sock->state = TCP_CLOSED;
+            sock->rto_armed = 0;
+        }
         return 0;
     }
     
     // State machine processing
-    serial_puts("TCP: Socket state=");
-    serial_puts(tcp_state_to_string(sock->state));
-    serial_puts("\n");
+    if (log) {
+        serial_puts("TCP: Socket state=");
+        serial_puts(tcp_state_to_string(sock->state));
+        serial_puts("\n");
+    }
     
     switch (sock->state) {
         case TCP_LISTEN:
@@ -474,7 +1375,10 @@ int tcp_receive(net_interface_t* iface, uint32_t src_ip, uint32_t dest_ip,
                 child->remote_ip = src_ip;
                 child->remote_port = src_port;
                 child->ack_num = seq_num + 1;
+                child->snd_wnd = window;
+                child->snd_wl1 = seq_num;
                 child->state = TCP_SYN_RECEIVED;
+                tcp_apply_syn_options(child, &opts);
 
                 if (accept_queue_enqueue(queue, child) != 0) {
                     child->state = TCP_CLOSED;
@@ -483,48 +1387,52 @@ int tcp_receive(net_interface_t* iface, uint32_t src_ip, uint32_t dest_ip,
                     break;
                 }
 
-                tcp_send(child, NULL, 0, TCP_FLAG_SYN | TCP_FLAG_ACK);
+                tcp_send_syn(child, TCP_FLAG_SYN | TCP_FLAG_ACK);
             }
             break;
             
         case TCP_SYN_SENT:
             if ((flags & (TCP_FLAG_SYN | TCP_FLAG_ACK)) == (TCP_FLAG_SYN | TCP_FLAG_ACK)) {
+                if (ack_num != sock->seq_num) {
+                    break;  // Not an answer to our SYN
+                }
                 // SYN-ACK received
                 serial_puts("TCP: SYN-ACK received, connection established!\n");
                 sock->ack_num = seq_num + 1;
+                sock->snd_wl1 = seq_num;
+                sock->snd_wl2 = ack_num;
+                tcp_apply_syn_options(sock, &opts);
+                tcp_set_mss(sock);
+                tcp_cong_start(sock);
+                tcp_process_ack(sock, seq_num, ack_num, window, 0, flags, &opts);
                 sock->state = TCP_ESTABLISHED;
                 
                 // Send ACK
                 tcp_send(sock, NULL, 0, TCP_FLAG_ACK);
             } else if (flags & TCP_FLAG_SYN) {
-                // Simultaneous open
+                // Simultaneous open: answer with our original SYN, now acked
                 sock->ack_num = seq_num + 1;
+                sock->snd_wnd = window;
+                sock->snd_wl1 = seq_num;
                 sock->state = TCP_SYN_RECEIVED;
-                
-                // Send SYN-ACK
-                tcp_send(sock, NULL, 0, TCP_FLAG_SYN | TCP_FLAG_ACK);
+                tcp_apply_syn_options(sock, &opts);
+                tcp_set_mss(sock);
+                tcp_cong_start(sock);
+                tcp_retransmit(sock);
             }
             break;
             
         case TCP_SYN_RECEIVED:
-            if (flags & TCP_FLAG_ACK) {
-                if (ack_num == sock->seq_num) {
-                    sock->state = TCP_ESTABLISHED;
-                }
+            if ((flags & TCP_FLAG_ACK) && ack_num == sock->seq_num) {
+                tcp_process_ack(sock, seq_num, ack_num, window, payload_len, flags, &opts);
+                sock->state = TCP_ESTABLISHED;
             }
             break;
             
         case TCP_ESTABLISHED:
-            // Handle incoming data - only accept in-order packets
+            tcp_process_ack(sock, seq_num, ack_num, window, payload_len, flags, &opts);
             if (payload_len > 0) {
-                // Only accept if this is the expected sequence number
-                if (seq_num == sock->ack_num) {
-                    // Store data in receive buffer
-                    tcp_rx_buffer_write(sock, payload, payload_len);
-                    sock->ack_num = seq_num + payload_len;
-                }
-                // Always send ACK (even for out-of-order, to trigger retransmit)
-                tcp_send(sock, NULL, 0, TCP_FLAG_ACK);
+                tcp_receive_data(sock, seq_num, payload, payload_len);
             }
             
             // Handle FIN (note: FIN consumes one sequence number)
@@ -538,22 +1446,15 @@ int tcp_receive(net_interface_t* iface, uint32_t src_ip, uint32_t dest_ip,
                     // Send ACK for the FIN
                     tcp_send(sock, NULL, 0, TCP_FLAG_ACK);
                 }
-            } else if (payload_len == 0 && (flags & TCP_FLAG_ACK)) {
-                // Pure ACK with no data - no need to respond
             }
+            tcp_output(sock);
             break;
             
-        case TCP_FIN_WAIT_1:
-            // Still receive data while in FIN_WAIT_1
+        case TCP_FIN_WAIT_1: {
+            // Still receive data while our queued data and FIN drain
+            int fin_acked = tcp_process_ack(sock, seq_num, ack_num, window, payload_len, flags, &opts);
             if (payload_len > 0) {
-                if (seq_num == sock->ack_num) {
-                    tcp_rx_buffer_write(sock, payload, payload_len);
-                    sock->ack_num = seq_num + payload_len;
-                }
-                tcp_send(sock, NULL, 0, TCP_FLAG_ACK);
-            }
-            if (flags & TCP_FLAG_ACK) {
-                sock->state = TCP_FIN_WAIT_2;
+                tcp_receive_data(sock, seq_num, payload, payload_len);
             }
             if (flags & TCP_FLAG_FIN) {
                 uint32_t fin_seq = seq_num + payload_len;
@@ -561,18 +1462,23 @@ int tcp_receive(net_interface_t* iface, uint32_t src_ip, uint32_t dest_ip,
                     sock->ack_num = fin_seq + 1;
                 }
                 tcp_send(sock, NULL, 0, TCP_FLAG_ACK);
-                sock->state = TCP_TIME_WAIT;
+                if (fin_acked) {
+                    tcp_enter_linger(sock, TCP_TIME_WAIT);
+                } else {
+                    sock->state = TCP_CLOSING;
+                }
+            } else if (fin_acked) {
+                tcp_enter_linger(sock, TCP_FIN_WAIT_2);
+            } else {
+                tcp_output(sock);
             }
             break;
+        }
             
         case TCP_FIN_WAIT_2:
             // Still receive data while in FIN_WAIT_2
             if (payload_len > 0) {
-                if (seq_num == sock->ack_num) {
-                    tcp_rx_buffer_write(sock, payload, payload_len);
-                    sock->ack_num = seq_num + payload_len;
-                }
-                tcp_send(sock, NULL, 0, TCP_FLAG_ACK);
+                tcp_receive_data(sock, seq_num, payload, payload_len);
             }
             if (flags & TCP_FLAG_FIN) {
                 uint32_t fin_seq = seq_num + payload_len;
@@ -580,26 +1486,34 @@ int tcp_receive(net_interface_t* iface, uint32_t src_ip, uint32_t dest_ip,
                     sock->ack_num = fin_seq + 1;
                 }
                 tcp_send(sock, NULL, 0, TCP_FLAG_ACK);
-                sock->state = TCP_TIME_WAIT;
+                tcp_enter_linger(sock, TCP_TIME_WAIT);
+            }
+            break;
+            
+        case TCP_CLOSING:
+            if (tcp_process_ack(sock, seq_num, ack_num, window, payload_len, flags, &opts)) {
+                tcp_enter_linger(sock, TCP_TIME_WAIT);
             }
             break;
             
         case TCP_CLOSE_WAIT:
-            // Application should call close
+            // Application should call close; until then its data keeps flowing
+            tcp_process_ack(sock, seq_num, ack_num, window, payload_len, flags, &opts);
+            tcp_output(sock);
             break;
             
         case TCP_LAST_ACK:
-            if (flags & TCP_FLAG_ACK) {
-                sock->state = TCP_CLOSED;
-                sock->bound = 0;
+            if (tcp_process_ack(sock, seq_num, ack_num, window, payload_len, flags, &opts)) {
+                tcp_release(sock);
+            } else {
+                tcp_output(sock);
             }
             break;
             
         case TCP_TIME_WAIT:
             // Stay in TIME_WAIT for 2*MSL
             // For simplicity, just close
-            sock->state = TCP_CLOSED;
-            sock->bound = 0;
+            tcp_release(sock);
             break;
             
         default:
@@ -619,10 +1533,16 @@ tcp_socket_t* tcp_socket_create(void) {
             tcp_socket_t* sock = &tcp_sockets[i];
             memset(sock, 0, sizeof(tcp_socket_t));
             sock->state = TCP_CLOSED;
-            sock->window_size = TCP_RX_BUFFER_SIZE;
+            sock->rcv_wnd = TCP_RX_BUFFER_SIZE - 1;
             sock->seq_num = get_tick_count();  // Random-ish initial sequence
             sock->rx_buffer = NULL;
             sock->rx_size = 0;
+            sock->snd_una = sock->seq_num;
+            sock->snd_max = sock->seq_num;
+            sock->mss = TCP_MSS_DEFAULT;
+            sock->cong = tcp_cong_default();
+            sock->rto_ms = TCP_RTO_INITIAL_MS;
+            sock->rcv_round_start = ktime_get_ms();
             return sock;
         }
     }
@@ -713,7 +1633,7 @@ int tcp_socket_connect(tcp_socket_t* sock, uint32_t ip, uint16_t port) {
     sock->error = 0;
     
     // Send SYN
-    if (tcp_send(sock, NULL, 0, TCP_FLAG_SYN) != 0) {
+    if (tcp_send_syn(sock, TCP_FLAG_SYN) != 0) {
         sock->state = TCP_CLOSED;
         return -1;
     }
@@ -785,26 +1705,18 @@ int tcp_socket_connect_blocking(tcp_socket_t* sock, uint32_t ip, uint16_t port,
     serial_puts(port_str);
     serial_puts("\n");
     
-    if (tcp_send(sock, NULL, 0, TCP_FLAG_SYN) != 0) {
+    if (tcp_send_syn(sock, TCP_FLAG_SYN) != 0) {
         serial_puts("TCP: Failed to send SYN\n");
         sock->state = TCP_CLOSED;
         return -1;
     }
     
-    // Wait for connection with polling
-    extern void net_poll(void);
-    
-    uint32_t start = get_tick_count();
-    uint32_t last_syn = start;
-    int retries = 0;
+    // Sleep until the bottom half hands us a segment; tcp_timer() retransmits the SYN
+    uint32_t start = ktime_get_ms();
     
-    while ((get_tick_count() - start) < timeout_ms) {
-        // Yield to allow interrupts
-        __asm__ volatile("sti");
-        __asm__ volatile("hlt");
-        
-        // Poll for incoming packets (handles both e1000 and pcnet)
-        net_poll();
+    while ((ktime_get_ms() - start) < timeout_ms) {
+        net_wait(&sock->event, TCP_WAIT_SLICE_MS);
+        sock->event = 0;
         
         // Check if connected
         if (sock->state == TCP_ESTABLISHED) {
@@ -812,9 +1724,9 @@ int tcp_socket_connect_blocking(tcp_socket_t* sock, uint32_t ip, uint16_t port,
             return 0;
         }
         
-        // Check for error (RST received, etc)
+        // Check for error (RST received or SYN retransmits exhausted)
         if (sock->error) {
-            serial_puts("TCP: Connection error (RST received)\n");
+            serial_puts("TCP: Connection error (RST or no SYN-ACK)\n");
             sock->state = TCP_CLOSED;
             return -1;
         }
@@ -823,23 +1735,6 @@ int tcp_socket_connect_blocking(tcp_socket_t* sock, uint32_t ip, uint16_t port,
             serial_puts("TCP: Connection closed unexpectedly\n");
             return -1;
         }
-        
-        // Retransmit SYN if needed
-        if ((get_tick_count() - last_syn) > TCP_RETRANSMIT_TIMEOUT_MS) {
-            if (retries++ >= TCP_MAX_RETRANSMITS) {
-                serial_puts("TCP: Max retransmits exceeded, giving up\n");
-                sock->state = TCP_CLOSED;
-                return -1;
-            }
-            serial_puts("TCP: Retransmitting SYN (retry ");
-            char retry_str[8];
-            itoa(retries, retry_str, 10);
-            serial_puts(retry_str);
-            serial_puts(")\n");
-            sock->seq_num--;  // Reset seq_num since SYN wasn't ACKed
-            tcp_send(sock, NULL, 0, TCP_FLAG_SYN);
-            last_syn = get_tick_count();
-        }
     }
     
     // Timeout
@@ -849,15 +1744,62 @@ int tcp_socket_connect_blocking(tcp_socket_t* sock, uint32_t ip, uint16_t port,
     serial_puts(ms_str);
     serial_puts("ms\n");
     sock->state = TCP_CLOSED;
+    sock->rto_armed = 0;
     return -1;
 }
 
 int tcp_socket_send(tcp_socket_t* sock, const uint8_t* data, uint32_t len) {
-    if (!sock || sock->state != TCP_ESTABLISHED) {
+    if (!sock || (!data && len > 0)) {
         return -1;
     }
     
-    return tcp_send(sock, data, len, TCP_FLAG_PSH | TCP_FLAG_ACK);
+    if (!sock->tx_buffer) {
+        uint8_t* buffer = (uint8_t*)kmalloc(TCP_TX_BUFFER_SIZE);
+        if (!buffer) {
+            return -1;
+        }
+        sock->tx_buffer = buffer;
+        sock->tx_head = 0;
+        sock->tx_len = 0;
+        sock->tx_size = TCP_TX_BUFFER_SIZE;
+    }
+    
+    uint32_t queued = 0;
+    while (queued < len) {
+        // Clear before checking so an ACK arriving after the check wakes us
+        sock->event = 0;
+        
+        process_set_preempt_disabled(1);
+        if (sock->error || (sock->state != TCP_ESTABLISHED && sock->state != TCP_CLOSE_WAIT)) {
+            process_set_preempt_disabled(0);
+            return -1;
+        }
+        
+        uint32_t chunk = sock->tx_size - sock->tx_len;
+        if (chunk > len - queued) {
+            chunk = len - queued;
+        }
+        if (chunk > 0) {
+            uint32_t pos = (sock->tx_head + sock->tx_len) % sock->tx_size;
+            uint32_t first = sock->tx_size - pos;
+            if (first > chunk) {
+                first = chunk;
+            }
+            memcpy(sock->tx_buffer + pos, data + queued, first);
+            memcpy(sock->tx_buffer, data + queued + first, chunk - first);
+            sock->tx_len += chunk;
+            queued += chunk;
+            tcp_output(sock);
+        }
+        process_set_preempt_disabled(0);
+        
+        if (queued < len) {
+            // Buffer full: ACKs from the bottom half free space
+            net_wait(&sock->event, TCP_WAIT_SLICE_MS);
+        }
+    }
+    
+    return (int)queued;
 }
 
 int tcp_socket_recv(tcp_socket_t* sock, uint8_t* buffer, uint32_t len) {
@@ -876,7 +1818,11 @@ int tcp_socket_recv(tcp_socket_t* sock, uint8_t* buffer, uint32_t len) {
     }
     
     // Read from buffer
-    return tcp_rx_buffer_read(sock, buffer, len);
+    int received = tcp_rx_buffer_read(sock, buffer, len);
+    if (received > 0) {
+        tcp_rx_consumed(sock, (uint32_t)received);
+    }
+    return received;
 }
 
 // Blocking receive with timeout - Military-grade implementation
@@ -886,21 +1832,16 @@ int tcp_socket_recv_blocking(tcp_socket_t* sock, uint8_t* buffer, uint32_t len,
         return -1;
     }
     
-    extern void net_poll(void);
+    uint32_t start = ktime_get_ms();
     
-    uint32_t start = get_tick_count();
-    
-    while ((get_tick_count() - start) < timeout_ms) {
-        // Yield to allow interrupts
-        __asm__ volatile("sti");
-        __asm__ volatile("hlt");
-        
-        // Poll for incoming packets (handles both e1000 and pcnet)
-        net_poll();
+    while ((ktime_get_ms() - start) < timeout_ms) {
+        // Clear before reading so data arriving after the read wakes us
+        sock->event = 0;
         
         // Check if data available
         int received = tcp_rx_buffer_read(sock, buffer, len);
         if (received > 0) {
+            tcp_rx_consumed(sock, (uint32_t)received);
             return received;
         }
         
@@ -914,6 +1855,8 @@ int tcp_socket_recv_blocking(tcp_socket_t* sock, uint8_t* buffer, uint32_t len,
         if (sock->error) {
             return -1;
         }
+        
+        net_wait(&sock->event, TCP_WAIT_SLICE_MS);
     }
     
     return 0;  // Timeout, no data
@@ -924,20 +1867,166 @@ void tcp_socket_close(tcp_socket_t* sock) {
         return;
     }
     
+    process_set_preempt_disabled(1);
     if (sock->state == TCP_ESTABLISHED || sock->state == TCP_CLOSE_WAIT) {
+        // The FIN follows whatever is still queued; ACKs and the timer finish
+        // the close and release the socket
         sock->state = (sock->state == TCP_CLOSE_WAIT) ? TCP_LAST_ACK : TCP_FIN_WAIT_1;
-        tcp_send(sock, NULL, 0, TCP_FLAG_FIN | TCP_FLAG_ACK);
+        sock->fin_pending = 1;
+        sock->orphan = 1;
+        tcp_output(sock);
     } else {
-        sock->state = TCP_CLOSED;
+        tcp_release(sock);
+    }
+    process_set_preempt_disabled(0);
+}
+
+int tcp_socket_set_congestion(tcp_socket_t* sock, const char* name) {
+    const tcp_cong_ops_t* ops = tcp_cong_find(name);
+    if (!sock || !ops) {
+        return -1;
     }
     
-    // Free receive buffer
-    if (sock->rx_buffer) {
-        kfree(sock->rx_buffer);
-        sock->rx_buffer = NULL;
+    // The new algorithm starts from the current cwnd/ssthresh with fresh state
+    process_set_preempt_disabled(1);
+    sock->cong = ops;
+    memset(sock->cong_priv, 0, sizeof(sock->cong_priv));
+    if (ops->init) {
+        ops->init(sock);
+    }
+    process_set_preempt_disabled(0);
+    return 0;
+}
+
+uint32_t tcp_get_rmem_max(void) {
+    return tcp_rmem_max;
+}
+
+int tcp_set_rmem_max(uint32_t bytes) {
+    /* Applies to growth from now on and to the scale offered by new connections. */
+    if (bytes < TCP_RX_BUFFER_SIZE || bytes > TCP_RMEM_CEILING) {
+        return -1;
+    }
+    tcp_rmem_max = bytes;
+    return 0;
+}
+
+int tcp_get_connections(tcp_conn_info_t* out, int max) {
+    if (!out || max <= 0) {
+        return 0;
     }
     
-    sock->bound = 0;
+    int count = 0;
+    process_set_preempt_disabled(1);
+    for (int i = 0; i < MAX_TCP_SOCKETS && count < max; i++) {
+        tcp_socket_t* sock = &tcp_sockets[i];
+        if (!sock->bound) {
+            continue;
+        }
+        
+        tcp_conn_info_t* info = &out[count++];
+        memset(info, 0, sizeof(*info));
+        info->local_ip = sock->local_ip;
+        info->local_port = sock->local_port;
+        info->remote_ip = sock->remote_ip;
+        info->remote_port = sock->remote_port;
+        info->state = sock->state;
+        if (sock->cong) {
+            strncpy(info->cong, sock->cong->name, TCP_CONG_NAME_MAX - 1);
+        }
+        info->mss = sock->mss;
+        info->cwnd = sock->cwnd;
+        info->ssthresh = sock->ssthresh;
+        info->snd_wnd = sock->snd_wnd;
+        info->in_flight = sock->snd_max - sock->snd_una;
+        info->srtt_ms = sock->srtt >> 3;
+        info->rttvar_ms = sock->rttvar >> 2;
+        info->rto_ms = sock->rto_ms;
+        info->retrans_segs = sock->retrans_segs;
+        info->fast_retransmits = sock->fast_retransmits;
+        info->timeouts = sock->timeouts;
+        info->rcv_buf = sock->rx_buffer ? sock->rx_size : TCP_RX_BUFFER_SIZE;
+        info->wscale_ok = sock->wscale_ok;
+        info->snd_wscale = sock->snd_wscale;
+        info->rcv_wscale = sock->rcv_wscale;
+        info->sack_ok = sock->sack_ok;
+        info->ts_ok = sock->ts_ok;
+        info->ooo_ranges = sock->ooo_count;
+    }
+    process_set_preempt_disabled(0);
+    
+    return count;
+}
+
+void tcp_timer(void) {
+    /* Expire retransmission timers and reap orphaned closing sockets. */
+    uint32_t now = ktime_get_ms();
+    
+    for (int i = 0; i < MAX_TCP_SOCKETS; i++) {
+        tcp_socket_t* sock = &tcp_sockets[i];
+        if (!sock->bound || sock->state == TCP_CLOSED) {
+            continue;
+        }
+        
+        if (sock->orphan && (sock->state == TCP_FIN_WAIT_2 || sock->state == TCP_TIME_WAIT)) {
+            if ((int32_t)(now - sock->linger_deadline) >= 0) {
+                tcp_release(sock);
+            }
+            continue;
+        }
+        
+        if (!sock->rto_armed || (int32_t)(now - sock->rto_deadline) < 0) {
+            continue;
+        }
+        
+        if (sock->retransmits >= TCP_MAX_RETRANSMITS) {
+            serial_puts("TCP: Retransmit limit reached, dropping connection to ");
+            serial_puts(ip_to_string(sock->remote_ip));
+            serial_puts("\n");
+            sock->error = 1;
+            sock->event = 1;
+            if (sock->orphan) {
+                tcp_release(sock);
+            } else {
+                sock->state = TCP_CLOSED;
+                sock->rto_armed = 0;
+            }
+            continue;
+        }
+        
+        // RFC 6298 5.5-5.6: back off, then resend
+        sock->retransmits++;
+        sock->timeouts++;
+        sock->rto_ms = sock->rto_ms * 2 > TCP_RTO_MAX_MS ? TCP_RTO_MAX_MS : sock->rto_ms * 2;
+        sock->dup_acks = 0;
+        
+        if (sock->state < TCP_ESTABLISHED ||
+            (sock->snd_max == sock->snd_una && sock->snd_wnd == 0)) {
+            // Handshake retransmit or zero-window probe: not congestion
+            tcp_retransmit(sock);
+        } else {
+            // RFC 5681 3.1: ssthresh from the flight, cwnd back to one segment,
+            // then resend everything from SND.UNA as the window reopens
+            sock->ssthresh = sock->cong->ssthresh(sock);
+            sock->cwnd = sock->mss;
+            sock->cwnd_cnt = 0;
+            sock->in_recovery = 0;
+            sock->recover = sock->snd_max;
+            sock->rtt_active = 0;
+            // The peer may renege on SACKed data (RFC 2018 section 8)
+            sock->sacked_count = 0;
+            sock->high_rxt = sock->snd_una;
+            if (sock->cong->event) {
+                sock->cong->event(sock, TCP_CA_EVENT_TIMEOUT);
+            }
+            sock->seq_num = sock->snd_una;
+            tcp_output(sock);
+            if (sock->seq_num == sock->snd_una) {
+                tcp_retransmit(sock);   // The window is shut: probe it
+            }
+        }
+        tcp_arm_rto(sock);
+    }
 }
 
 const char* tcp_state_to_string(tcp_state_t state) {
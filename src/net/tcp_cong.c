@@ -0,0 +1,156 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * src/net/tcp_cong.c
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+
+/**
+ * TCP congestion-control registry and NewReno
+ */
+
+#include <net/tcp_cong.h>
+#include <string.h>
+#include <serial.h>
+
+/*
+ * Algorithms register an ops table under a unique name. New connections
+ * take the current default; tcp_socket_set_congestion() overrides it per
+ * connection before any data is sent.
+ */
+
+static const tcp_cong_ops_t* tcp_cong_algorithms[TCP_CONG_MAX_ALGORITHMS];
+static uint32_t tcp_cong_count = 0;
+static const tcp_cong_ops_t* tcp_cong_default_ops = &tcp_newreno_ops;
+
+void tcp_cong_init(void) {
+    tcp_cong_count = 0;
+    tcp_cong_register(&tcp_newreno_ops);
+    tcp_cong_register(&tcp_cubic_ops);
+    tcp_cong_default_ops = &tcp_newreno_ops;
+}
+
+int tcp_cong_register(const tcp_cong_ops_t* ops) {
+    if (!ops || !ops->name || !ops->ssthresh || !ops->cong_avoid ||
+        strlen(ops->name) >= TCP_CONG_NAME_MAX) {
+        return -1;
+    }
+    if (tcp_cong_find(ops->name) || tcp_cong_count >= TCP_CONG_MAX_ALGORITHMS) {
+        return -1;
+    }
+
+    tcp_cong_algorithms[tcp_cong_count++] = ops;
+    return 0;
+}
+
+const tcp_cong_ops_t* tcp_cong_find(const char* name) {
+    if (!name) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < tcp_cong_count; i++) {
+        if (strcmp(tcp_cong_algorithms[i]->name, name) == 0) {
+            return tcp_cong_algorithms[i];
+        }
+    }
+    return NULL;
+}
+
+const tcp_cong_ops_t* tcp_cong_default(void) {
+    return tcp_cong_default_ops;
+}
+
+int tcp_cong_set_default(const char* name) {
+    const tcp_cong_ops_t* ops = tcp_cong_find(name);
+    if (!ops) {
+        return -1;
+    }
+
+    tcp_cong_default_ops = ops;
+    serial_puts("TCP: default congestion control is now ");
+    serial_puts(ops->name);
+    serial_puts("\n");
+    return 0;
+}
+
+int tcp_cong_list(char* buf, uint32_t size) {
+    if (!buf || size == 0) {
+        return -1;
+    }
+
+    uint32_t pos = 0;
+    buf[0] = '\0';
+    for (uint32_t i = 0; i < tcp_cong_count; i++) {
+        uint32_t len = (uint32_t)strlen(tcp_cong_algorithms[i]->name);
+        if (pos + len + 2 > size) {
+            break;
+        }
+        if (pos > 0) {
+            buf[pos++] = ' ';
+        }
+        memcpy(buf + pos, tcp_cong_algorithms[i]->name, len);
+        pos += len;
+        buf[pos] = '\0';
+    }
+    return (int)pos;
+}
+
+
+// Helpers shared by the algorithms
+
+
+uint32_t tcp_cong_flight_size(const tcp_socket_t* sock) {
+    return sock->snd_max - sock->snd_una;
+}
+
+void tcp_cong_slow_start(tcp_socket_t* sock, uint32_t acked) {
+    /* RFC 5681 3.1: grow by the bytes acked, at most one segment per ACK. */
+    uint32_t inc = acked < sock->mss ? acked : sock->mss;
+    if (sock->cwnd < TCP_CONG_CWND_MAX - inc) {
+        sock->cwnd += inc;
+    }
+}
+
+void tcp_cong_avoid_ai(tcp_socket_t* sock, uint32_t bytes_per_mss, uint32_t acked) {
+    /* Add one segment to cwnd for every bytes_per_mss bytes acknowledged. */
+    if (bytes_per_mss < sock->mss) {
+        bytes_per_mss = sock->mss;
+    }
+    sock->cwnd_cnt += acked;
+    while (sock->cwnd_cnt >= bytes_per_mss) {
+        sock->cwnd_cnt -= bytes_per_mss;
+        if (sock->cwnd < TCP_CONG_CWND_MAX - sock->mss) {
+            sock->cwnd += sock->mss;
+        }
+    }
+}
+
+
+// NewReno (RFC 5681 window growth; recovery lives in the TCP core)
+
+
+static uint32_t newreno_ssthresh(tcp_socket_t* sock) {
+    /* Half the data in flight, but never below two segments (RFC 5681 eq. 4). */
+    uint32_t half = tcp_cong_flight_size(sock) / 2;
+    uint32_t floor = 2U * sock->mss;
+    return half > floor ? half : floor;
+}
+
+static void newreno_cong_avoid(tcp_socket_t* sock, uint32_t acked) {
+    if (sock->cwnd < sock->ssthresh) {
+        tcp_cong_slow_start(sock, acked);
+        return;
+    }
+    // About one segment per round trip: a full cwnd of bytes per increase
+    tcp_cong_avoid_ai(sock, sock->cwnd, acked);
+}
+
+const tcp_cong_ops_t tcp_newreno_ops = {
+    .name = "newreno",
+    .init = NULL,
+    .ssthresh = newreno_ssthresh,
+    .cong_avoid = newreno_cong_avoid,
+    .event = NULL
+};
@@ -0,0 +1,177 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * src/net/tcp_cubic.c
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+
+/**
+ * CUBIC congestion control (RFC 9438)
+ */
+
+#include <net/tcp_cong.h>
+#include <string.h>
+#include <ktime.h>
+
+/*
+ * After a loss CUBIC grows the window along W(t) = C * (t - K)^3 + W_max,
+ * flattening out near the window where the loss happened, then probing
+ * beyond it. Time is kept in 1/1024 s units so the cube fits 64 bits
+ * without division, as in the classic BIC/CUBIC fixed-point formulation.
+ * C is 0.4 and the multiplicative decrease factor beta is 0.7.
+ */
+
+#define CUBIC_HZ_SHIFT 10                   // Time unit: 1/1024 s
+#define CUBIC_BETA 717                      // 0.7 in 1/1024
+#define CUBIC_BETA_SCALE 1024
+#define CUBIC_C_SCALED 410                  // C = 0.4 in 1/1024
+// K = cbrt(CUBIC_CUBE_FACTOR * (W_max - cwnd)) in 1/1024 s
+#define CUBIC_CUBE_FACTOR ((1ULL << (CUBIC_HZ_SHIFT * 3 + 10)) / CUBIC_C_SCALED)
+// ACKs per segment of Reno-friendly growth: 3(1-beta)/(1+beta), scaled by 8
+#define CUBIC_RENO_SCALE (8 * (CUBIC_BETA_SCALE + CUBIC_BETA) / 3 / (CUBIC_BETA_SCALE - CUBIC_BETA))
+#define CUBIC_MAX_OFFSET (1U << 18)         // Keeps C * offs^3 inside 64 bits
+
+typedef struct {
+    uint32_t w_max;             // Segments before the last reduction
+    uint32_t epoch_start;       // ms (+1, so 0 means no epoch running)
+    uint32_t k;                 // Time from epoch start to W_max, 1/1024 s
+    uint32_t origin;            // Segments at the plateau
+    uint32_t reno_cwnd;         // What Reno would have by now, segments
+    uint32_t ack_cnt;           // Segments acked toward reno_cwnd
+} cubic_state_t;
+
+_Static_assert(sizeof(cubic_state_t) <= sizeof(((tcp_socket_t*)0)->cong_priv),
+               "cubic_state_t must fit in tcp_socket_t.cong_priv");
+
+static inline cubic_state_t* cubic_state(tcp_socket_t* sock) {
+    return (cubic_state_t*)(void*)sock->cong_priv;
+}
+
+static uint32_t cubic_cbrt(uint64_t value) {
+    /* Integer cube root, one result bit at a time (no division). */
+    uint32_t root = 0;
+    for (int bit = 20; bit >= 0; bit--) {
+        uint64_t trial = root | (1U << bit);
+        if (trial * trial * trial <= value) {
+            root = (uint32_t)trial;
+        }
+    }
+    return root;
+}
+
+static void cubic_init(tcp_socket_t* sock) {
+    memset(cubic_state(sock), 0, sizeof(cubic_state_t));
+}
+
+static uint32_t cubic_segments_per_increase(tcp_socket_t* sock, uint32_t acked) {
+    /* Segments to ack per one-segment cwnd increase, tracking W(t). */
+    cubic_state_t* st = cubic_state(sock);
+    uint32_t cwnd = sock->cwnd / sock->mss;
+    uint32_t now = ktime_get_ms();
+
+    if (st->epoch_start == 0) {
+        st->epoch_start = now | 1;
+        st->ack_cnt = 0;
+        st->reno_cwnd = cwnd;
+        if (cwnd < st->w_max) {
+            st->k = cubic_cbrt(CUBIC_CUBE_FACTOR * (uint64_t)(st->w_max - cwnd));
+            st->origin = st->w_max;
+        } else {
+            st->k = 0;
+            st->origin = cwnd;
+        }
+    }
+
+    // Aim one round trip ahead: target = W(t + RTT)
+    uint32_t elapsed = now - st->epoch_start + (sock->srtt >> 3);
+    if (elapsed > (1U << 21)) {
+        elapsed = 1U << 21;
+    }
+    uint32_t t = (elapsed << CUBIC_HZ_SHIFT) / 1000;
+
+    uint32_t offs = t < st->k ? st->k - t : t - st->k;
+    if (offs > CUBIC_MAX_OFFSET) {
+        offs = CUBIC_MAX_OFFSET;
+    }
+    uint64_t cube = (uint64_t)offs * offs * offs;
+    uint32_t delta = (uint32_t)((CUBIC_C_SCALED * cube) >> (CUBIC_HZ_SHIFT * 3 + 10));
+
+    uint32_t target;
+    if (t < st->k) {
+        target = st->origin > delta ? st->origin - delta : 0;
+    } else {
+        target = st->origin + delta;
+    }
+
+    uint32_t cnt;
+    if (target > cwnd) {
+        cnt = cwnd / (target - cwnd);
+    } else {
+        cnt = 100 * cwnd;   // At or above the curve: barely grow
+    }
+    if (st->w_max == 0 && cnt > 20) {
+        cnt = 20;           // No loss seen yet: grow at least 5% per RTT
+    }
+
+    // Reno-friendly region: never grow slower than standard TCP would
+    st->ack_cnt += (acked + sock->mss - 1) / sock->mss;
+    uint32_t reno_step = (cwnd * CUBIC_RENO_SCALE) >> 3;
+    if (reno_step == 0) {
+        reno_step = 1;
+    }
+    while (st->ack_cnt > reno_step) {
+        st->ack_cnt -= reno_step;
+        st->reno_cwnd++;
+    }
+    if (st->reno_cwnd > cwnd) {
+        uint32_t max_cnt = cwnd / (st->reno_cwnd - cwnd);
+        if (cnt > max_cnt) {
+            cnt = max_cnt;
+        }
+    }
+
+    return cnt < 2 ? 2 : cnt;
+}
+
+static void cubic_cong_avoid(tcp_socket_t* sock, uint32_t acked) {
+    if (sock->cwnd < sock->ssthresh) {
+        tcp_cong_slow_start(sock, acked);
+        return;
+    }
+    uint32_t cnt = cubic_segments_per_increase(sock, acked);
+    tcp_cong_avoid_ai(sock, cnt * sock->mss, acked);
+}
+
+static uint32_t cubic_ssthresh(tcp_socket_t* sock) {
+    cubic_state_t* st = cubic_state(sock);
+    uint32_t cwnd = sock->cwnd / sock->mss;
+
+    st->epoch_start = 0;
+    // Fast convergence: release bandwidth to newer flows on back-to-back losses
+    if (cwnd < st->w_max) {
+        st->w_max = (cwnd * (CUBIC_BETA_SCALE + CUBIC_BETA)) / (2 * CUBIC_BETA_SCALE);
+    } else {
+        st->w_max = cwnd;
+    }
+
+    uint32_t threshold = (uint32_t)(((uint64_t)sock->cwnd * CUBIC_BETA) >> 10);
+    uint32_t floor = 2U * sock->mss;
+    return threshold > floor ? threshold : floor;
+}
+
+static void cubic_event(tcp_socket_t* sock, tcp_ca_event_t event) {
+    if (event == TCP_CA_EVENT_TIMEOUT) {
+        cubic_init(sock);   // A timeout says little about the old plateau
+    }
+}
+
+const tcp_cong_ops_t tcp_cubic_ops = {
+    .name = "cubic",
+    .init = cubic_init,
+    .ssthresh = cubic_ssthresh,
+    .cong_avoid = cubic_cong_avoid,
+    .event = cubic_event
+};
@@ -231,12 +231,13 @@ int udp_socket_sendto(udp_socket_t* sock, const uint8_t* data, uint32_t len,
     // Use bound port
     uint16_t src_port = sock->local_port;
     
-    // Build UDP packet
+    // Build the datagram straight into a frame buffer
     uint32_t total_len = UDP_HEADER_LEN + len;
-    uint8_t* packet_data = (uint8_t*)kmalloc(total_len);
-    if (!packet_data) {
+    net_packet_t* packet = net_packet_alloc(total_len);
+    if (!packet) {
         return -1;
     }
+    uint8_t* packet_data = net_packet_put(packet, total_len);
     
     udp_header_t* udp_hdr = (udp_header_t*)packet_data;
     udp_hdr->src_port = htons(src_port);
@@ -248,10 +249,7 @@ int udp_socket_sendto(udp_socket_t* sock, const uint8_t* data, uint32_t len,
     memcpy(packet_data + UDP_HEADER_LEN, data, len);
     
     // Send via IPv4
-    int ret = ipv4_send(iface, dest_ip, IP_PROTO_UDP, packet_data, total_len);
-    
-    kfree(packet_data);
-    return ret;
+    return ipv4_send_packet(iface, dest_ip, IP_PROTO_UDP, packet);
 }
 
 int udp_socket_recvfrom(udp_socket_t* sock, uint8_t* buffer, uint32_t len,
@@ -0,0 +1,340 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * src/system/clockevent.c
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+#include <clockevent.h>
+#include <ktime.h>
+#include <lapic.h>
+#include <smp.h>
+#include <cpu.h>
+#include <arch.h>
+#include <arch/pit.h>
+#include <process.h>
+#include <io.h>
+#include <serial.h>
+#include <stdlib.h>
+
+/*
+ * Clock-event layer: timekeeping and per-CPU timer interrupts.
+ *
+ * - Clocksource: the TSC, calibrated against PIT channel 2 at boot and
+ *   spliced onto the PIT tick count so ktime never jumps. Without a TSC,
+ *   ktime advances in whole scheduler ticks.
+ * - Clock events: every CPU programs its own LAPIC timer. In the one-shot
+ *   modes the timer is armed for the CPU's next scheduler event only, so an
+ *   idle CPU sleeps until a sleeper is due instead of taking 100 IRQs/s.
+ *   The BSP additionally advances the global tick (sleep wheel, module
+ *   timers, NIC poll) that IRQ0 used to drive.
+ *
+ * All CPUs are assumed to share a synchronised TSC and LAPIC timer rate,
+ * which holds for the single-socket machines and emulators aOS targets.
+ */
+
+#define PIT_CHANNEL2_DATA           0x42
+#define PIT_CONTROL_PORT_B          0x61    // Bit 0: ch2 gate, bit 1: speaker, bit 5: ch2 output
+#define CLOCKEVENT_CALIBRATE_MS     10
+#define CLOCKEVENT_CALIBRATE_COUNT  ((PIT_BASE_FREQUENCY * CLOCKEVENT_CALIBRATE_MS) / 1000)
+#define CLOCKEVENT_CALIBRATE_SPINS  10000000u
+#define CLOCKEVENT_NET_POLL_TICKS   10      // Same cadence the PIT handler used
+#define CLOCKEVENT_CYC2NS_SHIFT     22
+
+extern void net_rx_kick(void);
+
+static clockevent_mode_t clock_mode = CLOCKEVENT_MODE_PIT;
+static uint32_t tick_ns = NSEC_PER_SEC / 100;
+
+// TSC clocksource state; ktime = tick_base ticks + TSC cycles since tsc_base
+static int tsc_clocksource = 0;
+static uint32_t tsc_khz = 0;
+static uint32_t tsc_per_tick = 0;
+static uint32_t cyc2ns_mult = 0;    // ns per cycle << CLOCKEVENT_CYC2NS_SHIFT
+static uint64_t tsc_base = 0;
+static uint32_t tick_base = 0;
+
+static uint32_t lapic_khz = 0;      // LAPIC timer counts per ms (divide by 16)
+static uint32_t lapic_per_tick = 0;
+static uint32_t bsp_last_tick = 0;
+
+static uint64_t cycles_to_ns(uint64_t cycles) {
+    /* Split multiply so a 64-bit product never overflows on long uptimes. */
+    uint64_t hi = cycles >> 32;
+    uint64_t lo = (uint32_t)cycles;
+    return ((hi * cyc2ns_mult) << (32 - CLOCKEVENT_CYC2NS_SHIFT)) +
+           ((lo * cyc2ns_mult) >> CLOCKEVENT_CYC2NS_SHIFT);
+}
+
+uint32_t ktime_tick_ns(void) {
+    return tick_ns;
+}
+
+uint32_t ktime_get_ticks(void) {
+    if (!tsc_clocksource) {
+        return system_ticks;
+    }
+
+    uint32_t ticks = tick_base + (uint32_t)div_u64_u32(arch_read_tsc() - tsc_base, tsc_per_tick);
+    // Keep direct readers of system_ticks current between timer interrupts
+    if ((int32_t)(ticks - system_ticks) > 0) {
+        system_ticks = ticks;
+    }
+    return ticks;
+}
+
+uint64_t ktime_get_ns(void) {
+    if (!tsc_clocksource) {
+        return (uint64_t)system_ticks * tick_ns;
+    }
+    return (uint64_t)tick_base * tick_ns + cycles_to_ns(arch_read_tsc() - tsc_base);
+}
+
+uint32_t ktime_get_ms(void) {
+    return (uint32_t)div_u64_u32(ktime_get_ns(), NSEC_PER_MSEC);
+}
+
+uint32_t ktime_ns_to_ticks(uint64_t ns) {
+    return (uint32_t)div_u64_u32(ns, tick_ns);
+}
+
+clockevent_mode_t clockevent_get_mode(void) {
+    return clock_mode;
+}
+
+const char* clockevent_mode_name(void) {
+    switch (clock_mode) {
+        case CLOCKEVENT_MODE_LAPIC_PERIODIC: return "lapic-periodic";
+        case CLOCKEVENT_MODE_LAPIC_ONESHOT:  return "lapic-oneshot";
+        case CLOCKEVENT_MODE_TSC_DEADLINE:   return "tsc-deadline";
+        default:                             return "pit";
+    }
+}
+
+int clockevent_is_oneshot(void) {
+    return clock_mode == CLOCKEVENT_MODE_LAPIC_ONESHOT ||
+           clock_mode == CLOCKEVENT_MODE_TSC_DEADLINE;
+}
+
+uint32_t clockevent_tsc_khz(void) {
+    return tsc_clocksource ? tsc_khz : 0;
+}
+
+uint32_t clockevent_lapic_khz(void) {
+    return lapic_khz;
+}
+
+uint32_t clockevent_events(void) {
+    return smp_this_cpu()->clock_events;
+}
+
+static inline void clockevent_wrmsr(uint32_t msr, uint64_t value) {
+    asm volatile("wrmsr" :: "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static int clockevent_calibrate(uint64_t* tsc_cycles, uint32_t* lapic_counts) {
+    /*
+     * Count TSC cycles and LAPIC timer decrements while PIT channel 2 runs
+     * one CLOCKEVENT_CALIBRATE_MS countdown (mode 0, output rises at zero).
+     * Channel 0 keeps ticking, so the boot tick count is not disturbed.
+     */
+    uintptr_t irq = arch_irq_save();
+    uint8_t port_b = inb(PIT_CONTROL_PORT_B);
+
+    outb(PIT_CONTROL_PORT_B, (uint8_t)((port_b & ~0x02) | 0x01));
+    outb(PIT_COMMAND_REG, 0xB0);    // Channel 2, lobyte/hibyte, mode 0
+    outb(PIT_CHANNEL2_DATA, (uint8_t)(CLOCKEVENT_CALIBRATE_COUNT & 0xFF));
+    outb(PIT_CHANNEL2_DATA, (uint8_t)((CLOCKEVENT_CALIBRATE_COUNT >> 8) & 0xFF));
+
+    lapic_write(LAPIC_REG_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_REG_TIMER_INIT, 0xFFFFFFFFu);
+    uint64_t tsc_start = arch_read_tsc();
+
+    uint32_t spins = 0;
+    while (!(inb(PIT_CONTROL_PORT_B) & 0x20) && spins < CLOCKEVENT_CALIBRATE_SPINS) {
+        spins++;
+    }
+
+    uint64_t tsc_end = arch_read_tsc();
+    uint32_t lapic_left = lapic_read(LAPIC_REG_TIMER_CURRENT);
+    lapic_write(LAPIC_REG_TIMER_INIT, 0);
+    outb(PIT_CONTROL_PORT_B, port_b);
+    arch_irq_restore(irq);
+
+    if (spins >= CLOCKEVENT_CALIBRATE_SPINS) {
+        return -1;  // Channel 2 gate not wired up
+    }
+    *tsc_cycles = tsc_end - tsc_start;
+    *lapic_counts = 0xFFFFFFFFu - lapic_left;
+    return 0;
+}
+
+static void clockevent_arm(uint32_t ticks) {
+    /* Fire at the start of the tick `ticks` ahead of the current one. */
+    uint32_t target = ktime_get_ticks() + ticks;
+    uint64_t deadline = tsc_base + (uint64_t)(target - tick_base) * tsc_per_tick;
+
+    if (clock_mode == CLOCKEVENT_MODE_TSC_DEADLINE) {
+        clockevent_wrmsr(MSR_IA32_TSC_DEADLINE, deadline);
+        return;
+    }
+
+    uint64_t now = arch_read_tsc();
+    uint64_t delta = deadline > now ? deadline - now : 0;
+    uint64_t count = div_u64_u32(delta * lapic_khz, tsc_khz) + 1;
+    if (count > 0xFFFFFFFFu) {
+        count = 0xFFFFFFFFu;
+    }
+    lapic_write(LAPIC_REG_TIMER_INIT, (uint32_t)count);
+}
+
+void clockevent_reprogram(void) {
+    if (!clockevent_is_oneshot()) return;
+
+    cpu_local_t* cpu = smp_this_cpu();
+    uint32_t cap = (cpu->index == 0) ? CLOCKEVENT_BSP_IDLE_MAX_TICKS : CLOCKEVENT_IDLE_MAX_TICKS;
+    uint32_t ticks = scheduler_next_event(ktime_get_ticks());
+
+    if (ticks > cap) ticks = cap;
+    if (ticks == 0) ticks = 1;
+    clockevent_arm(ticks);
+}
+
+static void clockevent_bsp_tick(uint32_t now) {
+    /* Global per-tick duties formerly run from the PIT handler. */
+    if (clock_mode == CLOCKEVENT_MODE_LAPIC_PERIODIC) {
+        system_ticks = now;
+    }
+    if (now / CLOCKEVENT_NET_POLL_TICKS != bsp_last_tick / CLOCKEVENT_NET_POLL_TICKS) {
+        net_rx_kick();
+    }
+    bsp_last_tick = now;
+    scheduler_advance(now);
+}
+
+static void clockevent_interrupt(void* regs) {
+    (void)regs;
+    cpu_local_t* cpu = smp_this_cpu();
+    uint32_t now;
+    uint32_t elapsed;
+
+    if (clock_mode == CLOCKEVENT_MODE_LAPIC_PERIODIC) {
+        // No TSC: the BSP's interrupts are the clock, every event is one tick
+        now = (cpu->index == 0) ? system_ticks + 1 : system_ticks;
+        elapsed = 1;
+    } else {
+        now = ktime_get_ticks();
+        elapsed = now - cpu->clock_last_tick;
+    }
+    cpu->clock_last_tick = now;
+    cpu->clock_events++;
+    lapic_eoi();
+
+    if (cpu->index == 0) {
+        clockevent_bsp_tick(now);
+    }
+
+    // May switch tasks; schedule() re-arms for whatever runs next
+    scheduler_tick_local(elapsed);
+    clockevent_reprogram();
+}
+
+static void clockevent_start_local(void) {
+    cpu_local_t* cpu = smp_this_cpu();
+    cpu->clock_last_tick = ktime_get_ticks();
+
+    lapic_write(LAPIC_REG_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+    switch (clock_mode) {
+        case CLOCKEVENT_MODE_LAPIC_PERIODIC:
+            lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_PERIODIC | LAPIC_TIMER_VECTOR);
+            lapic_write(LAPIC_REG_TIMER_INIT, lapic_per_tick);
+            break;
+        case CLOCKEVENT_MODE_LAPIC_ONESHOT:
+            lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_ONESHOT | LAPIC_TIMER_VECTOR);
+            clockevent_reprogram();
+            break;
+        case CLOCKEVENT_MODE_TSC_DEADLINE:
+            lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_TSC_DEADLINE | LAPIC_TIMER_VECTOR);
+            asm volatile("mfence" ::: "memory");  // LVT write must land before the MSR
+            clockevent_reprogram();
+            break;
+        default:
+            break;
+    }
+}
+
+void clockevent_init_ap(void) {
+    if (clock_mode == CLOCKEVENT_MODE_PIT) return;  // APs follow the forwarded PIT tick
+    clockevent_start_local();
+}
+
+void clockevent_init(void) {
+    const cpu_info_t* info = cpu_get_info();
+    char buf[16];
+
+    uint32_t hz = arch_timer_get_frequency();
+    if (hz != 0) {
+        tick_ns = NSEC_PER_SEC / hz;
+    }
+
+    if (!info || !info->valid || !info->features.apic || info->lapic_mmio_base == 0 ||
+        (!lapic_available() && lapic_init(info->lapic_mmio_base) != 0)) {
+        serial_puts("CLOCK: no local APIC, keeping the PIT tick\n");
+        return;
+    }
+
+    uint64_t tsc_cycles = 0;
+    uint32_t lapic_counts = 0;
+    if (clockevent_calibrate(&tsc_cycles, &lapic_counts) != 0 || lapic_counts == 0) {
+        serial_puts("CLOCK: PIT channel 2 calibration failed, keeping the PIT tick\n");
+        return;
+    }
+
+    lapic_khz = lapic_counts / CLOCKEVENT_CALIBRATE_MS;
+    lapic_per_tick = (uint32_t)div_u64_u32((uint64_t)lapic_khz * tick_ns, NSEC_PER_MSEC);
+    if (info->features.tsc) {
+        tsc_khz = (uint32_t)div_u64_u32(tsc_cycles, CLOCKEVENT_CALIBRATE_MS);
+    }
+
+    clockevent_mode_t mode = CLOCKEVENT_MODE_LAPIC_PERIODIC;
+    if (tsc_khz >= 1000) {
+        tsc_per_tick = (uint32_t)div_u64_u32((uint64_t)tsc_khz * tick_ns, NSEC_PER_MSEC);
+        cyc2ns_mult = (uint32_t)div_u64_u32((uint64_t)NSEC_PER_MSEC << CLOCKEVENT_CYC2NS_SHIFT, tsc_khz);
+        mode = info->features.tsc_deadline ? CLOCKEVENT_MODE_TSC_DEADLINE : CLOCKEVENT_MODE_LAPIC_ONESHOT;
+    }
+
+    arch_register_interrupt_handler(LAPIC_TIMER_VECTOR, clockevent_interrupt);
+
+    // Hand over from IRQ0 atomically so no tick is counted twice or lost
+    uintptr_t irq = arch_irq_save();
+    arch_disable_irq(0);
+    if (mode != CLOCKEVENT_MODE_LAPIC_PERIODIC) {
+        tick_base = system_ticks;
+        tsc_base = arch_read_tsc();
+        tsc_clocksource = 1;
+    }
+    bsp_last_tick = system_ticks;
+    clock_mode = mode;
+    clockevent_start_local();
+    arch_irq_restore(irq);
+
+    serial_puts("CLOCK: ");
+    serial_puts(clockevent_mode_name());
+    serial_puts(" clock events, LAPIC timer ");
+    itoa(lapic_khz, buf, 10);
+    serial_puts(buf);
+    serial_puts(" kHz");
+    if (tsc_clocksource) {
+        serial_puts(", TSC ");
+        itoa(tsc_khz, buf, 10);
+        serial_puts(buf);
+        serial_puts(" kHz");
+        if (!info->features.invariant_tsc) {
+            serial_puts(" (not invariant)");
+        }
+    }
+    serial_puts("\n");
+}
@@ -267,6 +267,11 @@ uint32_t cpu_get_online_count(void) {
     return g_cpu_info.online_cpus > 0 ? g_cpu_info.online_cpus : 1;
 }
 
+void cpu_set_online_count(uint32_t online) {
+    g_cpu_info.online_cpus = online > 0 ? online : 1;
+    g_cpu_info.smp_active = g_cpu_info.online_cpus > 1;
+}
+
 void cpu_log_summary(void) {
     if (!g_cpu_info.valid) {
         serial_puts("CPU: not detected\n");
@@ -318,7 +323,7 @@ void cpu_log_summary(void) {
     }
 
     if (g_cpu_info.smp_possible && !g_cpu_info.smp_active) {
-        serial_puts("SMP: hardware supports multiple CPUs; AP startup pending in this build\n");
+        serial_puts("SMP: hardware supports multiple CPUs; APs not started\n");
     } else if (g_cpu_info.smp_active) {
         serial_puts("SMP: active\n");
     } else {
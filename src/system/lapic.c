@@ -0,0 +1,127 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * src/system/lapic.c
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+#include <lapic.h>
+#include <arch/paging.h>
+#include <serial.h>
+#include <stdlib.h>
+
+/*
+ * Local APIC access layer (xAPIC MMIO mode).
+ *
+ * The MMIO window is identity-mapped uncached into the kernel directory once
+ * by the BSP; every CPU sees its own LAPIC through the same physical address.
+ */
+
+#define LAPIC_ICR_SPIN_LIMIT 100000
+
+static volatile uint32_t* lapic_mmio = 0;
+
+int lapic_available(void) {
+    return lapic_mmio != 0;
+}
+
+uint32_t lapic_read(uint32_t reg) {
+    return lapic_mmio[reg / 4];
+}
+
+void lapic_write(uint32_t reg, uint32_t value) {
+    lapic_mmio[reg / 4] = value;
+    (void)lapic_mmio[LAPIC_REG_ID / 4];  // Serialise posted MMIO writes
+}
+
+uint32_t lapic_id(void) {
+    if (!lapic_mmio) return 0;
+    return lapic_read(LAPIC_REG_ID) >> 24;
+}
+
+void lapic_eoi(void) {
+    if (lapic_mmio) {
+        lapic_write(LAPIC_REG_EOI, 0);
+    }
+}
+
+static void lapic_enable_local(void) {
+    /* Software-enable the LAPIC and route spurious interrupts to a stub. */
+    lapic_write(LAPIC_REG_TPR, 0);
+    lapic_write(LAPIC_REG_LVT_ERROR, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_REG_ESR, 0);
+    lapic_write(LAPIC_REG_ESR, 0);
+    lapic_write(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+    lapic_eoi();
+}
+
+int lapic_init(uint32_t mmio_base) {
+    if (mmio_base == 0) {
+        return -1;
+    }
+
+    map_page(kernel_directory, mmio_base, mmio_base,
+             PAGE_PRESENT | PAGE_WRITE | PAGE_NOCACHE | PAGE_WRITETHROUGH);
+    lapic_mmio = (volatile uint32_t*)(uintptr_t)mmio_base;
+
+    // BSP keeps its BIOS-programmed LINT0 (ExtINT) so the 8259 PIC still works.
+    lapic_enable_local();
+
+    char buf[16];
+    serial_puts("LAPIC: enabled, id ");
+    itoa(lapic_id(), buf, 10);
+    serial_puts(buf);
+    serial_puts(", version 0x");
+    itoa(lapic_read(LAPIC_REG_VERSION) & 0xFF, buf, 16);
+    serial_puts(buf);
+    serial_puts("\n");
+    return 0;
+}
+
+void lapic_init_ap(void) {
+    if (!lapic_mmio) return;
+
+    // Legacy PIC interrupts are delivered to the BSP only.
+    lapic_write(LAPIC_REG_LVT_LINT0, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_REG_LVT_LINT1, LAPIC_LVT_MASKED);
+    lapic_enable_local();
+}
+
+static int lapic_wait_icr_idle(void) {
+    for (uint32_t i = 0; i < LAPIC_ICR_SPIN_LIMIT; i++) {
+        if (!(lapic_read(LAPIC_REG_ICR_LOW) & LAPIC_ICR_PENDING)) {
+            return 0;
+        }
+        asm volatile("pause");
+    }
+    return -1;
+}
+
+static int lapic_send_icr(uint32_t apic_id, uint32_t low) {
+    if (!lapic_mmio) return -1;
+    if (lapic_wait_icr_idle() != 0) {
+        serial_puts("LAPIC: ICR stuck busy\n");
+        return -1;
+    }
+    lapic_write(LAPIC_REG_ICR_HIGH, apic_id << 24);
+    lapic_write(LAPIC_REG_ICR_LOW, low);
+    return lapic_wait_icr_idle();
+}
+
+int lapic_send_ipi(uint32_t apic_id, uint8_t vector) {
+    return lapic_send_icr(apic_id, LAPIC_ICR_FIXED | LAPIC_ICR_ASSERT | vector);
+}
+
+int lapic_broadcast_ipi(uint8_t vector) {
+    return lapic_send_icr(0, LAPIC_ICR_ALL_BUT_SELF | LAPIC_ICR_FIXED | LAPIC_ICR_ASSERT | vector);
+}
+
+int lapic_send_init(uint32_t apic_id) {
+    return lapic_send_icr(apic_id, LAPIC_ICR_INIT | LAPIC_ICR_ASSERT | LAPIC_ICR_LEVEL);
+}
+
+int lapic_send_startup(uint32_t apic_id, uint8_t page_vector) {
+    return lapic_send_icr(apic_id, LAPIC_ICR_STARTUP | LAPIC_ICR_ASSERT | page_vector);
+}
@@ -0,0 +1,403 @@
+/*
+ * === AOS HEADER BEGIN ===
+ * src/system/smp.c
+ * Copyright (c) 2024 - 2026 Aarav Mehta and aOS Contributors
+ * Licensed under CC BY-NC 4.0
+ * aOS Version : 0.9.0
+ * === AOS HEADER END ===
+ */
+
+#include <smp.h>
+#include <lapic.h>
+#include <clockevent.h>
+#include <cpu.h>
+#include <arch.h>
+#include <arch/paging.h>
+#include <process.h>
+#include <vmm.h>
+#include <io.h>
+#include <serial.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Symmetric multiprocessing bring-up and cross-CPU primitives.
+ *
+ * Responsibilities:
+ * - Start application processors (APs) with INIT-SIPI-SIPI through a
+ *   real-mode trampoline copied below 1MB.
+ * - Own the per-CPU `cpu_local_t` slots (current task, idle task, loaded
+ *   address space).
+ * - Provide the big kernel lock that serialises kernel execution across CPUs.
+ * - Forward scheduler ticks and TLB shootdowns to other CPUs via IPIs.
+ */
+
+#define SMP_NO_OWNER            0xFFFFFFFFu
+#define SMP_AP_START_TIMEOUT    100     // Scheduler ticks to wait for an AP
+#define SMP_TLB_SPIN_LIMIT      10000000
+
+extern uint8_t ap_trampoline_start[];
+extern uint8_t ap_trampoline_end[];
+extern uint8_t ap_trampoline_params[];
+
+static cpu_local_t cpus[SMP_MAX_CPUS];
+static uint32_t cpu_count = 1;
+static volatile uint32_t online_count = 1;
+static volatile int smp_active = 0;
+
+// The BSP owns the kernel from boot until it first leaves ring 0.
+static volatile uint32_t kernel_lock_word = 1;
+static volatile uint32_t kernel_lock_owner = 0;
+
+void smp_ap_entry(uint32_t cpu_index);
+
+cpu_local_t* smp_this_cpu(void) {
+    return &cpus[arch_cpu_index()];
+}
+
+cpu_local_t* smp_cpu(uint32_t index) {
+    if (index >= cpu_count) return NULL;
+    return &cpus[index];
+}
+
+uint32_t smp_cpu_index(void) {
+    return arch_cpu_index();
+}
+
+uint32_t smp_cpu_count(void) {
+    return cpu_count;
+}
+
+uint32_t smp_online_count(void) {
+    return online_count;
+}
+
+int smp_is_active(void) {
+    return smp_active;
+}
+
+static void smp_service_tlb_flush(cpu_local_t* cpu) {
+    if (cpu->tlb_flush_pending) {
+        flush_tlb_full();
+        __sync_synchronize();
+        cpu->tlb_flush_pending = 0;
+    }
+}
+
+void smp_kernel_lock(void) {
+    /*
+     * Interrupts stay off while spinning so the lock is never observed as
+     * "held by nobody on this CPU" by a nested handler; shootdowns aimed at
+     * this CPU are serviced from the spin loop instead of the IPI handler.
+     */
+    uintptr_t irq = arch_irq_save();
+    cpu_local_t* cpu = smp_this_cpu();
+    while (__sync_lock_test_and_set(&kernel_lock_word, 1)) {
+        while (kernel_lock_word) {
+            smp_service_tlb_flush(cpu);
+            asm volatile("pause");
+        }
+    }
+    kernel_lock_owner = cpu->index;
+    arch_irq_restore(irq);
+}
+
+static int smp_kernel_trylock(void) {
+    if (__sync_lock_test_and_set(&kernel_lock_word, 1)) {
+        return 0;
+    }
+    kernel_lock_owner = smp_cpu_index();
+    return 1;
+}
+
+void smp_kernel_unlock(void) {
+    uintptr_t irq = arch_irq_save();
+    kernel_lock_owner = SMP_NO_OWNER;
+    __sync_lock_release(&kernel_lock_word);
+    arch_irq_restore(irq);
+}
+
+int smp_kernel_lock_held(void) {
+    return kernel_lock_word && kernel_lock_owner == smp_cpu_index();
+}
+
+int smp_irq_enter(uint32_t vector) {
+    /* Called by the arch interrupt dispatchers with interrupts disabled. */
+    if (!smp_active || vector == SMP_TLB_VECTOR || vector == LAPIC_SPURIOUS_VECTOR) {
+        return SMP_IRQ_NESTED;
+    }
+    if (smp_kernel_lock_held()) {
+        return SMP_IRQ_NESTED;
+    }
+    if (vector == SMP_TICK_VECTOR) {
+        // A missed tick only delays preemption; never stall user work for it.
+        if (!smp_kernel_trylock()) {
+            lapic_eoi();
+            return SMP_IRQ_SKIP;
+        }
+        return SMP_IRQ_LOCKED;
+    }
+    smp_kernel_lock();
+    return SMP_IRQ_LOCKED;
+}
+
+void smp_irq_exit(int state, int to_user) {
+    /*
+     * A task switch inside the handler may resume a task whose entry did not
+     * take the lock, so never carry it back into user mode.
+     */
+    if (state == SMP_IRQ_LOCKED || (to_user && smp_kernel_lock_held())) {
+        smp_kernel_unlock();
+    }
+}
+
+void smp_wait_for_interrupt(void) {
+    uintptr_t irq = arch_irq_save();
+    int held = smp_active && smp_kernel_lock_held();
+    if (held) {
+        smp_kernel_unlock();
+    }
+    asm volatile("sti; hlt" ::: "memory");
+    if (!(irq & 0x200)) {
+        asm volatile("cli" ::: "memory");
+    }
+    if (held) {
+        smp_kernel_lock();
+    }
+}
+
+void smp_send_tick(void) {
+    if (smp_active && online_count > 1) {
+        lapic_broadcast_ipi(SMP_TICK_VECTOR);
+    }
+}
+
+void smp_send_reschedule(uint32_t cpu) {
+    if (!smp_active || cpu >= cpu_count || !cpus[cpu].online) return;
+    if (cpu == smp_cpu_index()) return;
+    lapic_send_ipi(cpus[cpu].apic_id, SMP_TICK_VECTOR);
+}
+
+void smp_tlb_shootdown(struct address_space* as) {
+    /*
+     * Kernel mappings are shared by every address space, so changes to the
+     * kernel space hit all CPUs; user spaces only matter where loaded.
+     */
+    if (!smp_active || online_count < 2) return;
+
+    cpu_local_t* self = smp_this_cpu();
+    uint32_t targets = 0;
+
+    for (uint32_t i = 0; i < cpu_count; i++) {
+        cpu_local_t* cpu = &cpus[i];
+        if (cpu == self || !cpu->online) continue;
+        if (as && as != kernel_address_space && cpu->address_space != as) continue;
+
+        cpu->tlb_flush_pending = 1;
+        __sync_synchronize();
+        lapic_send_ipi(cpu->apic_id, SMP_TLB_VECTOR);
+        targets |= (1u << i);
+    }
+
+    for (uint32_t spin = 0; targets && spin < SMP_TLB_SPIN_LIMIT; spin++) {
+        for (uint32_t i = 0; i < cpu_count; i++) {
+            if ((targets & (1u << i)) && !cpus[i].tlb_flush_pending) {
+                targets &= ~(1u << i);
+            }
+        }
+        asm volatile("pause");
+    }
+
+    if (targets) {
+        serial_puts("SMP: TLB shootdown timed out\n");
+    }
+}
+
+static void smp_tick_ipi_handler(void* regs) {
+    /* A forwarded PIT tick, or just a reschedule kick with per-CPU timers. */
+    (void)regs;
+    lapic_eoi();
+    scheduler_tick_local(clockevent_get_mode() == CLOCKEVENT_MODE_PIT ? 1 : 0);
+    clockevent_reprogram();
+}
+
+static void smp_tlb_ipi_handler(void* regs) {
+    (void)regs;
+    smp_service_tlb_flush(smp_this_cpu());
+    lapic_eoi();
+}
+
+static void smp_spurious_handler(void* regs) {
+    (void)regs;  // Spurious LAPIC interrupts must not be acknowledged
+}
+
+static inline uintptr_t smp_read_cr0(void) {
+    uintptr_t v;
+    asm volatile("mov %%cr0, %0" : "=r"(v));
+    return v;
+}
+
+static inline uintptr_t smp_read_cr3(void) {
+    uintptr_t v;
+    asm volatile("mov %%cr3, %0" : "=r"(v));
+    return v;
+}
+
+static inline uintptr_t smp_read_cr4(void) {
+    uintptr_t v;
+    asm volatile("mov %%cr4, %0" : "=r"(v));
+    return v;
+}
+
+static void smp_delay_ticks(uint32_t ticks) {
+    uint32_t start = arch_timer_get_ticks();
+    while (arch_timer_get_ticks() - start < ticks) {
+        asm volatile("pause");
+    }
+}
+
+static void smp_delay_us(uint32_t us) {
+    // Each port 0x80 write takes roughly one microsecond on PC hardware.
+    for (uint32_t i = 0; i < us; i++) {
+        io_wait();
+    }
+}
+
+static int smp_start_ap(cpu_local_t* cpu) {
+    smp_ap_boot_params_t* params = (smp_ap_boot_params_t*)(uintptr_t)
+        (SMP_TRAMPOLINE_BASE + (uint32_t)(ap_trampoline_params - ap_trampoline_start));
+
+    params->cr0 = smp_read_cr0();
+    params->cr3 = smp_read_cr3();
+    params->cr4 = smp_read_cr4();
+#if defined(ARCH_X86_64)
+    {
+        uint32_t lo, hi;
+        asm volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(0xC0000080u));
+        params->efer = (((uint64_t)hi << 32) | lo) & ~(1ULL << 10);  // LMA is read-only
+    }
+#else
+    params->efer = 0;
+#endif
+    params->stack_top = cpu->stack_top;
+    params->entry = (uintptr_t)smp_ap_entry;
+    params->cpu_index = cpu->index;
+    __sync_synchronize();
+
+    // INIT, then the STARTUP IPI twice as the MP specification recommends.
+    if (lapic_send_init(cpu->apic_id) != 0) return -1;
+    smp_delay_ticks(2);
+
+    uint8_t page_vector = (uint8_t)(SMP_TRAMPOLINE_BASE >> 12);
+    for (int attempt = 0; attempt < 2 && !cpu->online; attempt++) {
+        if (lapic_send_startup(cpu->apic_id, page_vector) != 0) return -1;
+        smp_delay_us(200);
+    }
+
+    uint32_t start = arch_timer_get_ticks();
+    while (!cpu->online && arch_timer_get_ticks() - start < SMP_AP_START_TIMEOUT) {
+        asm volatile("pause");
+    }
+    return cpu->online ? 0 : -1;
+}
+
+void smp_init(void) {
+    /*
+     * Runs on the BSP after the process manager and PIT are live. APs are
+     * started one at a time because they share the trampoline parameters.
+     */
+    const cpu_info_t* info = cpu_get_info();
+    cpu_local_t* bsp = &cpus[0];
+    char buf[16];
+
+    bsp->index = 0;
+    bsp->online = 1;
+
+    if (!info || !info->valid || !info->features.apic || info->lapic_mmio_base == 0) {
+        serial_puts("SMP: no local APIC, staying single-CPU\n");
+        return;
+    }
+    if (!lapic_available() && lapic_init(info->lapic_mmio_base) != 0) {
+        serial_puts("SMP: LAPIC init failed, staying single-CPU\n");
+        return;
+    }
+    bsp->apic_id = lapic_id();
+
+    arch_register_interrupt_handler(SMP_TICK_VECTOR, smp_tick_ipi_handler);
+    arch_register_interrupt_handler(SMP_TLB_VECTOR, smp_tlb_ipi_handler);
+    arch_register_interrupt_handler(LAPIC_SPURIOUS_VECTOR, smp_spurious_handler);
+
+    if (info->apic_ids_enabled.count < 2) {
+        serial_puts("SMP: single CPU reported by MADT\n");
+        return;
+    }
+
+    memcpy((void*)(uintptr_t)SMP_TRAMPOLINE_BASE, ap_trampoline_start,
+           (size_t)(ap_trampoline_end - ap_trampoline_start));
+
+    smp_active = 1;
+
+    for (uint32_t i = 0; i < info->apic_ids_enabled.count && cpu_count < SMP_MAX_CPUS; i++) {
+        uint32_t apic_id = info->apic_ids_enabled.ids[i];
+        if (apic_id == bsp->apic_id) continue;
+
+        cpu_local_t* cpu = &cpus[cpu_count];
+        void* stack = kmalloc(SMP_AP_STACK_SIZE);
+        void* irq_stack = kmalloc(SMP_AP_STACK_SIZE);
+        if (!stack || !irq_stack) {
+            if (stack) kfree(stack);
+            if (irq_stack) kfree(irq_stack);
+            serial_puts("SMP: out of memory for AP stacks\n");
+            break;
+        }
+
+        memset(cpu, 0, sizeof(*cpu));
+        cpu->index = cpu_count;
+        cpu->apic_id = apic_id;
+        cpu->stack_top = (uintptr_t)stack + SMP_AP_STACK_SIZE;
+        cpu->irq_stack_top = (uintptr_t)irq_stack + SMP_AP_STACK_SIZE;
+        cpu_count++;
+
+        serial_puts("SMP: starting CPU ");
+        itoa(cpu->index, buf, 10);
+        serial_puts(buf);
+        serial_puts(" (APIC ");
+        itoa(apic_id, buf, 10);
+        serial_puts(buf);
+        serial_puts(")... ");
+
+        if (smp_start_ap(cpu) == 0) {
+            serial_puts("online\n");
+        } else {
+            // Park the AP again so a late start cannot reuse the next CPU's stack.
+            serial_puts("no response\n");
+            lapic_send_init(apic_id);
+            cpu_count--;
+            kfree(stack);
+            kfree(irq_stack);
+        }
+    }
+
+    cpu_set_online_count(online_count);
+
+    serial_puts("SMP: ");
+    itoa(online_count, buf, 10);
+    serial_puts(buf);
+    serial_puts(" CPU(s) online\n");
+}
+
+void smp_ap_entry(uint32_t cpu_index) {
+    /* First C code on an AP; entered from ap_trampoline.s on its own stack. */
+    cpu_local_t* cpu = &cpus[cpu_index];
+
+    arch_smp_cpu_init(cpu_index, cpu->irq_stack_top);
+    lapic_init_ap();
+    cpu->address_space = kernel_address_space;
+
+    __sync_fetch_and_add(&online_count, 1);
+    cpu->online = 1;
+
+    smp_kernel_lock();
+    clockevent_init_ap();
+    process_run_cpu_idle();
+}
@@ -9,6 +9,10 @@
 
 #include <command_registry.h>
 #include <cpu.h>
+#include <smp.h>
+#include <clockevent.h>
+#include <ktime.h>
+#include <process.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -118,7 +122,159 @@ static void cmd_cpuinfo(const char* args) {
         kprint(line);
     }
 
+    strcpy(line, "Clock events: ");
+    strcat(line, clockevent_mode_name());
+    if (clockevent_lapic_khz() > 0) {
+        strcat(line, ", LAPIC timer ");
+        itoa(clockevent_lapic_khz(), num, 10);
+        strcat(line, num);
+        strcat(line, " kHz");
+    }
+    if (clockevent_tsc_khz() > 0) {
+        strcat(line, ", TSC ");
+        itoa(clockevent_tsc_khz(), num, 10);
+        strcat(line, num);
+        strcat(line, " kHz");
+    }
+    kprint(line);
+
     kprint(info->smp_active ? "SMP state: active" : (info->smp_possible ? "SMP state: capable (AP startup not active)" : "SMP state: single-core mode"));
+
+    for (uint32_t i = 0; i < smp_cpu_count(); i++) {
+        cpu_local_t* cpu = smp_cpu(i);
+        strcpy(line, "  CPU ");
+        itoa(i, num, 10);
+        strcat(line, num);
+        strcat(line, ": APIC ");
+        itoa(cpu->apic_id, num, 10);
+        strcat(line, num);
+        strcat(line, cpu->online ? ", online, ticks " : ", offline, ticks ");
+        itoa(cpu->ticks, num, 10);
+        strcat(line, num);
+        strcat(line, ", timer irqs ");
+        itoa(cpu->clock_events, num, 10);
+        strcat(line, num);
+        if (cpu->current) {
+            strcat(line, ", running ");
+            strcat(line, cpu->current->name);
+        }
+        kprint(line);
+    }
+}
+
+/*
+ * smpbench: run the same CPU-bound loop with 1 worker and then with one
+ * worker per online CPU. Workers drop the kernel lock while computing, so
+ * with working SMP the N-worker round takes about as long as the 1-worker
+ * round while doing N times the work.
+ */
+#define SMPBENCH_DEFAULT_ITERATIONS 20000000u
+
+static uint32_t smpbench_iterations = SMPBENCH_DEFAULT_ITERATIONS;
+static volatile uint32_t smpbench_remaining = 0;
+static volatile uint32_t smpbench_sink = 0;
+
+static void smpbench_worker(void) {
+    uint32_t x = (uint32_t)process_getpid();
+
+    smp_kernel_unlock();
+    for (uint32_t i = 0; i < smpbench_iterations; i++) {
+        x = x * 1103515245u + 12345u;
+    }
+    smp_kernel_lock();
+
+    smpbench_sink += x;
+    __sync_fetch_and_sub(&smpbench_remaining, 1);
+    process_exit(0);
+    while (1) {
+        schedule();
+    }
+}
+
+static int smpbench_round(uint32_t workers, uint32_t* elapsed_ms) {
+    pid_t pids[SMP_MAX_CPUS];
+    uint32_t started = 0;
+
+    smpbench_remaining = workers;
+    uint32_t start = ktime_get_ms();
+    for (uint32_t i = 0; i < workers; i++) {
+        pids[i] = process_create_kernel_thread("smpbench", smpbench_worker, PRIORITY_NORMAL);
+        if (pids[i] < 0) {
+            __sync_fetch_and_sub(&smpbench_remaining, workers - i);
+            break;
+        }
+        started++;
+    }
+
+    while (smpbench_remaining != 0) {
+        smp_wait_for_interrupt();
+    }
+    *elapsed_ms = ktime_get_ms() - start;
+
+    for (uint32_t i = 0; i < started; i++) {
+        int status;
+        process_waitpid(pids[i], &status, 0);
+    }
+    return started == workers ? 0 : -1;
+}
+
+static void cmd_smpbench(const char* args) {
+    char line[128];
+    char num[24];
+    uint32_t workers = smp_online_count();
+    uint32_t single_ms = 0;
+    uint32_t multi_ms = 0;
+
+    smpbench_iterations = SMPBENCH_DEFAULT_ITERATIONS;
+    if (args && *args) {
+        uint32_t millions = (uint32_t)atoi(args);
+        if (millions > 0) {
+            smpbench_iterations = millions * 1000000u;
+        }
+    }
+
+    strcpy(line, "smpbench: ");
+    itoa(workers, num, 10);
+    strcat(line, num);
+    strcat(line, " online CPU(s), ");
+    itoa(smpbench_iterations / 1000000u, num, 10);
+    strcat(line, num);
+    strcat(line, "M iterations per worker");
+    kprint(line);
+
+    if (smpbench_round(1, &single_ms) != 0 || smpbench_round(workers, &multi_ms) != 0) {
+        kprint("smpbench: failed to start worker threads");
+        return;
+    }
+
+    strcpy(line, "  1 worker:  ");
+    itoa(single_ms, num, 10);
+    strcat(line, num);
+    strcat(line, " ms");
+    kprint(line);
+
+    strcpy(line, "  ");
+    itoa(workers, num, 10);
+    strcat(line, num);
+    strcat(line, " workers: ");
+    itoa(multi_ms, num, 10);
+    strcat(line, num);
+    strcat(line, " ms");
+    kprint(line);
+
+    if (multi_ms > 0) {
+        // Throughput speedup = (workers * single) / multi, in hundredths
+        uint32_t speedup = (uint32_t)div_u64_u32((uint64_t)workers * single_ms * 100, multi_ms);
+        strcpy(line, "  Speedup: ");
+        itoa(speedup / 100, num, 10);
+        strcat(line, num);
+        strcat(line, ".");
+        if (speedup % 100 < 10) strcat(line, "0");
+        itoa(speedup % 100, num, 10);
+        strcat(line, num);
+        strcat(line, "x");
+        kprint(line);
+    }
 }
 
 static void cmd_cpufeatures(const char* args) {
@@ -156,4 +312,5 @@ static void cmd_cpufeatures(const char* args) {
 void cmd_module_cpu_register(void) {
     command_register_with_category("cpuinfo", "", "Show CPU model/topology detection", "System", cmd_cpuinfo);
     command_register_with_category("cpufeatures", "", "Show CPU instruction and platform flags", "System", cmd_cpufeatures);
+    command_register_with_category("smpbench", "[millions]", "Measure CPU-bound scaling across online CPUs", "System", cmd_smpbench);
 }
@@ -26,6 +26,10 @@
 #include <fs/simplefs.h>
 #include <fs/fat32.h>
 #include <dev/ata.h>
+#include <dev/blkdev.h>
+#include <dev/virtio_blk.h>
+#include <fs/bcache.h>
+#include <ktime.h>
 #include <user.h>
 #include <editor.h>
 #include <memory.h>
@@ -142,6 +146,8 @@ static int install_write_buffer_to_disk(uint32_t start_lba, const uint8_t* data,
     uint32_t sectors = install_sectors_for_size(data_size);
     uint8_t sector_buf[INSTALL_SECTOR_SIZE];
 
+    bcache_invalidate(BCACHE_DEV_ATA0, start_lba, sectors);
+
     for (uint32_t i = 0; i < sectors; i++) {
         memset(sector_buf, 0, sizeof(sector_buf));
         uint32_t src_offset = i * INSTALL_SECTOR_SIZE;
@@ -921,6 +927,15 @@ static void cmd_pwd(const char* args) {
     kprint(cwd ? cwd : "/");
 }
 
+static void cmd_sync(const char* args) {
+    (void)args;
+    if (vfs_sync() != VFS_OK) {
+        kprint("sync: some blocks could not be written");
+        return;
+    }
+    kprint("sync: filesystems flushed");
+}
+
 static void cmd_disk_info(const char* args) {
     (void)args;
     char buf[32];
@@ -928,6 +943,20 @@ static void cmd_disk_info(const char* args) {
     if (ata_drive_available()) {
         kprint("ATA Drive Status: Available");
         kprint("Disk operations: Enabled");
+        ata_stats_t ata_stats;
+        ata_get_stats(&ata_stats);
+        kprint(ata_stats.dma_enabled ? "Transfer mode: bus-master DMA (IRQ 14)" : "Transfer mode: PIO");
+        kprint(ata_stats.lba48 ? "Addressing: LBA48" : "Addressing: LBA28");
+        vga_puts("Disk size: ");
+        itoa(ata_get_sector_count() / 2048, buf, 10);
+        vga_puts(buf);
+        vga_puts(" MB, ");
+        itoa(ata_stats.commands, buf, 10);
+        vga_puts(buf);
+        vga_puts(" commands (");
+        itoa(ata_stats.sectors_read + ata_stats.sectors_written, buf, 10);
+        vga_puts(buf);
+        kprint(" sectors)");
         kprint("Filesystem: SimpleFS (if mounted)");
         kprint("");
         
@@ -982,7 +1011,236 @@ static void cmd_disk_info(const char* args) {
         }
     } else {
         kprint("ATA Drive Status: Not Available");
-        kprint("Using RAM-based filesystem (ramfs)");
+        if (blk_device_count() == 0) {
+            kprint("Using RAM-based filesystem (ramfs)");
+        }
+    }
+
+    virtio_blk_stats_t vstats;
+    virtio_blk_get_stats(&vstats);
+    if (vstats.available) {
+        kprint("");
+        kprint(vstats.read_only ? "VirtIO Disk (vda): Available, read-only" : "VirtIO Disk (vda): Available");
+        vga_puts("Completion: ");
+        if (vstats.irq) {
+            vga_puts("IRQ ");
+            itoa(vstats.irq, buf, 10);
+            kprint(buf);
+        } else {
+            kprint("polled");
+        }
+        vga_puts("Disk size: ");
+        itoa(vstats.capacity / 2048, buf, 10);
+        vga_puts(buf);
+        vga_puts(" MB, ");
+        itoa(vstats.requests, buf, 10);
+        vga_puts(buf);
+        vga_puts(" requests (");
+        itoa(vstats.sectors_read + vstats.sectors_written, buf, 10);
+        vga_puts(buf);
+        vga_puts(" sectors), up to ");
+        itoa(vstats.max_in_flight, buf, 10);
+        vga_puts(buf);
+        kprint(" in flight");
+    }
+}
+
+#define DISKBENCH_CHUNK_SECTORS 128
+#define DISKBENCH_MAX_CHUNK     2048
+#define DISKBENCH_DEFAULT_MB    16
+#define DISKBENCH_MAX_MB        1024
+
+static void cmd_diskbench(const char* args) {
+    /* Sequential raw read from LBA 0, bypassing the buffer cache. */
+    if (!ata_drive_available()) {
+        kprint("diskbench: no ATA drive available");
+        return;
+    }
+
+    uint32_t mb = DISKBENCH_DEFAULT_MB;
+    uint32_t chunk_sectors = DISKBENCH_CHUNK_SECTORS;
+    int use_pio = 0;
+    if (args && *args) {
+        if (strstr(args, "--pio")) {
+            use_pio = 1;
+        }
+        const char* chunk_arg = strstr(args, "--chunk=");
+        if (chunk_arg) {
+            chunk_sectors = (uint32_t)atoi(chunk_arg + 8);
+        }
+        if (*args >= '0' && *args <= '9') {
+            mb = (uint32_t)atoi(args);
+        }
+    }
+    if (mb == 0) mb = DISKBENCH_DEFAULT_MB;
+    if (mb > DISKBENCH_MAX_MB) mb = DISKBENCH_MAX_MB;
+    if (chunk_sectors == 0) chunk_sectors = 1;
+    if (chunk_sectors > DISKBENCH_MAX_CHUNK) chunk_sectors = DISKBENCH_MAX_CHUNK;
+
+    uint32_t sectors = mb * 2048;
+    if (sectors > ata_get_sector_count()) {
+        sectors = ata_get_sector_count();
+    }
+    if (sectors == 0) {
+        kprint("diskbench: disk too small");
+        return;
+    }
+
+    uint8_t* buffer = (uint8_t*)kmalloc(chunk_sectors * ATA_SECTOR_SIZE);
+    if (!buffer) {
+        kprint("diskbench: out of memory");
+        return;
+    }
+
+    ata_stats_t before;
+    ata_stats_t after;
+    ata_get_stats(&before);
+    if (use_pio) {
+        ata_set_dma_enabled(0);
+    }
+
+    uint32_t start = ktime_get_ms();
+    uint32_t done = 0;
+    while (done < sectors) {
+        uint32_t chunk = sectors - done;
+        if (chunk > chunk_sectors) chunk = chunk_sectors;
+        if (ata_read_sectors(done, chunk, buffer) != 0) {
+            kprint("diskbench: read error");
+            break;
+        }
+        done += chunk;
+    }
+    uint32_t elapsed_ms = ktime_get_ms() - start;
+
+    if (use_pio && before.dma_enabled) {
+        ata_set_dma_enabled(1);
+    }
+    ata_get_stats(&after);
+    kfree(buffer);
+
+    char line[96];
+    char num[16];
+    uint32_t kb = done / 2;
+    uint32_t sleep_ms = (uint32_t)div_u64_u32(after.sleep_ns - before.sleep_ns, NSEC_PER_MSEC);
+
+    strcpy(line, "diskbench: ");
+    strcat(line, use_pio || !before.dma_enabled ? "PIO" : "DMA");
+    strcat(line, ", ");
+    itoa(kb / 1024, num, 10);
+    strcat(line, num);
+    strcat(line, " MB in ");
+    itoa(elapsed_ms, num, 10);
+    strcat(line, num);
+    strcat(line, " ms, ");
+    itoa(after.commands - before.commands, num, 10);
+    strcat(line, num);
+    strcat(line, " commands");
+    kprint(line);
+
+    if (elapsed_ms > 0) {
+        strcpy(line, "  Throughput: ");
+        itoa(kb * 1000 / elapsed_ms, num, 10);
+        strcat(line, num);
+        strcat(line, " KB/s");
+        kprint(line);
+
+        // Time the reader slept on the IRQ is CPU time other tasks could use
+        strcpy(line, "  CPU free during I/O: ");
+        itoa((sleep_ms > elapsed_ms ? elapsed_ms : sleep_ms) * 100 / elapsed_ms, num, 10);
+        strcat(line, num);
+        strcat(line, "%");
+        kprint(line);
+    }
+}
+
+static void iostat_print_hist(const char* label, const uint32_t* hist, uint32_t first, uint32_t last,
+                              uint32_t buckets, uint32_t base, int latency) {
+    /* Bucket i covers values below base << i; the last bucket is open-ended. */
+    char line[160];
+    char num[16];
+
+    strcpy(line, label);
+    for (uint32_t i = first; i < last; i++) {
+        int open_ended = (i == buckets - 1);
+        uint32_t bound = open_ended ? base << (i - 1) : base << i;
+        if (latency) {
+            strcat(line, open_ended ? " >=" : " <");
+        } else {
+            strcat(line, open_ended ? " >" : " <=");
+        }
+        if (latency && bound >= 1000) {
+            itoa(bound / 1000, num, 10);   // Approximate: 1024 us prints as 1ms
+            strcat(line, num);
+            strcat(line, "ms");
+        } else {
+            itoa(bound, num, 10);
+            strcat(line, num);
+        }
+        strcat(line, ":");
+        itoa(hist[i], num, 10);
+        strcat(line, num);
+    }
+    kprint(line);
+}
+
+static void cmd_iostat(const char* args) {
+    /* Block-layer queue statistics for every registered disk. */
+    (void)args;
+    if (blk_device_count() == 0) {
+        kprint("iostat: no block devices");
+        return;
+    }
+
+    for (uint32_t dev = 0; dev < blk_device_count(); dev++) {
+        blk_device_t* disk = blk_get_device(dev);
+        blk_stats_t stats;
+        if (!disk || blk_get_stats(dev, &stats) != 0) {
+            continue;
+        }
+
+        char line[128];
+        char num[16];
+        strcpy(line, disk->name);
+        strcat(line, ": ");
+        itoa(stats.bios, num, 10);
+        strcat(line, num);
+        strcat(line, " bios in ");
+        itoa(stats.requests, num, 10);
+        strcat(line, num);
+        strcat(line, " requests (");
+        itoa(stats.merged, num, 10);
+        strcat(line, num);
+        strcat(line, " merged), ");
+        itoa(stats.expired, num, 10);
+        strcat(line, num);
+        strcat(line, " expired, ");
+        itoa(stats.errors, num, 10);
+        strcat(line, num);
+        strcat(line, " errors");
+        kprint(line);
+
+        strcpy(line, "  read ");
+        itoa(stats.sectors_read / 2, num, 10);
+        strcat(line, num);
+        strcat(line, " KB in ");
+        itoa(stats.reads, num, 10);
+        strcat(line, num);
+        strcat(line, " requests, wrote ");
+        itoa(stats.sectors_written / 2, num, 10);
+        strcat(line, num);
+        strcat(line, " KB in ");
+        itoa(stats.writes, num, 10);
+        strcat(line, num);
+        strcat(line, " requests, max depth ");
+        itoa(stats.max_depth, num, 10);
+        strcat(line, num);
+        kprint(line);
+
+        iostat_print_hist("  depth:  ", stats.depth_hist, 0, BLK_DEPTH_BUCKETS, BLK_DEPTH_BUCKETS, 1, 0);
+        iostat_print_hist("  latency:", stats.latency_hist, 0, BLK_LAT_BUCKETS / 2,
+                          BLK_LAT_BUCKETS, BLK_LAT_BASE_US, 1);
+        iostat_print_hist("  latency:", stats.latency_hist, BLK_LAT_BUCKETS / 2, BLK_LAT_BUCKETS,
+                          BLK_LAT_BUCKETS, BLK_LAT_BASE_US, 1);
     }
 }
 
@@ -993,7 +1251,7 @@ static void cmd_format(const char* args) {
     }
     
     uint32_t total_sectors = ata_get_sector_count();
-    uint32_t disk_mb = (total_sectors * 512) / (1024 * 1024);
+    uint32_t disk_mb = total_sectors / 2048;
     uint32_t format_start = 0;
     uint32_t format_sectors = total_sectors;
     const char* target_desc = "whole disk";
@@ -1503,6 +1761,9 @@ void cmd_module_filesystem_register(void) {
     command_register_with_category("mkfld", "<dirname>", "Create directory", "Filesystem", cmd_mkfld);
     command_register_with_category("go", "<directory>", "Change working directory", "Filesystem", cmd_go);
     command_register_with_category("pwd", "", "Print working directory", "Filesystem", cmd_pwd);
+    command_register_with_category("sync", "", "Write cached filesystem data to disk", "Filesystem", cmd_sync);
+    command_register_with_category("iostat", "", "Show block queue depth and latency histograms", "Filesystem", cmd_iostat);
+    command_register_with_category("diskbench", "[MB] [--pio] [--chunk=sectors]", "Measure sequential disk read throughput", "Filesystem", cmd_diskbench);
     command_register_with_category("disk-info", "", "Display disk information", "Filesystem", cmd_disk_info);
     command_register_with_category("install", "[--force]", "Install aOS layout (ABL bootloader + simplefs data partition)", "Filesystem", cmd_install);
     command_register_with_category("format", "<simplefs|fat32>", "Format target disk/partition", "Filesystem", cmd_format);
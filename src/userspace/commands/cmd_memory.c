@@ -23,9 +23,11 @@
 #include <stdlib.h>
 #include <pmm.h>
 #include <vmm.h>
+#include <kheap.h>
 #include <process.h>
 #include <shell.h>
 #include <mem_debug.h>
+#include <arch.h>
 
 // Forward declarations
 extern void kprint(const char *str);
@@ -266,6 +268,129 @@ static void cmd_test_page(const char* args) {
     vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
 }
 
+// PMM allocator microbenchmark
+#define PMM_BENCH_BATCH 256
+static void* pmm_bench_pages[PMM_BENCH_BATCH];
+
+static uint32_t pmm_bench_per_op(uint64_t cycles, uint32_t ops) {
+    /* 32-bit division only: i386 builds do not link the 64-bit helpers. */
+    while (cycles > 0xFFFFFFFFULL) {
+        cycles >>= 1;
+        ops >>= 1;
+    }
+    return ops ? (uint32_t)cycles / ops : 0;
+}
+
+static void pmm_bench_report(const char *label, uint64_t alloc_cycles, uint64_t free_cycles, uint32_t ops) {
+    char buf[32];
+    
+    vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+    vga_puts(label);
+    vga_set_color(VGA_ATTR(VGA_COLOR_WHITE, VGA_COLOR_BLACK));
+    vga_puts("alloc ");
+    itoa(pmm_bench_per_op(alloc_cycles, ops), buf, 10);
+    vga_puts(buf);
+    vga_puts(" cyc/op, free ");
+    itoa(pmm_bench_per_op(free_cycles, ops), buf, 10);
+    vga_puts(buf);
+    vga_puts(" cyc/op");
+    vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    kprint("");
+}
+
+static void cmd_pmm_bench(const char* args) {
+    uint32_t rounds = 1000;
+    if (args && *args) {
+        int parsed = atoi(args);
+        if (parsed > 0) {
+            rounds = (uint32_t)parsed;
+        }
+    }
+    
+    vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
+    kprint("=== PMM Allocator Benchmark ===");
+    vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    kprint("");
+    
+    uint32_t free_before = pmm_get_free_frames();
+    uint64_t alloc_cycles = 0;
+    uint64_t free_cycles = 0;
+    
+    // Single page alloc/free pairs (hot LIFO path)
+    for (uint32_t i = 0; i < rounds; i++) {
+        uint64_t t0 = arch_read_tsc();
+        void *page = alloc_page();
+        uint64_t t1 = arch_read_tsc();
+        free_page(page);
+        uint64_t t2 = arch_read_tsc();
+        alloc_cycles += t1 - t0;
+        free_cycles += t2 - t1;
+    }
+    pmm_bench_report("  order-0 pair:   ", alloc_cycles, free_cycles, rounds);
+    
+    // Batched single pages (exercises splitting and coalescing)
+    uint32_t batch_rounds = (rounds + PMM_BENCH_BATCH - 1) / PMM_BENCH_BATCH;
+    alloc_cycles = 0;
+    free_cycles = 0;
+    for (uint32_t r = 0; r < batch_rounds; r++) {
+        uint64_t t0 = arch_read_tsc();
+        for (int i = 0; i < PMM_BENCH_BATCH; i++) {
+            pmm_bench_pages[i] = alloc_page();
+        }
+        uint64_t t1 = arch_read_tsc();
+        for (int i = 0; i < PMM_BENCH_BATCH; i++) {
+            free_page(pmm_bench_pages[i]);
+        }
+        uint64_t t2 = arch_read_tsc();
+        alloc_cycles += t1 - t0;
+        free_cycles += t2 - t1;
+    }
+    pmm_bench_report("  order-0 batch:  ", alloc_cycles, free_cycles, batch_rounds * PMM_BENCH_BATCH);
+    
+    // Multi-page contiguous blocks
+    static const uint32_t contig_sizes[] = {4, 16, 64};
+    static const char *contig_labels[] = {"  4 contiguous:  ", "  16 contiguous: ", "  64 contiguous: "};
+    for (int s = 0; s < 3; s++) {
+        uint32_t pages = contig_sizes[s];
+        uint32_t done = 0;
+        alloc_cycles = 0;
+        free_cycles = 0;
+        for (uint32_t i = 0; i < rounds; i++) {
+            uint64_t t0 = arch_read_tsc();
+            void *block = alloc_pages_contiguous(pages);
+            uint64_t t1 = arch_read_tsc();
+            if (!block) {
+                break;
+            }
+            for (uint32_t p = 0; p < pages; p++) {
+                free_page((void*)((uintptr_t)block + ((uintptr_t)p * 4096U)));
+            }
+            uint64_t t2 = arch_read_tsc();
+            alloc_cycles += t1 - t0;
+            free_cycles += t2 - t1;
+            done++;
+        }
+        if (done == 0) {
+            vga_set_color(VGA_ATTR(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+            vga_puts(contig_labels[s]);
+            kprint("SKIPPED - Not enough contiguous memory");
+            vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+            continue;
+        }
+        pmm_bench_report(contig_labels[s], alloc_cycles, free_cycles, done);
+    }
+    
+    kprint("");
+    if (pmm_get_free_frames() != free_before) {
+        vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_RED, VGA_COLOR_BLACK));
+        kprint("WARNING: Free frame count changed during benchmark!");
+    } else {
+        vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
+        kprint("Benchmark completed, all frames returned.");
+    }
+    vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+}
+
 static void cmd_showmem(const char* args) {
     (void)args;
     
@@ -299,10 +424,26 @@ static void cmd_showmem(const char* args) {
     kprint("");
     vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREEN, VGA_COLOR_BLACK));
     vga_puts("Kernel Heap: ");
+    kheap_stats_t heap;
+    kheap_get_stats(&heap);
+    vga_set_color(VGA_ATTR(VGA_COLOR_YELLOW, VGA_COLOR_BLACK));
+    itoa(heap.used_bytes / 1024, num_str, 10);
+    vga_puts(num_str);
+    vga_puts(" KB");
+    vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
+    vga_puts(" / ");
     vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_CYAN, VGA_COLOR_BLACK));
-    vga_puts("2 MB");
+    itoa((KHEAP_END - KHEAP_START) / 1024, num_str, 10);
+    vga_puts(num_str);
+    vga_puts(" KB");
     vga_set_color(VGA_ATTR(VGA_COLOR_DARK_GREY, VGA_COLOR_BLACK));
-    vga_puts(" allocated (0x500000 - 0x700000)");
+    vga_puts(" used (0x");
+    itoa(KHEAP_START, num_str, 16);
+    vga_puts(num_str);
+    vga_puts(" - 0x");
+    itoa(KHEAP_END, num_str, 16);
+    vga_puts(num_str);
+    vga_puts(")");
     vga_set_color(VGA_ATTR(VGA_COLOR_LIGHT_GREY, VGA_COLOR_BLACK));
     kprint("");
     
@@ -607,4 +748,5 @@ void cmd_module_memory_register(void) {
     // Test commands
     command_register_with_category("test-page", "", "Test page allocation", "Memory", cmd_test_page);
     command_register_with_category("mem-test", "", "Run comprehensive memory tests", "Memory", cmd_mem_test);
+    command_register_with_category("pmm-bench", "[iterations]", "Benchmark physical page alloc/free cycles", "Memory", cmd_pmm_bench);
 }
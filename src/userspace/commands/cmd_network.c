@@ -22,6 +22,7 @@
 #include <net/net.h>
 #include <net/icmp.h>
 #include <net/tcp.h>
+#include <net/tcp_cong.h>
 #include <net/udp.h>
 #include <net/arp.h>
 #include <net/ethernet.h>
@@ -36,6 +37,7 @@
 #include <vmm.h>
 #include <fs/vfs.h>
 #include <shell.h>
+#include <smp.h>
 
 extern uint32_t get_tick_count(void);
 
@@ -159,7 +161,7 @@ void cmd_ping(const char* args) {
         while ((get_tick_count() - start) < timeout_ms && !ping_reply_received && !shell_is_cancelled()) {
             // Yield to allow interrupts
             __asm__ volatile("sti");
-            __asm__ volatile("hlt");
+            smp_wait_for_interrupt();
             
             // Poll for incoming packets
             net_poll();
@@ -303,14 +305,91 @@ void cmd_ifconfig(const char* args) {
     }
 }
 
+static void netstat_put_kv(const char* key, uint32_t value, const char* unit) {
+    char num[16];
+    vga_puts(key);
+    itoa(value, num, 10);
+    vga_puts(num);
+    vga_puts(unit);
+}
+
+static void netstat_put_endpoint(uint32_t ip, uint16_t port) {
+    /* "ip:port" left-aligned in a 23-column field. */
+    char text[24];
+    char num[8];
+    strncpy(text, ip_to_string(ip), sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+    itoa(port, num, 10);
+    size_t len = strlen(text);
+    if (len + 1 + strlen(num) < sizeof(text)) {
+        text[len++] = ':';
+        strcpy(text + len, num);
+    }
+    vga_puts(text);
+    for (size_t i = strlen(text); i < 23; i++) {
+        vga_puts(" ");
+    }
+}
+
 void cmd_netstat(const char* args) {
     (void)args;
+    static tcp_conn_info_t conns[32];
     
     vga_puts("Active Internet connections\n");
-    vga_puts("Proto  Local Address          State\n");
+    vga_puts("Proto  Local Address          Foreign Address        State\n");
+    
+    int conn_count = tcp_get_connections(conns, 32);
+    for (int i = 0; i < conn_count; i++) {
+        tcp_conn_info_t* c = &conns[i];
+        vga_puts("tcp    ");
+        netstat_put_endpoint(c->local_ip, c->local_port);
+        netstat_put_endpoint(c->remote_ip, c->remote_port);
+        vga_puts(tcp_state_to_string(c->state));
+        vga_puts("\n");
+        
+        // Congestion and retransmission state, one line per connection
+        vga_puts("       ");
+        vga_puts(c->cong);
+        netstat_put_kv(" cwnd=", c->cwnd, "");
+        if (c->ssthresh == 0xFFFFFFFF) {
+            vga_puts(" ssthresh=-");
+        } else {
+            netstat_put_kv(" ssthresh=", c->ssthresh, "");
+        }
+        netstat_put_kv(" inflight=", c->in_flight, "");
+        netstat_put_kv(" rtt=", c->srtt_ms, "");
+        netstat_put_kv("/", c->rttvar_ms, "ms");
+        netstat_put_kv(" rto=", c->rto_ms, "ms");
+        netstat_put_kv(" retrans=", c->retrans_segs, "");
+        netstat_put_kv(" fast=", c->fast_retransmits, "");
+        netstat_put_kv(" timeouts=", c->timeouts, "\n");
+        
+        // Negotiated options and the receive side
+        netstat_put_kv("       mss=", c->mss, "");
+        if (c->wscale_ok) {
+            netstat_put_kv(" wscale=", c->snd_wscale, "");
+            netstat_put_kv("/", c->rcv_wscale, "");
+        }
+        if (c->sack_ok) {
+            vga_puts(" sack");
+        }
+        if (c->ts_ok) {
+            vga_puts(" ts");
+        }
+        netstat_put_kv(" rcvbuf=", c->rcv_buf, "");
+        netstat_put_kv(" ooo=", c->ooo_ranges, "\n");
+    }
+    if (conn_count == 0) {
+        vga_puts("(No connections)\n");
+    }
     
-    // This is a simplified implementation
-    // In a real implementation, we would iterate through all TCP/UDP sockets
+    char algorithms[64];
+    tcp_cong_list(algorithms, sizeof(algorithms));
+    vga_puts("TCP congestion control: ");
+    vga_puts(tcp_cong_default()->name);
+    vga_puts(" (available: ");
+    vga_puts(algorithms);
+    vga_puts(")\n");
     
     vga_puts("\nActive ARP cache entries:\n");
     vga_puts("IP Address       Hardware Address\n");
@@ -22,6 +22,8 @@
 #include <string.h>
 #include <stdlib.h>
 #include <partition.h>
+#include <fs/vfs.h>
+#include <dev/blkdev.h>
 
 extern void kprint(const char *str);
 
@@ -35,8 +37,8 @@ static void cmd_partitions(const char* args) {
     }
     
     kprint("Disk Partitions:");
-    kprint("ID  NAME            TYPE    START       SIZE        MOUNT");
-    kprint("--  --------------  ------  ----------  ----------  --------");
+    kprint("ID  DISK  NAME            TYPE    START       SIZE        MOUNT");
+    kprint("--  ----  --------------  ------  ----------  ----------  --------");
     
     for (int i = 0; i < count; i++) {
         partition_t* part = partition_get(i);
@@ -56,8 +58,12 @@ static void cmd_partitions(const char* args) {
                 default:               type_str = "EMPTY "; break;
             }
             
+            blk_device_t* disk = blk_get_device(part->dev);
+
             strcpy(line, id_str);
             strcat(line, "   ");
+            strcat(line, disk ? disk->name : "?");
+            strcat(line, "  ");
             strcat(line, part->name);
             strcat(line, "  ");
             strcat(line, type_str);
@@ -79,7 +85,7 @@ static void cmd_partitions(const char* args) {
 
 static void cmd_partmount(const char* args) {
     if (!args || strlen(args) == 0) {
-        kprint("Usage: partmount <partition_id> <mount_point> <fs_type>");
+        kprint("Usage: partmount <partition_id> <mount_point> <fs_type> [noatime|relatime|lazytime,...]");
         return;
     }
     
@@ -98,14 +104,26 @@ static void cmd_partmount(const char* args) {
     strncpy(mount_str, mount_point, p - mount_point);
     
     while (*p == ' ') p++;
-    const char* fs_type = p;
+    const char* fs_start = p;
+    while (*p && *p != ' ') p++;
+    
+    char fs_type[16] = {0};
+    uint32_t fs_len = (uint32_t)(p - fs_start);
+    strncpy(fs_type, fs_start, fs_len < sizeof(fs_type) - 1 ? fs_len : sizeof(fs_type) - 1);
+    
+    while (*p == ' ') p++;
+    uint32_t flags = 0;
+    if (*p && vfs_parse_mount_options(p, &flags) != VFS_OK) {
+        kprint("Error: Unknown mount option");
+        return;
+    }
     
     if (strlen(mount_str) == 0 || strlen(fs_type) == 0) {
         kprint("Error: Missing arguments");
         return;
     }
     
-    if (partition_mount(id, mount_str, fs_type) == 0) {
+    if (partition_mount(id, mount_str, fs_type, flags) == 0) {
         kprint("Partition mounted successfully");
     } else {
         kprint("Error: Failed to mount partition");
@@ -114,5 +132,5 @@ static void cmd_partmount(const char* args) {
 
 void cmd_module_partition_register(void) {
     command_register_with_category("partitions", "", "List disk partitions", "Partition", cmd_partitions);
-    command_register_with_category("partmount", "<id> <path> <fs>", "Mount partition", "Partition", cmd_partmount);
+    command_register_with_category("partmount", "<id> <path> <fs> [options]", "Mount partition", "Partition", cmd_partmount);
 }
@@ -29,6 +29,7 @@
 #include <fd.h>
 #include <string.h>
 #include <vmm.h>
+#include <smp.h>
 
 /* Symbols injected by objcopy from the embedded aosh.bin payload */
 extern char _binary_aosh_bin_start[];
@@ -185,6 +186,7 @@ void userspace_run(void) {
 
     /* --- Step 5: Enter ring 3 (never returns) --- */
     serial_puts("Entering ring 3 — handing control to userspace shell.\n");
+    smp_kernel_unlock();  // User mode never runs with the kernel lock held
     enter_usermode(user_code_addr, stack_top, 0, (void*)0);
 
     /* Should never get here */